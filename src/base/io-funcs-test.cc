@@ -144,6 +144,166 @@ void UnitTestIo(bool binary) {
   }
 }
 
+void UnitTestBinaryReader() {
+  std::stringstream ss;
+  int32 i1 = RandInt(-1000, 1000);
+  uint16 i2 = Rand() % 10000;
+  float f1 = RandUniform(), f2 = RandUniform();
+  double d1 = RandUniform(), d2 = RandUniform();
+  std::vector<int32> vec1(RandInt(0, 20), 3);
+  WriteBasicType(ss, true, i1);
+  WriteBasicType(ss, true, i2);
+  WriteToken(ss, true, "<Foo>");
+  WriteBasicType(ss, true, f1);
+  WriteBasicType(ss, true, f2);
+  WriteIntegerVector(ss, true, vec1);
+  WriteBasicType(ss, true, d1);
+  WriteBasicType(ss, true, d2);
+  WriteToken(ss, true, "<Bar>");
+  WriteBasicType(ss, true, i1);
+
+  BinaryReader reader(ss);
+  int32 i1_in;
+  reader.ReadBasicType(&i1_in);
+  KALDI_ASSERT(i1_in == i1);
+  uint16 i2_in;
+  reader.ReadBasicType(&i2_in);
+  KALDI_ASSERT(i2_in == i2);
+  std::string token;
+  reader.ReadToken(&token);
+  KALDI_ASSERT(token == "<Foo>");
+  float f1_in;  // same type.
+  reader.ReadBasicType(&f1_in);
+  AssertEqual(f1_in, f1);
+  double f2_in;  // wrong type.
+  reader.ReadBasicType(&f2_in);
+  AssertEqual(f2_in, f2);
+  // Reading from the stream itself can be mixed with the reader.
+  std::vector<int32> vec1_in;
+  ReadIntegerVector(ss, true, &vec1_in);
+  KALDI_ASSERT(vec1_in == vec1);
+  double d1_in;
+  reader.ReadBasicType(&d1_in);
+  AssertEqual(d1_in, d1);
+  float d2_in;
+  reader.ReadBasicType(&d2_in);
+  AssertEqual(d2_in, d2);
+  reader.ExpectToken("<Bar>");
+  bool threw = false;
+  try {
+    int64 wrong_type;
+    reader.ReadBasicType(&wrong_type);
+  } catch (const std::exception &e) {
+    threw = true;
+  }
+  KALDI_ASSERT(threw && ss.fail());
+}
+
+// A stringbuf that can't seek, like the streambuf of a pipe.
+class UnseekableStringBuf: public std::stringbuf {
+ public:
+  explicit UnseekableStringBuf(const std::string &str): std::stringbuf(str) { }
+ protected:
+  virtual pos_type seekoff(off_type, std::ios_base::seekdir,
+                           std::ios_base::openmode) {
+    return pos_type(off_type(-1));
+  }
+};
+
+void UnitTestSkipBytes(bool seekable) {
+  std::string data(100, 'a');
+  data[50] = 'b';
+  UnseekableStringBuf unseekable_buf(data);
+  std::istringstream seekable_is(data);
+  std::istream is(seekable ? seekable_is.rdbuf() : &unseekable_buf);
+  SkipBytes(is, 0);
+  SkipBytes(is, 50);
+  KALDI_ASSERT(is.get() == 'b');
+  SkipBytes(is, 49);  // exactly to the end, which is not an error.
+  KALDI_ASSERT(!is.fail() && is.peek() == EOF);
+  is.clear();
+  bool threw = false;
+  try {
+    SkipBytes(is, 1);
+  } catch (const std::exception &e) {
+    threw = true;
+  }
+  KALDI_ASSERT(threw && is.fail());
+}
+
+// Compares the speed of reading alignments and posteriors (in the format
+// written by WriteIntegerVector() and WritePosterior(), element by element)
+// with ReadBasicType() and with BinaryReader.
+void UnitTestBinaryReaderSpeed() {
+  int32 num_utts = 100, num_frames = 1000;
+  std::ostringstream ali_os, post_os;
+  for (int32 u = 0; u < num_utts; u++) {
+    WriteBasicType(ali_os, true, num_frames);
+    WriteBasicType(post_os, true, num_frames);
+    for (int32 t = 0; t < num_frames; t++) {
+      WriteBasicType(ali_os, true, RandInt(0, 5000));
+      int32 num_pdfs = RandInt(1, 3);
+      WriteBasicType(post_os, true, num_pdfs);
+      for (int32 i = 0; i < num_pdfs; i++) {
+        WriteBasicType(post_os, true, RandInt(0, 5000));
+        WriteBasicType(post_os, true, RandUniform());
+      }
+    }
+  }
+  double sums[2][2], times[2][2];
+  for (int32 use_reader = 0; use_reader < 2; use_reader++) {
+    Timer timer;
+    std::istringstream is(ali_os.str());
+    BinaryReader reader(is);
+    int64 sum = 0;
+    for (int32 u = 0; u < num_utts; u++) {
+      int32 size, pdf;
+      if (use_reader) reader.ReadBasicType(&size);
+      else ReadBasicType(is, true, &size);
+      for (int32 t = 0; t < size; t++) {
+        if (use_reader) reader.ReadBasicType(&pdf);
+        else ReadBasicType(is, true, &pdf);
+        sum += pdf;
+      }
+    }
+    sums[0][use_reader] = sum;
+    times[0][use_reader] = timer.Elapsed();
+  }
+  for (int32 use_reader = 0; use_reader < 2; use_reader++) {
+    Timer timer;
+    std::istringstream is(post_os.str());
+    BinaryReader reader(is);
+    double sum = 0.0;
+    for (int32 u = 0; u < num_utts; u++) {
+      int32 size, num_pdfs, pdf;
+      float weight;
+      if (use_reader) reader.ReadBasicType(&size);
+      else ReadBasicType(is, true, &size);
+      for (int32 t = 0; t < size; t++) {
+        if (use_reader) reader.ReadBasicType(&num_pdfs);
+        else ReadBasicType(is, true, &num_pdfs);
+        for (int32 i = 0; i < num_pdfs; i++) {
+          if (use_reader) {
+            reader.ReadBasicType(&pdf);
+            reader.ReadBasicType(&weight);
+          } else {
+            ReadBasicType(is, true, &pdf);
+            ReadBasicType(is, true, &weight);
+          }
+          sum += pdf * weight;
+        }
+      }
+    }
+    sums[1][use_reader] = sum;
+    times[1][use_reader] = timer.Elapsed();
+  }
+  KALDI_ASSERT(sums[0][0] == sums[0][1] && sums[1][0] == sums[1][1]);
+  KALDI_LOG << "Reading " << num_utts << " alignments took " << times[0][0]
+            << "s with ReadBasicType(), " << times[0][1]
+            << "s with BinaryReader; posteriors took " << times[1][0]
+            << "s and " << times[1][1] << "s.";
+}
+
 
 
 }  // end namespace kaldi.
@@ -153,7 +313,11 @@ int main() {
   for (size_t i = 0; i < 10; i++) {
     UnitTestIo(false);
     UnitTestIo(true);
+    UnitTestBinaryReader();
+    UnitTestSkipBytes(true);
+    UnitTestSkipBytes(false);
   }
+  UnitTestBinaryReaderSpeed();
   KALDI_ASSERT(1);  // just to check that KALDI_ASSERT does not fail for 1.
   return 0;
 }
@@ -189,7 +189,6 @@ int PeekToken(std::istream &is, bool binary) {
 
 
 void ExpectToken(std::istream &is, bool binary, const char *token) {
-  int pos_at_start = is.tellg();
   KALDI_ASSERT(token != NULL);
   CheckToken(token);  // make sure it's valid (can be read back)
   if (!binary) is >> std::ws;  // consume whitespace.
@@ -197,8 +196,12 @@ void ExpectToken(std::istream &is, bool binary, const char *token) {
   is >> str;
   is.get();  // consume the space.
   if (is.fail()) {
-    KALDI_ERR << "Failed to read token [started at file position "
-              << pos_at_start << "], expected " << token;
+    // We only get the file position here, as tellg() may be a system call.
+    is.clear();
+    std::streamoff pos = is.tellg();
+    is.setstate(std::ios_base::failbit);
+    KALDI_ERR << "Failed to read token [at file position " << pos
+              << "], expected " << token;
   }
   // The second half of the '&&' expression below is so that if we're expecting
   // "<Foo>", we will accept "Foo>" instead.  This is so that the model-reading
@@ -215,4 +218,89 @@ void ExpectToken(std::istream &is, bool binary, const std::string &token) {
   ExpectToken(is, binary, token.c_str());
 }
 
+void SkipBytes(std::istream &is, int64 num_bytes) {
+  KALDI_ASSERT(num_bytes >= 0);
+  if (num_bytes == 0 || is.fail())
+    return;
+  // We seek to the last byte to be skipped and read it, so that we notice if
+  // the stream is too short.
+  if (is.seekg(num_bytes - 1, std::ios_base::cur)) {
+    is.get();
+  } else {
+    is.clear();
+    is.ignore(num_bytes);
+    if (is.gcount() != num_bytes)
+      is.setstate(std::ios_base::failbit);
+  }
+  if (is.fail())
+    KALDI_ERR << "SkipBytes: encountered end of stream while skipping "
+              << num_bytes << " bytes.";
+}
+
+
+void BinaryReader::ReadBasicType(float *f) {
+  int c = buf_->sbumpc();
+  if (c == sizeof(*f)) {
+    ReadBytes(reinterpret_cast<char*>(f), sizeof(*f));
+  } else if (c == sizeof(double)) {
+    double d;
+    ReadBytes(reinterpret_cast<char*>(&d), sizeof(d));
+    *f = d;
+  } else {
+    Fail("ReadBasicType: expected float.");
+  }
+}
+
+void BinaryReader::ReadBasicType(double *d) {
+  int c = buf_->sbumpc();
+  if (c == sizeof(*d)) {
+    ReadBytes(reinterpret_cast<char*>(d), sizeof(*d));
+  } else if (c == sizeof(float)) {
+    float f;
+    ReadBytes(reinterpret_cast<char*>(&f), sizeof(f));
+    *d = f;
+  } else {
+    Fail("ReadBasicType: expected float.");
+  }
+}
+
+void BinaryReader::ReadToken(std::string *token) {
+  KALDI_ASSERT(token != NULL);
+  token->clear();
+  const int eof = std::char_traits<char>::eof();
+  int c = buf_->sgetc();
+  // Skip leading whitespace, as "is >> *token" would.
+  while (c != eof && isspace(c))
+    c = buf_->snextc();
+  while (c != eof && !isspace(c)) {
+    token->push_back(static_cast<char>(c));
+    c = buf_->snextc();
+  }
+  if (token->empty())
+    Fail("ReadToken, failed to read token.");
+  if (c == eof)
+    Fail("ReadToken, expected space after token, saw end of stream.");
+  buf_->sbumpc();  // consume the space.
+}
+
+void BinaryReader::ExpectToken(const char *token) {
+  KALDI_ASSERT(token != NULL);
+  std::string str;
+  ReadToken(&str);
+  // As in ExpectToken(), accept "Foo>" when expecting "<Foo>".
+  if (strcmp(str.c_str(), token) != 0 &&
+      !(token[0] == '<' && strcmp(str.c_str(), token + 1) == 0)) {
+    KALDI_ERR << "Expected token \"" << token << "\", got instead \""
+              << str <<"\".";
+  }
+}
+
+void BinaryReader::Fail(const char *msg) {
+  // pubseekoff() gives -1 for streams that can't seek, like tellg() does.
+  std::streamoff pos = buf_->pubseekoff(0, std::ios_base::cur,
+                                        std::ios_base::in);
+  is_.setstate(std::ios_base::failbit);
+  KALDI_ERR << msg << " [at file position " << pos << "]";
+}
+
 }  // end namespace kaldi
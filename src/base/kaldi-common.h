@@ -37,5 +37,6 @@
 #include "base/io-funcs.h"
 #include "base/kaldi-math.h"
 #include "base/timer.h"
+#include "base/trace-profiler.h"
 
 #endif  // KALDI_BASE_KALDI_COMMON_H_
@@ -0,0 +1,111 @@
+// base/trace-profiler-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//  http://www.apache.org/licenses/LICENSE-2.0
+
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/trace-profiler.h"
+#include "base/kaldi-common.h"
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace kaldi {
+
+static int64 CountOccurrences(const std::string &str, const std::string &pattern) {
+  int64 ans = 0;
+  for (size_t pos = str.find(pattern); pos != std::string::npos;
+       pos = str.find(pattern, pos + 1))
+    ans++;
+  return ans;
+}
+
+static void Work(int32 n) {
+  KALDI_TRACE_SCOPE("Work", n);
+  for (int32 i = 0; i < n; i++) {
+    KALDI_TRACE_SCOPE("Inner");
+    TraceProfiler::Counter("counter", i);
+  }
+}
+
+void UnitTestTraceProfilerDisabled() {
+  TraceProfiler::Clear();
+  KALDI_ASSERT(!TraceProfiler::Enabled());
+  Work(10);
+  std::ostringstream os;
+  TraceProfiler::WriteFoldedStacks(os);
+  KALDI_ASSERT(os.str().empty());
+}
+
+void UnitTestTraceProfilerNesting() {
+  TraceProfiler::Clear();
+  TraceProfiler::Start();
+  Work(5);
+  TraceProfiler::Stop();
+  Work(5);  // should not be recorded.
+
+  std::ostringstream folded;
+  TraceProfiler::WriteFoldedStacks(folded);
+  std::istringstream is(folded.str());
+  std::string path;
+  int64 us;
+  std::vector<std::string> paths;
+  while (is >> path >> us)
+    paths.push_back(path);
+  KALDI_ASSERT(paths.size() == 2 && paths[0] == "Work" &&
+               paths[1] == "Work;Inner");
+
+  std::ostringstream chrome;
+  TraceProfiler::WriteChromeTrace(chrome);
+  std::string trace = chrome.str();
+  KALDI_ASSERT(CountOccurrences(trace, "\"name\":\"Inner\",\"ph\":\"X\"") == 5);
+  KALDI_ASSERT(CountOccurrences(trace, "\"name\":\"Work\",\"ph\":\"X\"") == 1);
+  KALDI_ASSERT(CountOccurrences(trace, "\"ph\":\"C\"") == 5);
+  KALDI_ASSERT(CountOccurrences(trace, "\"args\":{\"arg\":5}") == 1);
+  KALDI_ASSERT(trace.substr(0, 15) == "{\"traceEvents\":");
+  TraceProfiler::PrintSummary();
+}
+
+void UnitTestTraceProfilerThreaded() {
+  TraceProfiler::Clear();
+  TraceProfiler::Start();
+  int32 num_threads = 4, n = 10000;  // more than one chunk per thread.
+  std::vector<std::thread> threads;
+  for (int32 t = 0; t < num_threads; t++)
+    threads.push_back(std::thread(Work, n));
+  // Reading while the other threads are recording should be safe.
+  std::ostringstream partial;
+  TraceProfiler::WriteChromeTrace(partial);
+  for (int32 t = 0; t < num_threads; t++)
+    threads[t].join();
+  TraceProfiler::Stop();
+
+  std::ostringstream chrome;
+  TraceProfiler::WriteChromeTrace(chrome);
+  KALDI_ASSERT(CountOccurrences(chrome.str(), "\"name\":\"Inner\",\"ph\":\"X\"")
+               == num_threads * n);
+  KALDI_ASSERT(CountOccurrences(chrome.str(), "\"name\":\"Work\",\"ph\":\"X\"")
+               == num_threads);
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestTraceProfilerDisabled();
+  UnitTestTraceProfilerNesting();
+  UnitTestTraceProfilerThreaded();
+  std::cout << "Test OK.\n";
+  return 0;
+}
@@ -0,0 +1,393 @@
+// base/trace-profiler.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//  http://www.apache.org/licenses/LICENSE-2.0
+
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/trace-profiler.h"
+#include "base/kaldi-error.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace kaldi {
+
+namespace {
+
+// An event is either a span (end_ns >= 0) or a counter value (end_ns == -1).
+struct TraceEvent {
+  const char *name;
+  int64 start_ns;
+  int64 end_ns;
+  int64 arg;
+  double value;
+};
+
+// The events of each thread are stored in a linked list of fixed-size chunks,
+// so that they never move; only the owning thread appends to them, and it
+// publishes each event by incrementing 'size' with release semantics, so other
+// threads can read them without locking.
+const int32 kTraceChunkSize = 4096;
+// Limit on the number of events per thread (about 160MB), to avoid running
+// out of memory in long runs.
+const int64 kTraceMaxEventsPerThread = 1 << 22;
+
+struct TraceChunk {
+  TraceEvent events[kTraceChunkSize];
+  std::atomic<int32> size;
+  std::atomic<TraceChunk*> next;
+  TraceChunk(): size(0), next(NULL) { }
+};
+
+struct ThreadTraceBuffer {
+  int32 thread_index;
+  TraceChunk *first;
+  TraceChunk *last;  // only accessed by the owning thread.
+  int64 num_events;  // only accessed by the owning thread.
+  explicit ThreadTraceBuffer(int32 thread_index):
+      thread_index(thread_index), first(new TraceChunk()), last(first),
+      num_events(0) { }
+};
+
+class TraceRegistry {
+ public:
+  TraceRegistry(): origin_ns_(0), warned_(false) { }
+
+  ThreadTraceBuffer *NewBuffer() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ThreadTraceBuffer *ans = new ThreadTraceBuffer(buffers_.size());
+    buffers_.push_back(ans);
+    return ans;
+  }
+
+  // Returns a snapshot of the buffers that exist now.
+  std::vector<ThreadTraceBuffer*> Buffers() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return buffers_;
+  }
+
+  std::mutex &Mutex() { return mutex_; }
+
+  // The following are protected by Mutex().
+  std::string filename_;
+  int64 origin_ns_;
+  bool warned_;
+
+  ~TraceRegistry() {
+    // Normally TraceProfiler::Stop() has written the trace by now (see
+    // ~ParseOptions()).  If not, e.g. because the program called exit(), we
+    // write it here as a last resort, but without the summary or any other
+    // logging, since the logging code may already have been destroyed.  We
+    // don't free the buffers, as other threads may still be running.
+    if (!filename_.empty()) {
+      std::ofstream os(filename_.c_str());
+      TraceProfiler::WriteChromeTrace(os);
+    }
+  }
+ private:
+  std::mutex mutex_;
+  std::vector<ThreadTraceBuffer*> buffers_;
+};
+
+TraceRegistry &GetTraceRegistry() {
+  static TraceRegistry registry;
+  return registry;
+}
+
+thread_local ThreadTraceBuffer *tls_trace_buffer = NULL;
+
+void AddTraceEvent(const TraceEvent &event) {
+  ThreadTraceBuffer *buffer = tls_trace_buffer;
+  if (buffer == NULL)
+    buffer = tls_trace_buffer = GetTraceRegistry().NewBuffer();
+  TraceChunk *chunk = buffer->last;
+  int32 size = chunk->size.load(std::memory_order_relaxed);
+  if (size == kTraceChunkSize) {
+    if (buffer->num_events >= kTraceMaxEventsPerThread) {
+      TraceRegistry &registry = GetTraceRegistry();
+      std::lock_guard<std::mutex> lock(registry.Mutex());
+      if (!registry.warned_) {
+        KALDI_WARN << "Reached the maximum number of trace events for a "
+                   << "thread; not recording any more.";
+        registry.warned_ = true;
+      }
+      return;
+    }
+    TraceChunk *new_chunk = new TraceChunk();
+    chunk->next.store(new_chunk, std::memory_order_release);
+    buffer->last = chunk = new_chunk;
+    size = 0;
+  }
+  chunk->events[size] = event;
+  chunk->size.store(size + 1, std::memory_order_release);
+  buffer->num_events++;
+}
+
+// Copies out the events of one thread.
+void GetTraceEvents(const ThreadTraceBuffer &buffer,
+                    std::vector<TraceEvent> *events) {
+  events->clear();
+  for (const TraceChunk *chunk = buffer.first; chunk != NULL;
+       chunk = chunk->next.load(std::memory_order_acquire)) {
+    int32 size = chunk->size.load(std::memory_order_acquire);
+    events->insert(events->end(), chunk->events, chunk->events + size);
+  }
+}
+
+bool SpanComparator(const TraceEvent &a, const TraceEvent &b) {
+  // Sort on start time; for equal start times, the outer (longer) span first.
+  if (a.start_ns != b.start_ns) return a.start_ns < b.start_ns;
+  return a.end_ns > b.end_ns;
+}
+
+// For each span of one thread, works out the enclosing spans and its
+// self-time, and calls callback(stack, self_ns), where stack.back() is the
+// span itself and the other elements are the enclosing spans, outermost
+// first.
+template <class F>
+void ProcessNestedSpans(std::vector<TraceEvent> *events, F callback) {
+  std::vector<TraceEvent> spans;
+  for (size_t i = 0; i < events->size(); i++)
+    if ((*events)[i].end_ns >= 0)
+      spans.push_back((*events)[i]);
+  std::sort(spans.begin(), spans.end(), SpanComparator);
+  std::vector<const TraceEvent*> stack;
+  std::vector<int64> child_ns;  // total time of the children of each stack
+                                // element.
+  for (size_t i = 0; i <= spans.size(); i++) {
+    // Pop the spans that finished before this one starts (at the end, pop
+    // everything).
+    while (!stack.empty() &&
+           (i == spans.size() || stack.back()->end_ns <= spans[i].start_ns)) {
+      const TraceEvent *span = stack.back();
+      int64 total_ns = span->end_ns - span->start_ns;
+      callback(stack, std::max<int64>(0, total_ns - child_ns.back()));
+      stack.pop_back();
+      child_ns.pop_back();
+      if (!child_ns.empty())
+        child_ns.back() += total_ns;
+    }
+    if (i < spans.size()) {
+      stack.push_back(&(spans[i]));
+      child_ns.push_back(0);
+    }
+  }
+}
+
+void WriteJsonString(const char *str, std::ostream &os) {
+  os << '"';
+  for (; *str != '\0'; str++) {
+    char c = *str;
+    if (c == '"' || c == '\\') os << '\\' << c;
+    else if (static_cast<unsigned char>(c) < 0x20) os << ' ';
+    else os << c;
+  }
+  os << '"';
+}
+
+}  // namespace
+
+
+std::atomic<bool> TraceProfiler::enabled_(false);
+
+int64 TraceProfiler::Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void TraceProfiler::Start(const std::string &filename) {
+  TraceRegistry &registry = GetTraceRegistry();
+  {
+    std::lock_guard<std::mutex> lock(registry.Mutex());
+    if (registry.origin_ns_ == 0)
+      registry.origin_ns_ = Now();
+    if (!filename.empty())
+      registry.filename_ = filename;
+  }
+  enabled_.store(true);
+}
+
+void TraceProfiler::Stop() {
+  enabled_.store(false);
+  TraceRegistry &registry = GetTraceRegistry();
+  std::string filename;
+  {
+    std::lock_guard<std::mutex> lock(registry.Mutex());
+    filename.swap(registry.filename_);
+  }
+  if (filename.empty())
+    return;
+  std::ofstream os(filename.c_str());
+  WriteChromeTrace(os);
+  os.close();
+  if (os.fail())
+    KALDI_WARN << "Error writing trace to " << filename;
+  else
+    KALDI_LOG << "Wrote trace to " << filename;
+  PrintSummary();
+}
+
+void TraceProfiler::Counter(const char *name, double value) {
+  if (!Enabled()) return;
+  TraceEvent event;
+  event.name = name;
+  event.start_ns = Now();
+  event.end_ns = -1;
+  event.arg = -1;
+  event.value = value;
+  AddTraceEvent(event);
+}
+
+void TraceProfiler::AddSpan(const char *name, int64 start_ns, int64 end_ns,
+                            int64 arg) {
+  TraceEvent event;
+  event.name = name;
+  event.start_ns = start_ns;
+  event.end_ns = end_ns;
+  event.arg = arg;
+  event.value = 0.0;
+  AddTraceEvent(event);
+}
+
+void TraceProfiler::WriteChromeTrace(std::ostream &os) {
+  TraceRegistry &registry = GetTraceRegistry();
+  int64 origin_ns;
+  {
+    std::lock_guard<std::mutex> lock(registry.Mutex());
+    origin_ns = registry.origin_ns_;
+  }
+  std::vector<ThreadTraceBuffer*> buffers = registry.Buffers();
+  std::vector<TraceEvent> events;
+  os << "{\"traceEvents\":[\n";
+  os << std::fixed << std::setprecision(3);
+  bool first = true;
+  for (size_t b = 0; b < buffers.size(); b++) {
+    int32 tid = buffers[b]->thread_index;
+    os << (first ? "" : ",\n")
+       << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+       << ",\"args\":{\"name\":\"thread " << tid << "\"}}";
+    first = false;
+    GetTraceEvents(*buffers[b], &events);
+    for (size_t i = 0; i < events.size(); i++) {
+      const TraceEvent &e = events[i];
+      double ts_us = (e.start_ns - origin_ns) * 1.0e-03;
+      os << ",\n{\"name\":";
+      WriteJsonString(e.name, os);
+      if (e.end_ns >= 0) {
+        os << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << ts_us
+           << ",\"dur\":" << (e.end_ns - e.start_ns) * 1.0e-03;
+        if (e.arg >= 0)
+          os << ",\"args\":{\"arg\":" << e.arg << "}";
+        os << "}";
+      } else {
+        os << ",\"ph\":\"C\",\"pid\":1,\"tid\":" << tid << ",\"ts\":" << ts_us
+           << ",\"args\":{\"value\":" << e.value << "}}";
+      }
+    }
+  }
+  os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+namespace {
+struct FoldedStacksAccumulator {
+  std::map<std::string, int64> *self_ns;
+  void operator () (const std::vector<const TraceEvent*> &stack,
+                    int64 span_self_ns) {
+    std::string path;
+    for (size_t i = 0; i < stack.size(); i++) {
+      if (i > 0) path += ';';
+      path += stack[i]->name;
+    }
+    (*self_ns)[path] += span_self_ns;
+  }
+};
+
+struct SpanStats {
+  int64 count;
+  int64 total_ns;
+  int64 self_ns;
+  SpanStats(): count(0), total_ns(0), self_ns(0) { }
+};
+
+struct SummaryAccumulator {
+  std::map<std::string, SpanStats> *stats;
+  void operator () (const std::vector<const TraceEvent*> &stack,
+                    int64 span_self_ns) {
+    const TraceEvent *span = stack.back();
+    SpanStats &s = (*stats)[span->name];
+    s.count++;
+    s.total_ns += span->end_ns - span->start_ns;
+    s.self_ns += span_self_ns;
+  }
+};
+
+bool CompareSelfTime(const std::pair<std::string, SpanStats> &a,
+                     const std::pair<std::string, SpanStats> &b) {
+  return a.second.self_ns > b.second.self_ns;
+}
+}  // namespace
+
+void TraceProfiler::WriteFoldedStacks(std::ostream &os) {
+  std::vector<ThreadTraceBuffer*> buffers = GetTraceRegistry().Buffers();
+  std::map<std::string, int64> self_ns;
+  FoldedStacksAccumulator acc;
+  acc.self_ns = &self_ns;
+  std::vector<TraceEvent> events;
+  for (size_t b = 0; b < buffers.size(); b++) {
+    GetTraceEvents(*buffers[b], &events);
+    ProcessNestedSpans(&events, acc);
+  }
+  for (std::map<std::string, int64>::const_iterator iter = self_ns.begin();
+       iter != self_ns.end(); ++iter)
+    os << iter->first << ' ' << (iter->second / 1000) << '\n';
+}
+
+void TraceProfiler::PrintSummary() {
+  std::vector<ThreadTraceBuffer*> buffers = GetTraceRegistry().Buffers();
+  std::map<std::string, SpanStats> stats;
+  SummaryAccumulator acc;
+  acc.stats = &stats;
+  std::vector<TraceEvent> events;
+  for (size_t b = 0; b < buffers.size(); b++) {
+    GetTraceEvents(*buffers[b], &events);
+    ProcessNestedSpans(&events, acc);
+  }
+  std::vector<std::pair<std::string, SpanStats> > pairs(stats.begin(),
+                                                        stats.end());
+  std::sort(pairs.begin(), pairs.end(), CompareSelfTime);
+  for (size_t i = 0; i < pairs.size(); i++) {
+    const SpanStats &s = pairs[i].second;
+    KALDI_LOG << "Trace: " << pairs[i].first << ": " << s.count
+              << " calls, self-time " << std::fixed << std::setprecision(3)
+              << s.self_ns * 1.0e-09 << "s, total time "
+              << s.total_ns * 1.0e-09 << "s.";
+  }
+}
+
+void TraceProfiler::Clear() {
+  std::vector<ThreadTraceBuffer*> buffers = GetTraceRegistry().Buffers();
+  for (size_t b = 0; b < buffers.size(); b++) {
+    for (TraceChunk *chunk = buffers[b]->first; chunk != NULL;
+         chunk = chunk->next.load(std::memory_order_acquire))
+      chunk->size.store(0, std::memory_order_release);
+    buffers[b]->num_events = 0;
+  }
+}
+
+}  // namespace kaldi
@@ -0,0 +1,137 @@
+// base/trace-profiler.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//  http://www.apache.org/licenses/LICENSE-2.0
+
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_BASE_TRACE_PROFILER_H_
+#define KALDI_BASE_TRACE_PROFILER_H_
+
+#include <atomic>
+#include <ostream>
+#include <string>
+#include "base/kaldi-types.h"
+
+namespace kaldi {
+
+/**
+   TraceProfiler records "spans" (timed, possibly nested, regions of code) and
+   "counters" (time-stamped values), from any number of threads, so that you
+   can see where the time goes in a decoding or training run.  Unlike
+   Profiler/KALDI_PROFILE (see timer.h), which keeps flat per-function totals,
+   this keeps the individual events with the thread they happened on, so they
+   can be exported as a timeline.
+
+   It is off by default, in which case a span costs a single atomic load.  It
+   is switched on at runtime with the standard option --trace-file (see
+   ParseOptions), or by calling Start() directly.  Each thread appends to its
+   own buffer, so recording does not take any locks.
+
+   The output of WriteChromeTrace() is JSON in the "trace event" format, which
+   can be viewed in chrome://tracing, in Perfetto (ui.perfetto.dev), or in
+   speedscope (which also shows it as a flame graph); WriteFoldedStacks()
+   writes the format expected by Brendan Gregg's flamegraph.pl.
+
+   Example:
+   \code
+     void Foo() {
+       KALDI_TRACE_SCOPE("Foo");
+       ...
+       TraceProfiler::Counter("num-active-tokens", num_toks);
+     }
+   \endcode
+*/
+class TraceProfiler {
+ public:
+  /// Starts recording.  If 'filename' is nonempty, a Chrome trace will be
+  /// written to it, and a summary printed to the log, when Stop() is called.
+  /// Call Stop() before main() returns (for --trace-file, ParseOptions does
+  /// this in its destructor); if it is never called, the trace (but not the
+  /// summary) is written during static destruction, as a last resort.
+  static void Start(const std::string &filename = "");
+
+  /// Stops recording; if Start() was given a filename, writes the trace and
+  /// prints the summary.  Spans that are open at this point are not recorded.
+  static void Stop();
+
+  static inline bool Enabled() {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /// Records the value of a counter (shown as a graph by the trace viewers).
+  /// Caution: 'name' should be a string constant, as only the pointer is
+  /// stored.  Does nothing if not enabled.
+  static void Counter(const char *name, double value);
+
+  /// Returns the time in nanoseconds since an arbitrary fixed point.
+  static int64 Now();
+
+  /// Records a completed span; you would normally use TraceSpan or
+  /// KALDI_TRACE_SCOPE instead.  'name' should be a string constant.
+  static void AddSpan(const char *name, int64 start_ns, int64 end_ns,
+                      int64 arg);
+
+  /// Writes all the events recorded so far as a Chrome trace (JSON).  The
+  /// other threads may still be recording while this is called; events that
+  /// are added after the call starts may or may not be included.
+  static void WriteChromeTrace(std::ostream &os);
+
+  /// Writes the recorded spans in the "folded stacks" format ("a;b;c <us>",
+  /// where the number is the self-time in microseconds of the call path
+  /// a;b;c, summed over all threads), for flamegraph.pl.
+  static void WriteFoldedStacks(std::ostream &os);
+
+  /// Prints to the log, for each span name, the number of calls, the total
+  /// time and the self-time (i.e. excluding nested spans), sorted on the
+  /// self-time.
+  static void PrintSummary();
+
+  /// Discards all recorded events (not thread safe with respect to threads
+  /// that are recording; intended for testing).
+  static void Clear();
+
+ private:
+  static std::atomic<bool> enabled_;
+};
+
+/// RAII object that records a span from its construction to its destruction.
+/// 'name' should be a string constant.  'arg' is an optional integer that is
+/// shown with the span in the trace viewer (e.g. a frame or command index).
+class TraceSpan {
+ public:
+  explicit TraceSpan(const char *name, int64 arg = -1):
+      name_(name), arg_(arg),
+      start_(TraceProfiler::Enabled() ? TraceProfiler::Now() : -1) { }
+  ~TraceSpan() {
+    if (start_ >= 0 && TraceProfiler::Enabled())
+      TraceProfiler::AddSpan(name_, start_, TraceProfiler::Now(), arg_);
+  }
+ private:
+  const char *name_;
+  int64 arg_;
+  int64 start_;
+};
+
+#define KALDI_TRACE_CONCAT_INTERNAL(a, b) a##b
+#define KALDI_TRACE_CONCAT(a, b) KALDI_TRACE_CONCAT_INTERNAL(a, b)
+
+/// Records a span named 'name' (a string constant) for the rest of the
+/// enclosing scope.  An optional second argument gives an integer shown
+/// with the span.
+#define KALDI_TRACE_SCOPE(...) \
+  ::kaldi::TraceSpan KALDI_TRACE_CONCAT(_kaldi_trace_span_, __LINE__)(__VA_ARGS__)
+
+}  // namespace kaldi
+
+#endif  // KALDI_BASE_TRACE_PROFILER_H_
@@ -0,0 +1,65 @@
+// bin/compute-graph-lookahead.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "fstext/fstext-lib.h"
+#include "decoder/graph-lookahead.h"
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Compute, for each state of a decoding graph, the cost of the best path\n"
+        "from it to a final state, for use as graph lookahead in pruning by\n"
+        "the lattice-faster decoders (see their --graph-lookahead option).\n"
+        "\n"
+        "Usage:   compute-graph-lookahead [options] <fst-in> <lookahead-out>\n"
+        "e.g.: \n"
+        " compute-graph-lookahead exp/tri3/graph/HCLG.fst exp/tri3/graph/HCLG.lookahead\n";
+    ParseOptions po(usage);
+
+    bool binary = true;
+    po.Register("binary", &binary, "Write output in binary mode");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string fst_in_str = po.GetArg(1),
+        lookahead_wxfilename = po.GetArg(2);
+
+    fst::Fst<fst::StdArc> *fst = fst::ReadFstKaldiGeneric(fst_in_str);
+    GraphLookahead lookahead;
+    lookahead.Compute(*fst);
+    delete fst;
+
+    WriteKaldiObject(lookahead, lookahead_wxfilename, binary);
+    KALDI_LOG << "Wrote graph lookahead for " << lookahead.NumStates()
+              << " states to " << lookahead_wxfilename;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
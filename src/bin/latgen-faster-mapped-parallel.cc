@@ -28,8 +28,8 @@
 #include "fstext/fstext-lib.h"
 #include "decoder/decoder-wrappers.h"
 #include "decoder/decodable-matrix.h"
+#include "decoder/lattice-faster-decoder-pool.h"
 #include "base/timer.h"
-#include "util/kaldi-thread.h"
 
 int main(int argc, char *argv[]) {
   try {
@@ -49,11 +49,11 @@ int main(int argc, char *argv[]) {
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
-    TaskSequencerConfig sequencer_config; // has --num-threads option
+    LatticeFasterDecoderPoolConfig pool_config; // has --num-threads option
 
     std::string word_syms_filename;
     config.Register(&po);
-    sequencer_config.Register(&po);
+    pool_config.Register(&po);
 
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
 
@@ -95,13 +95,14 @@ int main(int argc, char *argv[]) {
         KALDI_ERR << "Could not read symbol table from file "
                    << word_syms_filename;
 
-    double tot_like = 0.0;
-    kaldi::int64 frame_count = 0;
-    int num_success = 0, num_fail = 0;
+    int num_fail = 0;  // utterances we skipped before decoding.
     Fst<StdArc> *decode_fst = NULL; // only used if there is a single
                                     // decoding graph.
 
-    TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(sequencer_config);
+    LatticeFasterDecoderPool pool(pool_config, config, trans_model, word_syms,
+                                  acoustic_scale, determinize, allow_partial,
+                                  &alignment_writer, &words_writer,
+                                  &compact_lattice_writer, &lattice_writer);
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
@@ -120,19 +121,11 @@ int main(int argc, char *argv[]) {
             continue;
           }
 
-          LatticeFasterDecoder *decoder = new LatticeFasterDecoder(*decode_fst,
-                                                                   config);
           DecodableMatrixScaledMapped *decodable =
               new DecodableMatrixScaledMapped(trans_model, acoustic_scale, loglikes);
-          DecodeUtteranceLatticeFasterClass *task =
-              new DecodeUtteranceLatticeFasterClass(
-                  decoder, decodable, trans_model, word_syms, utt,
-                  acoustic_scale, determinize, allow_partial, &alignment_writer,
-                  &words_writer, &compact_lattice_writer, &lattice_writer,
-                  &tot_like, &frame_count, &num_success, &num_fail, NULL);
-
-          sequencer.Run(task); // takes ownership of "task",
-          // and will delete it when done.
+          // The pool reuses its decoders for decode_fst across utterances.
+          pool.Decode(utt, decode_fst, false, decodable); // takes ownership of
+          // "decodable", and will delete it when done.
         }
       }
     } else { // We have different FSTs for different utterances.
@@ -154,31 +147,30 @@ int main(int argc, char *argv[]) {
           delete loglikes;
           continue;
         }
-        fst::VectorFst<StdArc> *fst = 
+        fst::VectorFst<StdArc> *fst =
           new fst::VectorFst<StdArc>(fst_reader.Value());
-        LatticeFasterDecoder *decoder =
-          new LatticeFasterDecoder(config, fst);
         DecodableMatrixScaledMapped *decodable = new
             DecodableMatrixScaledMapped(trans_model, acoustic_scale, loglikes);
-        DecodeUtteranceLatticeFasterClass *task =
-            new DecodeUtteranceLatticeFasterClass(
-                decoder, decodable, trans_model, word_syms, utt, acoustic_scale,
-                determinize, allow_partial, &alignment_writer, &words_writer,
-                &compact_lattice_writer, &lattice_writer, &tot_like,
-                &frame_count, &num_success, &num_fail, NULL);
-        sequencer.Run(task); // takes ownership of "task",
-        // and will delete it when done.
+        pool.Decode(utt, fst, true, decodable); // takes ownership of "fst" and
+        // "decodable", and will delete them when done.
       }
     }
-    sequencer.Wait();
+    pool.Wait();
 
+    // The pool's decoders still point to decode_fst, but won't access it
+    // after Wait().
     delete decode_fst;
 
+    double tot_like = pool.TotLike();
+    kaldi::int64 frame_count = pool.NumFrames();
+    int num_success = pool.NumDone();
+    num_fail += pool.NumErr();
+
     double elapsed = timer.Elapsed();
-    KALDI_LOG << "Decoded with " << sequencer_config.num_threads << " threads.";
+    KALDI_LOG << "Decoded with " << pool_config.num_threads << " threads.";
     KALDI_LOG << "Time taken "<< elapsed
               << "s: real-time factor per thread assuming 100 frames/sec is "
-              << (sequencer_config.num_threads*elapsed*100.0/frame_count);
+              << (pool_config.num_threads*elapsed*100.0/frame_count);
     KALDI_LOG << "Done " << num_success << " utterances, failed for "
               << num_fail;
     KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count) << " over "
@@ -45,16 +45,22 @@ int main(int argc, char *argv[]) {
         " lattice-wspecifier [ words-wspecifier [alignments-wspecifier] ]\n";
     ParseOptions po(usage);
     Timer timer;
-    bool allow_partial = false;
+    bool allow_partial = false, flat_graph = false;
     BaseFloat acoustic_scale = 0.1;
     LatticeFasterDecoderConfig config;
 
-    std::string word_syms_filename;
+    std::string word_syms_filename, graph_lookahead_rxfilename;
     config.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
 
     po.Register("word-symbol-table", &word_syms_filename, "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial, "If true, produce output even if end state was not reached.");
+    po.Register("graph-lookahead", &graph_lookahead_rxfilename, "Table of "
+                "best future graph costs per state, from compute-graph-lookahead, "
+                "to use in pruning (only with a single FST).");
+    po.Register("flat-graph", &flat_graph, "If true, convert the decoding graph "
+                "to FlatFst, a layout that is faster to decode with (see "
+                "decoder/flat-fst.h), after reading it (only with a single FST).");
 
     po.Read(argc, argv);
 
@@ -99,10 +105,31 @@ int main(int argc, char *argv[]) {
       SequentialBaseFloatMatrixReader loglike_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
       Fst<StdArc> *decode_fst = fst::ReadFstKaldiGeneric(fst_in_str);
+      fst::FlatFst *flat_fst = NULL;
+      if (flat_graph) {
+        flat_fst = new fst::FlatFst(*decode_fst);
+        delete decode_fst;
+        decode_fst = NULL;
+      }
       timer.Reset();
 
       {
-        LatticeFasterDecoder decoder(*decode_fst, config);
+        // Only one of these is used, depending on --flat-graph.
+        LatticeFasterDecoder *decoder = NULL;
+        LatticeFasterDecoderTpl<fst::FlatFst> *flat_decoder = NULL;
+        if (flat_fst != NULL)
+          flat_decoder = new LatticeFasterDecoderTpl<fst::FlatFst>(*flat_fst,
+                                                                   config);
+        else
+          decoder = new LatticeFasterDecoder(*decode_fst, config);
+        GraphLookahead graph_lookahead;
+        if (!graph_lookahead_rxfilename.empty()) {
+          ReadKaldiObject(graph_lookahead_rxfilename, &graph_lookahead);
+          if (flat_decoder != NULL)
+            flat_decoder->SetGraphLookahead(&graph_lookahead);
+          else
+            decoder->SetGraphLookahead(&graph_lookahead);
+        }
 
         for (; !loglike_reader.Done(); loglike_reader.Next()) {
           std::string utt = loglike_reader.Key();
@@ -117,19 +144,36 @@ int main(int argc, char *argv[]) {
           DecodableMatrixScaledMapped decodable(trans_model, loglikes, acoustic_scale);
 
           double like;
-          if (DecodeUtteranceLatticeFaster(
-                  decoder, decodable, trans_model, word_syms, utt,
-                  acoustic_scale, determinize, allow_partial, &alignment_writer,
-                  &words_writer, &compact_lattice_writer, &lattice_writer,
-                  &like)) {
+          bool ok = (flat_decoder != NULL ?
+                     DecodeUtteranceLatticeFaster(
+                         *flat_decoder, decodable, trans_model, word_syms, utt,
+                         acoustic_scale, determinize, allow_partial,
+                         &alignment_writer, &words_writer,
+                         &compact_lattice_writer, &lattice_writer, &like) :
+                     DecodeUtteranceLatticeFaster(
+                         *decoder, decodable, trans_model, word_syms, utt,
+                         acoustic_scale, determinize, allow_partial,
+                         &alignment_writer, &words_writer,
+                         &compact_lattice_writer, &lattice_writer, &like));
+          if (ok) {
             tot_like += like;
             frame_count += loglikes.NumRows();
             num_success++;
           } else num_fail++;
         }
+        delete decoder;
+        delete flat_decoder;
       }
-      delete decode_fst; // delete this only after decoder goes out of scope.
+      // delete these only after the decoder has been deleted.
+      delete decode_fst;
+      delete flat_fst;
     } else { // We have different FSTs for different utterances.
+      if (!graph_lookahead_rxfilename.empty())
+        KALDI_WARN << "--graph-lookahead is ignored when decoding with "
+                   << "per-utterance FSTs.";
+      if (flat_graph)
+        KALDI_WARN << "--flat-graph is ignored when decoding with "
+                   << "per-utterance FSTs.";
       SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_in_str);
       RandomAccessBaseFloatMatrixReader loglike_reader(feature_rspecifier);
       for (; !fst_reader.Done(); fst_reader.Next()) {
@@ -79,6 +79,9 @@ namespace nnet3 {
                                       and input frames.
      @param [in]  utt_id              Utterance-id
      @param [in]  compress            If true, compresses the feature matrices.
+     @param [in]  compression_method  If not kAutomaticMethod, the method with
+                                      which the input features are compressed
+                                      (even if already compressed).
      @param [out]  utt_splitter       Pointer to UtteranceSplitter object,
                                       which helps to split an utterance into
                                       chunks. This also stores some stats.
@@ -95,7 +98,8 @@ static bool ProcessFile(const TransitionModel *trans_mdl,
                         const VectorBase<BaseFloat> *deriv_weights,
                         int32 supervision_length_tolerance,
                         const std::string &utt_id,
-                        bool compress, bool long_key,
+                        bool compress, CompressionMethod compression_method,
+                        bool long_key,
                         UtteranceSplitter *utt_splitter,
                         NnetChainExampleWriter *example_writer) {
   KALDI_ASSERT(supervision.num_sequences == 1);
@@ -204,6 +208,8 @@ static bool ProcessFile(const TransitionModel *trans_mdl,
     GeneralMatrix input_frames;
     ExtractRowRangeWithPadding(feats, start_frame, tot_input_frames,
                                &input_frames);
+    if (compress && compression_method != kAutomaticMethod)
+      input_frames.Compress(compression_method);
 
     NnetIo input_io("input", -chunk.left_context, input_frames);
     nnet_chain_eg.inputs[0].Swap(&input_io);
@@ -224,9 +230,6 @@ static bool ProcessFile(const TransitionModel *trans_mdl,
       nnet_chain_eg.inputs[1].Swap(&ivector_io);
     }
 
-    if (compress)
-      nnet_chain_eg.Compress();
-
     std::ostringstream os;
     if (long_key)
       os << utt_id
@@ -237,7 +240,11 @@ static bool ProcessFile(const TransitionModel *trans_mdl,
 
     std::string key = os.str(); 
 
-    example_writer->Write(key, nnet_chain_eg);
+    if (compress)  // with the "bg" wspecifier option, compresses in the
+                   // background.
+      example_writer->WriteCompressed(key, &nnet_chain_eg);
+    else
+      example_writer->Write(key, nnet_chain_eg);
   }
   return true;
 }
@@ -271,6 +278,7 @@ int main(int argc, char *argv[]) {
         "chain-get-supervision.\n";
 
     bool compress = true, long_key = false;
+    int32 compression_method_in = 1;
     int32 length_tolerance = 100, online_ivector_period = 1,
           supervision_length_tolerance = 1;
 
@@ -288,7 +296,15 @@ int main(int argc, char *argv[]) {
                 "in compressed format (recommended).  Update: this is now "
                 "only relevant if the features being read are un-compressed; "
                 "if already compressed, we keep the same compressed format when "
-                "dumping egs.");
+                "dumping egs.  With the bg option in the wspecifier (e.g. "
+                "ark,bg:-), compression is done in background threads.");
+    po.Register("compression-method", &compression_method_in, "Only "
+                "relevant if --compress=true; if not 1 (automatic), the "
+                "method with which the input features of the egs are "
+                "compressed, even if the features being read are already "
+                "compressed (e.g. use 2 for features that were stored with "
+                "method 8, which is slow to decompress).  Search for "
+                "CompressionMethod in src/matrix/compressed-matrix.h.");
     po.Register("ivectors", &online_ivector_rspecifier, "Alias for "
                 "--online-ivectors option, for back compatibility");
     po.Register("online-ivectors", &online_ivector_rspecifier, "Rspecifier of "
@@ -433,7 +449,9 @@ int main(int argc, char *argv[]) {
         if (!ProcessFile(trans_mdl_ptr, normalization_fst, feats,
                          online_ivector_feats, online_ivector_period,
                          supervision, deriv_weights, supervision_length_tolerance,
-                         key, compress, long_key,
+                         key, compress,
+                         static_cast<CompressionMethod>(compression_method_in),
+                         long_key,
                          &utt_splitter, &example_writer))
           num_err++;
       }
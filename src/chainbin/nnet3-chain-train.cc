@@ -88,8 +88,7 @@ int main(int argc, char *argv[]) {
 
       SequentialNnetChainExampleReader example_reader(examples_rspecifier);
 
-      for (; !example_reader.Done(); example_reader.Next())
-        trainer.Train(example_reader.Value());
+      trainer.Train(&example_reader);
 
       ok = trainer.PrintTotalStats();
     }
@@ -0,0 +1,204 @@
+// cudamatrix/cu-math-speed-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <iostream>
+#include <vector>
+#include <cstdlib>
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "cudamatrix/cu-matrix.h"
+#include "cudamatrix/cu-vector.h"
+#include "cudamatrix/cu-math.h"
+
+using namespace kaldi;
+
+
+namespace kaldi {
+
+template<typename Real>
+std::string NameOf() {
+  return (sizeof(Real) == 8 ? "<double>" : "<float>");
+}
+
+// The speeds below are given in millions of cells per second, where a cell is
+// one of the num_rows * cell_dim elements of the LSTM or GRU cell state.
+
+// Compares the speed of the reference CPU implementation of the LSTM
+// nonlinearity (forward) with the fused one.
+template<typename Real> void TestCpuComputeLstmNonlinearity(int32 dim) {
+  BaseFloat time_in_secs = 0.05;
+  int32 num_rows = dim, cell_dim = dim;
+  Matrix<Real> input(num_rows, 5 * cell_dim), params(3, cell_dim),
+      output(num_rows, 2 * cell_dim);
+  input.SetRandn();
+  params.SetRandn();
+
+  Timer tim;
+  int32 iter = 0;
+  for (; tim.Elapsed() < time_in_secs; iter++)
+    cu::CpuComputeLstmNonlinearity(input, params, &output);
+  BaseFloat fdim = dim,
+      ref_speed = (fdim * fdim * iter) / (tim.Elapsed() * 1.0e+06);
+
+  tim.Reset();
+  iter = 0;
+  for (; tim.Elapsed() < time_in_secs; iter++)
+    cu::CpuFusedComputeLstmNonlinearity(input, params, &output);
+  BaseFloat fused_speed = (fdim * fdim * iter) / (tim.Elapsed() * 1.0e+06);
+
+  KALDI_LOG << "For CpuComputeLstmNonlinearity" << NameOf<Real>()
+            << ", for dim = " << dim << ", speed was " << ref_speed
+            << " (reference) vs. " << fused_speed
+            << " (fused) million cells per second.";
+}
+
+// Compares the speed of the reference CPU implementation of the LSTM
+// nonlinearity (backward) with the fused one.
+template<typename Real> void TestCpuBackpropLstmNonlinearity(int32 dim) {
+  BaseFloat time_in_secs = 0.05;
+  int32 num_rows = dim, cell_dim = dim;
+  Matrix<Real> input(num_rows, 5 * cell_dim), params(3, cell_dim),
+      output_deriv(num_rows, 2 * cell_dim),
+      input_deriv(num_rows, 5 * cell_dim), params_deriv(3, cell_dim),
+      self_repair_sum_out(5, cell_dim);
+  Matrix<double> deriv_sum(5, cell_dim), value_sum(5, cell_dim);
+  Vector<Real> self_repair_config(10);
+  input.SetRandn();
+  params.SetRandn();
+  output_deriv.SetRandn();
+
+  Timer tim;
+  int32 iter = 0;
+  for (; tim.Elapsed() < time_in_secs; iter++)
+    cu::CpuBackpropLstmNonlinearity(input, params, output_deriv, deriv_sum,
+                                    self_repair_config, 0.0, &input_deriv,
+                                    &params_deriv, &value_sum, &deriv_sum,
+                                    &self_repair_sum_out);
+  BaseFloat fdim = dim,
+      ref_speed = (fdim * fdim * iter) / (tim.Elapsed() * 1.0e+06);
+
+  tim.Reset();
+  iter = 0;
+  for (; tim.Elapsed() < time_in_secs; iter++)
+    cu::CpuFusedBackpropLstmNonlinearity(input, params, output_deriv, deriv_sum,
+                                         self_repair_config, 0.0, &input_deriv,
+                                         &params_deriv, &value_sum, &deriv_sum,
+                                         &self_repair_sum_out);
+  BaseFloat fused_speed = (fdim * fdim * iter) / (tim.Elapsed() * 1.0e+06);
+
+  KALDI_LOG << "For CpuBackpropLstmNonlinearity" << NameOf<Real>()
+            << ", for dim = " << dim << ", speed was " << ref_speed
+            << " (reference) vs. " << fused_speed
+            << " (fused) million cells per second.";
+}
+
+// Compares the speed of the elementwise part of the GRU nonlinearity done
+// as a sequence of matrix operations (as GruNonlinearityComponent used to do
+// it) with the fused versions.
+template<typename Real> void TestCpuGruNonlinearity(int32 dim) {
+  BaseFloat time_in_secs = 0.05;
+  int32 num_rows = dim, cell_dim = dim;
+  Matrix<Real> z_t(num_rows, cell_dim), c_t1(num_rows, cell_dim),
+      h_t_in(num_rows, cell_dim), h_t(num_rows, cell_dim),
+      c_t(num_rows, cell_dim), c_t_deriv(num_rows, cell_dim),
+      h_t_deriv(num_rows, cell_dim), z_t_deriv(num_rows, cell_dim),
+      c_t1_deriv(num_rows, cell_dim);
+  z_t.SetRandn();
+  c_t1.SetRandn();
+  h_t_in.SetRandn();
+  c_t_deriv.SetRandn();
+
+  Timer tim;
+  int32 iter = 0;
+  for (; tim.Elapsed() < time_in_secs; iter++) {
+    h_t.Tanh(h_t_in);
+    c_t.CopyFromMat(h_t);
+    c_t.AddMatMatElements(-1.0, z_t, h_t, 1.0);
+    c_t.AddMatMatElements(1.0, z_t, c_t1, 1.0);
+  }
+  BaseFloat fdim = dim,
+      ref_forward_speed = (fdim * fdim * iter) / (tim.Elapsed() * 1.0e+06);
+
+  tim.Reset();
+  iter = 0;
+  for (; tim.Elapsed() < time_in_secs; iter++) {
+    h_t.CopyFromMat(h_t_in);
+    cu::CpuComputeGruNonlinearity(z_t, c_t1, &h_t, &c_t);
+  }
+  BaseFloat fused_forward_speed =
+      (fdim * fdim * iter) / (tim.Elapsed() * 1.0e+06);
+
+  tim.Reset();
+  iter = 0;
+  for (; tim.Elapsed() < time_in_secs; iter++) {
+    h_t_deriv.SetZero();
+    h_t_deriv.AddMat(1.0, c_t_deriv);
+    h_t_deriv.AddMatMatElements(-1.0, c_t_deriv, z_t, 1.0);
+    z_t_deriv.AddMatMatElements(-1.0, c_t_deriv, h_t, 1.0);
+    z_t_deriv.AddMatMatElements(1.0, c_t_deriv, c_t1, 1.0);
+    c_t1_deriv.AddMatMatElements(1.0, c_t_deriv, z_t, 1.0);
+    h_t_deriv.DiffTanh(h_t, h_t_deriv);
+  }
+  BaseFloat ref_backward_speed =
+      (fdim * fdim * iter) / (tim.Elapsed() * 1.0e+06);
+
+  tim.Reset();
+  iter = 0;
+  for (; tim.Elapsed() < time_in_secs; iter++) {
+    h_t_deriv.SetZero();
+    cu::CpuBackpropGruNonlinearity(z_t, h_t, c_t1, c_t_deriv, &h_t_deriv,
+                                   &z_t_deriv, &c_t1_deriv);
+  }
+  BaseFloat fused_backward_speed =
+      (fdim * fdim * iter) / (tim.Elapsed() * 1.0e+06);
+
+  KALDI_LOG << "For GRU nonlinearity" << NameOf<Real>() << ", for dim = "
+            << dim << ", forward speed was " << ref_forward_speed
+            << " (reference) vs. " << fused_forward_speed
+            << " (fused); backward speed was "
+            << ref_backward_speed << " (reference) vs. "
+            << fused_backward_speed << " (fused) million cells per second.";
+}
+
+template<typename Real> void CudaMathSpeedTest() {
+  std::vector<int32> sizes;
+  sizes.push_back(16);
+  sizes.push_back(64);
+  sizes.push_back(256);
+  sizes.push_back(1024);
+  int32 ns = sizes.size();
+  for (int32 s = 0; s < ns; s++)
+    TestCpuComputeLstmNonlinearity<Real>(sizes[s]);
+  for (int32 s = 0; s < ns; s++)
+    TestCpuBackpropLstmNonlinearity<Real>(sizes[s]);
+  for (int32 s = 0; s < ns; s++)
+    TestCpuGruNonlinearity<Real>(sizes[s]);
+}
+
+
+} // namespace kaldi
+
+
+int main() {
+  kaldi::SetVerboseLevel(1);
+  // These tests are of CPU code only, so we don't select a GPU.
+  kaldi::CudaMathSpeedTest<float>();
+  kaldi::CudaMathSpeedTest<double>();
+  KALDI_LOG << "Tests succeeded.";
+}
@@ -476,6 +476,119 @@ static void UnitTestBackpropLstmNonlinearity() {
   }
 }
 
+// Checks that the fused CPU versions of the LSTM nonlinearity give the same
+// results as the reference (non-fused) CPU versions, to the tolerance stated
+// in cu-math.h.
+template<typename Real>
+static void UnitTestCpuFusedLstmNonlinearity() {
+  for (int i = 0; i < 5; i++) {
+    int32 num_rows = 1 + Rand() % 100;
+    int32 cell_dim = 1 + Rand() % 500,
+       dropout_dim = (RandInt(0, 1) == 0 ? 0 : 3);
+
+    Matrix<Real> input(num_rows, 5 * cell_dim + dropout_dim),
+        params(3, cell_dim), output_deriv(num_rows, 2 * cell_dim);
+    input.SetRandn();
+    input.Scale(4.0);  // make sure we test the saturated regions too.
+    params.SetRandn();
+    output_deriv.SetRandn();
+
+    Matrix<Real> output(num_rows, 2 * cell_dim),
+        fused_output(num_rows, 2 * cell_dim);
+    cu::CpuComputeLstmNonlinearity(input, params, &output);
+    cu::CpuFusedComputeLstmNonlinearity(input, params, &fused_output);
+    AssertEqual(output, fused_output, 1.0e-05);
+
+    Matrix<double> deriv_sum_in(5, cell_dim);
+    deriv_sum_in.SetRandn();
+    Vector<Real> self_repair_config(10);
+    self_repair_config.SetRandn();
+    double count_in = Rand() % num_rows;
+
+    Matrix<Real> input_deriv(num_rows, 5 * cell_dim + dropout_dim),
+        params_deriv(3, cell_dim), self_repair_sum_out(5, cell_dim);
+    Matrix<double> value_sum_out(5, cell_dim), deriv_sum_out(5, cell_dim);
+    value_sum_out.SetRandn();
+    deriv_sum_out.SetRandn();
+    Matrix<Real> fused_input_deriv(input_deriv), fused_params_deriv(params_deriv),
+        fused_self_repair_sum_out(self_repair_sum_out);
+    Matrix<double> fused_value_sum_out(value_sum_out),
+        fused_deriv_sum_out(deriv_sum_out);
+
+    bool test_input_deriv = (RandInt(0, 2) != 0),
+        test_params_deriv = (RandInt(0, 2) != 0);
+    cu::CpuBackpropLstmNonlinearity(
+        input, params, output_deriv, deriv_sum_in, self_repair_config, count_in,
+        (test_input_deriv ? &input_deriv : NULL),
+        (test_params_deriv ? &params_deriv : NULL),
+        (test_params_deriv ? &value_sum_out : NULL),
+        (test_params_deriv ? &deriv_sum_out : NULL),
+        (test_params_deriv ? &self_repair_sum_out : NULL));
+    cu::CpuFusedBackpropLstmNonlinearity(
+        input, params, output_deriv, deriv_sum_in, self_repair_config, count_in,
+        (test_input_deriv ? &fused_input_deriv : NULL),
+        (test_params_deriv ? &fused_params_deriv : NULL),
+        (test_params_deriv ? &fused_value_sum_out : NULL),
+        (test_params_deriv ? &fused_deriv_sum_out : NULL),
+        (test_params_deriv ? &fused_self_repair_sum_out : NULL));
+
+    AssertEqual(input_deriv, fused_input_deriv, 1.0e-05);
+    AssertEqual(params_deriv, fused_params_deriv, 1.0e-05);
+    AssertEqual(value_sum_out, fused_value_sum_out, 1.0e-05);
+    AssertEqual(deriv_sum_out, fused_deriv_sum_out, 1.0e-05);
+    AssertEqual(self_repair_sum_out, fused_self_repair_sum_out, 1.0e-05);
+  }
+}
+
+// Checks ComputeGruNonlinearity() and BackpropGruNonlinearity() against the
+// sequence of matrix operations they replace.
+template<typename Real>
+static void UnitTestCuMathGruNonlinearity() {
+  for (int i = 0; i < 5; i++) {
+    int32 num_rows = 1 + Rand() % 100,
+        cell_dim = 1 + Rand() % 500;
+    CuMatrix<Real> z_t(num_rows, cell_dim), c_t1(num_rows, cell_dim),
+        h_t(num_rows, cell_dim), c_t(num_rows, cell_dim, kUndefined),
+        c_t_deriv(num_rows, cell_dim), h_t_deriv(num_rows, cell_dim),
+        z_t_deriv(num_rows, cell_dim), c_t1_deriv(num_rows, cell_dim);
+    z_t.SetRandUniform();
+    c_t1.SetRandn();
+    h_t.SetRandn();
+    h_t.Scale(3.0);
+    c_t_deriv.SetRandn();
+    h_t_deriv.SetRandn();
+    z_t_deriv.SetRandn();
+    c_t1_deriv.SetRandn();
+
+    CuMatrix<Real> ref_h_t(h_t), ref_c_t(h_t), ref_h_t_deriv(h_t_deriv),
+        ref_z_t_deriv(z_t_deriv), ref_c_t1_deriv(c_t1_deriv);
+
+    cu::ComputeGruNonlinearity(z_t, c_t1, &h_t, &c_t);
+    ref_h_t.Tanh(ref_h_t);
+    ref_c_t.CopyFromMat(ref_h_t);
+    ref_c_t.AddMatMatElements(-1.0, z_t, ref_h_t, 1.0);
+    ref_c_t.AddMatMatElements(1.0, z_t, c_t1, 1.0);
+    AssertEqual(h_t, ref_h_t, 1.0e-05);
+    AssertEqual(c_t, ref_c_t, 1.0e-05);
+
+    bool test_input_deriv = (RandInt(0, 1) == 0);
+    cu::BackpropGruNonlinearity(z_t, h_t, c_t1, c_t_deriv, &h_t_deriv,
+                                (test_input_deriv ? &z_t_deriv : NULL),
+                                (test_input_deriv ? &c_t1_deriv : NULL));
+    ref_h_t_deriv.AddMat(1.0, c_t_deriv);
+    ref_h_t_deriv.AddMatMatElements(-1.0, c_t_deriv, z_t, 1.0);
+    if (test_input_deriv) {
+      ref_z_t_deriv.AddMatMatElements(-1.0, c_t_deriv, h_t, 1.0);
+      ref_z_t_deriv.AddMatMatElements(1.0, c_t_deriv, c_t1, 1.0);
+      ref_c_t1_deriv.AddMatMatElements(1.0, c_t_deriv, z_t, 1.0);
+    }
+    ref_h_t_deriv.DiffTanh(h_t, ref_h_t_deriv);
+    AssertEqual(h_t_deriv, ref_h_t_deriv, 1.0e-05);
+    AssertEqual(z_t_deriv, ref_z_t_deriv, 1.0e-05);
+    AssertEqual(c_t1_deriv, ref_c_t1_deriv, 1.0e-05);
+  }
+}
+
 template<typename Real>
 static void UnitTestCuMathNormalizePerRow() {
 
@@ -704,6 +817,8 @@ template<typename Real> void CudaMathUnitTest() {
   UnitTestLstmNonlinearity();
   UnitTestEnsureNonzero<Real>();
   UnitTestBackpropLstmNonlinearity<Real>();
+  UnitTestCpuFusedLstmNonlinearity<Real>();
+  UnitTestCuMathGruNonlinearity<Real>();
   UnitTestCuMathNormalizePerRow<Real>();
   UnitTestCuMathNormalizePerRow_v2<Real>();
   UnitTestCuDiffNormalizePerRow<Real>();
@@ -441,6 +441,90 @@ static inline Real ScalarTanh(Real a) {
   }
 }
 
+// Kaldi is compiled with -O1 by default, and at that level GCC does not
+// vectorize loops, so we ask for -O3 for the fused CPU kernels, between
+// KALDI_BEGIN_FUSED_KERNELS and KALDI_END_FUSED_KERNELS.  This only takes
+// effect for functions first declared there, which is one reason their inner
+// loops are in static ...Row() functions.  With other compilers we can't do
+// this, and KALDI_FUSED_KERNELS_VECTORIZED is 0; see ComputeLstmNonlinearity()
+// for how that is used.
+#if defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER)
+#define KALDI_FUSED_KERNELS_VECTORIZED 1
+#define KALDI_BEGIN_FUSED_KERNELS \
+  _Pragma("GCC push_options") _Pragma("GCC optimize (\"O3\")")
+#define KALDI_END_FUSED_KERNELS _Pragma("GCC pop_options")
+#else
+#define KALDI_FUSED_KERNELS_VECTORIZED 0
+#define KALDI_BEGIN_FUSED_KERNELS
+#define KALDI_END_FUSED_KERNELS
+#endif
+
+// Returns true if, when no GPU is in use, the LSTM nonlinearity should be done
+// by the fused CPU kernels rather than the reference ones.  When the fused
+// kernels are vectorized (or for double, where FusedExp() is just Exp()) they
+// are always faster; otherwise the polynomial in FusedExp() is slower than
+// expf(), and only the backprop with large cell dimensions still gains from
+// making a single pass over the data.
+template<typename Real>
+static inline bool UseFusedLstmKernels(bool backprop, int32 cell_dim) {
+  return KALDI_FUSED_KERNELS_VECTORIZED || sizeof(Real) == sizeof(double) ||
+      (backprop && cell_dim >= 256);
+}
+
+KALDI_BEGIN_FUSED_KERNELS
+
+// FusedExp() is the exponential function used by the fused CPU kernels
+// below.  The float version uses the Cephes-style range reduction
+// exp(x) = 2^n exp(x - n log(2)) followed by a polynomial; it is accurate to
+// about 1 ulp and, unlike a call to expf(), it is inlined and can be
+// vectorized by the compiler.  The input is first clamped to [-87.3, 87.3]
+// so that the result is always a finite, normal number; the clamping is done
+// on the bit pattern because compilers will not vectorize floating-point
+// comparisons unless told to ignore floating-point exceptions.
+static inline float FusedExp(float x) {
+  uint32 bits;
+  memcpy(&bits, &x, sizeof(bits));
+  uint32 abs_bits = bits & 0x7fffffffu;
+  const uint32 max_abs_bits = 0x42ae9999u;  // the bit pattern of 87.3f.
+  abs_bits = (abs_bits < max_abs_bits ? abs_bits : max_abs_bits);
+  bits = (bits & 0x80000000u) | abs_bits;
+  memcpy(&x, &bits, sizeof(x));
+
+  float fx = x * 1.44269504088896341f + 0.5f;
+  int32 n = static_cast<int32>(fx);
+  n -= (static_cast<float>(n) > fx);  // make it floor(fx).
+  float fn = static_cast<float>(n);
+  x = x - fn * 0.693359375f + fn * 2.12194440e-4f;
+  float x2 = x * x;
+  float y = 1.9875691500e-4f;
+  y = y * x + 1.3981999507e-3f;
+  y = y * x + 8.3334519073e-3f;
+  y = y * x + 4.1665795894e-2f;
+  y = y * x + 1.6666665459e-1f;
+  y = y * x + 5.0000001201e-1f;
+  y = y * x2 + x + 1.0f;
+  int32 exponent_bits = (n + 127) << 23;
+  float scale;
+  memcpy(&scale, &exponent_bits, sizeof(scale));
+  return y * scale;
+}
+
+static inline double FusedExp(double x) {
+  return Exp(x);
+}
+
+template<typename Real>
+static inline Real FusedSigmoid(Real x) {
+  return Real(1) / (Real(1) + FusedExp(-x));
+}
+
+template<typename Real>
+static inline Real FusedTanh(Real x) {
+  return Real(2) / (Real(1) + FusedExp(Real(-2) * x)) - Real(1);
+}
+
+KALDI_END_FUSED_KERNELS
+
 template<typename Real>
 void CpuComputeLstmNonlinearity(const MatrixBase<Real> &input_mat,
                                 const MatrixBase<Real> &params_mat,
@@ -517,7 +601,9 @@ void ComputeLstmNonlinearity(const CuMatrixBase<Real> &input,
     CuDevice::Instantiate().AccuProfile(__func__, tim);
   } else
 #endif
-  {
+  if (UseFusedLstmKernels<Real>(false, cell_dim)) {
+    CpuFusedComputeLstmNonlinearity(input.Mat(), params.Mat(), &output->Mat());
+  } else {
     CpuComputeLstmNonlinearity(input.Mat(), params.Mat(), &output->Mat());
   }
 }
@@ -539,6 +625,75 @@ void ComputeLstmNonlinearity(const CuMatrixBase<double> &input,
                              const CuMatrixBase<double> &params,
                              CuMatrixBase<double> *output);
 
+KALDI_BEGIN_FUSED_KERNELS
+
+// Does the forward computation of the LSTM nonlinearity for one row; the
+// arguments are laid out as in the rows of the matrices given to
+// ComputeLstmNonlinearity().  This is a separate function so that the
+// __restrict__ qualifiers on the arguments let the compiler vectorize the loop.
+template<typename Real>
+static inline void FusedLstmNonlinearityRow(int32 cell_dim,
+                                            const Real *__restrict__ input_row,
+                                            const Real *__restrict__ params,
+                                            int32 params_stride,
+                                            Real i_scale, Real f_scale,
+                                            Real o_scale,
+                                            Real *__restrict__ output_row) {
+  for (int32 c = 0; c < cell_dim; c++) {
+    Real i_part = input_row[c],
+        f_part = input_row[c + cell_dim],
+        c_part = input_row[c + 2 * cell_dim],
+        o_part = input_row[c + 3 * cell_dim],
+        c_prev = input_row[c + 4 * cell_dim],
+        w_ic = params[c],
+        w_fc = params[c + params_stride],
+        w_oc = params[c + 2 * params_stride];
+    Real i_t = FusedSigmoid(i_part + w_ic * c_prev),
+        f_t = FusedSigmoid(f_part + w_fc * c_prev),
+        c_t = f_t * f_scale * c_prev + i_t * i_scale * FusedTanh(c_part),
+        o_t = FusedSigmoid(o_part + w_oc * c_t);
+    output_row[c] = c_t;
+    output_row[c + cell_dim] = o_t * o_scale * FusedTanh(c_t);
+  }
+}
+
+template<typename Real>
+void CpuFusedComputeLstmNonlinearity(const MatrixBase<Real> &input_mat,
+                                     const MatrixBase<Real> &params_mat,
+                                     MatrixBase<Real> *output) {
+  int32 num_rows = input_mat.NumRows(),
+      input_cols = input_mat.NumCols(),
+        cell_dim = input_cols / 5;
+  KALDI_ASSERT(input_cols == (cell_dim * 5) || input_cols == (cell_dim * 5) + 3);
+  KALDI_ASSERT(output->NumRows() == num_rows);
+  KALDI_ASSERT(params_mat.NumRows() == 3);
+  KALDI_ASSERT(params_mat.NumCols() == cell_dim);
+  KALDI_ASSERT(output->NumCols() == 2 * cell_dim);
+
+  bool have_dropout_mask = (input_cols == (cell_dim * 5) + 3);
+  for (int32 r = 0; r < num_rows; r++) {
+    const Real *input_row = input_mat.RowData(r);
+    // i_scale, f_scale and o_scale relate to dropout, they will normally be 1.0.
+    Real i_scale = (have_dropout_mask ? input_row[cell_dim * 5] : 1.0),
+         f_scale = (have_dropout_mask ? input_row[cell_dim * 5 + 1] : 1.0),
+         o_scale = (have_dropout_mask ? input_row[cell_dim * 5 + 2] : 1.0);
+    FusedLstmNonlinearityRow(cell_dim, input_row, params_mat.Data(),
+                             params_mat.Stride(), i_scale, f_scale, o_scale,
+                             output->RowData(r));
+  }
+}
+
+template
+void CpuFusedComputeLstmNonlinearity(const MatrixBase<float> &input_mat,
+                                     const MatrixBase<float> &params_mat,
+                                     MatrixBase<float> *output);
+template
+void CpuFusedComputeLstmNonlinearity(const MatrixBase<double> &input_mat,
+                                     const MatrixBase<double> &params_mat,
+                                     MatrixBase<double> *output);
+
+KALDI_END_FUSED_KERNELS
+
 template<typename Real>
 void CpuBackpropLstmNonlinearity(const MatrixBase<Real> &input,
                                  const MatrixBase<Real> &params,
@@ -764,6 +919,204 @@ void CpuBackpropLstmNonlinearity(const MatrixBase<Real> &input,
 
 
 
+KALDI_BEGIN_FUSED_KERNELS
+
+// Does the backward computation of the LSTM nonlinearity for one row.
+// 'input_row' and 'output_deriv_row' are laid out as in the rows of the
+// corresponding matrices given to BackpropLstmNonlinearity(), and 'params' is
+// the 3 by C parameter matrix with stride 'params_stride'.  'self_repair'
+// contains, in 5 consecutive blocks of dimension C, the self-repair scales for
+// i_t, f_t, c_part, o_t and c_t (see CpuBackpropLstmNonlinearity() for how
+// self-repair works).  The stats are added to the 13 vectors value_sum[i],
+// deriv_sum[i] (for the same 5 nonlinearities) and w_deriv_sum[i] (for w_ic,
+// w_fc and w_oc), and the derivatives w.r.t. the 5 blocks of the input are
+// written to in_deriv[i].  These are all passed as separate pointers so that,
+// with the __restrict__ qualifiers, the compiler can vectorize the loop.
+template<typename Real>
+static inline void FusedBackpropLstmNonlinearityRow(
+    int32 cell_dim,
+    const Real *__restrict__ input_row,
+    const Real *__restrict__ params,
+    int32 params_stride,
+    Real i_scale, Real f_scale, Real o_scale,
+    const Real *__restrict__ output_deriv_row,
+    const Real *__restrict__ self_repair,
+    Real *__restrict__ i_t_value_sum, Real *__restrict__ f_t_value_sum,
+    Real *__restrict__ c_part_value_sum, Real *__restrict__ o_t_value_sum,
+    Real *__restrict__ c_t_value_sum,
+    Real *__restrict__ i_t_deriv_sum, Real *__restrict__ f_t_deriv_sum,
+    Real *__restrict__ c_part_deriv_sum, Real *__restrict__ o_t_deriv_sum,
+    Real *__restrict__ c_t_deriv_sum,
+    Real *__restrict__ w_ic_deriv_sum, Real *__restrict__ w_fc_deriv_sum,
+    Real *__restrict__ w_oc_deriv_sum,
+    Real *__restrict__ di_part, Real *__restrict__ df_part,
+    Real *__restrict__ dc_part, Real *__restrict__ do_part,
+    Real *__restrict__ dc_prev) {
+  for (int32 c = 0; c < cell_dim; c++) {
+    Real i_part = input_row[c],
+        f_part = input_row[c + cell_dim],
+        c_part = input_row[c + 2 * cell_dim],
+        o_part = input_row[c + 3 * cell_dim],
+        c_prev = input_row[c + 4 * cell_dim],
+        w_ic = params[c],
+        w_fc = params[c + params_stride],
+        w_oc = params[c + 2 * params_stride];
+    // The forward computation.
+    Real i_t = FusedSigmoid(i_part + w_ic * c_prev),
+        f_t = FusedSigmoid(f_part + w_fc * c_prev),
+        tanh_c_part = FusedTanh(c_part),
+        c_t = f_t * f_scale * c_prev + i_t * i_scale * tanh_c_part,
+        o_t = FusedSigmoid(o_part + w_oc * c_t),
+        tanh_c_t = FusedTanh(c_t);
+
+    // The function-derivatives of the nonlinearities, and the stats.
+    Real i_t_deriv = i_t * (1.0F - i_t),
+        f_t_deriv = f_t * (1.0F - f_t),
+        c_part_deriv = 1.0F - tanh_c_part * tanh_c_part,
+        o_t_deriv = o_t * (1.0F - o_t),
+        c_t_deriv = 1.0F - tanh_c_t * tanh_c_t;
+    i_t_value_sum[c] += i_t;
+    i_t_deriv_sum[c] += i_t_deriv;
+    f_t_value_sum[c] += f_t;
+    f_t_deriv_sum[c] += f_t_deriv;
+    c_part_value_sum[c] += tanh_c_part;
+    c_part_deriv_sum[c] += c_part_deriv;
+    o_t_value_sum[c] += o_t;
+    o_t_deriv_sum[c] += o_t_deriv;
+    c_t_value_sum[c] += tanh_c_t;
+    c_t_deriv_sum[c] += c_t_deriv;
+
+    // The backward computation; compare with CpuBackpropLstmNonlinearity().
+    Real dc_t_out = output_deriv_row[c],
+        dm_t = output_deriv_row[c + cell_dim],
+        dtanh_c_t = o_t * o_scale * dm_t,
+        do_t = o_scale * tanh_c_t * dm_t,
+        do_t_input = (o_t_deriv * do_t
+                      - (2.0F * o_t - 1.0F) * self_repair[c + 3 * cell_dim]),
+        dc_t = (c_t_deriv * dtanh_c_t + dc_t_out + do_t_input * w_oc)
+               - tanh_c_t * self_repair[c + 4 * cell_dim],
+        dtanh_c_part = i_t * i_scale * dc_t,
+        df_t = dc_t * f_scale * c_prev,
+        df_t_input = (df_t * f_t_deriv
+                      - (2.0F * f_t - 1.0F) * self_repair[c + cell_dim]),
+        di_t = dc_t * i_scale * tanh_c_part,
+        di_t_input = (di_t * i_t_deriv
+                      - (2.0F * i_t - 1.0F) * self_repair[c]);
+
+    w_ic_deriv_sum[c] += c_prev * di_t_input;
+    w_fc_deriv_sum[c] += c_prev * df_t_input;
+    w_oc_deriv_sum[c] += c_t * do_t_input;
+
+    di_part[c] = di_t_input;
+    df_part[c] = df_t_input;
+    dc_part[c] = (c_part_deriv * dtanh_c_part
+                  - tanh_c_part * self_repair[c + 2 * cell_dim]);
+    do_part[c] = do_t_input;
+    dc_prev[c] = w_ic * di_t_input + w_fc * df_t_input + f_t * f_scale * dc_t;
+  }
+}
+
+template<typename Real>
+void CpuFusedBackpropLstmNonlinearity(
+    const MatrixBase<Real> &input,
+    const MatrixBase<Real> &params,
+    const MatrixBase<Real> &output_deriv,
+    const MatrixBase<double> &deriv_sum_in,
+    const VectorBase<Real> &self_repair_config,
+    double count_in,
+    MatrixBase<Real> *input_deriv,
+    MatrixBase<Real> *params_deriv,
+    MatrixBase<double> *value_sum_out,
+    MatrixBase<double> *deriv_sum_out,
+    MatrixBase<Real> *self_repair_sum_out) {
+  int32 num_rows = input.NumRows(),
+      input_cols = input.NumCols(),
+        cell_dim = input.NumCols() / 5;
+  // Check dimensions.
+  KALDI_ASSERT(input_cols == (cell_dim * 5) || input_cols == (cell_dim * 5) + 3);
+  KALDI_ASSERT(params.NumRows() == 3);
+  KALDI_ASSERT(params.NumCols() == cell_dim);
+  KALDI_ASSERT(output_deriv.NumRows() == num_rows);
+  KALDI_ASSERT(output_deriv.NumCols() == 2 * cell_dim);
+  KALDI_ASSERT(deriv_sum_in.NumRows() == 5);
+  KALDI_ASSERT(deriv_sum_in.NumCols() == cell_dim);
+  KALDI_ASSERT(self_repair_config.Dim() == 10);
+  if (input_deriv != NULL) {
+    KALDI_ASSERT(SameDim(input, *input_deriv));
+  }
+  if (params_deriv == NULL) {
+    KALDI_ASSERT(value_sum_out == NULL);
+    KALDI_ASSERT(deriv_sum_out == NULL);
+    KALDI_ASSERT(self_repair_sum_out == NULL);
+  } else {
+    KALDI_ASSERT(value_sum_out != NULL);
+    KALDI_ASSERT(deriv_sum_out != NULL);
+    KALDI_ASSERT(self_repair_sum_out != NULL);
+    KALDI_ASSERT(SameDim(params, *params_deriv));
+    KALDI_ASSERT(value_sum_out->NumRows() == 5);
+    KALDI_ASSERT(value_sum_out->NumCols() == cell_dim);
+    KALDI_ASSERT(SameDim(*value_sum_out, *deriv_sum_out));
+    KALDI_ASSERT(self_repair_sum_out->NumRows() == 5);
+    KALDI_ASSERT(self_repair_sum_out->NumCols() == cell_dim);
+  }
+  if (input_deriv == NULL && params_deriv == NULL)
+    return;
+
+  bool have_dropout_mask = (input_cols == (cell_dim * 5) + 3);
+  // We add 1.0 (i.e. a small value) to the count to avoid division by zero.
+  Real count = 1.0 + count_in;
+
+  // Unlike CpuBackpropLstmNonlinearity(), which loops over columns in the
+  // outer loop, we loop over rows, so the per-cell quantities are kept in
+  // the rows of these matrices: 'self_repair' has the self-repair scales for
+  // i_t, f_t, c_part, o_t and c_t, and 'sums' has the 5 value sums, the 5
+  // derivative sums and the 3 parameter-derivative sums, in that order.
+  Matrix<Real> self_repair(5, cell_dim, kUndefined, kStrideEqualNumCols),
+      sums(13, cell_dim);
+  for (int32 i = 0; i < 5; i++) {
+    Real threshold = self_repair_config(i), scale = self_repair_config(i + 5);
+    for (int32 c = 0; c < cell_dim; c++)
+      self_repair(i, c) = (deriv_sum_in(i, c) / count < threshold ? scale : 0.0);
+  }
+  // If the caller does not want the input derivative we still compute it, into
+  // this one-row buffer, so that the inner loop has no branches.
+  Vector<Real> input_deriv_buffer(input_deriv == NULL ? 5 * cell_dim : 0,
+                                  kUndefined);
+
+  for (int32 r = 0; r < num_rows; r++) {
+    const Real *input_row = input.RowData(r);
+    Real i_scale = (have_dropout_mask ? input_row[cell_dim * 5] : 1.0),
+         f_scale = (have_dropout_mask ? input_row[cell_dim * 5 + 1] : 1.0),
+         o_scale = (have_dropout_mask ? input_row[cell_dim * 5 + 2] : 1.0);
+    Real *input_deriv_row = (input_deriv != NULL ? input_deriv->RowData(r) :
+                             input_deriv_buffer.Data());
+    FusedBackpropLstmNonlinearityRow(
+        cell_dim, input_row, params.Data(), params.Stride(),
+        i_scale, f_scale, o_scale, output_deriv.RowData(r), self_repair.Data(),
+        sums.RowData(0), sums.RowData(1), sums.RowData(2), sums.RowData(3),
+        sums.RowData(4), sums.RowData(5), sums.RowData(6), sums.RowData(7),
+        sums.RowData(8), sums.RowData(9), sums.RowData(10), sums.RowData(11),
+        sums.RowData(12),
+        input_deriv_row, input_deriv_row + cell_dim,
+        input_deriv_row + 2 * cell_dim, input_deriv_row + 3 * cell_dim,
+        input_deriv_row + 4 * cell_dim);
+  }
+
+  if (params_deriv != NULL) {
+    params_deriv->CopyFromMat(sums.RowRange(10, 3));
+    value_sum_out->AddMat(1.0, Matrix<double>(sums.RowRange(0, 5)));
+    // need to update self_repair_sum_out before deriv_sum_out, because
+    // deriv_sum_out and deriv_sum_in might point to the same memory.
+    for (int32 i = 0; i < 5; i++)
+      for (int32 c = 0; c < cell_dim; c++)
+        (*self_repair_sum_out)(i, c) =
+            (deriv_sum_in(i, c) / count < self_repair_config(i) ? num_rows : 0);
+    deriv_sum_out->AddMat(1.0, Matrix<double>(sums.RowRange(5, 5)));
+  }
+}
+
+KALDI_END_FUSED_KERNELS
+
 template<typename Real>
 void BackpropLstmNonlinearity(const CuMatrixBase<Real> &input,
                               const CuMatrixBase<Real> &params,
@@ -900,14 +1253,179 @@ void BackpropLstmNonlinearity(const CuMatrixBase<Real> &input,
 
     CuDevice::Instantiate().AccuProfile(__func__, tim);
   } else
+#endif
+  if (UseFusedLstmKernels<Real>(true, cell_dim)) {
+    CpuFusedBackpropLstmNonlinearity(
+        input.Mat(), params.Mat(), output_deriv.Mat(),
+        deriv_sum_in.Mat(), self_repair_config.Vec(), count_in,
+        (input_deriv == NULL ? NULL : &(input_deriv->Mat())),
+        (params_deriv == NULL ? NULL : &(params_deriv->Mat())),
+        (value_sum_out == NULL ? NULL : &(value_sum_out->Mat())),
+        (deriv_sum_out == NULL ? NULL : &(deriv_sum_out->Mat())),
+        (self_repair_sum_out == NULL ? NULL : &(self_repair_sum_out->Mat())));
+  } else {
+    CpuBackpropLstmNonlinearity(
+        input.Mat(), params.Mat(), output_deriv.Mat(),
+        deriv_sum_in.Mat(), self_repair_config.Vec(), count_in,
+        (input_deriv == NULL ? NULL : &(input_deriv->Mat())),
+        (params_deriv == NULL ? NULL : &(params_deriv->Mat())),
+        (value_sum_out == NULL ? NULL : &(value_sum_out->Mat())),
+        (deriv_sum_out == NULL ? NULL : &(deriv_sum_out->Mat())),
+        (self_repair_sum_out == NULL ? NULL : &(self_repair_sum_out->Mat())));
+  }
+}
+
+KALDI_BEGIN_FUSED_KERNELS
+
+// Does the forward computation of the GRU nonlinearity for one row; see
+// CpuComputeGruNonlinearity().
+template<typename Real>
+static inline void FusedGruNonlinearityRow(int32 cell_dim,
+                                           const Real *__restrict__ z,
+                                           const Real *__restrict__ c_prev,
+                                           Real *__restrict__ h,
+                                           Real *__restrict__ c_out) {
+  for (int32 c = 0; c < cell_dim; c++) {
+    Real h_val = FusedTanh(h[c]);
+    h[c] = h_val;
+    c_out[c] = h_val + z[c] * (c_prev[c] - h_val);
+  }
+}
+
+template<typename Real>
+void CpuComputeGruNonlinearity(const MatrixBase<Real> &z_t,
+                               const MatrixBase<Real> &c_t1,
+                               MatrixBase<Real> *h_t,
+                               MatrixBase<Real> *c_t) {
+  KALDI_ASSERT(SameDim(z_t, c_t1) && SameDim(z_t, *h_t) &&
+               SameDim(z_t, *c_t));
+  int32 num_rows = z_t.NumRows(), cell_dim = z_t.NumCols();
+  for (int32 r = 0; r < num_rows; r++)
+    FusedGruNonlinearityRow(cell_dim, z_t.RowData(r), c_t1.RowData(r),
+                            h_t->RowData(r), c_t->RowData(r));
+}
+
+KALDI_END_FUSED_KERNELS
+
+template<typename Real>
+void ComputeGruNonlinearity(const CuMatrixBase<Real> &z_t,
+                            const CuMatrixBase<Real> &c_t1,
+                            CuMatrixBase<Real> *h_t,
+                            CuMatrixBase<Real> *c_t) {
+  KALDI_ASSERT(SameDim(z_t, c_t1) && SameDim(z_t, *h_t) &&
+               SameDim(z_t, *c_t));
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    h_t->Tanh(*h_t);
+    c_t->CopyFromMat(*h_t);
+    // now c_t = h_t
+    c_t->AddMatMatElements(-1.0, z_t, *h_t, 1.0);
+    // now c_t = (1 - z_t) \dot h_t.
+    c_t->AddMatMatElements(1.0, z_t, c_t1, 1.0);
+    // now c_t = (1 - z_t) \dot h_t  +  z_t \dot c_{t-1}.
+  } else
+#endif
+  {
+    CpuComputeGruNonlinearity(z_t.Mat(), c_t1.Mat(), &(h_t->Mat()),
+                              &(c_t->Mat()));
+  }
+}
+
+KALDI_BEGIN_FUSED_KERNELS
+
+// Does the backprop of the GRU nonlinearity for one row, in the case where
+// we need the derivatives w.r.t. z_t and c_{t-1}; see
+// CpuBackpropGruNonlinearity().
+template<typename Real>
+static inline void FusedBackpropGruNonlinearityRow(
+    int32 cell_dim,
+    const Real *__restrict__ z,
+    const Real *__restrict__ h,
+    const Real *__restrict__ c_prev,
+    const Real *__restrict__ dc_t,
+    Real *__restrict__ dh,
+    Real *__restrict__ dz,
+    Real *__restrict__ dc_prev) {
+  for (int32 c = 0; c < cell_dim; c++) {
+    dz[c] += dc_t[c] * (c_prev[c] - h[c]);
+    dc_prev[c] += dc_t[c] * z[c];
+    dh[c] = (dh[c] + dc_t[c] * (1.0F - z[c])) * (1.0F - h[c] * h[c]);
+  }
+}
+
+template<typename Real>
+void CpuBackpropGruNonlinearity(const MatrixBase<Real> &z_t,
+                                const MatrixBase<Real> &h_t,
+                                const MatrixBase<Real> &c_t1,
+                                const MatrixBase<Real> &c_t_deriv,
+                                MatrixBase<Real> *h_t_deriv,
+                                MatrixBase<Real> *z_t_deriv,
+                                MatrixBase<Real> *c_t1_deriv) {
+  KALDI_ASSERT(SameDim(z_t, h_t) && SameDim(z_t, c_t1) &&
+               SameDim(z_t, c_t_deriv) && SameDim(z_t, *h_t_deriv) &&
+               (z_t_deriv == NULL || SameDim(z_t, *z_t_deriv)) &&
+               (c_t1_deriv == NULL || SameDim(z_t, *c_t1_deriv)));
+  int32 num_rows = z_t.NumRows(), cell_dim = z_t.NumCols();
+  for (int32 r = 0; r < num_rows; r++) {
+    const Real *__restrict__ z = z_t.RowData(r),
+        *__restrict__ h = h_t.RowData(r),
+        *__restrict__ c_prev = c_t1.RowData(r),
+        *__restrict__ dc_t = c_t_deriv.RowData(r);
+    Real *__restrict__ dh = h_t_deriv->RowData(r);
+    if (z_t_deriv != NULL && c_t1_deriv != NULL) {
+      FusedBackpropGruNonlinearityRow(cell_dim, z, h, c_prev, dc_t, dh,
+                                      z_t_deriv->RowData(r),
+                                      c_t1_deriv->RowData(r));
+    } else {
+      if (z_t_deriv != NULL) {
+        Real *__restrict__ dz = z_t_deriv->RowData(r);
+        for (int32 c = 0; c < cell_dim; c++)
+          dz[c] += dc_t[c] * (c_prev[c] - h[c]);
+      }
+      if (c_t1_deriv != NULL) {
+        Real *__restrict__ dc_prev = c_t1_deriv->RowData(r);
+        for (int32 c = 0; c < cell_dim; c++)
+          dc_prev[c] += dc_t[c] * z[c];
+      }
+      for (int32 c = 0; c < cell_dim; c++)
+        dh[c] = (dh[c] + dc_t[c] * (1.0F - z[c])) * (1.0F - h[c] * h[c]);
+    }
+  }
+}
+
+KALDI_END_FUSED_KERNELS
+
+template<typename Real>
+void BackpropGruNonlinearity(const CuMatrixBase<Real> &z_t,
+                             const CuMatrixBase<Real> &h_t,
+                             const CuMatrixBase<Real> &c_t1,
+                             const CuMatrixBase<Real> &c_t_deriv,
+                             CuMatrixBase<Real> *h_t_deriv,
+                             CuMatrixBase<Real> *z_t_deriv,
+                             CuMatrixBase<Real> *c_t1_deriv) {
+  KALDI_ASSERT(SameDim(z_t, h_t) && SameDim(z_t, c_t1) &&
+               SameDim(z_t, c_t_deriv) && SameDim(z_t, *h_t_deriv) &&
+               (z_t_deriv == NULL || SameDim(z_t, *z_t_deriv)) &&
+               (c_t1_deriv == NULL || SameDim(z_t, *c_t1_deriv)));
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    // First do: h_t_deriv += c_t_deriv \dot (1 - z_t).
+    h_t_deriv->AddMat(1.0, c_t_deriv);
+    h_t_deriv->AddMatMatElements(-1.0, c_t_deriv, z_t, 1.0);
+    if (z_t_deriv != NULL) {
+      z_t_deriv->AddMatMatElements(-1.0, c_t_deriv, h_t, 1.0);
+      z_t_deriv->AddMatMatElements(1.0, c_t_deriv, c_t1, 1.0);
+    }
+    if (c_t1_deriv != NULL)
+      c_t1_deriv->AddMatMatElements(1.0, c_t_deriv, z_t, 1.0);
+    h_t_deriv->DiffTanh(h_t, *h_t_deriv);
+  } else
 #endif
   {
-    CpuBackpropLstmNonlinearity(input.Mat(), params.Mat(), output_deriv.Mat(),
-                                deriv_sum_in.Mat(), self_repair_config.Vec(),
-                                count_in, &(input_deriv->Mat()),
-                                &(params_deriv->Mat()), &(value_sum_out->Mat()),
-                                &(deriv_sum_out->Mat()),
-                                &(self_repair_sum_out->Mat()));
+    CpuBackpropGruNonlinearity(
+        z_t.Mat(), h_t.Mat(), c_t1.Mat(), c_t_deriv.Mat(), &(h_t_deriv->Mat()),
+        (z_t_deriv == NULL ? NULL : &(z_t_deriv->Mat())),
+        (c_t1_deriv == NULL ? NULL : &(c_t1_deriv->Mat())));
   }
 }
 
@@ -967,6 +1485,79 @@ void CpuBackpropLstmNonlinearity(const MatrixBase<double> &input,
                                  MatrixBase<double> *value_sum_out,
                                  MatrixBase<double> *deriv_sum_out,
                                  MatrixBase<double> *self_repair_sum_out);
+
+template
+void CpuFusedBackpropLstmNonlinearity(
+    const MatrixBase<float> &input, const MatrixBase<float> &params,
+    const MatrixBase<float> &output_deriv,
+    const MatrixBase<double> &deriv_sum_in,
+    const VectorBase<float> &self_repair_config, double count_in,
+    MatrixBase<float> *input_deriv, MatrixBase<float> *params_deriv,
+    MatrixBase<double> *value_sum_out, MatrixBase<double> *deriv_sum_out,
+    MatrixBase<float> *self_repair_sum_out);
+template
+void CpuFusedBackpropLstmNonlinearity(
+    const MatrixBase<double> &input, const MatrixBase<double> &params,
+    const MatrixBase<double> &output_deriv,
+    const MatrixBase<double> &deriv_sum_in,
+    const VectorBase<double> &self_repair_config, double count_in,
+    MatrixBase<double> *input_deriv, MatrixBase<double> *params_deriv,
+    MatrixBase<double> *value_sum_out, MatrixBase<double> *deriv_sum_out,
+    MatrixBase<double> *self_repair_sum_out);
+
+template
+void CpuComputeGruNonlinearity(const MatrixBase<float> &z_t,
+                               const MatrixBase<float> &c_t1,
+                               MatrixBase<float> *h_t,
+                               MatrixBase<float> *c_t);
+template
+void CpuComputeGruNonlinearity(const MatrixBase<double> &z_t,
+                               const MatrixBase<double> &c_t1,
+                               MatrixBase<double> *h_t,
+                               MatrixBase<double> *c_t);
+template
+void ComputeGruNonlinearity(const CuMatrixBase<float> &z_t,
+                            const CuMatrixBase<float> &c_t1,
+                            CuMatrixBase<float> *h_t,
+                            CuMatrixBase<float> *c_t);
+template
+void ComputeGruNonlinearity(const CuMatrixBase<double> &z_t,
+                            const CuMatrixBase<double> &c_t1,
+                            CuMatrixBase<double> *h_t,
+                            CuMatrixBase<double> *c_t);
+template
+void CpuBackpropGruNonlinearity(const MatrixBase<float> &z_t,
+                                const MatrixBase<float> &h_t,
+                                const MatrixBase<float> &c_t1,
+                                const MatrixBase<float> &c_t_deriv,
+                                MatrixBase<float> *h_t_deriv,
+                                MatrixBase<float> *z_t_deriv,
+                                MatrixBase<float> *c_t1_deriv);
+template
+void CpuBackpropGruNonlinearity(const MatrixBase<double> &z_t,
+                                const MatrixBase<double> &h_t,
+                                const MatrixBase<double> &c_t1,
+                                const MatrixBase<double> &c_t_deriv,
+                                MatrixBase<double> *h_t_deriv,
+                                MatrixBase<double> *z_t_deriv,
+                                MatrixBase<double> *c_t1_deriv);
+template
+void BackpropGruNonlinearity(const CuMatrixBase<float> &z_t,
+                             const CuMatrixBase<float> &h_t,
+                             const CuMatrixBase<float> &c_t1,
+                             const CuMatrixBase<float> &c_t_deriv,
+                             CuMatrixBase<float> *h_t_deriv,
+                             CuMatrixBase<float> *z_t_deriv,
+                             CuMatrixBase<float> *c_t1_deriv);
+template
+void BackpropGruNonlinearity(const CuMatrixBase<double> &z_t,
+                             const CuMatrixBase<double> &h_t,
+                             const CuMatrixBase<double> &c_t1,
+                             const CuMatrixBase<double> &c_t_deriv,
+                             CuMatrixBase<double> *h_t_deriv,
+                             CuMatrixBase<double> *z_t_deriv,
+                             CuMatrixBase<double> *c_t1_deriv);
+
 template
 void BackpropLstmNonlinearity(const CuMatrixBase<float> &input,
                               const CuMatrixBase<float> &params,
@@ -256,6 +256,109 @@ void CpuBackpropLstmNonlinearity(const MatrixBase<Real> &input,
                                  MatrixBase<double> *deriv_sum_out,
                                  MatrixBase<Real> *self_repair_sum_out);
 
+// These are fused versions of CpuComputeLstmNonlinearity and
+// CpuBackpropLstmNonlinearity that compute the same things, but traverse the
+// data row by row in a single pass, with the sigmoid and tanh evaluated inline
+// so that the inner loops can be vectorized by the compiler.  For float they
+// use a polynomial approximation to exp() that is accurate to about 1 ulp, so
+// the results are not bit-identical to the non-fused versions; cu-math-test
+// checks that each output agrees to a relative tolerance of 1.0e-05 (in the
+// Frobenius norm), and the differences we see are below 1.0e-06.  For double
+// they use Exp().  With GCC the fused kernels are compiled with -O3 (see
+// KALDI_BEGIN_FUSED_KERNELS in cu-math.cc) so that they are vectorized even in
+// the default -O1 build, and ComputeLstmNonlinearity() and
+// BackpropLstmNonlinearity() use them when no GPU is in use.  With other
+// compilers they are only used where they are faster without vectorization
+// (double, and the backprop for cell dimensions of 256 or more).  The
+// non-fused versions above are kept as a reference for testing and
+// benchmarking; see cu-math-speed-test.cc for the comparison.
+template<typename Real>
+void CpuFusedComputeLstmNonlinearity(const MatrixBase<Real> &input,
+                                     const MatrixBase<Real> &params,
+                                     MatrixBase<Real> *output);
+template<typename Real>
+void CpuFusedBackpropLstmNonlinearity(
+    const MatrixBase<Real> &input,
+    const MatrixBase<Real> &params,
+    const MatrixBase<Real> &output_deriv,
+    const MatrixBase<double> &deriv_sum_in,
+    const VectorBase<Real> &self_repair_config,
+    double count_in,
+    MatrixBase<Real> *input_deriv,
+    MatrixBase<Real> *params_deriv,
+    MatrixBase<double> *value_sum_out,
+    MatrixBase<double> *deriv_sum_out,
+    MatrixBase<Real> *self_repair_sum_out);
+
+
+/**
+ This is a special-purpose function used by class GruNonlinearityComponent and
+ OutputGruNonlinearityComponent (see ../nnet3/nnet-combined-component.h) to do
+ the elementwise part of their forward propagation, after the matrix
+ multiplication by W^h has been done.  All matrices must have the same
+ dimension N by C.
+
+ @param [in] z_t     The update gate z_t.
+ @param [in] c_t1    The previous cell value c_{t-1}.
+ @param [in,out] h_t At entry, the argument of the tanh, e.g.
+                     hpart_t + W^h (s_{t-1} \dot r_t); at exit, its tanh.
+ @param [out] c_t    To here is written (1 - z_t) \dot h_t + z_t \dot c_{t-1},
+                     where h_t is the output value.
+
+ On CPU this is done in a single pass over the data, using the same
+ approximate tanh (for float) as CpuFusedComputeLstmNonlinearity(), so the
+ result agrees with that of the corresponding sequence of CuMatrix
+ operations to a relative tolerance of 1.0e-05 rather than exactly; on GPU
+ it is done using that sequence of CuMatrix operations.
+*/
+template<typename Real>
+void ComputeGruNonlinearity(const CuMatrixBase<Real> &z_t,
+                            const CuMatrixBase<Real> &c_t1,
+                            CuMatrixBase<Real> *h_t,
+                            CuMatrixBase<Real> *c_t);
+
+/**
+ This does the backprop corresponding to ComputeGruNonlinearity().  All
+ matrices must have the same dimension N by C.
+
+ @param [in] z_t        The update gate z_t, as given to
+                        ComputeGruNonlinearity().
+ @param [in] h_t        The output value h_t of ComputeGruNonlinearity().
+ @param [in] c_t1       The previous cell value c_{t-1}.
+ @param [in] c_t_deriv  The derivative of the objective function w.r.t. c_t.
+ @param [in,out] h_t_deriv  At entry, the derivative of the objective function
+                        w.r.t. the output h_t (this is normally zero).  At exit,
+                        the derivative w.r.t. the argument of the tanh.
+ @param [in,out] z_t_deriv  If non-NULL, the derivative w.r.t. z_t is *added*
+                        to here.
+ @param [in,out] c_t1_deriv  If non-NULL, the part of the derivative w.r.t.
+                        c_{t-1} that arises via c_t is *added* to here.
+*/
+template<typename Real>
+void BackpropGruNonlinearity(const CuMatrixBase<Real> &z_t,
+                             const CuMatrixBase<Real> &h_t,
+                             const CuMatrixBase<Real> &c_t1,
+                             const CuMatrixBase<Real> &c_t_deriv,
+                             CuMatrixBase<Real> *h_t_deriv,
+                             CuMatrixBase<Real> *z_t_deriv,
+                             CuMatrixBase<Real> *c_t1_deriv);
+
+// CPU-only versions of ComputeGruNonlinearity and BackpropGruNonlinearity,
+// made available for testing purposes.
+template<typename Real>
+void CpuComputeGruNonlinearity(const MatrixBase<Real> &z_t,
+                               const MatrixBase<Real> &c_t1,
+                               MatrixBase<Real> *h_t,
+                               MatrixBase<Real> *c_t);
+template<typename Real>
+void CpuBackpropGruNonlinearity(const MatrixBase<Real> &z_t,
+                                const MatrixBase<Real> &h_t,
+                                const MatrixBase<Real> &c_t1,
+                                const MatrixBase<Real> &c_t_deriv,
+                                MatrixBase<Real> *h_t_deriv,
+                                MatrixBase<Real> *z_t_deriv,
+                                MatrixBase<Real> *c_t1_deriv);
+
 /// Normalize nonlinearity modifies the vector of activations
 /// by scaling it so that the root-mean-square equals 1.0.
 ///
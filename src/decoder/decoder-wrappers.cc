@@ -282,32 +282,21 @@ bool DecodeUtteranceLatticeIncremental(
 }
 
 
-// Takes care of output.  Returns true on success.
 template <typename FST>
-bool DecodeUtteranceLatticeFaster(
+bool GetLatticeFasterDecoderOutput(
     LatticeFasterDecoderTpl<FST> &decoder, // not const but is really an input.
-    DecodableInterface &decodable, // not const but is really an input.
     const TransitionModel &trans_model,
-    const fst::SymbolTable *word_syms,
-    std::string utt,
+    const std::string &utt,
     double acoustic_scale,
     bool determinize,
     bool allow_partial,
-    Int32VectorWriter *alignment_writer,
-    Int32VectorWriter *words_writer,
-    CompactLatticeWriter *compact_lattice_writer,
-    LatticeWriter *lattice_writer,
-    double *like_ptr) { // puts utterance's like in like_ptr on success.
-  using fst::VectorFst;
-
-  if (!decoder.Decode(&decodable)) {
-    KALDI_WARN << "Failed to decode utterance with id " << utt;
-    return false;
-  }
+    LatticeFasterDecoderOutput *output) {
+  output->partial = false;
   if (!decoder.ReachedFinal()) {
     if (allow_partial) {
       KALDI_WARN << "Outputting partial output for utterance " << utt
                  << " since no final-state reached\n";
+      output->partial = true;
     } else {
       KALDI_WARN << "Not producing output for utterance " << utt
                  << " since no final-state reached and "
@@ -316,44 +305,23 @@ bool DecodeUtteranceLatticeFaster(
     }
   }
 
-  double likelihood;
-  LatticeWeight weight;
-  int32 num_frames;
   { // First do some stuff with word-level traceback...
-    VectorFst<LatticeArc> decoded;
+    fst::VectorFst<LatticeArc> decoded;
     if (!decoder.GetBestPath(&decoded))
       // Shouldn't really reach this point as already checked success.
       KALDI_ERR << "Failed to get traceback for utterance " << utt;
-
-    std::vector<int32> alignment;
-    std::vector<int32> words;
-    GetLinearSymbolSequence(decoded, &alignment, &words, &weight);
-    num_frames = alignment.size();
-    if (words_writer->IsOpen())
-      words_writer->Write(utt, words);
-    if (alignment_writer->IsOpen())
-      alignment_writer->Write(utt, alignment);
-    if (word_syms != NULL) {
-      std::cerr << utt << ' ';
-      for (size_t i = 0; i < words.size(); i++) {
-        std::string s = word_syms->Find(words[i]);
-        if (s == "")
-          KALDI_ERR << "Word-id " << words[i] << " not in symbol table.";
-        std::cerr << s << ' ';
-      }
-      std::cerr << '\n';
-    }
-    likelihood = -(weight.Value1() + weight.Value2());
+    GetLinearSymbolSequence(decoded, &output->alignment, &output->words,
+                            &output->weight);
   }
 
   // Get lattice, and do determinization if requested.
-  Lattice lat;
+  Lattice &lat = output->lat;
   decoder.GetRawLattice(&lat);
   if (lat.NumStates() == 0)
     KALDI_ERR << "Unexpected problem getting lattice for utterance " << utt;
   fst::Connect(&lat);
   if (determinize) {
-    CompactLattice clat;
+    CompactLattice &clat = output->clat;
     if (!DeterminizeLatticePhonePrunedWrapper(
             trans_model,
             &lat,
@@ -362,26 +330,92 @@ bool DecodeUtteranceLatticeFaster(
             decoder.GetOptions().det_opts))
       KALDI_WARN << "Determinization finished earlier than the beam for "
                  << "utterance " << utt;
+    lat.DeleteStates();
     // We'll write the lattice without acoustic scaling.
     if (acoustic_scale != 0.0)
       fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), &clat);
-    compact_lattice_writer->Write(utt, clat);
   } else {
     // We'll write the lattice without acoustic scaling.
     if (acoustic_scale != 0.0)
       fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale), &lat);
-    lattice_writer->Write(utt, lat);
   }
+  return true;
+}
+
+void WriteLatticeFasterDecoderOutput(
+    const std::string &utt,
+    const LatticeFasterDecoderOutput &output,
+    const fst::SymbolTable *word_syms,
+    bool determinize,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr) {
+  const std::vector<int32> &words = output.words;
+  if (words_writer->IsOpen())
+    words_writer->Write(utt, words);
+  if (alignment_writer->IsOpen())
+    alignment_writer->Write(utt, output.alignment);
+  if (word_syms != NULL) {
+    std::cerr << utt << ' ';
+    for (size_t i = 0; i < words.size(); i++) {
+      std::string s = word_syms->Find(words[i]);
+      if (s == "")
+        KALDI_ERR << "Word-id " << words[i] << " not in symbol table.";
+      std::cerr << s << ' ';
+    }
+    std::cerr << '\n';
+  }
+  const LatticeWeight &weight = output.weight;
+  double likelihood = -(weight.Value1() + weight.Value2());
+  int32 num_frames = output.alignment.size();
+
+  if (determinize)
+    compact_lattice_writer->Write(utt, output.clat);
+  else
+    lattice_writer->Write(utt, output.lat);
   KALDI_LOG << "Log-like per frame for utterance " << utt << " is "
             << (likelihood / num_frames) << " over "
             << num_frames << " frames.";
   KALDI_VLOG(2) << "Cost for utterance " << utt << " is "
                 << weight.Value1() << " + " << weight.Value2();
   *like_ptr = likelihood;
+}
+
+// Takes care of output.  Returns true on success.
+template <typename FST>
+bool DecodeUtteranceLatticeFaster(
+    LatticeFasterDecoderTpl<FST> &decoder, // not const but is really an input.
+    DecodableInterface &decodable, // not const but is really an input.
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr) { // puts utterance's like in like_ptr on success.
+  if (!decoder.Decode(&decodable)) {
+    KALDI_WARN << "Failed to decode utterance with id " << utt;
+    return false;
+  }
+  LatticeFasterDecoderOutput output;
+  if (!GetLatticeFasterDecoderOutput(decoder, trans_model, utt,
+                                     acoustic_scale, determinize,
+                                     allow_partial, &output))
+    return false;
+  WriteLatticeFasterDecoderOutput(utt, output, word_syms, determinize,
+                                  alignment_writer, words_writer,
+                                  compact_lattice_writer, lattice_writer,
+                                  like_ptr);
   return true;
 }
 
-// Instantiate the template above for the two required FST types.
+// Instantiate the templates above for the required FST types.
 template bool DecodeUtteranceLatticeIncremental(
     LatticeIncrementalDecoderTpl<fst::Fst<fst::StdArc> > &decoder,
     DecodableInterface &decodable,
@@ -442,6 +476,72 @@ template bool DecodeUtteranceLatticeFaster(
     LatticeWriter *lattice_writer,
     double *like_ptr);
 
+template bool DecodeUtteranceLatticeFaster(
+    LatticeFasterDecoderTpl<fst::LmComposeFst> &decoder,
+    DecodableInterface &decodable,
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr);
+
+template bool DecodeUtteranceLatticeFaster(
+    LatticeFasterDecoderTpl<fst::FlatFst> &decoder,
+    DecodableInterface &decodable,
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    std::string utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignment_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr);
+
+template bool GetLatticeFasterDecoderOutput(
+    LatticeFasterDecoderTpl<fst::Fst<fst::StdArc> > &decoder,
+    const TransitionModel &trans_model,
+    const std::string &utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    LatticeFasterDecoderOutput *output);
+
+template bool GetLatticeFasterDecoderOutput(
+    LatticeFasterDecoderTpl<fst::ConstGrammarFst > &decoder,
+    const TransitionModel &trans_model,
+    const std::string &utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    LatticeFasterDecoderOutput *output);
+
+template bool GetLatticeFasterDecoderOutput(
+    LatticeFasterDecoderTpl<fst::LmComposeFst> &decoder,
+    const TransitionModel &trans_model,
+    const std::string &utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    LatticeFasterDecoderOutput *output);
+
+template bool GetLatticeFasterDecoderOutput(
+    LatticeFasterDecoderTpl<fst::FlatFst> &decoder,
+    const TransitionModel &trans_model,
+    const std::string &utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    LatticeFasterDecoderOutput *output);
+
 
 // Takes care of output.  Returns true on success.
 bool DecodeUtteranceLatticeSimple(
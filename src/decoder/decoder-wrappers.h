@@ -107,6 +107,52 @@ bool DecodeUtteranceLatticeIncremental(
     double *like_ptr);  // puts utterance's likelihood in like_ptr on success.
 
 
+/// The output for one utterance decoded with LatticeFasterDecoder, as
+/// produced by GetLatticeFasterDecoderOutput() and written out by
+/// WriteLatticeFasterDecoderOutput().  Keeping it separate from the decoder
+/// lets the decoder be reused before the output is written.
+struct LatticeFasterDecoderOutput {
+  bool partial;  // true if no final-state was reached.
+  std::vector<int32> alignment;
+  std::vector<int32> words;
+  LatticeWeight weight;  // the cost of the best path.
+  Lattice lat;  // the lattice, if not determinized.
+  CompactLattice clat;  // the lattice, if determinized.
+
+  LatticeFasterDecoderOutput(): partial(false) { }
+};
+
+/// This function gets the output of DecodeUtteranceLatticeFaster() from a
+/// decoder that has finished decoding the utterance 'utt': the best path,
+/// and the lattice, determinized if 'determinize' is true.  The lattice is
+/// scaled so that it is written without acoustic scaling.  Returns false,
+/// with a warning, if no final-state was reached and allow_partial == false.
+///
+/// Caution: this will only link correctly for the same FST types as
+/// DecodeUtteranceLatticeFaster().
+template <typename FST>
+bool GetLatticeFasterDecoderOutput(
+    LatticeFasterDecoderTpl<FST> &decoder, // not const but is really an input.
+    const TransitionModel &trans_model,
+    const std::string &utt,
+    double acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    LatticeFasterDecoderOutput *output);
+
+/// Writes out 'output' as DecodeUtteranceLatticeFaster() does, and logs the
+/// likelihood of the utterance, which it puts in like_ptr.
+void WriteLatticeFasterDecoderOutput(
+    const std::string &utt,
+    const LatticeFasterDecoderOutput &output,
+    const fst::SymbolTable *word_syms,
+    bool determinize,
+    Int32VectorWriter *alignments_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer,
+    double *like_ptr);
+
 /// This function DecodeUtteranceLatticeFaster is used in several decoders, and
 /// we have moved it here.  Note: this is really "binary-level" code as it
 /// involves table readers and writers; we've just put it here as there is no
@@ -114,9 +160,9 @@ bool DecodeUtteranceLatticeIncremental(
 /// lattice_writer, else to compact_lattice_writer.  The writers for
 /// alignments and words will only be written to if they are open.
 ///
-/// Caution: this will only link correctly if FST is either fst::Fst<fst::StdArc>,
-/// or fst::GrammarFst, as the template function is defined in the .cc file and
-/// only instantiated for those two types.
+/// Caution: this will only link correctly if FST is fst::Fst<fst::StdArc>,
+/// fst::ConstGrammarFst, fst::LmComposeFst or fst::FlatFst, as the template
+/// function is defined in the .cc file and only instantiated for those types.
 template <typename FST>
 bool DecodeUtteranceLatticeFaster(
     LatticeFasterDecoderTpl<FST> &decoder, // not const but is really an input.
@@ -65,9 +65,17 @@ void FasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
     target_frames_decoded = std::min(target_frames_decoded,
                                      num_frames_decoded_ + max_num_frames);
   while (num_frames_decoded_ < target_frames_decoded) {
+    KALDI_TRACE_SCOPE("FasterDecoder::DecodeFrame", num_frames_decoded_);
     // note: ProcessEmitting() increments num_frames_decoded_
-    double weight_cutoff = ProcessEmitting(decodable);
-    ProcessNonemitting(weight_cutoff);
+    double weight_cutoff;
+    {
+      KALDI_TRACE_SCOPE("FasterDecoder::ProcessEmitting");
+      weight_cutoff = ProcessEmitting(decodable);
+    }
+    {
+      KALDI_TRACE_SCOPE("FasterDecoder::ProcessNonemitting");
+      ProcessNonemitting(weight_cutoff);
+    }
   }
 }
 
@@ -0,0 +1,176 @@
+// decoder/flat-fst-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/flat-fst.h"
+#include "decoder/lattice-faster-decoder.h"
+#include "decoder/decodable-matrix.h"
+#include "fstext/fstext-utils.h"
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+
+namespace kaldi {
+
+using fst::StdArc;
+
+// Makes a random graph with input labels 1..num_indices in which every state
+// has an emitting self-loop, so no path dies, and epsilon arcs only go to
+// higher-numbered states.  The epsilon arcs are mixed in with the emitting
+// ones, as they would be in HCLG.
+static void RandomDecodingGraph(int32 num_indices, fst::StdVectorFst *fst) {
+  fst->DeleteStates();
+  int32 num_states = RandInt(2, 10);
+  for (int32 s = 0; s < num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    int32 num_arcs = RandInt(1, 5), self_loop = RandInt(0, num_arcs - 1);
+    for (int32 a = 0; a < num_arcs; a++) {
+      if (a == self_loop)
+        fst->AddArc(s, StdArc(RandInt(1, num_indices), 0, RandUniform(), s));
+      int32 next_state = RandInt(0, num_states - 1),
+          ilabel = RandInt(1, num_indices),
+          olabel = (RandInt(0, 1) == 0 ? 0 : RandInt(1, 20));
+      if (next_state > s && RandInt(0, 2) == 0)
+        ilabel = 0;
+      fst->AddArc(s, StdArc(ilabel, olabel, RandUniform(), next_state));
+    }
+    if (s == num_states - 1 || RandInt(0, 2) == 0)
+      fst->SetFinal(s, RandUniform());
+  }
+}
+
+static bool ArcsEqual(const StdArc &arc1, const StdArc &arc2) {
+  return arc1.ilabel == arc2.ilabel && arc1.olabel == arc2.olabel &&
+      arc1.weight == arc2.weight && arc1.nextstate == arc2.nextstate;
+}
+
+// Checks that FlatFst has the same states, final-probs and arcs as the FST it
+// was made from, with the epsilon arcs of each state first and otherwise in
+// the original order, and that the iterators the decoder uses see the right
+// arcs.
+void UnitTestFlatFstConversion() {
+  fst::StdVectorFst fst;
+  RandomDecodingGraph(RandInt(1, 10), &fst);
+  fst::FlatFst flat_fst(fst);
+  KALDI_ASSERT(flat_fst.Start() == fst.Start() &&
+               flat_fst.NumStates() == fst.NumStates());
+  // The arc array is aligned to a cache line.
+  KALDI_ASSERT(reinterpret_cast<size_t>(flat_fst.Arcs(0)) % 64 == 0);
+  for (int32 s = 0; s < fst.NumStates(); s++) {
+    KALDI_ASSERT(flat_fst.Final(s) == fst.Final(s) &&
+                 flat_fst.NumArcs(s) == fst.NumArcs(s) &&
+                 flat_fst.NumInputEpsilons(s) == fst.NumInputEpsilons(s));
+    std::vector<StdArc> epsilon_arcs, emitting_arcs;
+    for (fst::ArcIterator<fst::StdVectorFst> aiter(fst, s); !aiter.Done();
+         aiter.Next()) {
+      const StdArc &arc = aiter.Value();
+      (arc.ilabel == 0 ? epsilon_arcs : emitting_arcs).push_back(arc);
+    }
+    std::vector<StdArc> arcs(epsilon_arcs);
+    arcs.insert(arcs.end(), emitting_arcs.begin(), emitting_arcs.end());
+
+    size_t i = 0;
+    for (fst::ArcIterator<fst::FlatFst> aiter(flat_fst, s); !aiter.Done();
+         aiter.Next(), i++)
+      KALDI_ASSERT(i < arcs.size() && ArcsEqual(aiter.Value(), arcs[i]) &&
+                   &(aiter.Value()) == flat_fst.Arcs(s) + i);
+    KALDI_ASSERT(i == arcs.size());
+
+    i = 0;
+    for (fst::FlatFstNonemittingArcIterator aiter(flat_fst, s); !aiter.Done();
+         aiter.Next(), i++)
+      KALDI_ASSERT(i < epsilon_arcs.size() &&
+                   ArcsEqual(aiter.Value(), epsilon_arcs[i]));
+    KALDI_ASSERT(i == epsilon_arcs.size());
+
+    i = 0;
+    for (fst::FlatFstEmittingArcIterator aiter(flat_fst, s); !aiter.Done();
+         aiter.Next(), i++)
+      KALDI_ASSERT(i < emitting_arcs.size() &&
+                   ArcsEqual(aiter.Value(), emitting_arcs[i]));
+    KALDI_ASSERT(i == emitting_arcs.size());
+  }
+}
+
+// Decodes 'loglikes' with 'fst', with a beam wide enough not to prune
+// anything, and outputs the best path's words and the raw lattice
+// (topologically sorted); returns the cost of the best path.
+template <typename FST>
+static BaseFloat Decode(const FST &fst,
+                        const Matrix<BaseFloat> &loglikes,
+                        std::vector<int32> *words,
+                        Lattice *lat) {
+  LatticeFasterDecoderConfig config;
+  config.beam = 1000.0;
+  config.lattice_beam = 5.0;
+  LatticeFasterDecoderTpl<FST> decoder(fst, config);
+  DecodableMatrixScaled decodable(loglikes, 1.0);
+  KALDI_ASSERT(decoder.Decode(&decodable));
+  Lattice best_path;
+  KALDI_ASSERT(decoder.GetBestPath(&best_path));
+  std::vector<int32> alignment;
+  LatticeWeight weight;
+  fst::GetLinearSymbolSequence(best_path, &alignment, words, &weight);
+  KALDI_ASSERT(alignment.size() == static_cast<size_t>(loglikes.NumRows()));
+  KALDI_ASSERT(decoder.GetRawLattice(lat));
+  fst::TopSort(lat);
+  return weight.Value1() + weight.Value2();
+}
+
+// Checks that LatticeFasterDecoderTpl<FlatFst> gives the same best path and
+// the same lattice as decoding the original graph.  The lattice states may be
+// numbered differently, as the decoder visits the arcs in a different order,
+// so we compare their sizes and total likelihoods.
+void UnitTestFlatFstDecoding() {
+  int32 num_indices = RandInt(1, 8), num_frames = RandInt(1, 20);
+  fst::StdVectorFst fst;
+  RandomDecodingGraph(num_indices, &fst);
+  fst::FlatFst flat_fst(fst);
+  Matrix<BaseFloat> loglikes(num_frames, num_indices);
+  loglikes.SetRandn();
+
+  std::vector<int32> words1, words2;
+  Lattice lat1, lat2;
+  BaseFloat cost1 = Decode(fst, loglikes, &words1, &lat1),
+      cost2 = Decode(flat_fst, loglikes, &words2, &lat2);
+  KALDI_ASSERT(words1 == words2);
+  AssertEqual(cost1, cost2, 1.0e-04);
+
+  KALDI_ASSERT(lat1.NumStates() == lat2.NumStates());
+  int32 num_arcs1 = 0, num_arcs2 = 0;
+  for (int32 s = 0; s < lat1.NumStates(); s++) {
+    num_arcs1 += lat1.NumArcs(s);
+    num_arcs2 += lat2.NumArcs(s);
+  }
+  KALDI_ASSERT(num_arcs1 == num_arcs2);
+  std::vector<double> alpha, beta;
+  double tot_like1 = ComputeLatticeAlphasAndBetas(lat1, false, &alpha, &beta),
+      tot_like2 = ComputeLatticeAlphasAndBetas(lat2, false, &alpha, &beta);
+  AssertEqual(tot_like1, tot_like2, 1.0e-04);
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 50; i++) {
+    UnitTestFlatFstConversion();
+    UnitTestFlatFstDecoding();
+  }
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,73 @@
+// decoder/flat-fst.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/flat-fst.h"
+
+namespace fst {
+
+FlatFst::FlatFst(const Fst<StdArc> &fst): start_(fst.Start()), arcs_(NULL),
+                                          arcs_free_(NULL) {
+  // First pass: the state records, and the number of arcs.
+  uint64 num_arcs = 0;
+  for (StateIterator<Fst<StdArc> > siter(fst); !siter.Done(); siter.Next()) {
+    StateId s = siter.Value();
+    if (static_cast<size_t>(s) >= states_.size())
+      states_.resize(s + 1);
+    State &state = states_[s];
+    size_t num_eps = fst.NumInputEpsilons(s), n = fst.NumArcs(s);
+    state.arc_begin = num_arcs;
+    state.emitting_begin = num_arcs + num_eps;
+    num_arcs += n;
+    state.arc_end = num_arcs;
+    state.final_cost = fst.Final(s).Value();
+  }
+  if (num_arcs > static_cast<uint64>(std::numeric_limits<uint32>::max()))
+    KALDI_ERR << "FST has too many arcs (" << num_arcs << ") for FlatFst.";
+  if (start_ == kNoStateId)
+    KALDI_WARN << "Creating FlatFst from empty FST.";
+  if (num_arcs == 0)
+    return;
+
+  // 64 bytes is the cache-line size on all current x86 and most ARM machines.
+  void *data;
+  if ((data = KALDI_MEMALIGN(64, num_arcs * sizeof(Arc), &arcs_free_)) == NULL)
+    throw std::bad_alloc();
+  arcs_ = static_cast<Arc*>(data);
+
+  // Second pass: the arcs, nonemitting ones first, otherwise in their
+  // original order.
+  for (StateIterator<Fst<StdArc> > siter(fst); !siter.Done(); siter.Next()) {
+    StateId s = siter.Value();
+    const State &state = states_[s];
+    Arc *eps_arc = arcs_ + state.arc_begin,
+        *emitting_arc = arcs_ + state.emitting_begin;
+    for (ArcIterator<Fst<StdArc> > aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      if (arc.ilabel == 0) *(eps_arc++) = arc;
+      else *(emitting_arc++) = arc;
+    }
+    KALDI_ASSERT(eps_arc == arcs_ + state.emitting_begin &&
+                 emitting_arc == arcs_ + state.arc_end);
+  }
+}
+
+FlatFst::~FlatFst() {
+  if (arcs_free_ != NULL)
+    KALDI_MEMALIGN_FREE(arcs_free_);
+}
+
+}  // namespace fst
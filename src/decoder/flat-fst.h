@@ -0,0 +1,181 @@
+// decoder/flat-fst.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_FLAT_FST_H_
+#define KALDI_DECODER_FLAT_FST_H_
+
+/**
+   This header implements FlatFst, a read-only in-memory representation of a
+   decoding graph (e.g. HCLG) laid out for the inner loops of the decoders.
+   Like GrammarFst (see grammar-fst.h) it does not inherit from class Fst; it
+   just has enough of the same interface for LatticeFasterDecoderTpl to be
+   instantiated with it.
+
+   The arcs of all states are in a single array of StdArc (whose fields are all
+   32 bits; 4 arcs to a 64-byte cache line), aligned to a cache line, and the
+   arcs of each state are ordered so that the nonemitting arcs (ilabel == 0)
+   come first and the emitting arcs after them.  With the iterators returned by
+   DecoderArcIterators<FlatFst> (below), ProcessEmitting() and
+   ProcessNonemitting() in the decoder visit only the arcs they need, and the
+   iteration is a pointer walk with no virtual calls or per-state lookups
+   beyond one 16-byte state record.
+ */
+
+#include "base/kaldi-common.h"
+#include "fst/fstlib.h"
+
+namespace fst {
+
+class FlatFst;
+
+// Declare that we'll be overriding class ArcIterator for class FlatFst.
+template <> class ArcIterator<FlatFst>;
+
+
+class FlatFst {
+ public:
+  typedef StdArc Arc;
+  typedef TropicalWeight Weight;
+  typedef Arc::StateId StateId;
+  typedef Arc::Label Label;
+
+  /// The information we need about each state, in one 16-byte record.
+  struct State {
+    uint32 arc_begin;  // index of the first arc of this state in arcs_.
+    uint32 emitting_begin;  // index of the first emitting arc.
+    uint32 arc_end;  // one past the index of the last arc.
+    float final_cost;  // final-prob, as a cost (infinity if not final).
+  };
+
+  /// Copies 'fst', which may be of any type (ConstFst would be usual).  The
+  /// state numbering is unchanged.  Requires the number of arcs to fit in 32
+  /// bits.
+  explicit FlatFst(const Fst<StdArc> &fst);
+
+  ~FlatFst();
+
+  inline StateId Start() const { return start_; }
+
+  inline Weight Final(StateId s) const {
+    return Weight(states_[s].final_cost);
+  }
+
+  inline size_t NumInputEpsilons(StateId s) const {
+    return states_[s].emitting_begin - states_[s].arc_begin;
+  }
+
+  inline size_t NumArcs(StateId s) const {
+    return states_[s].arc_end - states_[s].arc_begin;
+  }
+
+  inline StateId NumStates() const { return states_.size(); }
+
+  inline std::string Type() const { return "flat"; }
+
+  /// Returns the arcs of state s; the nonemitting arcs are arcs[0] through
+  /// arcs[NumInputEpsilons(s) - 1].
+  inline const Arc *Arcs(StateId s) const {
+    return arcs_ + states_[s].arc_begin;
+  }
+
+ private:
+  friend class ArcIterator<FlatFst>;
+  friend class FlatFstEmittingArcIterator;
+  friend class FlatFstNonemittingArcIterator;
+
+  StateId start_;
+  std::vector<State> states_;
+  Arc *arcs_;  // cache-line aligned; size is states_.back().arc_end.
+  void *arcs_free_;  // what to free, from KALDI_MEMALIGN.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(FlatFst);
+};
+
+
+/**
+   Base-class of the arc iterators for FlatFst; iterates over a range of the
+   arc array.  As for the other special FST types, only what the decoder needs
+   is implemented.
+ */
+class FlatFstArcIteratorBase {
+ public:
+  typedef FlatFst::Arc Arc;
+
+  inline bool Done() const { return arc_ == end_; }
+
+  inline void Next() { ++arc_; }
+
+  inline const Arc &Value() const { return *arc_; }
+
+ protected:
+  FlatFstArcIteratorBase(const Arc *begin, const Arc *end):
+      arc_(begin), end_(end) { }
+
+  const Arc *arc_;
+  const Arc *end_;
+};
+
+
+/// Iterates over all the arcs of a state.
+template <>
+class ArcIterator<FlatFst>: public FlatFstArcIteratorBase {
+ public:
+  inline ArcIterator(const FlatFst &fst, FlatFst::StateId s):
+      FlatFstArcIteratorBase(fst.arcs_ + fst.states_[s].arc_begin,
+                             fst.arcs_ + fst.states_[s].arc_end) { }
+};
+
+/// Iterates over just the emitting arcs (ilabel != 0) of a state.
+class FlatFstEmittingArcIterator: public FlatFstArcIteratorBase {
+ public:
+  inline FlatFstEmittingArcIterator(const FlatFst &fst, FlatFst::StateId s):
+      FlatFstArcIteratorBase(fst.arcs_ + fst.states_[s].emitting_begin,
+                             fst.arcs_ + fst.states_[s].arc_end) { }
+};
+
+/// Iterates over just the nonemitting arcs (ilabel == 0) of a state.
+class FlatFstNonemittingArcIterator: public FlatFstArcIteratorBase {
+ public:
+  inline FlatFstNonemittingArcIterator(const FlatFst &fst, FlatFst::StateId s):
+      FlatFstArcIteratorBase(fst.arcs_ + fst.states_[s].arc_begin,
+                             fst.arcs_ + fst.states_[s].emitting_begin) { }
+};
+
+
+/**
+   DecoderArcIterators<FST> gives the types of arc iterator that the decoders
+   use when they only want the emitting or only the nonemitting arcs of a
+   state.  In general these are just ArcIterator<FST>, and the decoder skips
+   the arcs it doesn't want; for FSTs that keep the two kinds of arc apart
+   (FlatFst), they visit only the wanted arcs.  Either way the caller still
+   checks the ilabel, so the two are interchangeable.
+ */
+template <class FST>
+struct DecoderArcIterators {
+  typedef ArcIterator<FST> Emitting;
+  typedef ArcIterator<FST> Nonemitting;
+};
+
+template <>
+struct DecoderArcIterators<FlatFst> {
+  typedef FlatFstEmittingArcIterator Emitting;
+  typedef FlatFstNonemittingArcIterator Nonemitting;
+};
+
+}  // namespace fst
+
+#endif  // KALDI_DECODER_FLAT_FST_H_
@@ -0,0 +1,451 @@
+// decoder/grammar-fst-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <thread>
+#include <unordered_set>
+#include "decoder/grammar-fst.h"
+
+namespace kaldi {
+
+using fst::StdArc;
+using fst::StdVectorFst;
+using fst::VectorGrammarFst;
+
+// The FSTs below are written by hand in the form that PrepareForGrammarFst()
+// produces.  Phones are 1..9, and #nonterm_bos is 10.
+static const int32 kNontermPhonesOffset = 10;
+static const int32 kFoo = kNontermPhonesOffset + fst::kNontermUserDefined,
+    kBar = kFoo + 1, kBaz = kFoo + 2;
+
+// Returns the ilabel that encodes the pair (nonterminal, left_context_phone),
+// where 'nonterminal' is e.g. kFoo or fst::kNontermEnd.
+static int32 NontermLabel(int32 nonterminal, int32 left_context_phone) {
+  if (nonterminal < kNontermPhonesOffset)
+    nonterminal += kNontermPhonesOffset;
+  return fst::kNontermBigNumber +
+      nonterminal * fst::GetEncodingMultiple(kNontermPhonesOffset) +
+      left_context_phone;
+}
+
+// Adds a state whose arcs are all nonterminal arcs, which is marked by the
+// special final-prob.
+static int32 AddSpecialState(StdVectorFst *fst) {
+  int32 s = fst->AddState();
+  fst->SetFinal(s, KALDI_GRAMMAR_FST_SPECIAL_WEIGHT);
+  return s;
+}
+
+// Makes a top-level FST that invokes each of 'nonterminals' in turn, with
+// left-context phone 2; the FSTs invoked may return with left-context phone 1
+// or 2.  Each invocation creates an FST instance.  The arc before the i'th one
+// has ilabel 1 + nonterminals[i] % 5 and olabel 100 + i.
+static std::shared_ptr<StdVectorFst> MakeTopFst(
+    const std::vector<int32> &nonterminals) {
+  std::shared_ptr<StdVectorFst> fst(new StdVectorFst());
+  int32 state = fst->AddState();
+  fst->SetStart(state);
+  for (size_t i = 0; i < nonterminals.size(); i++) {
+    int32 nonterminal = nonterminals[i],
+        call_state = AddSpecialState(fst.get()),
+        return_state = fst->AddState(),
+        next_state = fst->AddState();
+    fst->AddArc(state, StdArc(1 + nonterminal % 5, 100 + i, 1.0, call_state));
+    fst->AddArc(call_state, StdArc(NontermLabel(nonterminal, 2), 0, 0.5,
+                                   return_state));
+    fst->AddArc(return_state, StdArc(NontermLabel(fst::kNontermReenter, 1), 0,
+                                     0.0, next_state));
+    fst->AddArc(return_state, StdArc(NontermLabel(fst::kNontermReenter, 2), 0,
+                                     0.25, next_state));
+    state = next_state;
+  }
+  fst->SetFinal(state, 0.0);
+  return fst;
+}
+
+// Makes the FST for kFoo: it can be entered with left-context phone 1 or 2,
+// outputs 'olabel' and returns with left-context phone 1.
+static std::shared_ptr<StdVectorFst> MakeFooFst(int32 olabel) {
+  std::shared_ptr<StdVectorFst> fst(new StdVectorFst());
+  for (int32 s = 0; s < 2; s++)
+    fst->AddState();
+  int32 end_state = AddSpecialState(fst.get()), final_state = fst->AddState();
+  fst->SetStart(0);
+  fst->AddArc(0, StdArc(NontermLabel(fst::kNontermBegin, 1), 0, 0.0, 1));
+  fst->AddArc(0, StdArc(NontermLabel(fst::kNontermBegin, 2), 0, 0.0, 1));
+  fst->AddArc(1, StdArc(2, olabel, 1.0, end_state));
+  fst->AddArc(end_state, StdArc(NontermLabel(fst::kNontermEnd, 1), 0, 0.0,
+                                final_state));
+  fst->SetFinal(final_state, 0.0);
+  return fst;
+}
+
+// Makes the FST for kBar, which outputs 300, invokes kFoo, outputs 400 and
+// returns with left-context phone 2.
+static std::shared_ptr<StdVectorFst> MakeBarFst() {
+  std::shared_ptr<StdVectorFst> fst(new StdVectorFst());
+  for (int32 s = 0; s < 2; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  fst->AddArc(0, StdArc(NontermLabel(fst::kNontermBegin, 1), 0, 0.0, 1));
+  fst->AddArc(0, StdArc(NontermLabel(fst::kNontermBegin, 2), 0, 0.0, 1));
+  int32 call_state = AddSpecialState(fst.get()),
+      return_state = fst->AddState(), next_state = fst->AddState(),
+      end_state = AddSpecialState(fst.get()), final_state = fst->AddState();
+  fst->AddArc(1, StdArc(3, 300, 1.0, call_state));
+  fst->AddArc(call_state, StdArc(NontermLabel(kFoo, 2), 0, 0.5, return_state));
+  fst->AddArc(return_state, StdArc(NontermLabel(fst::kNontermReenter, 1), 0,
+                                   0.0, next_state));
+  fst->AddArc(return_state, StdArc(NontermLabel(fst::kNontermReenter, 3), 0,
+                                   0.0, next_state));
+  fst->AddArc(next_state, StdArc(4, 400, 1.0, end_state));
+  fst->AddArc(end_state, StdArc(NontermLabel(fst::kNontermEnd, 2), 0, 0.0,
+                                final_state));
+  fst->SetFinal(final_state, 0.0);
+  return fst;
+}
+
+// Makes the FST for kBaz, which outputs 500 if entered with left-context phone
+// 2 and 600 (at a higher cost) if entered with 1, and returns with
+// left-context phone 1.  Its entry arcs are in the opposite order to those of
+// the other FSTs, so using the wrong FstInfo for it would give wrong arcs.
+static std::shared_ptr<StdVectorFst> MakeBazFst() {
+  std::shared_ptr<StdVectorFst> fst(new StdVectorFst());
+  for (int32 s = 0; s < 3; s++)
+    fst->AddState();
+  int32 end_state = AddSpecialState(fst.get()), final_state = fst->AddState();
+  fst->SetStart(0);
+  fst->AddArc(0, StdArc(NontermLabel(fst::kNontermBegin, 2), 0, 0.0, 1));
+  fst->AddArc(0, StdArc(NontermLabel(fst::kNontermBegin, 1), 0, 2.0, 2));
+  fst->AddArc(1, StdArc(5, 500, 1.0, end_state));
+  fst->AddArc(2, StdArc(6, 600, 1.0, end_state));
+  fst->AddArc(end_state, StdArc(NontermLabel(fst::kNontermEnd, 1), 0, 0.0,
+                                final_state));
+  fst->SetFinal(final_state, 0.0);
+  return fst;
+}
+
+typedef std::vector<std::pair<int32, std::shared_ptr<StdVectorFst> > >
+    NonterminalFsts;
+
+static NonterminalFsts MakeNonterminalFsts() {
+  NonterminalFsts ans;
+  ans.push_back(std::make_pair(kFoo, MakeFooFst(200)));
+  ans.push_back(std::make_pair(kBar, MakeBarFst()));
+  ans.push_back(std::make_pair(kBaz, MakeBazFst()));
+  return ans;
+}
+
+// Makes an FST with a single path with the given labels and costs.
+static void MakeLinearFst(const std::vector<StdArc> &arcs, StdVectorFst *fst) {
+  fst->DeleteStates();
+  int32 state = fst->AddState();
+  fst->SetStart(state);
+  for (size_t i = 0; i < arcs.size(); i++) {
+    int32 next_state = fst->AddState();
+    fst->AddArc(state, StdArc(arcs[i].ilabel, arcs[i].olabel, arcs[i].weight,
+                              next_state));
+    state = next_state;
+  }
+  fst->SetFinal(state, 0.0);
+}
+
+// Returns the number of FST instances reachable from the start state of
+// 'grammar_fst' (state-ids have the instance-id in their high-order bits).
+static int32 NumInstancesReached(const VectorGrammarFst &grammar_fst) {
+  std::vector<VectorGrammarFst::StateId> queue(1, grammar_fst.Start());
+  std::unordered_set<VectorGrammarFst::StateId> seen(queue.begin(),
+                                                     queue.end());
+  int32 max_instance_id = 0;
+  while (!queue.empty()) {
+    VectorGrammarFst::StateId s = queue.back();
+    queue.pop_back();
+    max_instance_id = std::max<int32>(max_instance_id, s >> 32);
+    fst::ArcIterator<VectorGrammarFst> aiter(grammar_fst, s);
+    for (; !aiter.Done(); aiter.Next())
+      if (seen.insert(aiter.Value().nextstate).second)
+        queue.push_back(aiter.Value().nextstate);
+  }
+  return max_instance_id + 1;
+}
+
+// Checks CopyToVectorFst() on a small GrammarFst against the expansion worked
+// out by hand.  'Correction' is the cost correction -log(2) that GrammarFst
+// adds when crossing into or out of an FST with 2 entry or re-entry arcs.
+void UnitTestGrammarFstExpansion() {
+  std::vector<int32> nonterminals;
+  nonterminals.push_back(kFoo);
+  nonterminals.push_back(kBar);
+  nonterminals.push_back(kBaz);
+  VectorGrammarFst grammar_fst(kNontermPhonesOffset, MakeTopFst(nonterminals),
+                               MakeNonterminalFsts());
+  StdVectorFst copy;
+  CopyToVectorFst(&grammar_fst, &copy);
+
+  BaseFloat correction = -Log(2.0);
+  std::vector<StdArc> arcs;
+  // Invoke kFoo, which returns with left-context phone 1.
+  arcs.push_back(StdArc(1 + kFoo % 5, 100, 1.0, 0));
+  arcs.push_back(StdArc(0, 0, 0.5 + correction, 0));
+  arcs.push_back(StdArc(2, 200, 1.0, 0));
+  arcs.push_back(StdArc(0, 0, 0.0 + correction, 0));
+  // Invoke kBar, which invokes kFoo and returns with left-context phone 2.
+  arcs.push_back(StdArc(1 + kBar % 5, 101, 1.0, 0));
+  arcs.push_back(StdArc(0, 0, 0.5 + correction, 0));
+  arcs.push_back(StdArc(3, 300, 1.0, 0));
+  arcs.push_back(StdArc(0, 0, 0.5 + correction, 0));
+  arcs.push_back(StdArc(2, 200, 1.0, 0));
+  arcs.push_back(StdArc(0, 0, 0.0 + correction, 0));
+  arcs.push_back(StdArc(4, 400, 1.0, 0));
+  arcs.push_back(StdArc(0, 0, 0.25 + correction, 0));
+  // Invoke kBaz with left-context phone 2, which returns with phone 1.
+  arcs.push_back(StdArc(1 + kBaz % 5, 102, 1.0, 0));
+  arcs.push_back(StdArc(0, 0, 0.5 + correction, 0));
+  arcs.push_back(StdArc(5, 500, 1.0, 0));
+  arcs.push_back(StdArc(0, 0, 0.0 + correction, 0));
+  StdVectorFst expected;
+  MakeLinearFst(arcs, &expected);
+  KALDI_ASSERT(fst::Equal(copy, expected, 1.0e-04));
+  KALDI_ASSERT(NumInstancesReached(grammar_fst) == 5);
+}
+
+// Checks that several threads expanding the same GrammarFst at once (some via
+// copies of it, which share its expanded states) get the same result as a
+// single thread does.  There are enough FST instances that the table of them
+// has to grow while the threads are using it.
+void UnitTestGrammarFstThreaded() {
+  std::vector<int32> nonterminals;
+  int32 num_invocations = RandInt(40, 60);
+  for (int32 i = 0; i < num_invocations; i++)
+    nonterminals.push_back(kFoo + RandInt(0, 2));
+  std::shared_ptr<StdVectorFst> top_fst = MakeTopFst(nonterminals);
+  NonterminalFsts ifsts = MakeNonterminalFsts();
+
+  VectorGrammarFst grammar_fst_ref(kNontermPhonesOffset, top_fst, ifsts);
+  StdVectorFst ref;
+  CopyToVectorFst(&grammar_fst_ref, &ref);
+  // With 40 or more invocations there are more than 32 FST instances, so the
+  // table starts at 16 and is reallocated at least twice.
+  KALDI_ASSERT(NumInstancesReached(grammar_fst_ref) > num_invocations);
+
+  VectorGrammarFst grammar_fst(kNontermPhonesOffset, top_fst, ifsts),
+      grammar_fst_copy(grammar_fst);
+  int32 num_threads = 4;
+  std::vector<StdVectorFst> copies(num_threads);
+  std::vector<std::thread> threads;
+  for (int32 t = 0; t < num_threads; t++)
+    threads.push_back(std::thread(
+        &fst::CopyToVectorFst<StdVectorFst>,
+        (t % 2 == 0 ? &grammar_fst : &grammar_fst_copy), &(copies[t])));
+  for (int32 t = 0; t < num_threads; t++)
+    threads[t].join();
+  for (int32 t = 0; t < num_threads; t++)
+    KALDI_ASSERT(fst::Equal(copies[t], ref));
+  KALDI_ASSERT(NumInstancesReached(grammar_fst) ==
+               NumInstancesReached(grammar_fst_ref));
+}
+
+// Returns the expansion of a GrammarFst made from 'top_fst' and 'ifsts'.
+static void ExpandGrammarFst(std::shared_ptr<StdVectorFst> top_fst,
+                             const NonterminalFsts &ifsts,
+                             StdVectorFst *expanded) {
+  VectorGrammarFst grammar_fst(kNontermPhonesOffset, top_fst, ifsts);
+  CopyToVectorFst(&grammar_fst, expanded);
+}
+
+// Returns true if expanding 'grammar_fst' fails because it reaches a
+// nonterminal for which there is no FST.
+static bool ExpansionFails(VectorGrammarFst *grammar_fst) {
+  StdVectorFst expanded;
+  try {
+    CopyToVectorFst(grammar_fst, &expanded);
+    return false;
+  } catch (const std::runtime_error &) {
+    return true;
+  }
+}
+
+// Checks that SetNonterminalFst(), when replacing an FST, affects only the
+// object it is called on and not copies made earlier, whether or not they
+// have been expanded.
+void UnitTestGrammarFstReplace() {
+  std::vector<int32> nonterminals;
+  nonterminals.push_back(kBar);
+  nonterminals.push_back(kFoo);
+  nonterminals.push_back(kBaz);
+  std::shared_ptr<StdVectorFst> top_fst = MakeTopFst(nonterminals);
+  NonterminalFsts ifsts = MakeNonterminalFsts(), new_ifsts = ifsts;
+  new_ifsts[0].second = MakeFooFst(201);
+  StdVectorFst old_ref, new_ref;
+  ExpandGrammarFst(top_fst, ifsts, &old_ref);
+  ExpandGrammarFst(top_fst, new_ifsts, &new_ref);
+  KALDI_ASSERT(!fst::Equal(old_ref, new_ref));
+
+  VectorGrammarFst grammar_fst(kNontermPhonesOffset, top_fst, ifsts),
+      unexpanded_copy(grammar_fst);
+  StdVectorFst expanded;
+  CopyToVectorFst(&grammar_fst, &expanded);
+  KALDI_ASSERT(fst::Equal(expanded, old_ref));
+  VectorGrammarFst expanded_copy(grammar_fst), new_grammar_fst(grammar_fst);
+
+  new_grammar_fst.SetNonterminalFst(kFoo, new_ifsts[0].second);
+  CopyToVectorFst(&new_grammar_fst, &expanded);
+  KALDI_ASSERT(fst::Equal(expanded, new_ref));
+  CopyToVectorFst(&grammar_fst, &expanded);
+  KALDI_ASSERT(fst::Equal(expanded, old_ref));
+  CopyToVectorFst(&expanded_copy, &expanded);
+  KALDI_ASSERT(fst::Equal(expanded, old_ref));
+  CopyToVectorFst(&unexpanded_copy, &expanded);
+  KALDI_ASSERT(fst::Equal(expanded, old_ref));
+}
+
+// Checks SetNonterminalFst() when adding an FST, and RemoveNonterminalFst().
+void UnitTestGrammarFstAddRemove() {
+  std::vector<int32> nonterminals;
+  nonterminals.push_back(kFoo);
+  nonterminals.push_back(kBaz);
+  nonterminals.push_back(kFoo);
+  std::shared_ptr<StdVectorFst> top_fst = MakeTopFst(nonterminals);
+  NonterminalFsts all_ifsts = MakeNonterminalFsts(), foo_ifsts, foo_baz_ifsts;
+  foo_ifsts.push_back(all_ifsts[0]);
+  foo_baz_ifsts.push_back(all_ifsts[0]);
+  foo_baz_ifsts.push_back(all_ifsts[2]);
+  StdVectorFst ref, expanded;
+  ExpandGrammarFst(top_fst, foo_baz_ifsts, &ref);
+
+  // Adding kBaz.
+  VectorGrammarFst foo_grammar_fst(kNontermPhonesOffset, top_fst, foo_ifsts),
+      new_grammar_fst(foo_grammar_fst);
+  new_grammar_fst.SetNonterminalFst(kBaz, all_ifsts[2].second);
+  KALDI_ASSERT(new_grammar_fst.HasNonterminalFst(kBaz) &&
+               !foo_grammar_fst.HasNonterminalFst(kBaz));
+  CopyToVectorFst(&new_grammar_fst, &expanded);
+  KALDI_ASSERT(fst::Equal(expanded, ref));
+  KALDI_ASSERT(ExpansionFails(&foo_grammar_fst));
+
+  // Removing kBar, which comes first in 'ifsts', so the indexes of the FSTs
+  // for kFoo and kBaz change.  The information about them that was worked out
+  // while expanding must go with them; baz's entry arcs are in a different
+  // order from foo's, so if it didn't, the arcs would come out wrong.
+  NonterminalFsts ifsts;
+  ifsts.push_back(all_ifsts[1]);
+  ifsts.push_back(all_ifsts[0]);
+  ifsts.push_back(all_ifsts[2]);
+  VectorGrammarFst grammar_fst(kNontermPhonesOffset, top_fst, ifsts);
+  CopyToVectorFst(&grammar_fst, &expanded);
+  KALDI_ASSERT(fst::Equal(expanded, ref));
+  VectorGrammarFst removed_grammar_fst(grammar_fst);
+  removed_grammar_fst.RemoveNonterminalFst(kBar);
+  KALDI_ASSERT(!removed_grammar_fst.HasNonterminalFst(kBar) &&
+               grammar_fst.HasNonterminalFst(kBar));
+  CopyToVectorFst(&removed_grammar_fst, &expanded);
+  KALDI_ASSERT(fst::Equal(expanded, ref));
+
+  // Removing kFoo, which the top FST invokes, makes expansion fail.
+  removed_grammar_fst.RemoveNonterminalFst(kFoo);
+  KALDI_ASSERT(ExpansionFails(&removed_grammar_fst));
+  CopyToVectorFst(&grammar_fst, &expanded);
+  KALDI_ASSERT(fst::Equal(expanded, ref));
+}
+
+static void ExpandSnapshots(const fst::LiveVectorGrammarFst *live_fst,
+                            int32 num_snapshots,
+                            const std::vector<StdVectorFst> *refs,
+                            bool *ok) {
+  *ok = true;
+  for (int32 i = 0; i < num_snapshots; i++) {
+    std::shared_ptr<const VectorGrammarFst> snapshot = live_fst->Snapshot();
+    VectorGrammarFst grammar_fst(*snapshot);
+    StdVectorFst expanded;
+    CopyToVectorFst(&grammar_fst, &expanded);
+    bool found = false;
+    for (size_t j = 0; j < refs->size(); j++)
+      if (fst::Equal(expanded, (*refs)[j]))
+        found = true;
+    if (!found)
+      *ok = false;
+  }
+}
+
+// Checks that LiveGrammarFst's snapshots are not affected by later changes,
+// including while other threads are decoding with them.
+void UnitTestLiveGrammarFst() {
+  std::vector<int32> nonterminals;
+  for (int32 i = 0; i < 20; i++)
+    nonterminals.push_back(kFoo + RandInt(0, 1));
+  std::shared_ptr<StdVectorFst> top_fst = MakeTopFst(nonterminals);
+  NonterminalFsts ifsts = MakeNonterminalFsts(), foo201_ifsts = ifsts;
+  foo201_ifsts[0].second = MakeFooFst(201);
+  std::vector<StdVectorFst> refs(2);
+  ExpandGrammarFst(top_fst, ifsts, &(refs[0]));
+  ExpandGrammarFst(top_fst, foo201_ifsts, &(refs[1]));
+
+  VectorGrammarFst grammar_fst(kNontermPhonesOffset, top_fst, ifsts);
+  fst::LiveVectorGrammarFst live_fst(grammar_fst);
+  KALDI_ASSERT(live_fst.Version() == 0);
+  std::shared_ptr<const VectorGrammarFst> snapshot0 = live_fst.Snapshot();
+  live_fst.SetNonterminalFst(kFoo, foo201_ifsts[0].second);
+  std::shared_ptr<const VectorGrammarFst> snapshot1 = live_fst.Snapshot();
+  live_fst.RemoveNonterminalFst(kBaz);
+  std::shared_ptr<const VectorGrammarFst> snapshot2 = live_fst.Snapshot();
+  KALDI_ASSERT(live_fst.Version() == 2);
+  KALDI_ASSERT(snapshot0->HasNonterminalFst(kBaz) &&
+               snapshot1->HasNonterminalFst(kBaz) &&
+               !snapshot2->HasNonterminalFst(kBaz));
+  StdVectorFst expanded;
+  VectorGrammarFst grammar_fst0(*snapshot0), grammar_fst1(*snapshot1),
+      grammar_fst2(*snapshot2);
+  CopyToVectorFst(&grammar_fst0, &expanded);
+  KALDI_ASSERT(fst::Equal(expanded, refs[0]));
+  CopyToVectorFst(&grammar_fst1, &expanded);
+  KALDI_ASSERT(fst::Equal(expanded, refs[1]));
+  CopyToVectorFst(&grammar_fst2, &expanded);
+  KALDI_ASSERT(fst::Equal(expanded, refs[1]));
+
+  // Switch kFoo's FST back and forth while other threads expand whatever
+  // version is current.
+  int32 num_threads = 3, num_updates = 20;
+  bool ok[3];
+  std::vector<std::thread> threads;
+  for (int32 t = 0; t < num_threads; t++)
+    threads.push_back(std::thread(ExpandSnapshots, &live_fst, 10, &refs,
+                                  &(ok[t])));
+  for (int32 i = 0; i < num_updates; i++)
+    live_fst.SetNonterminalFst(
+        kFoo, (i % 2 == 0 ? ifsts : foo201_ifsts)[0].second);
+  for (int32 t = 0; t < num_threads; t++) {
+    threads[t].join();
+    KALDI_ASSERT(ok[t]);
+  }
+  KALDI_ASSERT(live_fst.Version() == 2 + num_updates);
+  CopyToVectorFst(&grammar_fst0, &expanded);
+  KALDI_ASSERT(fst::Equal(expanded, refs[0]));
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  UnitTestGrammarFstExpansion();
+  for (int32 i = 0; i < 10; i++)
+    UnitTestGrammarFstThreaded();
+  UnitTestGrammarFstReplace();
+  UnitTestGrammarFstAddRemove();
+  for (int32 i = 0; i < 3; i++)
+    UnitTestLiveGrammarFst();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -37,15 +37,33 @@ template <typename FST>
 void GrammarFstTpl<FST>::Init() {
   KALDI_ASSERT(nonterm_phones_offset_ > 1);
   InitNonterminalMap();
-  entry_arcs_.resize(ifsts_.size());
+  std::shared_ptr<ExpansionTables> old_tables = tables_;
+  tables_ = std::make_shared<ExpansionTables>();
+  tables_->fst_info.resize(ifsts_.size() + 1);
+  if (old_tables != NULL) {
+    std::lock_guard<std::mutex> lock(old_tables->mutex);
+    std::unordered_map<const FST*, std::shared_ptr<FstInfo> > old_info;
+    for (size_t i = 0; i < old_tables->fst_info.size(); i++)
+      if (old_tables->fst_info[i] != NULL)
+        old_info[old_tables->fst_info[i]->fst.get()] = old_tables->fst_info[i];
+    for (size_t i = 0; i < tables_->fst_info.size(); i++) {
+      const FST *fst = (i == 0 ? top_fst_.get() : ifsts_[i - 1].second.get());
+      typename std::unordered_map<const FST*,
+                                  std::shared_ptr<FstInfo> >::iterator iter =
+          old_info.find(fst);
+      if (iter != old_info.end())
+        tables_->fst_info[i] = iter->second;
+    }
+  }
+  std::lock_guard<std::mutex> lock(tables_->mutex);
   if (!ifsts_.empty()) {
     // We call this mostly so that if something is wrong with the input FSTs, the
     // problem will be detected sooner rather than later.
-    // There would be no problem if we were to call InitEntryArcs(i)
+    // There would be no problem if we were to call GetFstInfo(i)
     // for all 0 <= i < ifsts_size(), but we choose to call it
     // lazily on demand, to save startup time if the number of nonterminals
     // is large.
-    InitEntryArcs(0);
+    GetFstInfo(0);
   }
   InitInstances();
 }
@@ -56,28 +74,39 @@ GrammarFstTpl<FST>::~GrammarFstTpl() {
 }
 
 template <typename FST>
-void GrammarFstTpl<FST>::Destroy() {
-  for (size_t i = 0; i < instances_.size(); i++) {
-    FstInstance &instance = instances_[i];
-    typename std::unordered_map<BaseStateId, ExpandedState*>::const_iterator
-        iter = instance.expanded_states.begin(),
-        end = instance.expanded_states.end();
-    for (; iter != end; ++iter) {
-      ExpandedState *e = iter->second;
-      delete e;
+GrammarFstTpl<FST>::ExpansionTables::~ExpansionTables() {
+  std::vector<FstInstance*> *table = instances.load();
+  for (int32 i = 0; i < num_instances; i++) {
+    FstInstance *instance = (*table)[i];
+    for (size_t p = 0; p < instance->expanded_states.size(); p++) {
+      std::atomic<ExpandedState*> *page = instance->expanded_states[p].load();
+      if (page != NULL) {
+        for (int32 k = 0; k < kExpandedStatePageSize; k++)
+          delete page[k].load();
+        delete [] page;
+      }
     }
+    delete instance;
   }
+  delete table;
+  for (size_t i = 0; i < old_instance_tables.size(); i++)
+    delete old_instance_tables[i];
+}
+
+template <typename FST>
+void GrammarFstTpl<FST>::Destroy() {
+  // The expansions are freed when the last copy of this object that shares
+  // them is destroyed.
+  tables_.reset();
   top_fst_ = NULL;
   ifsts_.clear();
   nonterminal_map_.clear();
-  entry_arcs_.clear();
-  instances_.clear();
 }
 
 template <typename FST>
 void GrammarFstTpl<FST>::DecodeSymbol(Label label,
                               int32 *nonterminal_symbol,
-                              int32 *left_context_phone) {
+                              int32 *left_context_phone) const {
   // encoding_multiple will normally equal 1000 (but may be a multiple of 1000
   // if there are a lot of phones); kNontermBigNumber is 10000000.
   int32 big_number = static_cast<int32>(kNontermBigNumber),
@@ -100,48 +129,133 @@ void GrammarFstTpl<FST>::DecodeSymbol(Label label,
 template <typename FST>
 void GrammarFstTpl<FST>::InitNonterminalMap() {
   nonterminal_map_.clear();
+  int32 first_user_defined = GetPhoneSymbolFor(kNontermUserDefined);
   for (size_t i = 0; i < ifsts_.size(); i++) {
     int32 nonterminal = ifsts_[i].first;
-    if (nonterminal_map_.count(nonterminal))
-      KALDI_ERR << "Nonterminal symbol " << nonterminal
-                << " is paired with two FSTs.";
-    if (nonterminal < GetPhoneSymbolFor(kNontermUserDefined))
+    if (nonterminal < first_user_defined)
       KALDI_ERR << "Nonterminal symbol " << nonterminal
                 << " in input pairs, was expected to be >= "
-                << GetPhoneSymbolFor(kNontermUserDefined);
-    nonterminal_map_[nonterminal] = static_cast<int32>(i);
+                << first_user_defined;
+    int32 index = nonterminal - first_user_defined;
+    if (static_cast<size_t>(index) >= nonterminal_map_.size())
+      nonterminal_map_.resize(index + 1, -1);
+    if (nonterminal_map_[index] != -1)
+      KALDI_ERR << "Nonterminal symbol " << nonterminal
+                << " is paired with two FSTs.";
+    nonterminal_map_[index] = static_cast<int32>(i);
   }
 }
 
 template <typename FST>
-bool GrammarFstTpl<FST>::InitEntryArcs(int32 i) {
-  KALDI_ASSERT(static_cast<size_t>(i) < ifsts_.size());
-  FST &fst = *(ifsts_[i].second);
-  if (fst.NumStates() == 0)
-    return false;  /* this was the empty FST. */
-  InitEntryOrReentryArcs(fst, fst.Start(),
-                         GetPhoneSymbolFor(kNontermBegin),
-                         &(entry_arcs_[i]));
-  return true;
+int32 GrammarFstTpl<FST>::GetIfstIndex(int32 nonterminal) const {
+  int32 index = nonterminal - GetPhoneSymbolFor(kNontermUserDefined);
+  if (index < 0 || static_cast<size_t>(index) >= nonterminal_map_.size())
+    return -1;
+  return nonterminal_map_[index];
+}
+
+template <typename FST>
+void GrammarFstTpl<FST>::SetNonterminalFst(int32 nonterminal,
+                                           std::shared_ptr<FST> fst) {
+  KALDI_ASSERT(top_fst_ != NULL && fst != NULL);
+  if (nonterminal < GetPhoneSymbolFor(kNontermUserDefined))
+    KALDI_ERR << "Nonterminal symbol " << nonterminal
+              << " was expected to be >= "
+              << GetPhoneSymbolFor(kNontermUserDefined);
+  int32 ifst_index = GetIfstIndex(nonterminal);
+  if (ifst_index == -1) {
+    ifst_index = ifsts_.size();
+    ifsts_.push_back(std::pair<int32, std::shared_ptr<FST> >(nonterminal, fst));
+  } else {
+    ifsts_[ifst_index].second = fst;
+  }
+  Init();
+  // Check the new FST now, rather than when it's first entered while decoding.
+  std::lock_guard<std::mutex> lock(tables_->mutex);
+  GetFstInfo(ifst_index);
+}
+
+template <typename FST>
+void GrammarFstTpl<FST>::RemoveNonterminalFst(int32 nonterminal) {
+  KALDI_ASSERT(top_fst_ != NULL);
+  int32 ifst_index = GetIfstIndex(nonterminal);
+  if (ifst_index == -1)
+    KALDI_ERR << "There is no FST for nonterminal " << nonterminal;
+  ifsts_.erase(ifsts_.begin() + ifst_index);
+  Init();
+}
+
+template <typename FST>
+const typename GrammarFstTpl<FST>::FstInfo *GrammarFstTpl<FST>::GetFstInfo(
+    int32 ifst_index) const {
+  KALDI_ASSERT(ifst_index >= -1 &&
+               static_cast<size_t>(ifst_index) + 1 < tables_->fst_info.size());
+  std::shared_ptr<FstInfo> &info = tables_->fst_info[ifst_index + 1];
+  if (info != NULL)
+    return info.get();
+  info = std::make_shared<FstInfo>();
+  info->fst = (ifst_index == -1 ? top_fst_ : ifsts_[ifst_index].second);
+  FST &fst = *(info->fst);
+  info->num_entry_arcs = 0;
+  // If the FST is the empty FST, there will be no entry arcs.
+  if (ifst_index != -1 && fst.NumStates() != 0)
+    info->num_entry_arcs = InitEntryOrReentryArcs(
+        fst, fst.Start(), GetPhoneSymbolFor(kNontermBegin),
+        &(info->entry_arcs));
+  return info.get();
+}
+
+template <typename FST>
+int32 GrammarFstTpl<FST>::AddInstance(FstInstance *instance) const {
+  ExpansionTables &tables = *tables_;
+  std::vector<FstInstance*> *table =
+      tables.instances.load(std::memory_order_relaxed);
+  int32 instance_id = tables.num_instances;
+  if (table == NULL || static_cast<size_t>(instance_id) == table->size()) {
+    // Replace the table with one twice the size.  Readers may still be using
+    // the old one, so we keep it.
+    std::vector<FstInstance*> *new_table = new std::vector<FstInstance*>(
+        std::max<size_t>(16, 2 * instance_id), NULL);
+    if (table != NULL) {
+      std::copy(table->begin(), table->end(), new_table->begin());
+      tables.old_instance_tables.push_back(table);
+    }
+    tables.instances.store(new_table, std::memory_order_release);
+    table = new_table;
+  }
+  // Readers only learn this instance-id from an ExpandedState that is
+  // published (with release semantics) after this point, so they will see
+  // this write.
+  (*table)[instance_id] = instance;
+  tables.num_instances = instance_id + 1;
+  return instance_id;
 }
 
 template <typename FST>
 void GrammarFstTpl<FST>::InitInstances() {
-  KALDI_ASSERT(instances_.empty());
-  instances_.resize(1);
-  instances_[0].ifst_index = -1;
-  instances_[0].fst = top_fst_.get();
-  instances_[0].parent_instance = -1;
-  instances_[0].parent_state = -1;
+  KALDI_ASSERT(tables_->num_instances == 0);
+  const FstInfo *info = GetFstInfo(-1);
+  FstInstance *instance = new FstInstance(top_fst_->NumStates());
+  instance->fst = top_fst_.get();
+  instance->info = info;
+  instance->ifst_index = -1;
+  instance->parent_instance = -1;
+  instance->parent_state = -1;
+  instance->num_parent_reentry_arcs = 0;
+  AddInstance(instance);
 }
 
 template <typename FST>
-void GrammarFstTpl<FST>::InitEntryOrReentryArcs(
+int32 GrammarFstTpl<FST>::InitEntryOrReentryArcs(
     FST &fst,
     int32 entry_state,
     int32 expected_nonterminal_symbol,
-    std::unordered_map<int32, int32> *phone_to_arc) {
+    std::vector<int32> *phone_to_arc) const {
   phone_to_arc->clear();
+  // Left-context phones are in the range [1, nonterm_phones_offset_ +
+  // kNontermBos]; see DecodeSymbol().
+  phone_to_arc->resize(nonterm_phones_offset_ +
+                       static_cast<int32>(kNontermBos) + 1, -1);
   ArcIterator<FST > aiter(fst, entry_state);
   int32 arc_index = 0;
   for (; !aiter.Done(); aiter.Next(), ++arc_index) {
@@ -163,22 +277,47 @@ void GrammarFstTpl<FST>::InitEntryOrReentryArcs(
                 << expected_nonterminal_symbol << ", but got "
                 << nonterminal;
     }
-    std::pair<int32, int32> p(left_context_phone, arc_index);
-    if (!phone_to_arc->insert(p).second) {
-      // If it was not successfully inserted in the phone_to_arc map, it means
-      // there were two arcs with the same left-context phone, which does not
-      // make sense; that's an error, likely a code error (or an error when the
-      // input FSTs were generated).
+    if ((*phone_to_arc)[left_context_phone] != -1) {
+      // If it was already set, it means there were two arcs with the same
+      // left-context phone, which does not make sense; that's an error,
+      // likely a code error (or an error when the input FSTs were generated).
       KALDI_ERR << "Two arcs had the same left-context phone.";
     }
+    (*phone_to_arc)[left_context_phone] = arc_index;
   }
+  return arc_index;
+}
+
+template <typename FST>
+typename GrammarFstTpl<FST>::ExpandedState *GrammarFstTpl<FST>::ExpandStateShared(
+    int32 instance_id, BaseStateId state_id) const {
+  std::lock_guard<std::mutex> lock(tables_->mutex);
+  std::atomic<std::atomic<ExpandedState*>*> &page_ptr =
+      MutableInstance(instance_id).expanded_states[
+          state_id / kExpandedStatePageSize];
+  std::atomic<ExpandedState*> *page = page_ptr.load(std::memory_order_relaxed);
+  if (page == NULL) {
+    page = new std::atomic<ExpandedState*>[kExpandedStatePageSize];
+    for (int32 k = 0; k < kExpandedStatePageSize; k++)
+      page[k].store(NULL, std::memory_order_relaxed);
+    page_ptr.store(page, std::memory_order_release);
+  }
+  std::atomic<ExpandedState*> &expanded_state =
+      page[state_id % kExpandedStatePageSize];
+  // Another thread may have expanded it while we were waiting for the lock.
+  ExpandedState *ans = expanded_state.load(std::memory_order_relaxed);
+  if (ans == NULL) {
+    ans = ExpandState(instance_id, state_id);
+    expanded_state.store(ans, std::memory_order_release);
+  }
+  return ans;
 }
 
 template <typename FST>
 typename GrammarFstTpl<FST>::ExpandedState *GrammarFstTpl<FST>::ExpandState(
-    int32 instance_id, BaseStateId state_id) {
+    int32 instance_id, BaseStateId state_id) const {
   int32 big_number = kNontermBigNumber;
-  FST &fst = *(instances_[instance_id].fst);
+  FST &fst = *(Instance(instance_id).fst);
   ArcIterator<FST> aiter(fst, state_id);
   KALDI_ASSERT(!aiter.Done() && aiter.Value().ilabel > big_number &&
                "Something is not right; did you call PrepareForGrammarFst()?");
@@ -227,13 +366,13 @@ void GrammarFstTpl<FST>::CombineArcs(const StdArc &leaving_arc,
 
 template <typename FST>
 typename GrammarFstTpl<FST>::ExpandedState *GrammarFstTpl<FST>::ExpandStateEnd(
-    int32 instance_id, BaseStateId state_id) {
+    int32 instance_id, BaseStateId state_id) const {
   if (instance_id == 0)
     KALDI_ERR << "Did not expect #nonterm_end symbol in FST-instance 0.";
-  const FstInstance &instance = instances_[instance_id];
+  const FstInstance &instance = Instance(instance_id);
   int32 parent_instance_id = instance.parent_instance;
   FST &fst = *(instance.fst);
-  const FstInstance &parent_instance = instances_[parent_instance_id];
+  const FstInstance &parent_instance = Instance(parent_instance_id);
   FST &parent_fst = *(parent_instance.fst);
 
   ExpandedState *ans = new ExpandedState;
@@ -246,7 +385,7 @@ typename GrammarFstTpl<FST>::ExpandedState *GrammarFstTpl<FST>::ExpandStateEnd(
                                               instance.parent_state);
 
   // for explanation of cost_correction, see documentation for CombineArcs().
-  float num_reentry_arcs = instances_[instance_id].parent_reentry_arcs.size(),
+  float num_reentry_arcs = instance.num_parent_reentry_arcs,
       cost_correction = -log(num_reentry_arcs);
 
   ArcIterator<FST > aiter(fst, state_id);
@@ -259,17 +398,17 @@ typename GrammarFstTpl<FST>::ExpandedState *GrammarFstTpl<FST>::ExpandStateEnd(
     KALDI_ASSERT(this_nonterminal == GetPhoneSymbolFor(kNontermEnd) &&
                  ">1 nonterminals from a state; did you use "
                  "PrepareForGrammarFst()?");
-    std::unordered_map<int32, int32>::const_iterator reentry_iter =
-        instances_[instance_id].parent_reentry_arcs.find(left_context_phone),
-        reentry_end = instances_[instance_id].parent_reentry_arcs.end();
-    if (reentry_iter == reentry_end) {
+    int32 parent_arc_index =
+        (static_cast<size_t>(left_context_phone) <
+         instance.parent_reentry_arcs.size() ?
+         instance.parent_reentry_arcs[left_context_phone] : -1);
+    if (parent_arc_index == -1) {
       KALDI_ERR << "FST with index " << instance.ifst_index
                 << " ends with left-context-phone " << left_context_phone
                 << " but parent FST does not support that left-context "
           "at the return point.";
     }
-    size_t parent_arc_index = static_cast<size_t>(reentry_iter->second);
-    parent_aiter.Seek(parent_arc_index);
+    parent_aiter.Seek(static_cast<size_t>(parent_arc_index));
     const StdArc &arriving_arc = parent_aiter.Value();
     // 'arc' will combine the information on 'leaving_arc' and 'arriving_arc',
     // except that the ilabel will be set to zero.
@@ -289,16 +428,16 @@ typename GrammarFstTpl<FST>::ExpandedState *GrammarFstTpl<FST>::ExpandStateEnd(
 
 template <typename FST>
 int32 GrammarFstTpl<FST>::GetChildInstanceId(int32 instance_id, int32 nonterminal,
-                                     int32 state) {
+                                     int32 state) const {
   int64 encoded_pair = (static_cast<int64>(nonterminal) << 32) + state;
   // 'new_instance_id' is the instance-id we'd assign if we had to create a new one.
   // We try to add it at once, to avoid having to do an extra map lookup in case
   // it wasn't there and we did need to add it.
-  int32 child_instance_id = instances_.size();
+  int32 child_instance_id = tables_->num_instances;
   {
     std::pair<int64, int32> p(encoded_pair, child_instance_id);
     std::pair<std::unordered_map<int64, int32>::const_iterator, bool> ans =
-        instances_[instance_id].child_instances.insert(p);
+        MutableInstance(instance_id).child_instances.insert(p);
     if (!ans.second) {
       // The pair was not inserted, which means the key 'encoded_pair' did exist in the
       // map.  Return the value in the map.
@@ -309,32 +448,33 @@ int32 GrammarFstTpl<FST>::GetChildInstanceId(int32 instance_id, int32 nontermina
   // If we reached this point, we did successfully insert 'child_instance_id' into
   // the map, because the key didn't exist.  That means we have to actually create
   // the instance.
-  instances_.resize(child_instance_id + 1);
-  const FstInstance &parent_instance = instances_[instance_id];
-  FstInstance &child_instance = instances_[child_instance_id];
+  const FstInstance &parent_instance = Instance(instance_id);
 
   // Work out the ifst_index for this nonterminal.
-  std::unordered_map<int32, int32>::const_iterator iter =
-      nonterminal_map_.find(nonterminal);
-  if (iter == nonterminal_map_.end()) {
+  int32 ifst_index = GetIfstIndex(nonterminal);
+  if (ifst_index == -1) {
     KALDI_ERR << "Nonterminal " << nonterminal << " was requested, but "
         "there is no FST for it.";
   }
-  int32 ifst_index = iter->second;
-  child_instance.ifst_index = ifst_index;
-  child_instance.fst = ifsts_[ifst_index].second.get();
-  child_instance.parent_instance = instance_id;
-  child_instance.parent_state = state;
-  InitEntryOrReentryArcs(*(parent_instance.fst), state,
-                         GetPhoneSymbolFor(kNontermReenter),
-                         &(child_instance.parent_reentry_arcs));
+  const FstInfo *info = GetFstInfo(ifst_index);
+  FstInstance *child_instance = new FstInstance(info->fst->NumStates());
+  child_instance->ifst_index = ifst_index;
+  child_instance->fst = ifsts_[ifst_index].second.get();
+  child_instance->info = info;
+  child_instance->parent_instance = instance_id;
+  child_instance->parent_state = state;
+  child_instance->num_parent_reentry_arcs = InitEntryOrReentryArcs(
+      *(parent_instance.fst), state, GetPhoneSymbolFor(kNontermReenter),
+      &(child_instance->parent_reentry_arcs));
+  int32 added_instance_id = AddInstance(child_instance);
+  KALDI_ASSERT(added_instance_id == child_instance_id);
   return child_instance_id;
 }
 
 template <typename FST>
 typename GrammarFstTpl<FST>::ExpandedState *GrammarFstTpl<FST>::ExpandStateUserDefined(
-    int32 instance_id, BaseStateId state_id) {
-  FST &fst = *(instances_[instance_id].fst);
+    int32 instance_id, BaseStateId state_id) const {
+  FST &fst = *(Instance(instance_id).fst);
   ArcIterator<FST > aiter(fst, state_id);
 
   ExpandedState *ans = new ExpandedState;
@@ -355,30 +495,28 @@ typename GrammarFstTpl<FST>::ExpandedState *GrammarFstTpl<FST>::ExpandStateUserD
       KALDI_ERR << "Same state leaves to different FST instances "
           "(Did you use PrepareForGrammarFst()?)";
     }
-    const FstInstance &child_instance = instances_[child_instance_id];
+    const FstInstance &child_instance = Instance(child_instance_id);
     FST &child_fst = *(child_instance.fst);
-    int32 child_ifst_index = child_instance.ifst_index;
-    std::unordered_map<int32, int32> &entry_arcs = entry_arcs_[child_ifst_index];
-    if (entry_arcs.empty()) {
-      if (!InitEntryArcs(child_ifst_index)) {
-        // This child-FST was the empty FST.  There are no arcs to expand.
-        continue;
-      }
+    const FstInfo &child_info = *(child_instance.info);
+    if (child_info.num_entry_arcs == 0) {
+      // This child-FST was the empty FST.  There are no arcs to expand.
+      continue;
     }
     // for explanation of cost_correction, see documentation for CombineArcs().
-    float num_entry_arcs = entry_arcs.size(),
+    float num_entry_arcs = child_info.num_entry_arcs,
         cost_correction = -log(num_entry_arcs);
 
     // Get the arc-index for the arc leaving the start-state of child FST that
     // corresponds to this phonetic context.
-    std::unordered_map<int32, int32>::const_iterator entry_iter =
-        entry_arcs.find(left_context_phone);
-    if (entry_iter == entry_arcs.end()) {
+    int32 arc_index =
+        (static_cast<size_t>(left_context_phone) <
+         child_info.entry_arcs.size() ?
+         child_info.entry_arcs[left_context_phone] : -1);
+    if (arc_index == -1) {
       KALDI_ERR << "FST for nonterminal " << nonterminal
                 << " does not have an entry point for left-context-phone "
                 << left_context_phone;
     }
-    int32 arc_index = entry_iter->second;
     ArcIterator<FST > child_aiter(child_fst, child_fst.Start());
     child_aiter.Seek(arc_index);
     const StdArc &arriving_arc = child_aiter.Value();
@@ -997,6 +1135,49 @@ void PrepareForGrammarFst(int32 nonterm_phones_offset,
   p.Prepare();
 }
 
+template <typename FST>
+LiveGrammarFstTpl<FST>::LiveGrammarFstTpl(
+    const GrammarFstTpl<FST> &grammar_fst):
+    current_(std::make_shared<const GrammarFstTpl<FST> >(grammar_fst)),
+    version_(0) { }
+
+template <typename FST>
+std::shared_ptr<const GrammarFstTpl<FST> >
+LiveGrammarFstTpl<FST>::Snapshot() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return current_;
+}
+
+template <typename FST>
+int64 LiveGrammarFstTpl<FST>::Version() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return version_;
+}
+
+template <typename FST>
+void LiveGrammarFstTpl<FST>::SetNonterminalFst(int32 nonterminal,
+                                               std::shared_ptr<FST> fst) {
+  std::lock_guard<std::mutex> update_lock(update_mutex_);
+  // No other thread can change current_ while we hold update_mutex_.
+  std::shared_ptr<GrammarFstTpl<FST> > new_version =
+      std::make_shared<GrammarFstTpl<FST> >(*Snapshot());
+  new_version->SetNonterminalFst(nonterminal, fst);
+  std::lock_guard<std::mutex> lock(mutex_);
+  current_ = new_version;
+  version_++;
+}
+
+template <typename FST>
+void LiveGrammarFstTpl<FST>::RemoveNonterminalFst(int32 nonterminal) {
+  std::lock_guard<std::mutex> update_lock(update_mutex_);
+  std::shared_ptr<GrammarFstTpl<FST> > new_version =
+      std::make_shared<GrammarFstTpl<FST> >(*Snapshot());
+  new_version->RemoveNonterminalFst(nonterminal);
+  std::lock_guard<std::mutex> lock(mutex_);
+  current_ = new_version;
+  version_++;
+}
+
 template <typename FST>
 void CopyToVectorFst(GrammarFstTpl<FST> *grammar_fst,
                      VectorFst<StdArc> *vector_fst) {
@@ -1053,6 +1234,9 @@ template class GrammarFstTpl<StdVectorFst>;
 template class ArcIterator<GrammarFstTpl<const ConstFst<StdArc> > >;
 template class ArcIterator<GrammarFstTpl<StdVectorFst> >;
 
+template class LiveGrammarFstTpl<const ConstFst<StdArc> >;
+template class LiveGrammarFstTpl<StdVectorFst>;
+
 // Instantiate the function template for CopyToVectorFST
 template void CopyToVectorFst<const ConstFst<StdArc> >(GrammarFstTpl<const ConstFst<StdArc> > *grammar_fst,
                                                        VectorFst<StdArc> *vector_fst);
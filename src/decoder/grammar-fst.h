@@ -32,6 +32,9 @@
 
 
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include "fst/fstlib.h"
 #include "fstext/grammar-context-fst.h"
 
@@ -92,10 +95,14 @@ template <typename instance_FST> class ArcIterator<GrammarFstTpl<instance_FST> >
    points whenever we invoke a nonterminal.  For more information
    see \ref grammar (i.e. ../doc/grammar.dox).
 
-   THREAD SAFETY: you can't use this object from multiple threads; you should
-   create lightweight copies of this object using the copy constructor,
-   e.g. `new GrammarFst(this_grammar_fst)`, if you want to decode from multiple
-   threads using the same GrammarFst.
+   THREAD SAFETY: this object may be used from multiple threads, e.g. by
+   several decoders at once.  States are expanded lazily, the first time any
+   decoder visits them, and the expansions are shared: a mutex is held while
+   expanding a state or creating an FST instance, but the lookups done in
+   ArcIterator for states that have already been expanded are lock-free array
+   accesses.  Copies of this object made with the copy constructor share the
+   expansions too (and the FSTs), so copying is cheap; there is no longer any
+   need to make a copy per thread, but it does no harm.
 */
 template <typename FST>
 class GrammarFstTpl {
@@ -104,7 +111,7 @@ class GrammarFstTpl {
   typedef TropicalWeight Weight;
 
   // StateId is actually int64.  The high-order 32 bits are interpreted as an
-  // instance_id, i.e. and index into the instances_ vector; the low-order 32
+  // instance_id, i.e. and index into the table of FST instances; the low-order 32
   // bits are the state index in the FST instance.
   typedef Arc::StateId StateId;
 
@@ -115,9 +122,11 @@ class GrammarFstTpl {
 
 
   /**
-     Constructor.  This constructor is very lightweight; the only immediate work
-     it does is to iterate over the arcs in the start states of the provided
-     FSTs in order to set up the appropriate entry points.
+     Constructor.  This constructor is fairly lightweight; the only immediate
+     work it does is to iterate over the arcs in the start state of the first
+     of 'ifsts' as a sanity check.  Finding the states of an FST that need
+     expansion is done lazily, when each state is first expanded, and the
+     entry arcs of the other FSTs are examined the first time each is entered.
 
      For simplicity (to avoid templates), we limit the input FSTs to be of type
      ConstFst<StdArc>; this limitation could be removed later if needed.  You
@@ -150,9 +159,8 @@ class GrammarFstTpl {
       std::shared_ptr<FST> top_fst,
       const std::vector<std::pair<int32, std::shared_ptr<FST> > > &ifsts);
 
-  /// Copy constructor.  Useful because this object is not thread safe so cannot
-  /// be used by multiple parallel decoder threads, but it is lightweight and
-  /// can copy it without causing the stored FSTs to be copied.
+  /// Copy constructor.  This is lightweight: the copy shares the stored FSTs
+  /// and the table of expanded states with 'other'.
   GrammarFstTpl(const GrammarFstTpl<FST> &other) = default;
 
   ///  This constructor should only be used prior to calling Read().
@@ -167,6 +175,35 @@ class GrammarFstTpl {
   // Reads the format that Write() outputs.  Will crash if binary == false.
   void Read(std::istream &os, bool binary);
 
+  /**
+     Adds an FST for the user-defined nonterminal 'nonterminal' (e.g. the
+     index of #nonterm:contact_list in phones.txt), or replaces the existing
+     one.  'fst' must have been prepared with PrepareForGrammarFst(), as for
+     the constructor.
+
+     This is copy-on-write: it does not affect copies of this object made
+     before the call (e.g. ones that decoders are currently using), which keep
+     the previous set of FSTs and their expanded states.  This object starts
+     again with no expanded states, but the per-FST information for the FSTs
+     that have not changed is kept, so the cost is roughly proportional to
+     the size of the new FST.  This object must not be in use by any decoder
+     while this is called; see LiveGrammarFstTpl for a thread-safe way to
+     change the FSTs while decoding is going on.
+  */
+  void SetNonterminalFst(int32 nonterminal, std::shared_ptr<FST> fst);
+
+  /// Removes the FST for the user-defined nonterminal 'nonterminal', which
+  /// must exist.  Copy-on-write in the same way as SetNonterminalFst().  If a
+  /// state that invokes this nonterminal is reached while decoding, it is an
+  /// error.
+  void RemoveNonterminalFst(int32 nonterminal);
+
+  /// Returns true if there is an FST for the user-defined nonterminal
+  /// 'nonterminal'.
+  bool HasNonterminalFst(int32 nonterminal) const {
+    return GetIfstIndex(nonterminal) != -1;
+  }
+
   StateId Start() const {
     // the top 32 bits of the 64-bit state-id will be zero, because the
     // top FST instance has instance-id = 0.
@@ -196,10 +233,10 @@ class GrammarFstTpl {
     // Compare with the constructor of ArcIterator.
     int32 instance_id = s >> 32;
     BaseStateId base_state = static_cast<int32>(s);
-    const GrammarFstTpl::FstInstance &instance = instances_[instance_id];
-    FST *base_fst = instance.fst;
-    if (base_fst->Final(base_state).Value() != KALDI_GRAMMAR_FST_SPECIAL_WEIGHT) {
-      return base_fst->NumInputEpsilons(base_state);
+    const GrammarFstTpl::FstInstance &instance = Instance(instance_id);
+    if (instance.fst->Final(base_state).Value() !=
+        KALDI_GRAMMAR_FST_SPECIAL_WEIGHT) {
+      return instance.fst->NumInputEpsilons(base_state);
     } else {
       return 1;
     }
@@ -234,24 +271,56 @@ class GrammarFstTpl {
     std::vector<StdArc> arcs;
   };
 
+  /**
+     Information about one of the FSTs (top_fst_ or one of ifsts_) that is
+     shared by all the FstInstances of that FST.  It is worked out the first
+     time an instance of the FST is created.  It depends only on the FST, so
+     it is carried over when the set of FSTs is changed by SetNonterminalFst()
+     or RemoveNonterminalFst().
+  */
+  struct FstInfo {
+    // The FST this is about.  We hold a reference so that the address can't
+    // be reused by another FST while this object exists.
+    std::shared_ptr<FST> fst;
+
+    // Only for the FSTs in ifsts_, and only if the FST is nonempty: a map
+    // from left-context phone (i.e. either a phone-index or #nonterm_bos) to
+    // the corresponding arc-index leaving the start state of the FST, or -1
+    // if there is no such arc.  num_entry_arcs is the number of elements
+    // that are not -1.
+    std::vector<int32> entry_arcs;
+    int32 num_entry_arcs;
+  };
+
+  // The number of states in a page of FstInstance::expanded_states.
+  static const int32 kExpandedStatePageSize = 256;
+
   // An FstInstance is a copy of an FST.  The instance numbered zero is for
   // top_fst_, and (to state it approximately) whenever any FST instance invokes
   // another FST a new instance will be generated on demand.
   struct FstInstance {
-    // ifst_index is the index into the ifsts_ vector that corresponds to this
-    // FST instance, or -1 if this is the top-level instance.
-    int32 ifst_index;
+    // The members that the ArcIterator uses come first.
 
     // Pointer to the FST corresponding to this instance: it will equal top_fst_
     // if ifst_index == -1, or ifsts_[ifst_index].second otherwise.
     FST *fst;
 
-    // 'expanded_states', which will be populated on demand as states in this
-    // FST instance are accessed, will only contain entries for states in this
-    // FST that the final-prob's value equal to
-    // KALDI_GRAMMAR_FST_SPECIAL_WEIGHT.  (That final-prob value is used as a
-    // kind of signal to this code that the state needs expansion).
-    std::unordered_map<BaseStateId, ExpandedState*> expanded_states;
+    // Information about 'fst' that is shared between its instances.
+    const FstInfo *info;
+
+    // The ExpandedStates of this instance, indexed by state in pages of
+    // kExpandedStatePageSize states: the one for state s is element
+    // s % kExpandedStatePageSize of page s / kExpandedStatePageSize.  Pages
+    // are allocated when one of their states is first expanded, so the
+    // memory used is in proportion to the number of states expanded rather
+    // than to the size of the FST (which for top_fst_ may be very large).
+    // Pages and their elements are NULL until set; each is set once, with the
+    // mutex held, and read without locking.
+    std::vector<std::atomic<std::atomic<ExpandedState*>*> > expanded_states;
+
+    // ifst_index is the index into the ifsts_ vector that corresponds to this
+    // FST instance, or -1 if this is the top-level instance.
+    int32 ifst_index;
 
     // 'child_instances', which is populated on demand as states in this FST
     // instance are accessed, is logically a map from pair (nonterminal_index,
@@ -269,6 +338,7 @@ class GrammarFstTpl {
     // nonterminal_index, making the 'nonterminal_index' in the key *usually*
     // redundant, but in principle it could happen that two user-defined
     // nonterminals might share the same return-state.
+    // Only accessed with the mutex held.
     std::unordered_map<int64, int32> child_instances;
 
     // The instance-id of the FST we return to when we are done with this one
@@ -282,21 +352,52 @@ class GrammarFstTpl {
     int32 parent_state;
 
     // 'parent_reentry_arcs' is a map from left-context-phone (i.e. either a
-    // phone index or #nonterm_bos), to an arc-index, which we could use to
-    // Seek() in an arc-iterator for state parent_state in the FST-instance
-    // 'parent_instance'.  It's set up when we create this FST instance.  (The
-    // arcs used to enter this instance are not located here, they can be
-    // located in entry_arcs_[instance_id]).  We make use of reentry_arcs when
-    // we expand states in this FST that have #nonterm_end on their arcs,
-    // leading to final-states, which signal a return to the parent
-    // FST-instance.
-    std::unordered_map<int32, int32> parent_reentry_arcs;
+    // phone index or #nonterm_bos), to an arc-index (or -1 if there is none),
+    // which we could use to Seek() in an arc-iterator for state parent_state
+    // in the FST-instance 'parent_instance'.  It's set up when we create this
+    // FST instance.  (The arcs used to enter this instance are located in
+    // info->entry_arcs).  We make use of reentry_arcs when we expand states
+    // in this FST that have #nonterm_end on their arcs, leading to
+    // final-states, which signal a return to the parent FST-instance.
+    // num_parent_reentry_arcs is the number of elements that are not -1.
+    std::vector<int32> parent_reentry_arcs;
+    int32 num_parent_reentry_arcs;
+
+    explicit FstInstance(BaseStateId num_states):
+        expanded_states((num_states + kExpandedStatePageSize - 1) /
+                        kExpandedStatePageSize) {
+      for (size_t p = 0; p < expanded_states.size(); p++)
+        expanded_states[p].store(NULL, std::memory_order_relaxed);
+    }
   };
 
-  // The FST instances.  Initially it is a vector with just one element
-  // representing top_fst_, and it will be populated with more elements on
-  // demand.  An instance_id refers to an index into this vector.
-  std::vector<FstInstance> instances_;
+ private:
+  /**
+     ExpansionTables contains everything that is built up lazily as decoders
+     visit states of the GrammarFst: the FST instances, their expanded states,
+     and the FstInfo for each FST.  It is shared between copies of a
+     GrammarFst.  Everything is added with 'mutex' held and never changed or
+     freed afterwards (until destruction), so readers that reached an instance
+     or ExpandedState via an atomic load need no lock.
+  */
+  struct ExpansionTables {
+    std::mutex mutex;
+
+    // The FST instances, indexed by instance-id; only the first
+    // num_instances elements are set.  When it is full it is replaced by a
+    // larger copy, but the old one may still be in use by readers, so it's
+    // kept in old_instance_tables until destruction.
+    std::atomic<std::vector<FstInstance*>*> instances;
+    std::vector<std::vector<FstInstance*>*> old_instance_tables;
+    int32 num_instances;
+
+    // fst_info[0] is for top_fst_ and fst_info[i + 1] for ifsts_[i]; each
+    // is NULL until it is needed.
+    std::vector<std::shared_ptr<FstInfo> > fst_info;
+
+    ExpansionTables(): instances(NULL), num_instances(0) { }
+    ~ExpansionTables();
+  };
 
   // The top-level FST passed in by the user; contains the start state and
   // final-states, and may invoke FSTs in 'ifsts_' (which can also invoke
@@ -311,48 +412,57 @@ class GrammarFstTpl {
   // 'fst' is the corresponding FST.
   std::vector<std::pair<int32, std::shared_ptr<FST > > > ifsts_;
 
-  // Maps from the user-defined nonterminals like #nonterm:foo as numbered
-  // in phones.txt, to the corresponding index into 'ifsts_', i.e. the ifst_index.
-  std::unordered_map<int32, int32> nonterminal_map_;
-
-  // entry_arcs_ will have the same dimension as ifsts_.  Each entry_arcs_[i]
-  // is a map from left-context phone (i.e. either a phone-index or
-  // #nonterm_bos) to the corresponding arc-index leaving the start-state in
-  // the FST 'ifsts_[i].second'.
-  // We populate this only on demand as each one is needed (except for the
-  // first one, which we populate immediately as a kind of sanity check).
-  // Doing it on-demand prevents this object's initialization from being
-  // nontrivial in the case where there are a lot of nonterminals.
-  std::vector<std::unordered_map<int32, int32> > entry_arcs_;
-
- private:
+  // Maps from the user-defined nonterminals like #nonterm:foo as numbered in
+  // phones.txt, minus the index of the first user-defined nonterminal, to the
+  // corresponding index into 'ifsts_', i.e. the ifst_index; -1 for
+  // nonterminals that have no FST.
+  std::vector<int32> nonterminal_map_;
 
+  // The lazily expanded part of this object, shared with copies of it.
+  std::shared_ptr<ExpansionTables> tables_;
 
   friend class ArcIterator<GrammarFstTpl<FST> >;
 
   // sets up nonterminal_map_.
   void InitNonterminalMap();
 
-  // sets up entry_arcs_[i].  We do this only on demand, as each one is
-  // accessed, so that if there are a lot of nonterminals, this object doesn't
-  // too much work when it is initialized.  Each call to this function only
-  // takes time O(number of left-context phones), which is quite small, but we'd
-  // like to avoid that if possible.
-  //
-  // This function returns true if it successfully initialized the
-  // entry_arcs_[i]; and false if it left it empty because
-  bool InitEntryArcs(int32 i);
-
-  // sets up instances_ with the top-level instance.
+  // Returns the index into ifsts_ of the FST for this nonterminal, or -1 if
+  // there is none.
+  int32 GetIfstIndex(int32 nonterminal) const;
+
+  // sets up tables_, with the top-level instance.
   void InitInstances();
 
   // Does the initialization tasks after nonterm_phones_offset_,
-  // top_fsts_ and ifsts_ have been set up
+  // top_fsts_ and ifsts_ have been set up.  If tables_ was already set
+  // (because ifsts_ has been changed), the FstInfo for FSTs that are still
+  // in use is carried over to the new tables.
   void Init();
 
   // clears everything.
   void Destroy();
 
+  // Returns the FstInstance with this instance-id; it must exist.  May be
+  // called without holding the mutex.
+  inline const FstInstance &Instance(int32 instance_id) const {
+    return *((*(tables_->instances.load(std::memory_order_acquire)))[
+        instance_id]);
+  }
+
+  // The non-const version of Instance(); only call with the mutex held.
+  inline FstInstance &MutableInstance(int32 instance_id) const {
+    return *((*(tables_->instances.load(std::memory_order_relaxed)))[
+        instance_id]);
+  }
+
+  // Adds 'instance' to the table of instances and returns its instance-id.
+  // Only call with the mutex held.
+  int32 AddInstance(FstInstance *instance) const;
+
+  // Returns the FstInfo for the FST with this ifst_index (-1 for top_fst_),
+  // creating it if needed.  Only call with the mutex held.
+  const FstInfo *GetFstInfo(int32 ifst_index) const;
+
   /*
     This utility function sets up a map from "left-context phone", meaning
     either a phone index or the index of the symbol #nonterm_bos, to
@@ -374,16 +484,20 @@ class GrammarFstTpl {
                  to #nonterm_begin or #nonterm_reenter.
       @param [out] phone_to_arc  We output the map from left_context_phone
                  to the arc-index (i.e. the index we'd have to Seek() to
-                 in an arc-iterator set up for the state 'entry_state).
+                 in an arc-iterator set up for the state 'entry_state), as a
+                 vector indexed by left_context_phone with -1 for phones
+                 that have no arc.
+      @return    Returns the number of arcs, i.e. of elements of
+                 'phone_to_arc' that are not -1.
    */
-  void InitEntryOrReentryArcs(
+  int32 InitEntryOrReentryArcs(
       FST &fst,
       int32 entry_state,
       int32 nonterminal_symbol,
-      std::unordered_map<int32, int32> *phone_to_arc);
+      std::vector<int32> *phone_to_arc) const;
 
 
-  inline int32 GetPhoneSymbolFor(enum NonterminalValues n) {
+  inline int32 GetPhoneSymbolFor(enum NonterminalValues n) const {
     return nonterm_phones_offset_ + static_cast<int32>(n);
   }
   /**
@@ -401,32 +515,34 @@ class GrammarFstTpl {
    */
   void DecodeSymbol(Label label,
                     int32 *nonterminal_symbol,
-                    int32 *left_context_phone);
+                    int32 *left_context_phone) const;
 
 
   // This function creates and returns an ExpandedState corresponding to a
   // particular state-id in the FstInstance for this instance_id.  It is called
-  // when we have determined that an ExpandedState needs to be created and that
-  // it is not currently present.  It creates and returns it; the calling code
-  // needs to add it to the expanded_states map for its FST instance.
-  ExpandedState *ExpandState(int32 instance_id, BaseStateId state_id);
+  // (with the mutex held) when we have determined that an ExpandedState needs
+  // to be created and that it is not currently present.  It creates and
+  // returns it; the calling code needs to add it to the expanded_states of
+  // its FST instance.
+  ExpandedState *ExpandState(int32 instance_id, BaseStateId state_id) const;
 
   // Called from ExpandState() when the nonterminal type on the arcs is
   // #nonterm_end, this implements ExpandState() for that case.
-  ExpandedState *ExpandStateEnd(int32 instance_id, BaseStateId state_id);
+  ExpandedState *ExpandStateEnd(int32 instance_id, BaseStateId state_id) const;
 
   // Called from ExpandState() when the nonterminal type on the arcs is a
   // user-defined nonterminal, this implements ExpandState() for that case.
-  ExpandedState *ExpandStateUserDefined(int32 instance_id, BaseStateId state_id);
+  ExpandedState *ExpandStateUserDefined(int32 instance_id,
+                                        BaseStateId state_id) const;
 
   // Called from ExpandStateUserDefined(), this function attempts to look up the
   // pair (nonterminal, state) in the map
-  // instances_[instance_id].child_instances.  If it exists (because this
+  // Instance(instance_id).child_instances.  If it exists (because this
   // return-state has been expanded before), it returns the value it found;
   // otherwise it creates the child-instance and returns its newly created
   // instance-id.
-  inline int32 GetChildInstanceId(int32 instance_id, int32 nonterminal,
-                                  int32 state);
+  int32 GetChildInstanceId(int32 instance_id, int32 nonterminal,
+                           int32 state) const;
 
   /**
     Called while expanding states, this function combines information from two
@@ -464,28 +580,31 @@ class GrammarFstTpl {
                                  float cost_correction,
                                  StdArc *arc);
 
-  /** Called from the ArcIterator constructor when we encounter an FST state with
-      nonzero final-prob, this function first looks up this state_id in
-      'expanded_states' member of the corresponding FstInstance, and returns it
-      if already present; otherwise it populates the 'expanded_states' map with
-      something for this state_id and returns the value.
+  // Called from GetExpandedState() when the state has not been expanded yet:
+  // takes the mutex, and expands the state unless another thread got there
+  // first.
+  ExpandedState *ExpandStateShared(int32 instance_id,
+                                   BaseStateId state_id) const;
+
+  /** Called from the ArcIterator constructor when we encounter an FST state
+      that needs expansion (its final-prob's value is
+      KALDI_GRAMMAR_FST_SPECIAL_WEIGHT), this function returns the
+      corresponding element of instance.expanded_states, first expanding the
+      state if necessary.
   */
-  inline ExpandedState *GetExpandedState(int32 instance_id,
-                                         BaseStateId state_id) {
-    std::unordered_map<BaseStateId, ExpandedState*> &expanded_states =
-        instances_[instance_id].expanded_states;
-
-    typename std::unordered_map<BaseStateId, ExpandedState*>::iterator iter =
-        expanded_states.find(state_id);
-    if (iter != expanded_states.end()) {
-      return iter->second;
-    } else {
-      ExpandedState *ans = ExpandState(instance_id, state_id);
-      // Don't use the reference 'expanded_states'; it could have been
-      // invalidated.
-      instances_[instance_id].expanded_states[state_id] = ans;
-      return ans;
+  inline ExpandedState *GetExpandedState(const FstInstance &instance,
+                                         int32 instance_id,
+                                         BaseStateId state_id) const {
+    const std::atomic<ExpandedState*> *page =
+        instance.expanded_states[state_id / kExpandedStatePageSize].load(
+            std::memory_order_acquire);
+    if (page != NULL) {
+      ExpandedState *ans = page[state_id % kExpandedStatePageSize].load(
+          std::memory_order_acquire);
+      if (ans != NULL)
+        return ans;
     }
+    return ExpandStateShared(instance_id, state_id);
   }
 };
 
@@ -505,27 +624,27 @@ class ArcIterator<GrammarFstTpl<instance_FST > > {
   using BaseStateId = typename StdArc::StateId;  // int
   using ExpandedState = typename GrammarFstTpl<instance_FST >::ExpandedState;
 
-  // Caution: uses const_cast to evade const rules on GrammarFst.  This is for
-  // compatibility with how things work in OpenFst.
-  inline ArcIterator(const GrammarFstTpl<instance_FST > &fst_in, StateId s) {
-    GrammarFstTpl<instance_FST > &fst = const_cast<GrammarFstTpl<instance_FST >&>(fst_in);
+  // Note: this may expand states of 'fst' (which is allowed for a const
+  // GrammarFst, and is thread-safe).
+  inline ArcIterator(const GrammarFstTpl<instance_FST > &fst, StateId s) {
     // 'instance_id' is the high order bits of the state.
     int32 instance_id = s >> 32;
     // 'base_state' is low order bits of the state.  It's important to
     // explicitly say int32 below, not BaseStateId == int, which might on some
     // compilers be a 64-bit type.
     BaseStateId base_state = static_cast<int32>(s);
-    const typename GrammarFstTpl<instance_FST >::FstInstance &instance = fst.instances_[instance_id];
-    instance_FST *base_fst = instance.fst;
-    if (base_fst->Final(base_state).Value() != KALDI_GRAMMAR_FST_SPECIAL_WEIGHT) {
+    const typename GrammarFstTpl<instance_FST >::FstInstance &instance =
+        fst.Instance(instance_id);
+    if (instance.fst->Final(base_state).Value() !=
+        KALDI_GRAMMAR_FST_SPECIAL_WEIGHT) {
       // A normal state
       dest_instance_ = instance_id;
-      base_fst->InitArcIterator(s, &data_);
+      instance.fst->InitArcIterator(base_state, &data_);
       i_ = 0;
     } else {
       // A special state
-      ExpandedState *expanded_state = fst.GetExpandedState(instance_id,
-                                                           base_state);
+      ExpandedState *expanded_state = fst.GetExpandedState(
+          instance, instance_id, base_state);
       dest_instance_ = expanded_state->dest_fst_instance;
       // it's ok to leave the other members of data_ uninitialized, as they will
       // never be interrogated.
@@ -592,14 +711,62 @@ class ArcIterator<GrammarFstTpl<instance_FST > > {
 };
 
 
+/**
+   LiveGrammarFstTpl holds the current version of a GrammarFst whose
+   nonterminal FSTs (e.g. per-user contact lists) may be changed while decoding
+   is going on, from any thread.  Decoders get the version that is current
+   when they start, via Snapshot(), and keep using it until they are done
+   even if it is changed in the meantime; see the constructor of
+   SingleUtteranceNnet3DecoderTpl that takes a std::shared_ptr.  Changes are
+   made on a copy of the current version (see
+   GrammarFstTpl::SetNonterminalFst()), which then becomes current, so their
+   cost does not depend on the size of the top-level FST or the other
+   nonterminal FSTs.
+ */
+template <typename FST>
+class LiveGrammarFstTpl {
+ public:
+  /// Makes 'grammar_fst' (of which we take a lightweight copy) the current
+  /// version.
+  explicit LiveGrammarFstTpl(const GrammarFstTpl<FST> &grammar_fst);
+
+  /// Returns the current version.  It will not change; later changes are made
+  /// to new versions.
+  std::shared_ptr<const GrammarFstTpl<FST> > Snapshot() const;
+
+  /// Adds or replaces the FST for 'nonterminal' in a new version of the
+  /// GrammarFst, which becomes current.  See GrammarFstTpl::SetNonterminalFst().
+  void SetNonterminalFst(int32 nonterminal, std::shared_ptr<FST> fst);
+
+  /// Removes the FST for 'nonterminal' in a new version of the GrammarFst,
+  /// which becomes current.
+  void RemoveNonterminalFst(int32 nonterminal);
+
+  /// Returns the number of changes made so far; can be used to tell whether a
+  /// snapshot is out of date.
+  int64 Version() const;
+
+ private:
+  // Serializes SetNonterminalFst() and RemoveNonterminalFst(); held while the
+  // new version is being created.
+  std::mutex update_mutex_;
+  // Protects current_ and version_; held only briefly.
+  mutable std::mutex mutex_;
+  std::shared_ptr<const GrammarFstTpl<FST> > current_;
+  int64 version_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LiveGrammarFstTpl);
+};
+
+
 /**
    This function copies a GrammarFst to a VectorFst (intended mostly for testing
    and comparison purposes).  GrammarFst doesn't actually inherit from class
    Fst, so we can't just construct an FST from the GrammarFst.
 
    grammar_fst gets expanded by this call, and although we could make it a const
-   reference (because the ArcIterator does actually use const_cast), we make it
-   a non-const pointer to emphasize that this call does change grammar_fst.
+   reference (the expansion is allowed on a const GrammarFst), we make it a
+   non-const pointer to emphasize that this call does change grammar_fst.
  */
 template<typename FST>
 void CopyToVectorFst(GrammarFstTpl<FST> *grammar_fst,
@@ -646,6 +813,8 @@ void PrepareForGrammarFst(int32 nonterm_phones_offset,
 // Template aliases
 using ConstGrammarFst = GrammarFstTpl<const ConstFst<StdArc> >;
 using VectorGrammarFst =  GrammarFstTpl<StdVectorFst>;
+using LiveConstGrammarFst = LiveGrammarFstTpl<const ConstFst<StdArc> >;
+using LiveVectorGrammarFst = LiveGrammarFstTpl<StdVectorFst>;
 
 } // end namespace fst
 
@@ -0,0 +1,51 @@
+// decoder/graph-lookahead.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/graph-lookahead.h"
+
+namespace kaldi {
+
+void GraphLookahead::Compute(const fst::Fst<fst::StdArc> &fst) {
+  std::vector<fst::TropicalWeight> distance;
+  // reverse == true gives the distance from each state to the final states.
+  fst::ShortestDistance(fst, &distance, true);
+  int32 num_states = distance.size();
+  costs_.Resize(num_states, kUndefined);
+  int32 num_unreachable = 0;
+  for (int32 s = 0; s < num_states; s++) {
+    costs_(s) = distance[s].Value();
+    if (costs_(s) == std::numeric_limits<BaseFloat>::infinity())
+      num_unreachable++;
+  }
+  if (num_unreachable != 0)
+    KALDI_WARN << num_unreachable << " out of " << num_states
+               << " states cannot reach a final state (graph not trimmed?)";
+}
+
+void GraphLookahead::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<GraphLookahead>");
+  costs_.Write(os, binary);
+  WriteToken(os, binary, "</GraphLookahead>");
+}
+
+void GraphLookahead::Read(std::istream &is, bool binary) {
+  ExpectToken(is, binary, "<GraphLookahead>");
+  costs_.Read(is, binary);
+  ExpectToken(is, binary, "</GraphLookahead>");
+}
+
+}  // namespace kaldi
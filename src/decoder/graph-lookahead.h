@@ -0,0 +1,68 @@
+// decoder/graph-lookahead.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_GRAPH_LOOKAHEAD_H_
+#define KALDI_DECODER_GRAPH_LOOKAHEAD_H_
+
+#include <limits>
+#include "base/kaldi-common.h"
+#include "matrix/kaldi-vector.h"
+#include "fst/fstlib.h"
+
+namespace kaldi {
+
+/**
+   GraphLookahead stores, for each state of a decoding graph (normally HCLG),
+   the graph cost of the best path from that state to a final state (including
+   the final-cost).  This is a lower bound on the graph cost that any token in
+   that state still has to pay, so adding it to the token's cost before
+   comparing with the beam (see LatticeFasterDecoderTpl::SetGraphLookahead())
+   lets the decoder prune tokens whose language-model future is bad before
+   they have paid for it, which is what makes much tighter beams usable.
+
+   It is computed offline, once per graph, by the program
+   compute-graph-lookahead, and only makes sense for the graph it was computed
+   from.  States with no path to a final state get an infinite cost.
+ */
+class GraphLookahead {
+ public:
+  GraphLookahead() { }
+
+  /// Computes the table for 'fst', by a shortest-distance computation on the
+  /// reversed FST.  This needs memory proportional to the size of the FST.
+  void Compute(const fst::Fst<fst::StdArc> &fst);
+
+  /// Returns the best future graph cost of state 's', or zero if 's' is not
+  /// a state that the table knows about.
+  inline BaseFloat Cost(int64 s) const {
+    return (s >= 0 && s < static_cast<int64>(costs_.Dim()) ?
+            costs_(s) : 0.0);
+  }
+
+  int32 NumStates() const { return costs_.Dim(); }
+
+  void Write(std::ostream &os, bool binary) const;
+
+  void Read(std::istream &is, bool binary);
+
+ private:
+  Vector<BaseFloat> costs_;
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_DECODER_GRAPH_LOOKAHEAD_H_
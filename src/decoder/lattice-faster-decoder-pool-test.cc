@@ -0,0 +1,209 @@
+// decoder/lattice-faster-decoder-pool-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <unistd.h>
+#include "decoder/lattice-faster-decoder-pool.h"
+#include "decoder/decodable-matrix.h"
+#include "hmm/hmm-test-utils.h"
+#include "lat/kaldi-lattice.h"
+
+namespace kaldi {
+
+using fst::StdArc;
+
+// Makes a random graph whose input labels are the transition-ids of
+// 'trans_model'.  Every state has an emitting self-loop, so no path dies, and
+// epsilon arcs only go to higher-numbered states.
+static void RandomDecodingGraph(const TransitionModel &trans_model,
+                                fst::StdVectorFst *fst) {
+  int32 num_tids = trans_model.NumTransitionIds();
+  fst->DeleteStates();
+  int32 num_states = RandInt(2, 10);
+  for (int32 s = 0; s < num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    fst->AddArc(s, StdArc(RandInt(1, num_tids), 0, RandUniform(), s));
+    int32 num_arcs = RandInt(1, 4);
+    for (int32 a = 0; a < num_arcs; a++) {
+      int32 next_state = RandInt(0, num_states - 1),
+          ilabel = RandInt(1, num_tids),
+          olabel = (RandInt(0, 1) == 0 ? 0 : RandInt(1, 20));
+      if (next_state > s && RandInt(0, 3) == 0)
+        ilabel = 0;
+      fst->AddArc(s, StdArc(ilabel, olabel, RandUniform(), next_state));
+    }
+    if (s == num_states - 1 || RandInt(0, 2) == 0)
+      fst->SetFinal(s, RandUniform());
+  }
+}
+
+// The utterances to decode: utterance i is decoded with graph
+// graphs[graph_index[i]], or if graph_index[i] == -1, with its own copy of
+// graphs[0], of which the pool takes ownership.
+struct PoolTestData {
+  std::vector<fst::StdVectorFst> graphs;
+  std::vector<int32> graph_index;
+  std::vector<Matrix<BaseFloat> > loglikes;
+};
+
+// Decodes the utterances in 'data' with a pool of 'num_threads' threads,
+// writing the lattices, words and alignments to archives whose names start
+// with 'prefix'.  Returns the total likelihood.
+static double DecodeWithPool(const TransitionModel &trans_model,
+                             const PoolTestData &data,
+                             int32 num_threads,
+                             bool determinize,
+                             const std::string &prefix) {
+  LatticeFasterDecoderPoolConfig pool_config;
+  pool_config.num_threads = num_threads;
+  pool_config.max_pending = num_threads + RandInt(0, 2);
+  LatticeFasterDecoderConfig decoder_config;
+  BaseFloat acoustic_scale = 0.1;
+  bool allow_partial = true;
+  Int32VectorWriter alignments_writer("ark:" + prefix + ".ali"),
+      words_writer("ark:" + prefix + ".words");
+  CompactLatticeWriter compact_lattice_writer;
+  LatticeWriter lattice_writer;
+  if (determinize)
+    KALDI_ASSERT(compact_lattice_writer.Open("ark:" + prefix + ".lats"));
+  else
+    KALDI_ASSERT(lattice_writer.Open("ark:" + prefix + ".lats"));
+
+  LatticeFasterDecoderPool pool(pool_config, decoder_config, trans_model,
+                                NULL, acoustic_scale, determinize,
+                                allow_partial, &alignments_writer,
+                                &words_writer, &compact_lattice_writer,
+                                &lattice_writer);
+  for (size_t i = 0; i < data.loglikes.size(); i++) {
+    std::ostringstream utt;
+    utt << "utt" << i;
+    const fst::Fst<StdArc> *fst;
+    bool take_ownership_of_fst = (data.graph_index[i] == -1);
+    if (take_ownership_of_fst)
+      fst = new fst::StdVectorFst(data.graphs[0]);
+    else
+      fst = &(data.graphs[data.graph_index[i]]);
+    DecodableInterface *decodable = new DecodableMatrixScaledMapped(
+        trans_model, acoustic_scale, new Matrix<BaseFloat>(data.loglikes[i]));
+    pool.Decode(utt.str(), fst, take_ownership_of_fst, decodable);
+  }
+  pool.Wait();
+  KALDI_ASSERT(pool.NumDone() == static_cast<int32>(data.loglikes.size()) &&
+               pool.NumErr() == 0);
+  return pool.TotLike();
+}
+
+// Checks that the archives written by DecodeWithPool() with prefixes 'prefix1'
+// and 'prefix2' are the same, and that the utterances are in the order they
+// were decoded in.
+static void CheckSameOutput(const std::string &prefix1,
+                            const std::string &prefix2,
+                            int32 num_utts,
+                            bool determinize) {
+  const char *int32_extensions[] = { ".ali", ".words" };
+  for (int32 e = 0; e < 2; e++) {
+    SequentialInt32VectorReader reader1(std::string("ark:") + prefix1 +
+                                        int32_extensions[e]),
+        reader2(std::string("ark:") + prefix2 + int32_extensions[e]);
+    for (int32 i = 0; i < num_utts; i++) {
+      std::ostringstream utt;
+      utt << "utt" << i;
+      KALDI_ASSERT(!reader1.Done() && !reader2.Done() &&
+                   reader1.Key() == utt.str() && reader2.Key() == utt.str() &&
+                   reader1.Value() == reader2.Value());
+      reader1.Next();
+      reader2.Next();
+    }
+    KALDI_ASSERT(reader1.Done() && reader2.Done());
+  }
+  if (determinize) {
+    SequentialCompactLatticeReader reader1("ark:" + prefix1 + ".lats"),
+        reader2("ark:" + prefix2 + ".lats");
+    for (int32 i = 0; i < num_utts; i++, reader1.Next(), reader2.Next()) {
+      std::ostringstream utt;
+      utt << "utt" << i;
+      KALDI_ASSERT(!reader1.Done() && !reader2.Done() &&
+                   reader1.Key() == utt.str() && reader2.Key() == utt.str());
+      KALDI_ASSERT(fst::Equal(reader1.Value(), reader2.Value()));
+    }
+    KALDI_ASSERT(reader1.Done() && reader2.Done());
+  } else {
+    SequentialLatticeReader reader1("ark:" + prefix1 + ".lats"),
+        reader2("ark:" + prefix2 + ".lats");
+    for (int32 i = 0; i < num_utts; i++, reader1.Next(), reader2.Next()) {
+      std::ostringstream utt;
+      utt << "utt" << i;
+      KALDI_ASSERT(!reader1.Done() && !reader2.Done() &&
+                   reader1.Key() == utt.str() && reader2.Key() == utt.str());
+      KALDI_ASSERT(fst::Equal(reader1.Value(), reader2.Value()));
+    }
+    KALDI_ASSERT(reader1.Done() && reader2.Done());
+  }
+}
+
+static void DeleteArchives(const std::string &prefix) {
+  unlink((prefix + ".ali").c_str());
+  unlink((prefix + ".words").c_str());
+  unlink((prefix + ".lats").c_str());
+}
+
+// Checks that decoding a batch of utterances with 4 threads gives the same
+// output, in the same order, as with 1 thread.  The threads share two graphs
+// (so each thread reuses its decoders for them) and some utterances have
+// their own graph, which the pool deletes.
+void UnitTestLatticeFasterDecoderPool() {
+  TransitionModel *trans_model = GenRandTransitionModel(NULL);
+  PoolTestData data;
+  data.graphs.resize(2);
+  RandomDecodingGraph(*trans_model, &(data.graphs[0]));
+  RandomDecodingGraph(*trans_model, &(data.graphs[1]));
+  int32 num_utts = RandInt(10, 30);
+  for (int32 i = 0; i < num_utts; i++) {
+    data.graph_index.push_back(RandInt(-1, 1));
+    // Some utterances are much longer than the others, so they finish out of
+    // order.
+    int32 num_frames = (RandInt(0, 4) == 0 ? RandInt(50, 100) :
+                        RandInt(1, 20));
+    data.loglikes.push_back(Matrix<BaseFloat>(num_frames,
+                                              trans_model->NumPdfs()));
+    data.loglikes.back().SetRandn();
+  }
+  bool determinize = (RandInt(0, 1) == 0);
+
+  std::string prefix1 = "tmp.lattice-faster-decoder-pool-test.1",
+      prefix4 = "tmp.lattice-faster-decoder-pool-test.4";
+  double tot_like1 = DecodeWithPool(*trans_model, data, 1, determinize,
+                                    prefix1),
+      tot_like4 = DecodeWithPool(*trans_model, data, 4, determinize,
+                                 prefix4);
+  AssertEqual(tot_like1, tot_like4);
+  CheckSameOutput(prefix1, prefix4, num_utts, determinize);
+  DeleteArchives(prefix1);
+  DeleteArchives(prefix4);
+  delete trans_model;
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++)
+    UnitTestLatticeFasterDecoderPool();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
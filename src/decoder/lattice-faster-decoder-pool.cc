@@ -0,0 +1,213 @@
+// decoder/lattice-faster-decoder-pool.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/lattice-faster-decoder-pool.h"
+
+namespace kaldi {
+
+LatticeFasterDecoderPool::LatticeFasterDecoderPool(
+    const LatticeFasterDecoderPoolConfig &pool_config,
+    const LatticeFasterDecoderConfig &decoder_config,
+    const TransitionModel &trans_model,
+    const fst::SymbolTable *word_syms,
+    BaseFloat acoustic_scale,
+    bool determinize,
+    bool allow_partial,
+    Int32VectorWriter *alignments_writer,
+    Int32VectorWriter *words_writer,
+    CompactLatticeWriter *compact_lattice_writer,
+    LatticeWriter *lattice_writer):
+    decoder_config_(decoder_config), trans_model_(trans_model),
+    word_syms_(word_syms), acoustic_scale_(acoustic_scale),
+    determinize_(determinize), allow_partial_(allow_partial),
+    alignments_writer_(alignments_writer), words_writer_(words_writer),
+    compact_lattice_writer_(compact_lattice_writer),
+    lattice_writer_(lattice_writer),
+    queues_(std::max<int32>(pool_config.num_threads, 1)),
+    tasks_avail_(0),
+    pending_avail_(pool_config.max_pending > 0 ? pool_config.max_pending :
+                   pool_config.num_threads + 20),
+    stop_(false), next_seq_(0), next_output_seq_(0),
+    tot_like_(0.0), num_frames_(0), num_done_(0), num_err_(0),
+    num_partial_(0) {
+  decoder_config.Check();
+  KALDI_ASSERT(pool_config.num_threads > 0 &&
+               (pool_config.max_pending <= 0 ||
+                pool_config.max_pending >= pool_config.num_threads) &&
+               "max-pending-utterances, if specified, must be >= num-threads");
+  for (int32 i = 0; i < pool_config.num_threads; i++)
+    threads_.push_back(std::thread(&LatticeFasterDecoderPool::RunWorker,
+                                   this, i));
+}
+
+void LatticeFasterDecoderPool::Decode(const std::string &utt,
+                                      const fst::Fst<fst::StdArc> *fst,
+                                      bool take_ownership_of_fst,
+                                      DecodableInterface *decodable) {
+  pending_avail_.Wait();
+  Task *task = new Task();
+  task->utt = utt;
+  task->seq = next_seq_++;
+  task->fst = fst;
+  task->own_fst = take_ownership_of_fst;
+  task->decodable = decodable;
+  task->success = false;
+  TaskQueue &queue = queues_[task->seq % queues_.size()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(task);
+  }
+  tasks_avail_.Signal();
+}
+
+void LatticeFasterDecoderPool::Wait() {
+  std::unique_lock<std::mutex> lock(output_mutex_);
+  while (next_output_seq_ != next_seq_)
+    output_done_.wait(lock);
+}
+
+LatticeFasterDecoderPool::~LatticeFasterDecoderPool() {
+  Wait();
+  stop_ = true;
+  for (size_t i = 0; i < threads_.size(); i++)
+    tasks_avail_.Signal();
+  for (size_t i = 0; i < threads_.size(); i++)
+    threads_[i].join();
+}
+
+void LatticeFasterDecoderPool::RunWorker(int32 thread_id) {
+  DecoderMap decoders;
+  while (true) {
+    tasks_avail_.Wait();
+    Task *task = GetTask(thread_id);
+    if (task == NULL)
+      break;
+    DecodeTask(task, &decoders);
+    FinishTask(task);
+  }
+  for (DecoderMap::iterator iter = decoders.begin(); iter != decoders.end();
+       ++iter)
+    delete iter->second;
+}
+
+LatticeFasterDecoderPool::Task *LatticeFasterDecoderPool::GetTask(
+    int32 thread_id) {
+  {
+    TaskQueue &queue = queues_[thread_id];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      Task *task = queue.tasks.front();
+      queue.tasks.pop_front();
+      return task;
+    }
+  }
+  // Our queue is empty, so steal the oldest task from the other queues.  We
+  // loop because another thread may take it between our looking at it and
+  // taking it; the semaphore guarantees there is a task for us somewhere.
+  int32 num_queues = queues_.size();
+  while (true) {
+    int32 best_queue = -1;
+    int64 best_seq = 0;
+    for (int32 i = 0; i < num_queues; i++) {
+      TaskQueue &queue = queues_[i];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (!queue.tasks.empty() &&
+          (best_queue == -1 || queue.tasks.front()->seq < best_seq)) {
+        best_queue = i;
+        best_seq = queue.tasks.front()->seq;
+      }
+    }
+    if (best_queue == -1) {
+      if (stop_)
+        return NULL;
+      std::this_thread::yield();
+      continue;
+    }
+    TaskQueue &queue = queues_[best_queue];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      Task *task = queue.tasks.front();
+      queue.tasks.pop_front();
+      return task;
+    }
+  }
+}
+
+void LatticeFasterDecoderPool::DecodeTask(Task *task, DecoderMap *decoders) {
+  LatticeFasterDecoder *decoder;
+  std::unique_ptr<LatticeFasterDecoder> temp_decoder;
+  if (task->own_fst) {
+    // This constructor takes ownership of the FST.
+    temp_decoder.reset(new LatticeFasterDecoder(
+        decoder_config_, const_cast<fst::Fst<fst::StdArc>*>(task->fst)));
+    decoder = temp_decoder.get();
+  } else {
+    LatticeFasterDecoder *&d = (*decoders)[task->fst];
+    if (d == NULL)
+      d = new LatticeFasterDecoder(*(task->fst), decoder_config_);
+    decoder = d;
+  }
+  task->fst = NULL;
+
+  task->success = decoder->Decode(task->decodable);
+  if (!task->success)
+    KALDI_WARN << "Failed to decode utterance with id " << task->utt;
+  // The decodable may hold a lot of memory, so free it before we start on the
+  // lattice.
+  delete task->decodable;
+  task->decodable = NULL;
+  if (task->success)
+    task->success = GetLatticeFasterDecoderOutput(
+        *decoder, trans_model_, task->utt, acoustic_scale_, determinize_,
+        allow_partial_, &task->output);
+}
+
+void LatticeFasterDecoderPool::FinishTask(Task *task) {
+  std::lock_guard<std::mutex> lock(output_mutex_);
+  finished_[task->seq] = task;
+  bool any_output = false;
+  while (!finished_.empty() &&
+         finished_.begin()->first == next_output_seq_) {
+    Task *next_task = finished_.begin()->second;
+    finished_.erase(finished_.begin());
+    OutputTask(*next_task);
+    delete next_task;
+    next_output_seq_++;
+    pending_avail_.Signal();
+    any_output = true;
+  }
+  if (any_output)
+    output_done_.notify_all();
+}
+
+void LatticeFasterDecoderPool::OutputTask(const Task &task) {
+  if (!task.success) {
+    num_err_++;
+    return;
+  }
+  double likelihood;
+  WriteLatticeFasterDecoderOutput(task.utt, task.output, word_syms_,
+                                  determinize_, alignments_writer_,
+                                  words_writer_, compact_lattice_writer_,
+                                  lattice_writer_, &likelihood);
+  tot_like_ += likelihood;
+  num_frames_ += task.output.alignment.size();
+  num_done_++;
+  if (task.output.partial) num_partial_++;
+}
+
+}  // namespace kaldi
@@ -0,0 +1,200 @@
+// decoder/lattice-faster-decoder-pool.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_LATTICE_FASTER_DECODER_POOL_H_
+#define KALDI_DECODER_LATTICE_FASTER_DECODER_POOL_H_
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "util/common-utils.h"
+#include "util/kaldi-semaphore.h"
+#include "hmm/transition-model.h"
+#include "decoder/decoder-wrappers.h"
+#include "decoder/lattice-faster-decoder.h"
+
+namespace kaldi {
+
+struct LatticeFasterDecoderPoolConfig {
+  int32 num_threads;
+  int32 max_pending;
+
+  LatticeFasterDecoderPoolConfig(): num_threads(1), max_pending(0) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("num-threads", &num_threads, "Number of decoding threads "
+                   "to run in parallel");
+    opts->Register("max-pending-utterances", &max_pending, "Maximum number of "
+                   "utterances that may be queued, being decoded or waiting to "
+                   "be written out.  Controls memory use.  If <= 0, defaults to "
+                   "--num-threads plus 20.");
+    // The *-latgen-faster-parallel programs used to take this option from
+    // TaskSequencerConfig.
+    opts->Register("num-threads-total", &max_pending, "(Deprecated) Same as "
+                   "--max-pending-utterances.");
+  }
+};
+
+/**
+   LatticeFasterDecoderPool decodes utterances on a fixed pool of worker
+   threads and writes the output in the order the utterances were given to
+   Decode(), the way DecodeUtteranceLatticeFasterClass with TaskSequencer does
+   in the *-latgen-faster-parallel programs; the differences are:
+
+    - Each thread keeps one LatticeFasterDecoder for each decoding graph it has
+      seen and reuses it for later utterances, instead of creating and
+      destroying a decoder (with its hash and token memory) per utterance.
+    - Utterances are assigned round-robin to per-thread queues, and a thread
+      whose queue is empty steals the oldest utterance from the other queues.
+      Threads never wait for the output of earlier utterances: a decoded
+      utterance is kept (as its lattice, the decodable having been freed)
+      until everything before it has been written, so one long utterance
+      doesn't stall the other threads.  The number of utterances in flight is
+      limited by max_pending.
+
+   Output (lattices, words, alignments and logging) is as for
+   DecodeUtteranceLatticeFaster().  It is done by whichever worker thread
+   completes the oldest outstanding utterance, with a lock held, so the writers
+   are never accessed concurrently.
+ */
+class LatticeFasterDecoderPool {
+ public:
+  /// The writers for alignments and words will only be written to if they are
+  /// open.  If determinize == false, lattices are written to lattice_writer,
+  /// else to compact_lattice_writer.  None of the pointers are owned.
+  LatticeFasterDecoderPool(const LatticeFasterDecoderPoolConfig &pool_config,
+                           const LatticeFasterDecoderConfig &decoder_config,
+                           const TransitionModel &trans_model,
+                           const fst::SymbolTable *word_syms,
+                           BaseFloat acoustic_scale,
+                           bool determinize,
+                           bool allow_partial,
+                           Int32VectorWriter *alignments_writer,
+                           Int32VectorWriter *words_writer,
+                           CompactLatticeWriter *compact_lattice_writer,
+                           LatticeWriter *lattice_writer);
+
+  /// Queues utterance 'utt' for decoding with graph 'fst'; takes ownership of
+  /// 'decodable', which is deleted as soon as the utterance is decoded.  If
+  /// take_ownership_of_fst is false, 'fst' must stay valid until Wait() has
+  /// returned, and decoders for it are reused; otherwise it is deleted after
+  /// decoding (use this for per-utterance graphs).  Blocks while max_pending
+  /// utterances are in flight.
+  void Decode(const std::string &utt,
+              const fst::Fst<fst::StdArc> *fst,
+              bool take_ownership_of_fst,
+              DecodableInterface *decodable);
+
+  /// Waits until all utterances given to Decode() have been decoded and
+  /// written out.  You can call Decode() again afterwards.
+  void Wait();
+
+  /// Calls Wait() and stops the threads.
+  ~LatticeFasterDecoderPool();
+
+  // Statistics, valid after Wait().  Frame counts are of decoded frames.
+  double TotLike() const { return tot_like_; }
+  int64 NumFrames() const { return num_frames_; }
+  int32 NumDone() const { return num_done_; }
+  int32 NumErr() const { return num_err_; }
+  int32 NumPartial() const { return num_partial_; }
+
+ private:
+  struct Task {
+    std::string utt;
+    int64 seq;  // position in the order of calls to Decode().
+    const fst::Fst<fst::StdArc> *fst;
+    bool own_fst;
+    DecodableInterface *decodable;
+
+    // The following are set by DecodeTask().
+    bool success;
+    LatticeFasterDecoderOutput output;  // valid if success == true.
+  };
+  // Per-thread queue of tasks; the owner and thieves both take from the
+  // front, which has the oldest tasks.
+  struct TaskQueue {
+    std::mutex mutex;
+    std::deque<Task*> tasks;
+  };
+  typedef std::map<const fst::Fst<fst::StdArc>*, LatticeFasterDecoder*>
+      DecoderMap;
+
+  // The function each worker thread runs.
+  void RunWorker(int32 thread_id);
+
+  // Takes a task from queue 'thread_id', or if it's empty the oldest task
+  // from any other queue.  Returns NULL only if there are no tasks and we are
+  // stopping.  Must only be called after a successful tasks_avail_.Wait().
+  Task *GetTask(int32 thread_id);
+
+  // Does the decoding, lattice generation and determinization for 'task',
+  // using (and if necessary adding to) the thread's decoders; see
+  // GetLatticeFasterDecoderOutput().
+  void DecodeTask(Task *task, DecoderMap *decoders);
+
+  // Adds 'task' to the finished tasks and writes out (and deletes) any
+  // finished tasks that are next in order.
+  void FinishTask(Task *task);
+
+  // Writes out the output for one task (see
+  // WriteLatticeFasterDecoderOutput()) and updates the statistics.  Called
+  // with output_mutex_ held.
+  void OutputTask(const Task &task);
+
+  LatticeFasterDecoderConfig decoder_config_;
+  const TransitionModel &trans_model_;
+  const fst::SymbolTable *word_syms_;
+  BaseFloat acoustic_scale_;
+  bool determinize_;
+  bool allow_partial_;
+  Int32VectorWriter *alignments_writer_;
+  Int32VectorWriter *words_writer_;
+  CompactLatticeWriter *compact_lattice_writer_;
+  LatticeWriter *lattice_writer_;
+
+  std::vector<TaskQueue> queues_;  // indexed by thread.
+  Semaphore tasks_avail_;  // counts the tasks in queues_ (plus one per
+                           // thread when stopping).
+  Semaphore pending_avail_;  // counts how many more tasks may be in flight.
+  bool stop_;  // set when the threads are to exit.
+  std::vector<std::thread> threads_;
+
+  // next_seq_ is only accessed by the thread calling Decode() and Wait().
+  int64 next_seq_;
+
+  // Protects the following variables, and the writers.
+  std::mutex output_mutex_;
+  std::condition_variable output_done_;  // notified when next_output_seq_
+                                         // changes.
+  std::map<int64, Task*> finished_;  // decoded tasks not yet output.
+  int64 next_output_seq_;
+  double tot_like_;
+  int64 num_frames_;
+  int32 num_done_;
+  int32 num_err_;
+  int32 num_partial_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterDecoderPool);
+};
+
+}  // namespace kaldi
+
+#endif  // KALDI_DECODER_LATTICE_FASTER_DECODER_POOL_H_
@@ -0,0 +1,143 @@
+// decoder/lattice-faster-decoder-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/lattice-faster-decoder.h"
+#include "fstext/fstext-utils.h"
+#include "lat/kaldi-lattice.h"
+
+namespace kaldi {
+
+// A decodable object backed by a matrix, of which only the first
+// 'num_frames_ready' rows are visible; it records the frames it was asked for.
+class RecordingDecodable: public DecodableInterface {
+ public:
+  explicit RecordingDecodable(const Matrix<BaseFloat> &loglikes):
+      loglikes_(loglikes), num_frames_ready_(0) { }
+
+  virtual BaseFloat LogLikelihood(int32 frame, int32 index) {
+    KALDI_ASSERT(frame < num_frames_ready_ && index >= 1 &&
+                 index <= loglikes_.NumCols());
+    frames_requested_.push_back(frame);
+    return loglikes_(frame, index - 1);
+  }
+  virtual int32 NumFramesReady() const { return num_frames_ready_; }
+  virtual bool IsLastFrame(int32 frame) const {
+    return frame == loglikes_.NumRows() - 1;
+  }
+  virtual int32 NumIndices() const { return loglikes_.NumCols(); }
+
+  void SetNumFramesReady(int32 n) {
+    num_frames_ready_ = std::min(n, loglikes_.NumRows());
+  }
+  const std::vector<int32> &FramesRequested() const {
+    return frames_requested_;
+  }
+
+ private:
+  const Matrix<BaseFloat> &loglikes_;
+  int32 num_frames_ready_;
+  std::vector<int32> frames_requested_;
+};
+
+// Makes a random graph with input labels 1..num_indices in which every state
+// has an emitting self-loop, so no path dies, and epsilon arcs only go to
+// higher-numbered states.
+static void RandomDecodingGraph(int32 num_indices, fst::StdVectorFst *fst) {
+  typedef fst::StdArc Arc;
+  fst->DeleteStates();
+  int32 num_states = RandInt(2, 10);
+  for (int32 s = 0; s < num_states; s++)
+    fst->AddState();
+  fst->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    fst->AddArc(s, Arc(RandInt(1, num_indices), 0, RandUniform(), s));
+    int32 num_arcs = RandInt(1, 4);
+    for (int32 a = 0; a < num_arcs; a++) {
+      int32 next_state = RandInt(0, num_states - 1),
+          ilabel = RandInt(1, num_indices),
+          olabel = (RandInt(0, 1) == 0 ? 0 : RandInt(1, 20));
+      if (next_state > s && RandInt(0, 3) == 0)
+        ilabel = 0;
+      fst->AddArc(s, Arc(ilabel, olabel, RandUniform(), next_state));
+    }
+    if (s == num_states - 1 || RandInt(0, 2) == 0)
+      fst->SetFinal(s, RandUniform());
+  }
+}
+
+// Decodes 'loglikes' in chunks of random size, and returns the cost of the
+// best path.
+static BaseFloat DecodeInChunks(const fst::StdVectorFst &fst,
+                                const LatticeFasterDecoderConfig &config,
+                                const Matrix<BaseFloat> &loglikes,
+                                RecordingDecodable *decodable) {
+  LatticeFasterDecoder decoder(fst, config);
+  decoder.InitDecoding();
+  int32 num_frames = loglikes.NumRows();
+  while (decoder.NumFramesDecoded() < num_frames) {
+    decodable->SetNumFramesReady(decodable->NumFramesReady() +
+                                 RandInt(0, 5));
+    decoder.AdvanceDecoding(decodable);
+  }
+  decoder.FinalizeDecoding();
+  Lattice best_path;
+  KALDI_ASSERT(decoder.GetBestPath(&best_path));
+  std::vector<int32> alignment, words;
+  LatticeWeight weight;
+  fst::GetLinearSymbolSequence(best_path, &alignment, &words, &weight);
+  KALDI_ASSERT(static_cast<int32>(alignment.size()) == num_frames);
+  return weight.Value1() + weight.Value2();
+}
+
+// Checks that with --acoustic-lookahead-frames, each frame is read from the
+// decodable object exactly once and in order (so a decodable that only keeps
+// one chunk of output never has to recompute), and that with a beam wide
+// enough not to prune anything we get the same best path as without lookahead.
+void UnitTestAcousticLookahead() {
+  int32 num_indices = RandInt(1, 10), num_frames = RandInt(1, 30);
+  fst::StdVectorFst fst;
+  RandomDecodingGraph(num_indices, &fst);
+  Matrix<BaseFloat> loglikes(num_frames, num_indices);
+  loglikes.SetRandn();
+
+  LatticeFasterDecoderConfig config;
+  config.beam = 1000.0;
+  config.lattice_beam = 10.0;
+  RecordingDecodable decodable1(loglikes);
+  BaseFloat cost1 = DecodeInChunks(fst, config, loglikes, &decodable1);
+
+  config.acoustic_lookahead_frames = RandInt(1, 5);
+  config.batch_acoustic_scores = (RandInt(0, 1) == 0);
+  RecordingDecodable decodable2(loglikes);
+  BaseFloat cost2 = DecodeInChunks(fst, config, loglikes, &decodable2);
+
+  const std::vector<int32> &frames = decodable2.FramesRequested();
+  KALDI_ASSERT(static_cast<int32>(frames.size()) == num_frames * num_indices);
+  for (size_t i = 0; i < frames.size(); i++)
+    KALDI_ASSERT(frames[i] == static_cast<int32>(i) / num_indices);
+  AssertEqual(cost1, cost2, 1.0e-04);
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 50; i++)
+    UnitTestAcousticLookahead();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
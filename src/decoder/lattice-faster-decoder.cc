@@ -30,7 +30,9 @@ template <typename FST, typename Token>
 LatticeFasterDecoderTpl<FST, Token>::LatticeFasterDecoderTpl(
     const FST &fst,
     const LatticeFasterDecoderConfig &config):
-    fst_(&fst), delete_fst_(false), config_(config), num_toks_(0) {
+    fst_(&fst), delete_fst_(false), config_(config),
+    graph_lookahead_(NULL), decodable_(NULL), cur_ac_cost_row_(NULL),
+    initial_nonemitting_pending_(false), num_toks_(0) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
@@ -39,7 +41,9 @@ LatticeFasterDecoderTpl<FST, Token>::LatticeFasterDecoderTpl(
 template <typename FST, typename Token>
 LatticeFasterDecoderTpl<FST, Token>::LatticeFasterDecoderTpl(
     const LatticeFasterDecoderConfig &config, FST *fst):
-    fst_(fst), delete_fst_(true), config_(config), num_toks_(0) {
+    fst_(fst), delete_fst_(true), config_(config),
+    graph_lookahead_(NULL), decodable_(NULL), cur_ac_cost_row_(NULL),
+    initial_nonemitting_pending_(false), num_toks_(0) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
@@ -62,6 +66,13 @@ void LatticeFasterDecoderTpl<FST, Token>::InitDecoding() {
   num_toks_ = 0;
   decoding_finalized_ = false;
   final_costs_.clear();
+  decodable_ = NULL;
+  for (int32 i = 0; i < 2; i++) {
+    ac_lookahead_cache_[i].clear();
+    ac_lookahead_frame_[i] = -1;
+  }
+  std::fill(ac_cost_row_frame_.begin(), ac_cost_row_frame_.end(), -1);
+  std::fill(ac_cost_frame_.begin(), ac_cost_frame_.end(), -1);
   StateId start_state = fst_->Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
@@ -69,7 +80,18 @@ void LatticeFasterDecoderTpl<FST, Token>::InitDecoding() {
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
-  ProcessNonemitting(config_.beam);
+  // The acoustic lookahead needs the decodable object, which we don't have
+  // yet, so in that case this is done by AdvanceDecoding().
+  initial_nonemitting_pending_ = true;
+  if (config_.acoustic_lookahead_frames == 0)
+    ProcessInitialNonemitting();
+}
+
+template <typename FST, typename Token>
+void LatticeFasterDecoderTpl<FST, Token>::ProcessInitialNonemitting() {
+  KALDI_ASSERT(initial_nonemitting_pending_ && NumFramesDecoded() == 0);
+  initial_nonemitting_pending_ = false;
+  ProcessNonemitting(LookaheadCost(fst_->Start(), 0) + config_.beam);
 }
 
 // Returns true if any kind of traceback is available (not necessarily from
@@ -609,13 +631,27 @@ void LatticeFasterDecoderTpl<FST, Token>::AdvanceDecoding(DecodableInterface *de
   if (max_num_frames >= 0)
     target_frames_decoded = std::min(target_frames_decoded,
                                      NumFramesDecoded() + max_num_frames);
+  decodable_ = decodable;
+  if (initial_nonemitting_pending_ && num_frames_ready > 0)
+    ProcessInitialNonemitting();
   while (NumFramesDecoded() < target_frames_decoded) {
+    KALDI_TRACE_SCOPE("LatticeFasterDecoder::DecodeFrame", NumFramesDecoded());
     if (NumFramesDecoded() % config_.prune_interval == 0) {
+      KALDI_TRACE_SCOPE("LatticeFasterDecoder::PruneActiveTokens");
       PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
     }
-    BaseFloat cost_cutoff = ProcessEmitting(decodable);
-    ProcessNonemitting(cost_cutoff);
+    BaseFloat cost_cutoff;
+    {
+      KALDI_TRACE_SCOPE("LatticeFasterDecoder::ProcessEmitting");
+      cost_cutoff = ProcessEmitting(decodable);
+    }
+    {
+      KALDI_TRACE_SCOPE("LatticeFasterDecoder::ProcessNonemitting");
+      ProcessNonemitting(cost_cutoff);
+    }
+    TraceProfiler::Counter("LatticeFasterDecoder::num-toks", num_toks_);
   }
+  decodable_ = NULL;
 }
 
 // FinalizeDecoding() is a version of PruneActiveTokens that we call
@@ -623,6 +659,8 @@ void LatticeFasterDecoderTpl<FST, Token>::AdvanceDecoding(DecodableInterface *de
 // tokens.  This function used to be called PruneActiveTokensFinal().
 template <typename FST, typename Token>
 void LatticeFasterDecoderTpl<FST, Token>::FinalizeDecoding() {
+  if (initial_nonemitting_pending_)
+    ProcessInitialNonemitting();
   int32 final_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // PruneForwardLinksFinal() prunes final frame (with final-probs), and
@@ -639,17 +677,98 @@ void LatticeFasterDecoderTpl<FST, Token>::FinalizeDecoding() {
                 << " to " << num_toks_;
 }
 
-/// Gets the weight cutoff.  Also counts the active tokens.
+template <typename FST, typename Token>
+inline BaseFloat LatticeFasterDecoderTpl<FST, Token>::LookaheadCost(
+    StateId state, int32 frame) {
+  BaseFloat ans = 0.0;
+  if (graph_lookahead_ != NULL)
+    ans = config_.graph_lookahead_scale * graph_lookahead_->Cost(state);
+  if (config_.acoustic_lookahead_frames > 0 && decodable_ != NULL)
+    ans += AcousticLookaheadCost(state, frame);
+  return ans;
+}
+
+template <typename FST, typename Token>
+const BaseFloat *LatticeFasterDecoderTpl<FST, Token>::AcousticCostRow(
+    int32 t, BaseFloat *best_cost) {
+  int32 num_rows = config_.acoustic_lookahead_frames + 2,
+      num_indices = decodable_->NumIndices();
+  if (ac_cost_rows_.size() != static_cast<size_t>(num_rows) * num_indices) {
+    ac_cost_rows_.resize(static_cast<size_t>(num_rows) * num_indices);
+    ac_cost_row_frame_.assign(num_rows, -1);
+    ac_cost_row_best_.resize(num_rows);
+  }
+  int32 r = t % num_rows;
+  BaseFloat *row = &(ac_cost_rows_[static_cast<size_t>(r) * num_indices]);
+  if (ac_cost_row_frame_[r] != t) {
+    BaseFloat best = std::numeric_limits<BaseFloat>::infinity();
+    for (int32 i = 0; i < num_indices; i++) {
+      row[i] = -decodable_->LogLikelihood(t, i + 1);
+      best = std::min(best, row[i]);
+    }
+    ac_cost_row_frame_[r] = t;
+    ac_cost_row_best_[r] = best;
+  }
+  *best_cost = ac_cost_row_best_[r];
+  return row;
+}
+
+template <typename FST, typename Token>
+BaseFloat LatticeFasterDecoderTpl<FST, Token>::AcousticLookaheadCost(
+    StateId state, int32 frame) {
+  int32 i = frame % 2;
+  unordered_map<StateId, BaseFloat> &cache = ac_lookahead_cache_[i];
+  if (ac_lookahead_frame_[i] != frame) {
+    cache.clear();
+    ac_lookahead_frame_[i] = frame;
+    // Fix the number of frames we look at once per frame, so the lookahead
+    // costs of all tokens are comparable even if more frames become ready
+    // while we are decoding.
+    ac_lookahead_end_[i] = std::min(frame + config_.acoustic_lookahead_frames,
+                                    decodable_->NumFramesReady());
+  }
+  typename unordered_map<StateId, BaseFloat>::const_iterator iter =
+      cache.find(state);
+  if (iter != cache.end())
+    return iter->second;
+
+  const BaseFloat inf = std::numeric_limits<BaseFloat>::infinity();
+  BaseFloat ans = 0.0;
+  for (int32 t = frame; t < ac_lookahead_end_[i]; t++) {
+    BaseFloat best_cost = inf, best_frame_cost;
+    const BaseFloat *costs = AcousticCostRow(t, &best_frame_cost);
+    for (typename fst::DecoderArcIterators<FST>::Emitting aiter(*fst_, state);
+         !aiter.Done();
+         aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      if (arc.ilabel != 0)
+        best_cost = std::min(best_cost, costs[arc.ilabel - 1]);
+    }
+    // States with no emitting arcs (e.g. word-end states in HCLG) get zero,
+    // which is optimistic.
+    if (best_cost != inf)
+      ans += best_cost - best_frame_cost;
+  }
+  ans *= config_.acoustic_lookahead_scale;
+  cache[state] = ans;
+  return ans;
+}
+
+/// Gets the weight cutoff.  Also counts the active tokens.  The weights
+/// include LookaheadCost().
 template <typename FST, typename Token>
 BaseFloat LatticeFasterDecoderTpl<FST, Token>::GetCutoff(Elem *list_head, size_t *tok_count,
                                           BaseFloat *adaptive_beam, Elem **best_elem) {
+  // ProcessEmitting() has already added the TokenList for the next frame, so
+  // the frame the tokens in 'list_head' will consume is this:
+  int32 frame = NumFramesDecoded() - 1;
   BaseFloat best_weight = std::numeric_limits<BaseFloat>::infinity();
   // positive == high cost == bad.
   size_t count = 0;
   if (config_.max_active == std::numeric_limits<int32>::max() &&
       config_.min_active == 0) {
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
-      BaseFloat w = static_cast<BaseFloat>(e->val->tot_cost);
+      BaseFloat w = e->val->tot_cost + LookaheadCost(e->key, frame);
       if (w < best_weight) {
         best_weight = w;
         if (best_elem) *best_elem = e;
@@ -661,7 +780,7 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::GetCutoff(Elem *list_head, size_t
   } else {
     tmp_array_.clear();
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
-      BaseFloat w = e->val->tot_cost;
+      BaseFloat w = e->val->tot_cost + LookaheadCost(e->key, frame);
       tmp_array_.push_back(w);
       if (w < best_weight) {
         best_weight = w;
@@ -710,6 +829,37 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::GetCutoff(Elem *list_head, size_t
   }
 }
 
+template <typename FST, typename Token>
+void LatticeFasterDecoderTpl<FST, Token>::GatherAcousticCosts(
+    DecodableInterface *decodable, int32 frame, Elem *list_head,
+    BaseFloat cutoff) {
+  ac_indices_.clear();
+  for (Elem *e = list_head; e != NULL; e = e->tail) {
+    StateId state = e->key;
+    if (e->val->tot_cost + LookaheadCost(state, frame) > cutoff)
+      continue;  // ProcessEmitting() won't expand this token.
+    for (typename fst::DecoderArcIterators<FST>::Emitting aiter(*fst_, state);
+         !aiter.Done();
+         aiter.Next()) {
+      Label ilabel = aiter.Value().ilabel;
+      if (ilabel != 0) {
+        if (static_cast<size_t>(ilabel) >= ac_cost_frame_.size()) {
+          ac_cost_frame_.resize(ilabel + 1, -1);
+          ac_costs_.resize(ilabel + 1);
+        }
+        if (ac_cost_frame_[ilabel] != frame) {
+          ac_cost_frame_[ilabel] = frame;
+          ac_indices_.push_back(ilabel);
+        }
+      }
+    }
+  }
+  decodable->LogLikelihoods(frame, ac_indices_, &ac_loglikes_);
+  KALDI_ASSERT(ac_loglikes_.size() == ac_indices_.size());
+  for (size_t i = 0; i < ac_indices_.size(); i++)
+    ac_costs_[ac_indices_[i]] = -ac_loglikes_[i];
+}
+
 template <typename FST, typename Token>
 BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
     DecodableInterface *decodable) {
@@ -731,6 +881,15 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
 
   PossiblyResizeHash(tok_cnt);  // This makes sure the hash is always big enough.
 
+  if (config_.acoustic_lookahead_frames > 0) {
+    // The row for this frame was fetched (and cached) when it was the
+    // lookahead for earlier frames; so there's nothing to gather.
+    BaseFloat best_cost;
+    cur_ac_cost_row_ = AcousticCostRow(frame, &best_cost);
+  } else if (config_.batch_acoustic_scores) {
+    GatherAcousticCosts(decodable, frame, final_toks, cur_cutoff);
+  }
+
   BaseFloat next_cutoff = std::numeric_limits<BaseFloat>::infinity();
   // pruning "online" before having seen all tokens
 
@@ -745,13 +904,14 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
     StateId state = best_elem->key;
     Token *tok = best_elem->val;
     cost_offset = - tok->tot_cost;
-    for (fst::ArcIterator<FST> aiter(*fst_, state);
+    for (typename fst::DecoderArcIterators<FST>::Emitting aiter(*fst_, state);
          !aiter.Done();
          aiter.Next()) {
       const Arc &arc = aiter.Value();
       if (arc.ilabel != 0) {  // propagate..
-        BaseFloat new_weight = arc.weight.Value() + cost_offset -
-            decodable->LogLikelihood(frame, arc.ilabel) + tok->tot_cost;
+        BaseFloat new_weight = arc.weight.Value() + cost_offset +
+            AcousticCost(decodable, frame, arc.ilabel) + tok->tot_cost
+            + LookaheadCost(arc.nextstate, frame + 1);
         if (new_weight + adaptive_beam < next_cutoff)
           next_cutoff = new_weight + adaptive_beam;
       }
@@ -771,20 +931,22 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
     // loop this way because we delete "e" as we go.
     StateId state = e->key;
     Token *tok = e->val;
-    if (tok->tot_cost <= cur_cutoff) {
-      for (fst::ArcIterator<FST> aiter(*fst_, state);
+    if (tok->tot_cost + LookaheadCost(state, frame) <= cur_cutoff) {
+      for (typename fst::DecoderArcIterators<FST>::Emitting
+               aiter(*fst_, state);
            !aiter.Done();
            aiter.Next()) {
         const Arc &arc = aiter.Value();
         if (arc.ilabel != 0) {  // propagate..
-          BaseFloat ac_cost = cost_offset -
-              decodable->LogLikelihood(frame, arc.ilabel),
+          BaseFloat ac_cost = cost_offset +
+              AcousticCost(decodable, frame, arc.ilabel),
               graph_cost = arc.weight.Value(),
               cur_cost = tok->tot_cost,
-              tot_cost = cur_cost + ac_cost + graph_cost;
-          if (tot_cost >= next_cutoff) continue;
-          else if (tot_cost + adaptive_beam < next_cutoff)
-            next_cutoff = tot_cost + adaptive_beam; // prune by best current token
+              tot_cost = cur_cost + ac_cost + graph_cost,
+              prune_cost = tot_cost + LookaheadCost(arc.nextstate, frame + 1);
+          if (prune_cost >= next_cutoff) continue;
+          else if (prune_cost + adaptive_beam < next_cutoff)
+            next_cutoff = prune_cost + adaptive_beam; // prune by best current token
           // Note: the frame indexes into active_toks_ are one-based,
           // hence the + 1.
           Elem *e_next = FindOrAddToken(arc.nextstate,
@@ -800,6 +962,7 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
     e_tail = e->tail;
     toks_.Delete(e); // delete Elem
   }
+  cur_ac_cost_row_ = NULL;
   return next_cutoff;
 }
 
@@ -852,22 +1015,23 @@ void LatticeFasterDecoderTpl<FST, Token>::ProcessNonemitting(BaseFloat cutoff) {
     StateId state = e->key;
     Token *tok = e->val;  // would segfault if e is a NULL pointer but this can't happen.
     BaseFloat cur_cost = tok->tot_cost;
-    if (cur_cost >= cutoff) // Don't bother processing successors.
-      continue;
+    if (cur_cost + LookaheadCost(state, frame + 1) >= cutoff)
+      continue;  // Don't bother processing successors.
     // If "tok" has any existing forward links, delete them,
     // because we're about to regenerate them.  This is a kind
     // of non-optimality (remember, this is the simple decoder),
     // but since most states are emitting it's not a huge issue.
     DeleteForwardLinks(tok); // necessary when re-visiting
     tok->links = NULL;
-    for (fst::ArcIterator<FST> aiter(*fst_, state);
+    for (typename fst::DecoderArcIterators<FST>::Nonemitting
+             aiter(*fst_, state);
          !aiter.Done();
          aiter.Next()) {
       const Arc &arc = aiter.Value();
       if (arc.ilabel == 0) {  // propagate nonemitting only...
         BaseFloat graph_cost = arc.weight.Value(),
             tot_cost = cur_cost + graph_cost;
-        if (tot_cost < cutoff) {
+        if (tot_cost + LookaheadCost(arc.nextstate, frame + 1) < cutoff) {
           bool changed;
 
           Elem *e_new = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
@@ -999,12 +1163,16 @@ template class LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, decoder::StdT
 
 template class LatticeFasterDecoderTpl<fst::ConstGrammarFst, decoder::StdToken>;
 template class LatticeFasterDecoderTpl<fst::VectorGrammarFst, decoder::StdToken>;
+template class LatticeFasterDecoderTpl<fst::LmComposeFst, decoder::StdToken>;
+template class LatticeFasterDecoderTpl<fst::FlatFst, decoder::StdToken>;
 
 template class LatticeFasterDecoderTpl<fst::Fst<fst::StdArc> , decoder::BackpointerToken>;
 template class LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, decoder::BackpointerToken >;
 template class LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, decoder::BackpointerToken >;
 template class LatticeFasterDecoderTpl<fst::ConstGrammarFst, decoder::BackpointerToken>;
 template class LatticeFasterDecoderTpl<fst::VectorGrammarFst, decoder::BackpointerToken>;
+template class LatticeFasterDecoderTpl<fst::LmComposeFst, decoder::BackpointerToken>;
+template class LatticeFasterDecoderTpl<fst::FlatFst, decoder::BackpointerToken>;
 
 
 } // end namespace kaldi.
@@ -32,6 +32,9 @@
 #include "lat/determinize-lattice-pruned.h"
 #include "lat/kaldi-lattice.h"
 #include "decoder/grammar-fst.h"
+#include "decoder/graph-lookahead.h"
+#include "decoder/lm-compose-fst.h"
+#include "decoder/flat-fst.h"
 
 namespace kaldi {
 
@@ -50,6 +53,16 @@ struct LatticeFasterDecoderConfig {
   // tokens as we go.
   BaseFloat prune_scale;
 
+  // Options for lookahead in pruning; see SetGraphLookahead() and
+  // AcousticLookaheadCost() in LatticeFasterDecoderTpl.
+  BaseFloat graph_lookahead_scale;
+  int32 acoustic_lookahead_frames;
+  BaseFloat acoustic_lookahead_scale;
+
+  // If true, ProcessEmitting() gets all the acoustic scores for a frame with
+  // one call to DecodableInterface::LogLikelihoods().
+  bool batch_acoustic_scores;
+
   // Most of the options inside det_opts are not actually queried by the
   // LatticeFasterDecoder class itself, but by the code that calls it, for
   // example in the function DecodeUtteranceLatticeFaster.
@@ -63,7 +76,11 @@ struct LatticeFasterDecoderConfig {
                                 determinize_lattice(true),
                                 beam_delta(0.5),
                                 hash_ratio(2.0),
-                                prune_scale(0.1) { }
+                                prune_scale(0.1),
+                                graph_lookahead_scale(1.0),
+                                acoustic_lookahead_frames(0),
+                                acoustic_lookahead_scale(1.0),
+                                batch_acoustic_scores(false) { }
   void Register(OptionsItf *opts) {
     det_opts.Register(opts);
     opts->Register("beam", &beam, "Decoding beam.  Larger->slower, more accurate.");
@@ -82,12 +99,34 @@ struct LatticeFasterDecoderConfig {
                    "max-active constraint is applied.  Larger is more accurate.");
     opts->Register("hash-ratio", &hash_ratio, "Setting used in decoder to "
                    "control hash behavior");
+    opts->Register("graph-lookahead-scale", &graph_lookahead_scale, "Scale on "
+                   "the best future graph cost of each state that is added to "
+                   "token costs for pruning, if a graph-lookahead table is "
+                   "supplied (see compute-graph-lookahead).");
+    opts->Register("acoustic-lookahead-frames", &acoustic_lookahead_frames,
+                   "If >0, number of future frames whose best acoustic cost "
+                   "from each token's state is added to token costs for "
+                   "pruning.  The log-likelihoods of all indices on each "
+                   "of those frames are fetched once and cached, so this "
+                   "costs one full row of the acoustic model per frame.");
+    opts->Register("acoustic-lookahead-scale", &acoustic_lookahead_scale,
+                   "Scale on the acoustic lookahead cost (see "
+                   "--acoustic-lookahead-frames).");
+    opts->Register("batch-acoustic-scores", &batch_acoustic_scores, "If true, "
+                   "on each frame first collect the distinct input labels of "
+                   "the arcs to be expanded and get their acoustic scores in "
+                   "one call to the decodable object, which helps with models "
+                   "(e.g. GMMs) that can compute the needed pdfs together.  "
+                   "Has no effect with --acoustic-lookahead-frames > 0.");
   }
   void Check() const {
     KALDI_ASSERT(beam > 0.0 && max_active > 1 && lattice_beam > 0.0
                  && min_active <= max_active
                  && prune_interval > 0 && beam_delta > 0.0 && hash_ratio >= 1.0
-                 && prune_scale > 0.0 && prune_scale < 1.0);
+                 && prune_scale > 0.0 && prune_scale < 1.0
+                 && graph_lookahead_scale >= 0.0
+                 && acoustic_lookahead_frames >= 0
+                 && acoustic_lookahead_scale >= 0.0);
   }
 };
 
@@ -219,8 +258,8 @@ struct BackpointerToken {
    quick lookup of the current best path (see lattice-faster-online-decoder.h)
 
    The FST you invoke this decoder which is expected to equal
-   Fst::Fst<fst::StdArc>, a.k.a. StdFst, or GrammarFst.  If you invoke it with
-   FST == StdFst and it notices that the actual FST type is
+   Fst::Fst<fst::StdArc>, a.k.a. StdFst, GrammarFst, LmComposeFst or FlatFst.
+   If you invoke it with FST == StdFst and it notices that the actual FST type is
    fst::VectorFst<fst::StdArc> or fst::ConstFst<fst::StdArc>, the decoder object
    will internally cast itself to one that is templated on those more specific
    types; this is an optimization for speed.
@@ -253,6 +292,16 @@ class LatticeFasterDecoderTpl {
     return config_;
   }
 
+  /// Sets a table of best future graph costs per state (see graph-lookahead.h),
+  /// which must have been computed from the FST we are decoding with.  Costs
+  /// from it, times config.graph_lookahead_scale, are added to token costs
+  /// whenever we compare them with a pruning cutoff; they do not affect the
+  /// costs in the lattice.  Does not take ownership; NULL turns this off.
+  /// Not meaningful for GrammarFst.
+  void SetGraphLookahead(const GraphLookahead *lookahead) {
+    graph_lookahead_ = lookahead;
+  }
+
   ~LatticeFasterDecoderTpl();
 
   /// Decodes until there are no more frames left in the "decodable" object..
@@ -306,6 +355,9 @@ class LatticeFasterDecoderTpl {
   /// intend to call AdvanceDecoding().  If you call Decode(), you don't need to
   /// call this.  You can also call InitDecoding if you have already decoded an
   /// utterance and want to start with a new utterance.
+  /// With --acoustic-lookahead-frames > 0, the expansion of the start state's
+  /// epsilon arcs waits for the first AdvanceDecoding() call that has frames
+  /// ready, so until then the partial results only contain the start state.
   void InitDecoding();
 
   /// This will decode until there are no more frames ready in the decodable
@@ -435,6 +487,57 @@ class LatticeFasterDecoderTpl {
   // less far.
   void PruneActiveTokens(BaseFloat delta);
 
+  /// Returns the cost that is added to the tot_cost of a token in state
+  /// 'state' when it is compared with a pruning cutoff: the graph lookahead
+  /// cost, if SetGraphLookahead() was called, plus AcousticLookaheadCost().
+  /// 'frame' is the next frame the token will consume.  Zero when no
+  /// lookahead is configured.
+  inline BaseFloat LookaheadCost(StateId state, int32 frame);
+
+  /// Returns acoustic_lookahead_scale times the sum, over the next
+  /// acoustic_lookahead_frames frames starting at 'frame', of the best acoustic
+  /// cost of any emitting arc leaving 'state', relative to the best acoustic
+  /// cost of any index on that frame.  It assumes the token keeps using the
+  /// arcs of its current state (in HCLG these are normally the self-loop and
+  /// the transitions to the next HMM-states), so it is not a strict lower
+  /// bound; acoustic_lookahead_scale controls how much we trust it.  Values
+  /// are cached per (frame, state).
+  BaseFloat AcousticLookaheadCost(StateId state, int32 frame);
+
+  /// Used with acoustic lookahead: returns the acoustic costs (negated
+  /// log-likelihoods) of all indices on frame 't', indexed by the index minus
+  /// one, and sets *best_cost to the lowest of them.  Each frame is fetched
+  /// from the decodable object once, the first time it is needed, and kept
+  /// while it may still be needed, and ProcessEmitting() takes its acoustic
+  /// costs from here too; so the decodable object is accessed in order of
+  /// increasing frame, which matters for decodables that only keep the
+  /// output of one chunk (e.g. DecodableNnetSimple).
+  const BaseFloat *AcousticCostRow(int32 t, BaseFloat *best_cost);
+
+  /// Does the ProcessNonemitting() for the start of the utterance, which
+  /// InitDecoding() defers to the first AdvanceDecoding() call that has frames
+  /// ready (or to FinalizeDecoding()) when acoustic lookahead is enabled, so
+  /// that the start state's tokens are pruned with the same lookahead costs
+  /// as all the others.
+  void ProcessInitialNonemitting();
+
+  /// Used if config_.batch_acoustic_scores: collects the distinct input labels
+  /// of the emitting arcs leaving the tokens in 'list_head' that are within
+  /// 'cutoff', gets their log-likelihoods on frame 'frame' with one call to
+  /// decodable->LogLikelihoods(), and puts their negations in ac_costs_.
+  void GatherAcousticCosts(DecodableInterface *decodable, int32 frame,
+                           Elem *list_head, BaseFloat cutoff);
+
+  /// Returns the acoustic cost (negated log-likelihood) of 'ilabel' on 'frame',
+  /// which must be the frame ProcessEmitting() is processing.
+  inline BaseFloat AcousticCost(DecodableInterface *decodable, int32 frame,
+                                Label ilabel) {
+    if (cur_ac_cost_row_ != NULL)
+      return cur_ac_cost_row_[ilabel - 1];
+    return config_.batch_acoustic_scores ? ac_costs_[ilabel] :
+        -decodable->LogLikelihood(frame, ilabel);
+  }
+
   /// Gets the weight cutoff.  Also counts the active tokens.
   BaseFloat GetCutoff(Elem *list_head, size_t *tok_count,
                       BaseFloat *adaptive_beam, Elem **best_elem);
@@ -475,6 +578,42 @@ class LatticeFasterDecoderTpl {
   // frame in order to keep everything in a nice dynamic range i.e.  close to
   // zero, to reduce roundoff errors.
   LatticeFasterDecoderConfig config_;
+
+  // Table of best future graph costs; not owned, may be NULL.
+  const GraphLookahead *graph_lookahead_;
+  // The decodable object we are decoding from; only non-NULL inside
+  // AdvanceDecoding(), and used only for acoustic lookahead.
+  DecodableInterface *decodable_;
+  // Caches for AcousticLookaheadCost(), indexed by frame % 2 (we need the
+  // current and the next frame at the same time).  ac_lookahead_frame_ is the
+  // frame each cache is for, and ac_lookahead_end_ one past the last frame
+  // it looks at.
+  unordered_map<StateId, BaseFloat> ac_lookahead_cache_[2];
+  int32 ac_lookahead_frame_[2];
+  int32 ac_lookahead_end_[2];
+  // Used by AcousticCostRow(): a ring of acoustic_lookahead_frames + 2 rows,
+  // frame t being in row t % num-rows, each row having NumIndices() elements.
+  // ac_cost_row_frame_ is the frame each row holds (-1 if none) and
+  // ac_cost_row_best_ its lowest cost.
+  std::vector<BaseFloat> ac_cost_rows_;
+  std::vector<int32> ac_cost_row_frame_;
+  std::vector<BaseFloat> ac_cost_row_best_;
+  // Inside ProcessEmitting() with acoustic lookahead, the AcousticCostRow()
+  // of the frame being processed; NULL otherwise.
+  const BaseFloat *cur_ac_cost_row_;
+  // True if InitDecoding() has deferred the ProcessNonemitting() for the start
+  // state; see ProcessInitialNonemitting().  Until it's done, the only token
+  // is the one for the start state.
+  bool initial_nonemitting_pending_;
+
+  // Used by GatherAcousticCosts(), indexed by input label: the acoustic cost,
+  // and the frame it was computed for (-1 if none).
+  std::vector<BaseFloat> ac_costs_;
+  std::vector<int32> ac_cost_frame_;
+  // Temporaries used in GatherAcousticCosts().
+  std::vector<int32> ac_indices_;
+  std::vector<BaseFloat> ac_loglikes_;
+
   int32 num_toks_; // current total #toks allocated...
   bool warned_;
 
@@ -280,6 +280,8 @@ template class LatticeFasterOnlineDecoderTpl<fst::VectorFst<fst::StdArc> >;
 template class LatticeFasterOnlineDecoderTpl<fst::ConstFst<fst::StdArc> >;
 template class LatticeFasterOnlineDecoderTpl<fst::ConstGrammarFst >;
 template class LatticeFasterOnlineDecoderTpl<fst::VectorGrammarFst >;
+template class LatticeFasterOnlineDecoderTpl<fst::LmComposeFst >;
+template class LatticeFasterOnlineDecoderTpl<fst::FlatFst >;
 
 
 } // end namespace kaldi.
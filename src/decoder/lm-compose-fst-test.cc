@@ -0,0 +1,155 @@
+// decoder/lm-compose-fst-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/lm-compose-fst.h"
+#include "decoder/lattice-faster-decoder.h"
+#include "decoder/decodable-matrix.h"
+#include "fstext/fstext-utils.h"
+#include "lat/kaldi-lattice.h"
+
+namespace kaldi {
+
+using fst::StdArc;
+
+// Behaves like ConstArpaLmDeterministicFst on an LM with <unk>: words that
+// 'fst' has no arc for get the arc for 'unk'.
+class UnkMappingLm: public fst::DeterministicOnDemandFst<StdArc> {
+ public:
+  UnkMappingLm(const fst::Fst<StdArc> &fst, int32 unk): lm_(fst), unk_(unk) { }
+  virtual StateId Start() { return lm_.Start(); }
+  virtual Weight Final(StateId s) { return lm_.Final(s); }
+  virtual bool GetArc(StateId s, Label word, StdArc *oarc) {
+    if (lm_.GetArc(s, word, oarc))
+      return true;
+    if (!lm_.GetArc(s, unk_, oarc))
+      return false;
+    oarc->ilabel = oarc->olabel = word;
+    return true;
+  }
+ private:
+  fst::BackoffDeterministicOnDemandFst<StdArc> lm_;
+  int32 unk_;
+};
+
+// Makes a random HCL whose input labels are 1..num_indices and output labels
+// are words 1..num_words.  Every state has an emitting self-loop, epsilon arcs
+// only go to higher-numbered states, and some states have the epsilon:#0
+// self-loop that L_disambig.fst gives HCL, #0 being word num_words + 1.
+static void RandomHcl(int32 num_indices, int32 num_words,
+                      fst::StdVectorFst *hcl) {
+  hcl->DeleteStates();
+  int32 num_states = RandInt(2, 8), disambig_word = num_words + 1;
+  for (int32 s = 0; s < num_states; s++)
+    hcl->AddState();
+  hcl->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    hcl->AddArc(s, StdArc(RandInt(1, num_indices), 0, RandUniform(), s));
+    if (RandInt(0, 2) == 0)
+      hcl->AddArc(s, StdArc(0, disambig_word, 0.0, s));
+    int32 num_arcs = RandInt(1, 4);
+    for (int32 a = 0; a < num_arcs; a++) {
+      int32 next_state = RandInt(0, num_states - 1),
+          ilabel = RandInt(1, num_indices),
+          olabel = (RandInt(0, 1) == 0 ? 0 : RandInt(1, num_words));
+      if (next_state > s && RandInt(0, 3) == 0)
+        ilabel = 0;
+      hcl->AddArc(s, StdArc(ilabel, olabel, RandUniform(), next_state));
+    }
+    if (s == num_states - 1 || RandInt(0, 2) == 0)
+      hcl->SetFinal(s, RandUniform());
+  }
+}
+
+// Makes a random deterministic acceptor with an arc for each of the words
+// 1..num_words and 'unk' on each state and no backoff arcs, so that on-demand
+// lookup and static composition agree.
+static void RandomLm(int32 num_words, int32 unk, fst::StdVectorFst *g) {
+  g->DeleteStates();
+  int32 num_states = RandInt(1, 4);
+  for (int32 s = 0; s < num_states; s++)
+    g->AddState();
+  g->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    for (int32 w = 1; w <= num_words + 1; w++) {
+      int32 word = (w <= num_words ? w : unk);
+      g->AddArc(s, StdArc(word, word, 2.0 * RandUniform(),
+                          RandInt(0, num_states - 1)));
+    }
+    g->SetFinal(s, RandUniform());
+  }
+}
+
+template <typename FST>
+static BaseFloat DecodeBestPath(const FST &fst,
+                                const Matrix<BaseFloat> &loglikes,
+                                std::vector<int32> *words) {
+  LatticeFasterDecoderConfig config;
+  config.beam = 1000.0;
+  config.lattice_beam = 10.0;
+  LatticeFasterDecoderTpl<FST> decoder(fst, config);
+  DecodableMatrixScaled decodable(loglikes, 1.0);
+  KALDI_ASSERT(decoder.Decode(&decodable));
+  Lattice best_path;
+  KALDI_ASSERT(decoder.GetBestPath(&best_path));
+  std::vector<int32> alignment;
+  LatticeWeight weight;
+  fst::GetLinearSymbolSequence(best_path, &alignment, words, &weight);
+  KALDI_ASSERT(alignment.size() == static_cast<size_t>(loglikes.NumRows()));
+  return weight.Value1() + weight.Value2();
+}
+
+// Checks that decoding with LmComposeFst gives the same best path as decoding
+// with HCLG composed statically, and that #0 is not output even though the LM
+// maps unknown words to <unk>.
+void UnitTestLmComposeFst() {
+  int32 num_indices = RandInt(1, 8), num_words = RandInt(1, 6),
+      disambig_word = num_words + 1, unk = num_words + 2,
+      num_frames = RandInt(1, 20);
+  fst::StdVectorFst hcl, g, hclg;
+  RandomHcl(num_indices, num_words, &hcl);
+  RandomLm(num_words, unk, &g);
+  fst::ArcSort(&g, fst::ILabelCompare<StdArc>());
+  fst::ArcSort(&hcl, fst::OLabelCompare<StdArc>());
+  // We don't connect HCLG, so that it has the same dead ends as LmComposeFst
+  // and we get the same partial paths if no final state is reached.
+  fst::Compose(hcl, g, &hclg, fst::ComposeOptions(false));
+
+  fst::ConstFst<StdArc> hcl_const(hcl), g_const(g);
+  UnkMappingLm lm(g_const, unk);
+  fst::LmComposeFst compose_fst(hcl_const, &lm,
+                                std::vector<int32>(1, disambig_word));
+
+  Matrix<BaseFloat> loglikes(num_frames, num_indices);
+  loglikes.SetRandn();
+  std::vector<int32> words1, words2;
+  BaseFloat cost1 = DecodeBestPath(hclg, loglikes, &words1),
+      cost2 = DecodeBestPath(compose_fst, loglikes, &words2);
+  for (size_t i = 0; i < words2.size(); i++)
+    KALDI_ASSERT(words2[i] != disambig_word && words2[i] != unk);
+  KALDI_ASSERT(words1 == words2);
+  AssertEqual(cost1, cost2, 1.0e-04);
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 50; i++)
+    UnitTestLmComposeFst();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,225 @@
+// decoder/lm-compose-fst.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_LM_COMPOSE_FST_H_
+#define KALDI_DECODER_LM_COMPOSE_FST_H_
+
+/**
+   This header implements LmComposeFst, an FST-like object that represents
+   HCL composed with a language model G, where the composition is done on the
+   fly as the decoder visits states.  Like GrammarFst (see grammar-fst.h) it
+   does not inherit from class Fst; it just has enough of the same interface
+   for LatticeFasterDecoderTpl to be instantiated with it.
+
+   Compared with decoding with a full HCLG, memory scales with the size of HCL
+   plus G, and the language model can be swapped without rebuilding the graph;
+   compared with OpenFst's lookahead composition (nnet3-latgen-faster-lookahead)
+   it needs no OpenFst extension and the per-arc work is a lookup in G.  Note
+   that there is no weight pushing across the composition: the LM cost of a
+   word is only added when HCL outputs the word, so somewhat wider beams are
+   needed than with HCLG.
+ */
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "fst/fstlib.h"
+#include "fstext/deterministic-fst.h"
+
+namespace fst {
+
+// LmComposeFstArc is as StdArc except that the state-id is 64 bits: the state
+// in the LM in the higher 32 bits and the state in HCL in the lower 32 bits.
+// The decoder stores states in hashes, not arrays, so the large numbers are not
+// a problem.
+struct LmComposeFstArc {
+  typedef fst::TropicalWeight Weight;
+  typedef int Label;  // OpenFst's StdArc uses int; this is for compatibility.
+  typedef int64 StateId;
+
+  Label ilabel;
+  Label olabel;
+  Weight weight;
+  StateId nextstate;
+
+  LmComposeFstArc() {}
+
+  LmComposeFstArc(Label ilabel, Label olabel, Weight weight, StateId nextstate)
+      : ilabel(ilabel),
+        olabel(olabel),
+        weight(std::move(weight)),
+        nextstate(nextstate) {}
+};
+
+class LmComposeFst;
+
+// Declare that we'll be overriding class ArcIterator for class LmComposeFst.
+template <> class ArcIterator<LmComposeFst>;
+
+/**
+   LmComposeFst is the composition of 'hcl', whose input labels are
+   transition-ids (disambiguation symbols removed) and output labels are words,
+   with the language model 'lm', whose states are the LM histories.
+
+   'lm' is normally a CacheDeterministicOnDemandFst (which memoizes the arcs we
+   look up) wrapping either a BackoffDeterministicOnDemandFst on an
+   ilabel-sorted ConstFst G whose backoff arcs have epsilon input (i.e. G.fst
+   projected on its output), or a ConstArpaLmDeterministicFst.  Arcs of 'hcl'
+   whose word is in 'disambig_words' (normally just #0, whose self-loops come
+   from L_disambig.fst; see phones/wdisambig_words.int), or whose word 'lm' has
+   no arc for, are dropped.  'disambig_words' matters for LMs that accept
+   every word, such as a ConstArpaLm with <unk>, which would otherwise give #0
+   the cost of <unk> and put it in the output.
+
+   Because 'lm' has internal state, this object is not thread-safe; copies are
+   cheap and share 'hcl' and 'lm', so for several threads give each its own
+   'lm' object and its own copy.
+ */
+class LmComposeFst {
+ public:
+  typedef LmComposeFstArc Arc;
+  typedef TropicalWeight Weight;
+  typedef Arc::StateId StateId;  // int64
+  typedef StdArc::StateId BaseStateId;  // int
+  typedef Arc::Label Label;
+
+  /// Does not take ownership of 'hcl' or 'lm'.
+  LmComposeFst(const ConstFst<StdArc> &hcl,
+               DeterministicOnDemandFst<StdArc> *lm,
+               const std::vector<int32> &disambig_words =
+               std::vector<int32>()):
+      hcl_(&hcl), lm_(lm) {
+    KALDI_ASSERT(hcl.Start() != kNoStateId && lm->Start() != kNoStateId);
+    for (size_t i = 0; i < disambig_words.size(); i++) {
+      int32 word = disambig_words[i];
+      KALDI_ASSERT(word > 0);
+      if (static_cast<size_t>(word) >= is_disambig_.size())
+        is_disambig_.resize(word + 1, false);
+      is_disambig_[word] = true;
+    }
+  }
+
+  StateId Start() const {
+    return PairState(hcl_->Start(), lm_->Start());
+  }
+
+  Weight Final(StateId s) const {
+    Weight ans = hcl_->Final(HclState(s));
+    if (ans == Weight::Zero())
+      return ans;
+    return Times(ans, lm_->Final(LmState(s)));
+  }
+
+  // This is called in LatticeFasterDecoder, which only needs to know whether
+  // it is nonzero, so we don't subtract the arcs that ArcIterator would drop.
+  inline size_t NumInputEpsilons(StateId s) const {
+    return hcl_->NumInputEpsilons(HclState(s));
+  }
+
+  inline std::string Type() const { return "lm-compose"; }
+
+  static inline StateId PairState(BaseStateId hcl_state,
+                                  BaseStateId lm_state) {
+    return (static_cast<int64>(lm_state) << 32) |
+        static_cast<uint32>(hcl_state);
+  }
+  // It's important to explicitly say int32 below, not BaseStateId == int,
+  // which might on some compilers be a 64-bit type.
+  static inline BaseStateId HclState(StateId s) {
+    return static_cast<int32>(s);
+  }
+  static inline BaseStateId LmState(StateId s) {
+    return static_cast<int32>(s >> 32);
+  }
+
+ private:
+  friend class ArcIterator<LmComposeFst>;
+
+  inline bool IsDisambigWord(Label word) const {
+    return static_cast<size_t>(word) < is_disambig_.size() &&
+        is_disambig_[word];
+  }
+
+  const ConstFst<StdArc> *hcl_;
+  DeterministicOnDemandFst<StdArc> *lm_;
+  // Indexed by word-id; true for the words whose arcs we drop.
+  std::vector<bool> is_disambig_;
+};
+
+
+/**
+   This is the overridden template for class ArcIterator for LmComposeFst.  As
+   for GrammarFst, it only implements what the decoder needs.  We do the work
+   of finding the next arc in Done(), which the calling code always calls
+   before Value(); this is where the arcs with disambiguation symbols and the
+   arcs that the LM does not accept are skipped.
+ */
+template <>
+class ArcIterator<LmComposeFst> {
+ public:
+  using Arc = LmComposeFst::Arc;
+  using StateId = Arc::StateId;  // int64
+
+  inline ArcIterator(const LmComposeFst &fst, StateId s):
+      fst_(&fst), lm_(fst.lm_), lm_state_(LmComposeFst::LmState(s)),
+      i_(0) {
+    fst.hcl_->InitArcIterator(LmComposeFst::HclState(s), &data_);
+  }
+
+  inline bool Done() {
+    for (; i_ < data_.narcs; i_++) {
+      const StdArc &src = data_.arcs[i_];
+      arc_.ilabel = src.ilabel;
+      arc_.olabel = src.olabel;
+      if (src.olabel == 0) {
+        arc_.weight = src.weight;
+        arc_.nextstate = LmComposeFst::PairState(src.nextstate, lm_state_);
+        return false;
+      }
+      StdArc lm_arc;
+      if (!fst_->IsDisambigWord(src.olabel) &&
+          lm_->GetArc(lm_state_, src.olabel, &lm_arc)) {
+        arc_.weight = Times(src.weight, lm_arc.weight);
+        arc_.nextstate = LmComposeFst::PairState(src.nextstate,
+                                                 lm_arc.nextstate);
+        return false;
+      }
+    }
+    return true;
+  }
+
+  inline void Next() { i_++; }
+
+  inline const Arc &Value() const { return arc_; }
+
+ private:
+  const LmComposeFst *fst_;
+  DeterministicOnDemandFst<StdArc> *lm_;
+  LmComposeFst::BaseStateId lm_state_;
+
+  // The members of 'data_' that we use are:
+  //  const Arc *arcs;
+  //  size_t narcs;
+  ArcIteratorData<StdArc> data_;
+  size_t i_;  // index into data_.arcs.
+
+  Arc arc_;  // The current arc, set up by Done().
+};
+
+}  // namespace fst
+
+#endif  // KALDI_DECODER_LM_COMPOSE_FST_H_
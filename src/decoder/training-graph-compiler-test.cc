@@ -0,0 +1,144 @@
+// decoder/training-graph-compiler-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/training-graph-compiler.h"
+#include "fstext/fstext-utils.h"
+#include "hmm/hmm-test-utils.h"
+
+namespace kaldi {
+
+using fst::StdArc;
+using fst::VectorFst;
+
+// Makes a lexicon FST with words 1..num_words, each of which has a random
+// pronunciation of 1 to 3 phones; the word label is on the first arc.
+static VectorFst<StdArc> *RandomLexicon(const std::vector<int32> &phones,
+                                        int32 num_words) {
+  VectorFst<StdArc> *lex_fst = new VectorFst<StdArc>();
+  int32 loop_state = lex_fst->AddState();
+  lex_fst->SetStart(loop_state);
+  lex_fst->SetFinal(loop_state, StdArc::Weight::One());
+  for (int32 word = 1; word <= num_words; word++) {
+    int32 num_phones = RandInt(1, 3), cur_state = loop_state;
+    for (int32 p = 0; p < num_phones; p++) {
+      int32 phone = phones[RandInt(0, phones.size() - 1)],
+          next_state = (p + 1 == num_phones ? loop_state :
+                        lex_fst->AddState());
+      lex_fst->AddArc(cur_state, StdArc(phone, (p == 0 ? word : 0),
+                                        StdArc::Weight::One(), next_state));
+      cur_state = next_state;
+    }
+  }
+  return lex_fst;
+}
+
+static bool GraphsEquivalent(const VectorFst<StdArc> &fst1,
+                             const VectorFst<StdArc> &fst2) {
+  return fst::RandEquivalent(fst1, fst2, 5 /*paths*/, 0.01 /*delta*/,
+                             kaldi::Rand() /*seed*/, 100 /*path length*/);
+}
+
+// Checks that CompileGraphsFromText() and CompileGraphs() give graphs
+// equivalent to compiling each transcript on its own, for batches with
+// repeated transcripts, with 1 and 4 threads and with and without the
+// transcript cache.  The graphs can't be compared with fst::Equal(), because
+// the numbering of the context-dependent phones, and hence the state
+// numbering, depends on which other graphs a thread has compiled.
+void UnitTestTrainingGraphCompiler() {
+  ContextDependency *ctx_dep;
+  TransitionModel *trans_model = GenRandTransitionModel(&ctx_dep);
+  int32 num_words = RandInt(1, 10);
+  VectorFst<StdArc> *lex_fst = RandomLexicon(trans_model->GetPhones(),
+                                             num_words);
+  std::vector<int32> disambig_syms;
+
+  int32 num_transcripts = RandInt(1, 5);
+  std::vector<std::vector<int32> > transcripts(num_transcripts);
+  std::vector<VectorFst<StdArc> > ref_graphs(num_transcripts);
+  {
+    TrainingGraphCompilerOptions opts;
+    TrainingGraphCompiler compiler(*trans_model, *ctx_dep,
+                                   new VectorFst<StdArc>(*lex_fst),
+                                   disambig_syms, opts);
+    for (int32 i = 0; i < num_transcripts; i++) {
+      int32 length = RandInt(1, 4);
+      for (int32 j = 0; j < length; j++)
+        transcripts[i].push_back(RandInt(1, num_words));
+      KALDI_ASSERT(compiler.CompileGraphFromText(transcripts[i],
+                                                 &(ref_graphs[i])));
+    }
+  }
+
+  for (int32 num_threads = 1; num_threads <= 4; num_threads += 3) {
+    for (int32 cache_size = 0; cache_size <= 2; cache_size += 2) {
+      TrainingGraphCompilerOptions opts;
+      opts.num_threads = num_threads;
+      opts.transcript_cache_size = cache_size;
+      TrainingGraphCompiler compiler(*trans_model, *ctx_dep,
+                                     new VectorFst<StdArc>(*lex_fst),
+                                     disambig_syms, opts);
+      // The second batch may find some of its transcripts in the cache.
+      for (int32 batch = 0; batch < 2; batch++) {
+        int32 batch_size = RandInt(1, 10);
+        std::vector<int32> transcript_index(batch_size);
+        std::vector<std::vector<int32> > batch_transcripts(batch_size);
+        std::vector<const VectorFst<StdArc>*> word_fsts(batch_size);
+        for (int32 i = 0; i < batch_size; i++) {
+          transcript_index[i] = RandInt(0, num_transcripts - 1);
+          batch_transcripts[i] = transcripts[transcript_index[i]];
+          VectorFst<StdArc> *word_fst = new VectorFst<StdArc>();
+          fst::MakeLinearAcceptor(batch_transcripts[i], word_fst);
+          word_fsts[i] = word_fst;
+        }
+
+        std::vector<VectorFst<StdArc>*> text_graphs, graphs;
+        KALDI_ASSERT(compiler.CompileGraphsFromText(batch_transcripts,
+                                                    &text_graphs));
+        KALDI_ASSERT(compiler.CompileGraphs(word_fsts, &graphs));
+        KALDI_ASSERT(text_graphs.size() == static_cast<size_t>(batch_size) &&
+                     graphs.size() == static_cast<size_t>(batch_size));
+        for (int32 i = 0; i < batch_size; i++) {
+          const VectorFst<StdArc> &ref_graph =
+              ref_graphs[transcript_index[i]];
+          KALDI_ASSERT(GraphsEquivalent(*(text_graphs[i]), ref_graph));
+          KALDI_ASSERT(GraphsEquivalent(*(graphs[i]), ref_graph));
+          // Repeats of a transcript within a batch are copies of the same
+          // graph.
+          for (int32 j = 0; j < i; j++)
+            if (transcript_index[j] == transcript_index[i])
+              KALDI_ASSERT(fst::Equal(*(text_graphs[i]), *(text_graphs[j])));
+        }
+        DeletePointers(&word_fsts);
+        DeletePointers(&text_graphs);
+        DeletePointers(&graphs);
+      }
+    }
+  }
+  delete lex_fst;
+  delete trans_model;
+  delete ctx_dep;
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++)
+    UnitTestTrainingGraphCompiler();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -17,6 +17,7 @@
 // MERCHANTABLITY OR NON-INFRINGEMENT.
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
+#include <thread>
 #include "decoder/training-graph-compiler.h"
 #include "hmm/hmm-utils.h" // for GetHTransducer
 
@@ -29,7 +30,8 @@ TrainingGraphCompiler::TrainingGraphCompiler(const TransitionModel &trans_model,
                                              const std::vector<int32> &disambig_syms,
                                              const TrainingGraphCompilerOptions &opts):
     trans_model_(trans_model), ctx_dep_(ctx_dep), lex_fst_(lex_fst),
-    disambig_syms_(disambig_syms), opts_(opts) {
+    disambig_syms_(disambig_syms), opts_(opts),
+    num_cache_lookups_(0), num_cache_hits_(0) {
   using namespace fst;
   const std::vector<int32> &phone_syms = trans_model_.GetPhones();  // needed to create context fst.
 
@@ -59,12 +61,38 @@ TrainingGraphCompiler::TrainingGraphCompiler(const TransitionModel &trans_model,
     fst::OLabelCompare<fst::StdArc> olabel_comp;
     fst::ArcSort(lex_fst_, olabel_comp);
   }
+  // Work out all the lexicon's properties now, as it will be shared between
+  // threads in CompileGraphs() and we don't want them computed (and stored)
+  // concurrently.
+  lex_fst_->Properties(fst::kFstProperties, true);
+
+  for (int32 t = 1; t < opts_.num_threads; t++)
+    thread_lex_caches_.push_back(new LexCache());
+}
+
+TrainingGraphCompiler::~TrainingGraphCompiler() {
+  if (num_cache_lookups_ > 0)
+    KALDI_LOG << "Training-graph cache: " << num_cache_hits_ << " hits out of "
+              << num_cache_lookups_ << " lookups.";
+  for (TranscriptCache::iterator iter = transcript_cache_.begin();
+       iter != transcript_cache_.end(); ++iter)
+    delete iter->second.fst;
+  DeletePointers(&thread_lex_caches_);
+  delete lex_fst_;
 }
 
 bool TrainingGraphCompiler::CompileGraphFromText(
     const std::vector<int32> &transcript,
     fst::VectorFst<fst::StdArc> *out_fst) {
   using namespace fst;
+  if (opts_.transcript_cache_size > 0) {
+    std::vector<std::vector<int32> > transcripts(1, transcript);
+    std::vector<VectorFst<StdArc>*> out_fsts;
+    bool ans = CompileGraphsFromText(transcripts, &out_fsts);
+    *out_fst = *(out_fsts[0]);
+    delete out_fsts[0];
+    return ans;
+  }
   VectorFst<StdArc> word_fst;
   MakeLinearAcceptor(transcript, &word_fst);
   return CompileGraph(word_fst, out_fst);
@@ -146,18 +174,87 @@ bool TrainingGraphCompiler::CompileGraphsFromText(
     const std::vector<std::vector<int32> > &transcripts,
     std::vector<fst::VectorFst<fst::StdArc>*> *out_fsts) {
   using namespace fst;
-  std::vector<const VectorFst<StdArc>* > word_fsts(transcripts.size());
+  KALDI_ASSERT(out_fsts != NULL && out_fsts->empty());
+  out_fsts->resize(transcripts.size(), NULL);
+
+  // Work out which distinct transcripts need compiling; to_compile[j] is the
+  // j'th of these, and output_indexes[j] the positions in 'transcripts' at
+  // which it appears.
+  typedef std::unordered_map<std::vector<int32>, size_t,
+                             VectorHasher<int32> > IndexMap;
+  std::vector<const std::vector<int32>*> to_compile;
+  std::vector<std::vector<size_t> > output_indexes;
+  IndexMap transcript_to_index;
   for (size_t i = 0; i < transcripts.size(); i++) {
+    if (opts_.transcript_cache_size > 0) {
+      num_cache_lookups_++;
+      const VectorFst<StdArc> *cached = LookupCache(transcripts[i]);
+      if (cached != NULL) {
+        num_cache_hits_++;
+        (*out_fsts)[i] = new VectorFst<StdArc>(*cached);  // shallow copy.
+        continue;
+      }
+    }
+    std::pair<IndexMap::iterator, bool> ret = transcript_to_index.insert(
+        std::make_pair(transcripts[i], to_compile.size()));
+    if (ret.second) {
+      to_compile.push_back(&(transcripts[i]));
+      output_indexes.resize(output_indexes.size() + 1);
+    }
+    output_indexes[ret.first->second].push_back(i);
+  }
+
+  std::vector<const VectorFst<StdArc>* > word_fsts(to_compile.size());
+  for (size_t j = 0; j < to_compile.size(); j++) {
     VectorFst<StdArc> *word_fst = new VectorFst<StdArc>();
-    MakeLinearAcceptor(transcripts[i], word_fst);
-    word_fsts[i] = word_fst;
+    MakeLinearAcceptor(*(to_compile[j]), word_fst);
+    word_fsts[j] = word_fst;
+  }
+  std::vector<VectorFst<StdArc>*> compiled_fsts;
+  bool ans = CompileGraphs(word_fsts, &compiled_fsts);
+  DeletePointers(&word_fsts);
+
+  for (size_t j = 0; j < compiled_fsts.size(); j++) {
+    const std::vector<size_t> &indexes = output_indexes[j];
+    (*out_fsts)[indexes[0]] = compiled_fsts[j];
+    for (size_t k = 1; k < indexes.size(); k++)
+      (*out_fsts)[indexes[k]] = new VectorFst<StdArc>(*(compiled_fsts[j]));
+    if (opts_.transcript_cache_size > 0)
+      AddToCache(*(to_compile[j]), *(compiled_fsts[j]));
   }
-  bool ans = CompileGraphs(word_fsts, out_fsts);
-  for (size_t i = 0; i < transcripts.size(); i++)
-    delete word_fsts[i];
   return ans;
 }
 
+const fst::VectorFst<fst::StdArc> *TrainingGraphCompiler::LookupCache(
+    const std::vector<int32> &transcript) {
+  TranscriptCache::iterator iter = transcript_cache_.find(transcript);
+  if (iter == transcript_cache_.end())
+    return NULL;
+  // Move it to the front of the LRU list.
+  lru_list_.splice(lru_list_.begin(), lru_list_, iter->second.lru_pos);
+  return iter->second.fst;
+}
+
+void TrainingGraphCompiler::AddToCache(
+    const std::vector<int32> &transcript,
+    const fst::VectorFst<fst::StdArc> &fst) {
+  KALDI_ASSERT(opts_.transcript_cache_size > 0);
+  if (transcript_cache_.count(transcript) != 0)
+    return;
+  if (transcript_cache_.size() >=
+      static_cast<size_t>(opts_.transcript_cache_size)) {
+    TranscriptCache::iterator iter = transcript_cache_.find(lru_list_.back());
+    KALDI_ASSERT(iter != transcript_cache_.end());
+    delete iter->second.fst;
+    transcript_cache_.erase(iter);
+    lru_list_.pop_back();
+  }
+  lru_list_.push_front(transcript);
+  CacheEntry &entry = transcript_cache_[transcript];
+  entry.fst = new fst::VectorFst<fst::StdArc>(fst);  // shallow copy.
+  entry.lru_pos = lru_list_.begin();
+}
+
 bool TrainingGraphCompiler::CompileGraphs(
     const std::vector<const fst::VectorFst<fst::StdArc>* > &word_fsts,
     std::vector<fst::VectorFst<fst::StdArc>* > *out_fsts) {
@@ -167,6 +264,57 @@ bool TrainingGraphCompiler::CompileGraphs(
   KALDI_ASSERT(out_fsts != NULL && out_fsts->empty());
   out_fsts->resize(word_fsts.size(), NULL);
   if (word_fsts.empty()) return true;
+  for (size_t i = 0; i < word_fsts.size(); i++)
+    (*out_fsts)[i] = new VectorFst<StdArc>();
+
+  int32 num_threads = std::min<size_t>(std::max<int32>(opts_.num_threads, 1),
+                                       word_fsts.size());
+  // Graphs are assigned to threads round-robin, which balances the load well
+  // enough since neighbouring utterances are not correlated in length.
+  std::vector<std::vector<size_t> > indexes(num_threads);
+  for (size_t i = 0; i < word_fsts.size(); i++)
+    indexes[i % num_threads].push_back(i);
+
+  std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(num_threads);
+  for (int32 t = 1; t < num_threads; t++) {
+    threads.push_back(std::thread(
+        &TrainingGraphCompiler::CompileGraphsThread, this, &word_fsts,
+        &(indexes[t]), thread_lex_caches_[t - 1], out_fsts, &(errors[t])));
+  }
+  CompileGraphsThread(&word_fsts, &(indexes[0]), &lex_cache_, out_fsts,
+                      &(errors[0]));
+  for (size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+  for (int32 t = 0; t < num_threads; t++) {
+    if (errors[t]) {
+      DeletePointers(out_fsts);
+      std::rethrow_exception(errors[t]);
+    }
+  }
+  return true;
+}
+
+void TrainingGraphCompiler::CompileGraphsThread(
+    const std::vector<const fst::VectorFst<fst::StdArc>* > *word_fsts,
+    const std::vector<size_t> *indexes,
+    LexCache *lex_cache,
+    std::vector<fst::VectorFst<fst::StdArc>* > *out_fsts,
+    std::exception_ptr *error) const {
+  try {
+    CompileGraphsForIndexes(*word_fsts, *indexes, lex_cache, out_fsts);
+  } catch (...) {
+    *error = std::current_exception();
+  }
+}
+
+void TrainingGraphCompiler::CompileGraphsForIndexes(
+    const std::vector<const fst::VectorFst<fst::StdArc>* > &word_fsts,
+    const std::vector<size_t> &indexes,
+    LexCache *lex_cache,
+    std::vector<fst::VectorFst<fst::StdArc>* > *out_fsts) const {
+  using namespace fst;
+  if (indexes.empty()) return;
 
   const std::vector<int32> &phone_syms = trans_model_.GetPhones();  // needed to create context fst.
 
@@ -177,21 +325,21 @@ bool TrainingGraphCompiler::CompileGraphs(
                              ctx_dep_.ContextWidth(),
                              ctx_dep_.CentralPosition());
 
-  for (size_t i = 0; i < word_fsts.size(); i++) {
+  for (size_t k = 0; k < indexes.size(); k++) {
+    size_t i = indexes[k];
     VectorFst<StdArc> phone2word_fst;
     // TableCompose more efficient than compose.
-    TableCompose(*lex_fst_, *(word_fsts[i]), &phone2word_fst, &lex_cache_);
+    TableCompose(*lex_fst_, *(word_fsts[i]), &phone2word_fst, lex_cache);
 
     KALDI_ASSERT(phone2word_fst.Start() != kNoStateId &&
                  "Perhaps you have words missing in your lexicon?");
 
-    VectorFst<StdArc> ctx2word_fst;
+    VectorFst<StdArc> &ctx2word_fst = *((*out_fsts)[i]);
     ComposeDeterministicOnDemandInverse(phone2word_fst, &inv_cfst, &ctx2word_fst);
     // now ctx2word_fst is C * LG, assuming phone2word_fst is written as LG.
+    // For now (*out_fsts)[i] contains the FST with symbols representing
+    // phones-in-context.
     KALDI_ASSERT(ctx2word_fst.Start() != kNoStateId);
-
-    (*out_fsts)[i] = ctx2word_fst.Copy();  // For now this contains the FST with symbols
-    // representing phones-in-context.
   }
 
   HTransducerConfig h_cfg;
@@ -204,7 +352,8 @@ bool TrainingGraphCompiler::CompileGraphs(
                                         h_cfg,
                                         &disambig_syms_h);
 
-  for (size_t i = 0; i < out_fsts->size(); i++) {
+  for (size_t k = 0; k < indexes.size(); k++) {
+    size_t i = indexes[k];
     VectorFst<StdArc> &ctx2word_fst = *((*out_fsts)[i]);
     VectorFst<StdArc> trans2word_fst;
     TableCompose(*H, ctx2word_fst, &trans2word_fst);
@@ -235,7 +384,6 @@ bool TrainingGraphCompiler::CompileGraphs(
   }
 
   delete H;
-  return true;
 }
 
 
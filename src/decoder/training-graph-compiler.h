@@ -20,7 +20,11 @@
 #ifndef KALDI_DECODER_TRAINING_GRAPH_COMPILER_H_
 #define KALDI_DECODER_TRAINING_GRAPH_COMPILER_H_
 
+#include <exception>
+#include <list>
+#include <unordered_map>
 #include "base/kaldi-common.h"
+#include "util/stl-utils.h"
 #include "hmm/transition-model.h"
 #include "fst/fstlib.h"
 #include "fstext/fstext-lib.h"
@@ -35,6 +39,8 @@ struct TrainingGraphCompilerOptions {
   BaseFloat self_loop_scale;
   bool rm_eps;
   bool reorder;  // (Dan-style graphs)
+  int32 num_threads;
+  int32 transcript_cache_size;
 
   explicit TrainingGraphCompilerOptions(BaseFloat transition_scale = 1.0,
                                         BaseFloat self_loop_scale = 1.0,
@@ -42,7 +48,9 @@ struct TrainingGraphCompilerOptions {
       transition_scale(transition_scale),
       self_loop_scale(self_loop_scale),
       rm_eps(false),
-      reorder(b) { }
+      reorder(b),
+      num_threads(1),
+      transcript_cache_size(0) { }
 
   void Register(OptionsItf *opts) {
     opts->Register("transition-scale", &transition_scale, "Scale of transition "
@@ -52,6 +60,13 @@ struct TrainingGraphCompilerOptions {
     opts->Register("reorder", &reorder, "Reorder transition ids for greater decoding efficiency.");
     opts->Register("rm-eps", &rm_eps,  "Remove [most] epsilons before minimization (only applicable "
                    "if disambig symbols present)");
+    opts->Register("num-threads", &num_threads, "Number of threads used to "
+                   "compile each batch of graphs (only relevant when graphs "
+                   "are compiled in batches).");
+    opts->Register("transcript-cache-size", &transcript_cache_size, "If >0, "
+                   "keep the compiled graphs of up to this many of the most "
+                   "recently used transcripts, so repeated transcripts are "
+                   "not recompiled.");
   }
 };
 
@@ -76,23 +91,68 @@ class TrainingGraphCompiler {
                     fst::VectorFst<fst::StdArc> *out_fst);
 
   // CompileGraphs allows you to compile a number of graphs at the same
-  // time.  This consumes more memory but is faster.
+  // time.  This consumes more memory but is faster.  If opts.num_threads > 1
+  // the graphs are divided among that many threads, which share the lexicon
+  // (read-only) but each have their own context FST, H transducer and
+  // composition cache.
   bool CompileGraphs(
       const std::vector<const fst::VectorFst<fst::StdArc> *> &word_fsts,
       std::vector<fst::VectorFst<fst::StdArc> *> *out_fsts);
 
-  // This version creates an FST from the text and calls CompileGraph.
+  // This version creates an FST from the text and calls CompileGraph (or, if
+  // opts.transcript_cache_size > 0, CompileGraphsFromText()).
   bool CompileGraphFromText(const std::vector<int32> &transcript,
                             fst::VectorFst<fst::StdArc> *out_fst);
 
   // This function creates FSTs from the text and calls CompileGraphs.
+  // Repeated transcripts within the batch are compiled only once, and if
+  // opts.transcript_cache_size > 0, transcripts whose graphs are in the cache
+  // are not compiled at all.  The output FSTs may share their
+  // (copy-on-write) implementation with each other and with the cache.
   bool CompileGraphsFromText(
       const std::vector<std::vector<int32> >  &word_grammar,
       std::vector<fst::VectorFst<fst::StdArc> *> *out_fsts);
 
 
-  ~TrainingGraphCompiler() { delete lex_fst_; }
+  ~TrainingGraphCompiler();
  private:
+  typedef fst::TableComposeCache<fst::Fst<fst::StdArc> > LexCache;
+  typedef std::list<std::vector<int32> > LruList;
+  struct CacheEntry {
+    fst::VectorFst<fst::StdArc> *fst;
+    LruList::iterator lru_pos;  // position of the transcript in lru_list_.
+  };
+  typedef std::unordered_map<std::vector<int32>, CacheEntry,
+                             VectorHasher<int32> > TranscriptCache;
+
+  // Compiles the graphs word_fsts[i] for i in 'indexes' into (*out_fsts)[i],
+  // which must be non-NULL.  This is the body of CompileGraphs(); it is
+  // called once per thread.
+  void CompileGraphsForIndexes(
+      const std::vector<const fst::VectorFst<fst::StdArc>* > &word_fsts,
+      const std::vector<size_t> &indexes,
+      LexCache *lex_cache,
+      std::vector<fst::VectorFst<fst::StdArc>* > *out_fsts) const;
+
+  // Calls CompileGraphsForIndexes(); any exception is caught and put in
+  // *error, to be rethrown in the calling thread.
+  void CompileGraphsThread(
+      const std::vector<const fst::VectorFst<fst::StdArc>* > *word_fsts,
+      const std::vector<size_t> *indexes,
+      LexCache *lex_cache,
+      std::vector<fst::VectorFst<fst::StdArc>* > *out_fsts,
+      std::exception_ptr *error) const;
+
+  // Returns the cached graph for 'transcript' (and marks it as most recently
+  // used), or NULL.
+  const fst::VectorFst<fst::StdArc> *LookupCache(
+      const std::vector<int32> &transcript);
+
+  // Adds a copy of 'fst' to the cache, removing the least recently used graph
+  // if the cache is full.
+  void AddToCache(const std::vector<int32> &transcript,
+                  const fst::VectorFst<fst::StdArc> &fst);
+
   const TransitionModel &trans_model_;
   const ContextDependency &ctx_dep_;
   fst::VectorFst<fst::StdArc> *lex_fst_; // lexicon FST (an input; we take
@@ -100,10 +160,20 @@ class TrainingGraphCompiler {
   std::vector<int32> disambig_syms_; // disambig symbols (if any) in the phone
   int32 subsequential_symbol_;  // search in ../fstext/context-fst.h for more info.
   // symbol table.
-  fst::TableComposeCache<fst::Fst<fst::StdArc> > lex_cache_;  // stores matcher..
+  LexCache lex_cache_;  // stores matcher..
   // this is one of Dan's extensions.
+  // The matchers are not thread-safe, so threads other than the calling one
+  // get their own; thread_lex_caches_[t-1] is for thread t.  Owned here.
+  std::vector<LexCache*> thread_lex_caches_;
 
   TrainingGraphCompilerOptions opts_;
+
+  // The cache of graphs for transcripts; lru_list_ holds its keys, most
+  // recently used first.
+  TranscriptCache transcript_cache_;
+  LruList lru_list_;
+  int64 num_cache_lookups_;
+  int64 num_cache_hits_;
 };
 
 
@@ -50,6 +50,7 @@ void OfflineFeatureTpl<F>::ComputeFeatures(
                 << " upsampling the waveform).";
     // Resample the waveform.
     Vector<BaseFloat> resampled_wave(wave);
+    KALDI_TRACE_SCOPE("OfflineFeature::ResampleWaveform");
     ResampleWaveform(sample_freq, wave,
                      new_sample_freq, &resampled_wave);
     Compute(resampled_wave, vtln_warp, output);
@@ -62,6 +63,7 @@ void OfflineFeatureTpl<F>::Compute(
     BaseFloat vtln_warp,
     Matrix<BaseFloat> *output) {
   KALDI_ASSERT(output != NULL);
+  KALDI_TRACE_SCOPE("OfflineFeature::Compute");
   int32 rows_out = NumFrames(wave.Dim(), computer_.GetFrameOptions()),
       cols_out = computer_.Dim();
   if (rows_out == 0) {
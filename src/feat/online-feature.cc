@@ -166,6 +166,8 @@ void OnlineGenericBaseFeature<C>::ComputeFeatures() {
       num_frames_new = NumFrames(num_samples_total, frame_opts,
                                  input_finished_);
   KALDI_ASSERT(num_frames_new >= num_frames_old);
+  KALDI_TRACE_SCOPE("OnlineFeature::ComputeFeatures",
+                    num_frames_new - num_frames_old);
 
   Vector<BaseFloat> window;
   bool need_raw_log_energy = computer_.NeedRawLogEnergy();
@@ -52,9 +52,11 @@ int main(int argc, char *argv[]) {
                 "(only currently supported for wxfilename, i.e. archive/script,"
                 "output)");
     po.Register("compression-method", &compression_method_in,
-                "Only relevant if --compress=true; the method (1 through 7) to "
+                "Only relevant if --compress=true; the method (1 through 8) to "
                 "compress the matrix.  Search for CompressionMethod in "
-                "src/matrix/compressed-matrix.h.");
+                "src/matrix/compressed-matrix.h.  Method 8 gives smaller "
+                "archives of features that can still be read in ranges of "
+                "rows, but is slower to decompress.");
     po.Register("write-num-frames", &num_frames_wspecifier,
                 "Wspecifier to write length in frames of each utterance. "
                 "e.g. 'ark,t:utt2num_frames'.  Only applicable if writing tables, "
@@ -80,8 +82,8 @@ int main(int argc, char *argv[]) {
       Int32Writer num_frames_writer(num_frames_wspecifier);
 
       if (!compress) {
-        BaseFloatMatrixWriter kaldi_writer(wspecifier);
         if (htk_in) {
+          BaseFloatMatrixWriter kaldi_writer(wspecifier);
           SequentialTableReader<HtkMatrixHolder> htk_reader(rspecifier);
           for (; !htk_reader.Done(); htk_reader.Next(), num_done++) {
             kaldi_writer.Write(htk_reader.Key(), htk_reader.Value().first);
@@ -90,6 +92,7 @@ int main(int argc, char *argv[]) {
                                       htk_reader.Value().first.NumRows());
           }
         } else if (sphinx_in) {
+          BaseFloatMatrixWriter kaldi_writer(wspecifier);
           SequentialTableReader<SphinxMatrixHolder<> > sphinx_reader(rspecifier);
           for (; !sphinx_reader.Done(); sphinx_reader.Next(), num_done++) {
             kaldi_writer.Write(sphinx_reader.Key(), sphinx_reader.Value());
@@ -98,12 +101,16 @@ int main(int argc, char *argv[]) {
                                       sphinx_reader.Value().NumRows());
           }
         } else {
-          SequentialBaseFloatMatrixReader kaldi_reader(rspecifier);
+          // We read views, which don't copy the data if it is read from a
+          // memory-mapped archive (e.g. ranges of rows in scp files).
+          BaseFloatMatrixViewWriter kaldi_writer(wspecifier);
+          SequentialBaseFloatMatrixViewReader kaldi_reader(rspecifier);
           for (; !kaldi_reader.Done(); kaldi_reader.Next(), num_done++) {
-            kaldi_writer.Write(kaldi_reader.Key(), kaldi_reader.Value());
+            MatrixView<BaseFloat> &feats = kaldi_reader.Value();
+            feats.Uncompress();  // Compressed input is written uncompressed.
+            kaldi_writer.Write(kaldi_reader.Key(), feats);
             if (!num_frames_wspecifier.empty())
-              num_frames_writer.Write(kaldi_reader.Key(),
-                                      kaldi_reader.Value().NumRows());
+              num_frames_writer.Write(kaldi_reader.Key(), feats.NumRows());
           }
         }
       } else {
@@ -129,10 +136,10 @@ int main(int argc, char *argv[]) {
                                       sphinx_reader.Value().NumRows());
           }
         } else {
-          SequentialBaseFloatMatrixReader kaldi_reader(rspecifier);
+          SequentialBaseFloatMatrixViewReader kaldi_reader(rspecifier);
           for (; !kaldi_reader.Done(); kaldi_reader.Next(), num_done++) {
             kaldi_writer.Write(kaldi_reader.Key(),
-                               CompressedMatrix(kaldi_reader.Value(),
+                               CompressedMatrix(kaldi_reader.Value().Mat(),
                                                 compression_method));
             if (!num_frames_wspecifier.empty())
               num_frames_writer.Write(kaldi_reader.Key(),
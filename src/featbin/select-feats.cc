@@ -52,8 +52,10 @@ int main(int argc, char *argv[]) {
     string rspecifier = po.GetArg(2);
     string wspecifier = po.GetArg(3);
 
-    // set up input (we'll need that to validate the selected indices)
-    SequentialBaseFloatMatrixReader kaldi_reader(rspecifier);
+    // set up input (we'll need that to validate the selected indices).  We
+    // only copy parts of the input matrices, so we read them as views, which
+    // avoids copying (or decompressing) the rest of them where possible.
+    SequentialBaseFloatMatrixViewReader kaldi_reader(rspecifier);
 
     if (kaldi_reader.Done()) {
       KALDI_WARN << "Empty archive provided.";
@@ -127,8 +129,8 @@ int main(int argc, char *argv[]) {
         int32 f = ranges[i].first;
         int32 ncol = ranges[i].second - f + 1;
 
-        feats.Range(0, feats.NumRows(), offsets[i], ncol)
-          .CopyFromMat(kaldi_reader.Value().Range(0, feats.NumRows(), f, ncol));
+        SubMatrix<BaseFloat> dest(feats, 0, feats.NumRows(), offsets[i], ncol);
+        kaldi_reader.Value().CopyToMat(0, f, &dest);
       }
 
       kaldi_writer.Write(kaldi_reader.Key(), feats);
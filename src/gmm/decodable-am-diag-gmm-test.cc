@@ -0,0 +1,91 @@
+// gmm/decodable-am-diag-gmm-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gmm/model-test-common.h"
+#include "gmm/decodable-am-diag-gmm.h"
+
+namespace kaldi {
+
+// Exposes LogLikelihoodsForPdfs() for testing.
+class TestDecodableAmDiagGmm: public DecodableAmDiagGmmUnmapped {
+ public:
+  TestDecodableAmDiagGmm(const AmDiagGmm &am,
+                         const Matrix<BaseFloat> &feats):
+      DecodableAmDiagGmmUnmapped(am, feats) { }
+  void PdfLogLikelihoods(int32 frame, const std::vector<int32> &pdf_ids,
+                         std::vector<BaseFloat> *loglikes) {
+    LogLikelihoodsForPdfs(frame, pdf_ids, 1.0, loglikes);
+  }
+};
+
+// Checks that batch computation (SetBatchComputation()) gives the same
+// log-likelihoods as the normal computation, whether the pdfs are requested
+// one at a time or several at once, and frames in order or not.
+void UnitTestDecodableAmDiagGmmBatch() {
+  int32 dim = 1 + RandInt(0, 20),
+      num_pdfs = 5 + RandInt(0, 20),
+      num_frames = 1 + RandInt(0, 30),
+      frames_per_batch = 1 + RandInt(0, 10);
+
+  AmDiagGmm am_gmm;
+  for (int32 i = 0; i < num_pdfs; i++) {
+    DiagGmm gmm;
+    unittest::InitRandDiagGmm(dim, 1 + RandInt(0, 9), &gmm);
+    am_gmm.AddPdf(gmm);
+  }
+  Matrix<BaseFloat> feats(num_frames, dim);
+  feats.SetRandn();
+
+  StackedAmDiagGmm stacked(am_gmm);
+  KALDI_ASSERT(stacked.NumPdfs() == num_pdfs &&
+               stacked.Params().NumRows() == am_gmm.NumGauss());
+
+  TestDecodableAmDiagGmm normal(am_gmm, feats), batched(am_gmm, feats);
+  batched.SetBatchComputation(&stacked, frames_per_batch);
+
+  for (int32 i = 0; i < 3 * num_frames; i++) {
+    // Mostly go forward, sometimes jump around.
+    int32 frame = (RandInt(0, 3) == 0 ? RandInt(0, num_frames - 1) :
+                   i % num_frames);
+    std::vector<int32> pdf_ids;
+    int32 n = RandInt(1, 2 * num_pdfs);
+    for (int32 j = 0; j < n; j++)
+      pdf_ids.push_back(RandInt(0, num_pdfs - 1));
+    std::vector<BaseFloat> loglikes, batched_loglikes;
+    normal.PdfLogLikelihoods(frame, pdf_ids, &loglikes);
+    if (RandInt(0, 1) == 0) {
+      batched.PdfLogLikelihoods(frame, pdf_ids, &batched_loglikes);
+    } else {
+      for (int32 j = 0; j < n; j++)
+        batched_loglikes.push_back(
+            batched.LogLikelihood(frame, pdf_ids[j] + 1));
+    }
+    for (int32 j = 0; j < n; j++) {
+      KALDI_ASSERT(loglikes[j] == normal.LogLikelihood(frame, pdf_ids[j] + 1));
+      AssertEqual(loglikes[j], batched_loglikes[j], 1.0e-03);
+    }
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 20; i++)
+    kaldi::UnitTestDecodableAmDiagGmmBatch();
+  std::cout << "Test OK.\n";
+  return 0;
+}
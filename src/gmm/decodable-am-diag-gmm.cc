@@ -25,6 +25,115 @@ using std::vector;
 
 namespace kaldi {
 
+StackedAmDiagGmm::StackedAmDiagGmm(const AmDiagGmm &am): dim_(am.Dim()) {
+  int32 num_pdfs = am.NumPdfs();
+  offsets_.resize(num_pdfs + 1);
+  offsets_[0] = 0;
+  for (int32 pdf = 0; pdf < num_pdfs; pdf++)
+    offsets_[pdf + 1] = offsets_[pdf] + am.NumGaussInPdf(pdf);
+  params_.Resize(offsets_[num_pdfs], 2 * dim_ + 1);
+  for (int32 pdf = 0; pdf < num_pdfs; pdf++) {
+    const DiagGmm &gmm = am.GetPdf(pdf);
+    if (!gmm.valid_gconsts())
+      KALDI_ERR << "State "  << pdf  << ": Must call ComputeGconsts() "
+          "before computing likelihood.";
+    int32 num_gauss = gmm.NumGauss();
+    SubMatrix<BaseFloat> rows(params_, offsets_[pdf], num_gauss,
+                              0, 2 * dim_ + 1);
+    rows.ColRange(0, dim_).CopyFromMat(gmm.means_invvars());
+    rows.ColRange(dim_, dim_).AddMat(-0.5, gmm.inv_vars());
+    rows.CopyColFromVec(gmm.gconsts(), 2 * dim_);
+  }
+}
+
+void DecodableAmDiagGmmUnmapped::SetBatchComputation(
+    const StackedAmDiagGmm *stacked, int32 frames_per_batch) {
+  KALDI_ASSERT(stacked != NULL && frames_per_batch > 0);
+  KALDI_ASSERT(stacked->NumPdfs() == acoustic_model_.NumPdfs() &&
+               stacked->Dim() == acoustic_model_.Dim());
+  if (stacked->Dim() != feature_matrix_.NumCols())
+    KALDI_ERR << "Dim mismatch: data dim = "  << feature_matrix_.NumCols()
+              << " vs. model dim = " << stacked->Dim();
+  stacked_ = stacked;
+  frames_per_batch_ = frames_per_batch;
+  batch_start_ = -1;
+  batch_pdf_id_.assign(stacked->NumPdfs(), -1);
+}
+
+void DecodableAmDiagGmmUnmapped::SetBatch(int32 frame) {
+  int32 batch_start = frame - frame % frames_per_batch_;
+  if (batch_start == batch_start_)
+    return;
+  batch_start_ = batch_start;
+  batch_id_++;  // invalidates the pdfs in batch_pdf_id_.
+  int32 num_frames = std::min(frames_per_batch_,
+                              NumFramesReady() - batch_start),
+      dim = feature_matrix_.NumCols();
+  batch_feats_.Resize(num_frames, 2 * dim + 1, kUndefined);
+  SubMatrix<BaseFloat> feats(batch_feats_, 0, num_frames, 0, dim),
+      feats_sq(batch_feats_, 0, num_frames, dim, dim);
+  feats.CopyFromMat(feature_matrix_.RowRange(batch_start, num_frames));
+  feats_sq.CopyFromMat(feats);
+  feats_sq.ApplyPow(2.0);
+  batch_feats_.ColRange(2 * dim, 1).Set(1.0);
+  batch_loglikes_.Resize(num_frames, acoustic_model_.NumPdfs(), kUndefined);
+}
+
+void DecodableAmDiagGmmUnmapped::ComputeBatch(
+    const std::vector<int32> &pdf_ids) {
+  const Matrix<BaseFloat> &params = stacked_->Params();
+  int32 num_frames = batch_feats_.NumRows(), tot_gauss = 0;
+  for (size_t i = 0; i < pdf_ids.size(); i++)
+    tot_gauss += stacked_->NumGaussInPdf(pdf_ids[i]);
+  if (tot_gauss == 0)
+    return;
+
+  // Stack the Gaussians of the pdfs we need; for a single pdf they are
+  // already consecutive.
+  if (pdf_ids.size() > 1) {
+    if (batch_params_.NumRows() < tot_gauss)
+      batch_params_.Resize(tot_gauss * 3 / 2, params.NumCols(), kUndefined);
+    int32 offset = 0;
+    for (size_t i = 0; i < pdf_ids.size(); i++) {
+      int32 n = stacked_->NumGaussInPdf(pdf_ids[i]);
+      batch_params_.RowRange(offset, n).CopyFromMat(
+          params.RowRange(stacked_->FirstGauss(pdf_ids[i]), n));
+      offset += n;
+    }
+  }
+  SubMatrix<BaseFloat> needed_params(
+      pdf_ids.size() == 1 ?
+      params.RowRange(stacked_->FirstGauss(pdf_ids[0]), tot_gauss) :
+      batch_params_.RowRange(0, tot_gauss));
+
+  if (gauss_loglikes_.NumRows() < num_frames ||
+      gauss_loglikes_.NumCols() < tot_gauss)
+    gauss_loglikes_.Resize(frames_per_batch_,
+                           std::max(tot_gauss * 3 / 2,
+                                    gauss_loglikes_.NumCols()), kUndefined);
+  SubMatrix<BaseFloat> gauss_loglikes(gauss_loglikes_, 0, num_frames,
+                                      0, tot_gauss);
+  // gauss_loglikes(t, g) = gconst(g) + means_invvars(g) . x_t
+  //                        - 0.5 inv_vars(g) . x_t^2.
+  gauss_loglikes.AddMatMat(1.0, batch_feats_, kNoTrans,
+                           needed_params, kTrans, 0.0);
+
+  int32 offset = 0;
+  for (size_t i = 0; i < pdf_ids.size(); i++) {
+    int32 pdf = pdf_ids[i], n = stacked_->NumGaussInPdf(pdf);
+    for (int32 t = 0; t < num_frames; t++) {
+      BaseFloat log_sum = SubVector<BaseFloat>(gauss_loglikes.Row(t),
+                                               offset, n).LogSumExp(
+                                                   log_sum_exp_prune_);
+      if (KALDI_ISNAN(log_sum) || KALDI_ISINF(log_sum))
+        KALDI_ERR << "Invalid answer (overflow or invalid variances/features?)";
+      batch_loglikes_(t, pdf) = log_sum;
+    }
+    batch_pdf_id_[pdf] = batch_id_;
+    offset += n;
+  }
+}
+
 BaseFloat DecodableAmDiagGmmUnmapped::LogLikelihoodZeroBased(
     int32 frame, int32 state) {
   KALDI_ASSERT(static_cast<size_t>(frame) <
@@ -32,6 +141,15 @@ BaseFloat DecodableAmDiagGmmUnmapped::LogLikelihoodZeroBased(
   KALDI_ASSERT(static_cast<size_t>(state) < static_cast<size_t>(NumIndices()) &&
                "Likely graph/model mismatch, e.g. using wrong HCLG.fst");
 
+  if (stacked_ != NULL) {
+    SetBatch(frame);
+    if (batch_pdf_id_[state] != batch_id_) {
+      batch_pdfs_.assign(1, state);
+      ComputeBatch(batch_pdfs_);
+    }
+    return batch_loglikes_(frame - batch_start_, state);
+  }
+
   if (log_like_cache_[state].hit_time == frame) {
     return log_like_cache_[state].log_like;  // return cached value, if found
   }
@@ -71,6 +189,33 @@ BaseFloat DecodableAmDiagGmmUnmapped::LogLikelihoodZeroBased(
   return log_sum;
 }
 
+void DecodableAmDiagGmmUnmapped::LogLikelihoodsForPdfs(
+    int32 frame, const std::vector<int32> &pdf_ids, BaseFloat scale,
+    std::vector<BaseFloat> *loglikes) {
+  loglikes->resize(pdf_ids.size());
+  if (stacked_ != NULL) {
+    SetBatch(frame);
+    batch_pdfs_.clear();
+    for (size_t i = 0; i < pdf_ids.size(); i++) {
+      int32 pdf = pdf_ids[i];
+      KALDI_ASSERT(static_cast<size_t>(pdf) < batch_pdf_id_.size() &&
+                   "Likely graph/model mismatch, e.g. using wrong HCLG.fst");
+      if (batch_pdf_id_[pdf] != batch_id_) {
+        batch_pdf_id_[pdf] = batch_id_;  // so we only add it once.
+        batch_pdfs_.push_back(pdf);
+      }
+    }
+    ComputeBatch(batch_pdfs_);
+    int32 t = frame - batch_start_;
+    for (size_t i = 0; i < pdf_ids.size(); i++)
+      (*loglikes)[i] = scale * batch_loglikes_(t, pdf_ids[i]);
+    return;
+  }
+  // LogLikelihoodZeroBased() caches, so repeated pdfs are only computed once.
+  for (size_t i = 0; i < pdf_ids.size(); i++)
+    (*loglikes)[i] = scale * LogLikelihoodZeroBased(frame, pdf_ids[i]);
+}
+
 void DecodableAmDiagGmmUnmapped::ResetLogLikeCache() {
   if (static_cast<int32>(log_like_cache_.size()) != acoustic_model_.NumPdfs()) {
     log_like_cache_.resize(acoustic_model_.NumPdfs());
@@ -34,6 +34,36 @@
 
 namespace kaldi {
 
+/// StackedAmDiagGmm holds the parameters of all the Gaussians of an AmDiagGmm
+/// in one matrix, one row per Gaussian with the Gaussians of each pdf in
+/// consecutive rows, so that the log-likelihoods of several frames against
+/// many Gaussians can be computed with one matrix multiplication.  Row g is
+/// [ means_invvars(g), -0.5 * inv_vars(g), gconst(g) ], which is to be
+/// multiplied by [ x, x^2, 1 ] for a frame x.  See
+/// DecodableAmDiagGmmUnmapped::SetBatchComputation().
+class StackedAmDiagGmm {
+ public:
+  /// The gconsts of 'am' must be valid.  Does not keep a reference to 'am'.
+  explicit StackedAmDiagGmm(const AmDiagGmm &am);
+
+  int32 Dim() const { return dim_; }
+  int32 NumPdfs() const { return static_cast<int32>(offsets_.size()) - 1; }
+  /// Index of the first row of 'pdf' in Params().
+  int32 FirstGauss(int32 pdf) const { return offsets_[pdf]; }
+  int32 NumGaussInPdf(int32 pdf) const {
+    return offsets_[pdf + 1] - offsets_[pdf];
+  }
+  /// Dimension is (total #Gaussians) by (2 * Dim() + 1).
+  const Matrix<BaseFloat> &Params() const { return params_; }
+
+ private:
+  int32 dim_;
+  Matrix<BaseFloat> params_;
+  std::vector<int32> offsets_;  // dimension NumPdfs() + 1.
+  KALDI_DISALLOW_COPY_AND_ASSIGN(StackedAmDiagGmm);
+};
+
+
 /// DecodableAmDiagGmmUnmapped is a decodable object that
 /// takes indices that correspond to pdf-id's plus one.
 /// This may be used in future in a decoder that doesn't need
@@ -53,10 +83,21 @@ class DecodableAmDiagGmmUnmapped : public DecodableInterface {
                              BaseFloat log_sum_exp_prune = -1.0):
     acoustic_model_(am), feature_matrix_(feats),
     previous_frame_(-1), log_sum_exp_prune_(log_sum_exp_prune), 
-    data_squared_(feats.NumCols()) {
+    data_squared_(feats.NumCols()), stacked_(NULL), frames_per_batch_(0),
+    batch_start_(-1), batch_id_(0) {
     ResetLogLikeCache();
   }
 
+  /// Makes this object compute log-likelihoods in batches: when a pdf is first
+  /// needed in a batch of frames_per_batch frames (batches start at multiples
+  /// of frames_per_batch), it is computed for all frames of the batch, and all
+  /// the pdfs requested together by LogLikelihoods() are computed with one
+  /// matrix multiplication.  'stacked' must be made from the same model; it
+  /// is not owned.  Not for use with child classes that override
+  /// LogLikelihoodZeroBased() (e.g. DecodableAmDiagGmmRegtreeFmllr).
+  void SetBatchComputation(const StackedAmDiagGmm *stacked,
+                           int32 frames_per_batch);
+
   // Note, frames are numbered from zero.  But state_index is numbered
   // from one (this routine is called by FSTs).
   virtual BaseFloat LogLikelihood(int32 frame, int32 state_index) {
@@ -76,6 +117,12 @@ class DecodableAmDiagGmmUnmapped : public DecodableInterface {
   void ResetLogLikeCache();
   virtual BaseFloat LogLikelihoodZeroBased(int32 frame, int32 state_index);
 
+  /// Sets (*loglikes)[i] to scale times the log-likelihood of pdf pdf_ids[i]
+  /// (zero-based) on frame 'frame'.  Each distinct pdf is computed only once;
+  /// this is what the LogLikelihoods() functions of the child classes use.
+  void LogLikelihoodsForPdfs(int32 frame, const std::vector<int32> &pdf_ids,
+                             BaseFloat scale, std::vector<BaseFloat> *loglikes);
+
   const AmDiagGmm &acoustic_model_;
   const Matrix<BaseFloat> &feature_matrix_;
   int32 previous_frame_;
@@ -87,9 +134,30 @@ class DecodableAmDiagGmmUnmapped : public DecodableInterface {
     int32 hit_time;     ///< Frame for which this value is relevant
   };
   std::vector<LikelihoodCacheRecord> log_like_cache_;
+  std::vector<int32> pdf_ids_;  // Temporary used in LogLikelihoods().
  private:
+  // Used if stacked_ != NULL: makes the batch containing 'frame' current.
+  void SetBatch(int32 frame);
+  // Used if stacked_ != NULL: computes the log-likelihoods of 'pdf_ids' (which
+  // must be distinct) on all frames of the current batch.
+  void ComputeBatch(const std::vector<int32> &pdf_ids);
+
   Vector<BaseFloat> data_squared_;  ///< Cache for fast likelihood calculation
 
+  // The following are for batch computation; see SetBatchComputation().
+  const StackedAmDiagGmm *stacked_;  // NULL if not batching.
+  int32 frames_per_batch_;
+  int32 batch_start_;  // first frame of the current batch, or -1.
+  int32 batch_id_;  // incremented when the current batch changes.
+  Matrix<BaseFloat> batch_feats_;  // [ x, x^2, 1 ] for the frames of the batch.
+  Matrix<BaseFloat> batch_loglikes_;  // (#frames in batch) by NumPdfs().
+  std::vector<int32> batch_pdf_id_;  // batch_id_ that each pdf is computed
+                                     // for in batch_loglikes_, or -1.
+  std::vector<int32> batch_pdfs_;  // Temporary.
+  Matrix<BaseFloat> batch_params_;  // Temporary: stacked params of the
+                                    // pdfs being computed.
+  Matrix<BaseFloat> gauss_loglikes_;  // Temporary: per-Gaussian loglikes.
+
 
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmDiagGmmUnmapped);
 };
@@ -109,6 +177,13 @@ class DecodableAmDiagGmm: public DecodableAmDiagGmmUnmapped {
     return LogLikelihoodZeroBased(frame,
                                   trans_model_.TransitionIdToPdf(tid));
   }
+  virtual void LogLikelihoods(int32 frame, const std::vector<int32> &tids,
+                              std::vector<BaseFloat> *loglikes) {
+    pdf_ids_.resize(tids.size());
+    for (size_t i = 0; i < tids.size(); i++)
+      pdf_ids_[i] = trans_model_.TransitionIdToPdf(tids[i]);
+    LogLikelihoodsForPdfs(frame, pdf_ids_, 1.0, loglikes);
+  }
   // Indices are one-based!  This is for compatibility with OpenFst.
   virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
 
@@ -143,6 +218,13 @@ class DecodableAmDiagGmmScaled: public DecodableAmDiagGmmUnmapped {
     return scale_*LogLikelihoodZeroBased(frame,
                                          trans_model_.TransitionIdToPdf(tid));
   }
+  virtual void LogLikelihoods(int32 frame, const std::vector<int32> &tids,
+                              std::vector<BaseFloat> *loglikes) {
+    pdf_ids_.resize(tids.size());
+    for (size_t i = 0; i < tids.size(); i++)
+      pdf_ids_[i] = trans_model_.TransitionIdToPdf(tids[i]);
+    LogLikelihoodsForPdfs(frame, pdf_ids_, scale_, loglikes);
+  }
   // Indices are one-based!  This is for compatibility with OpenFst.
   virtual int32 NumIndices() const { return trans_model_.NumTransitionIds(); }
 
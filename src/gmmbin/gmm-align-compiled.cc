@@ -52,6 +52,7 @@ int main(int argc, char *argv[]) {
     BaseFloat acoustic_scale = 1.0;
     BaseFloat transition_scale = 1.0;
     BaseFloat self_loop_scale = 1.0;
+    int32 batch_frames = 0;
     std::string per_frame_acwt_wspecifier;
 
     align_config.Register(&po);
@@ -64,6 +65,10 @@ int main(int argc, char *argv[]) {
     po.Register("write-per-frame-acoustic-loglikes", &per_frame_acwt_wspecifier,
                 "Wspecifier for table of vectors containing the acoustic log-likelihoods "
                 "per frame for each utterance. E.g. ark:foo/per_frame_logprobs.1.ark");
+    po.Register("batch-frames", &batch_frames, "If >0, compute GMM "
+                "likelihoods in batches of this many frames, evaluating the "
+                "Gaussians needed together with one matrix multiplication "
+                "(faster for large models).");
     po.Read(argc, argv);
 
     if (po.NumArgs() < 4 || po.NumArgs() > 5) {
@@ -85,6 +90,9 @@ int main(int argc, char *argv[]) {
       trans_model.Read(ki.Stream(), binary);
       am_gmm.Read(ki.Stream(), binary);
     }
+    StackedAmDiagGmm *stacked_gmm = NULL;
+    if (batch_frames > 0)
+      stacked_gmm = new StackedAmDiagGmm(am_gmm);
 
     SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_rspecifier);
     RandomAccessBaseFloatMatrixReader feature_reader(feature_rspecifier);
@@ -123,6 +131,8 @@ int main(int argc, char *argv[]) {
 
         DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
                                                acoustic_scale);
+        if (stacked_gmm != NULL)
+          gmm_decodable.SetBatchComputation(stacked_gmm, batch_frames);
 
         KALDI_LOG << utt;
         AlignUtteranceWrapper(align_config, utt,
@@ -132,6 +142,7 @@ int main(int argc, char *argv[]) {
                               &tot_like, &frame_count, &per_frame_acwt_writer);
       }
     }
+    delete stacked_gmm;
     KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count)
               << " over " << frame_count<< " frames.";
     KALDI_LOG << "Retried " << num_retry << " out of "
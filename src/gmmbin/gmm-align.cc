@@ -49,11 +49,15 @@ int main(int argc, char *argv[]) {
     BaseFloat acoustic_scale = 1.0;
     std::string disambig_rxfilename;
     TrainingGraphCompilerOptions gopts;
+    int32 batch_size = 50;
 
     align_config.Register(&po);
     po.Register("acoustic-scale", &acoustic_scale, "Scaling factor for acoustic likelihoods");
     po.Register("read-disambig-syms", &disambig_rxfilename, "File containing "
                 "list of disambiguation symbols in phone symbol table");
+    po.Register("batch-size", &batch_size, "Number of utterances whose graphs "
+                "are compiled at a time (see also --num-threads).  More is "
+                "faster but uses more memory.");
 
     gopts.Register(&po);
     po.Read(argc, argv);
@@ -103,39 +107,48 @@ int main(int argc, char *argv[]) {
     int32 num_done = 0, num_err = 0, num_retry = 0;
     double tot_like = 0.0;
     kaldi::int64 frame_count = 0;
-    for (; !feature_reader.Done(); feature_reader.Next()) {
-      std::string utt = feature_reader.Key();
-      if (!transcript_reader.HasKey(utt)) {
-        KALDI_WARN << "No transcript found for utterance " << utt;
-        num_err++;
-        continue;
+    while (!feature_reader.Done()) {
+      std::vector<std::string> utts;
+      std::vector<std::vector<int32> > transcripts;
+      std::vector<Matrix<BaseFloat>*> features;
+      for (; !feature_reader.Done() &&
+               static_cast<int32>(utts.size()) < std::max(batch_size, 1);
+           feature_reader.Next()) {
+        std::string utt = feature_reader.Key();
+        if (!transcript_reader.HasKey(utt)) {
+          KALDI_WARN << "No transcript found for utterance " << utt;
+          num_err++;
+          continue;
+        }
+        const Matrix<BaseFloat> &feats = feature_reader.Value();
+        if (feats.NumRows() == 0) {
+          KALDI_WARN << "Zero-length features for utterance: " << utt;
+          num_err++;
+          continue;
+        }
+        utts.push_back(utt);
+        transcripts.push_back(transcript_reader.Value(utt));
+        features.push_back(new Matrix<BaseFloat>(feats));
       }
 
-      const Matrix<BaseFloat> &features = feature_reader.Value();
-      const std::vector<int32> &transcript = transcript_reader.Value(utt);
-
-      VectorFst<StdArc> decode_fst;
-      if (!gc.CompileGraphFromText(transcript, &decode_fst)) {
-        KALDI_WARN << "Problem creating decoding graph for utterance "
-                   << utt <<" [serious error]";
-        num_err++;
-        continue;
-      }
-      if (features.NumRows() == 0) {
-        KALDI_WARN << "Zero-length features for utterance: " << utt;
-        num_err++;
-        continue;
+      std::vector<VectorFst<StdArc>*> decode_fsts;
+      if (!gc.CompileGraphsFromText(transcripts, &decode_fsts))
+        KALDI_ERR << "Not expecting CompileGraphs to fail.";
+      KALDI_ASSERT(decode_fsts.size() == utts.size());
+
+      for (size_t i = 0; i < utts.size(); i++) {
+        DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model,
+                                               *(features[i]),
+                                               acoustic_scale);
+
+        AlignUtteranceWrapper(align_config, utts[i],
+                              acoustic_scale, decode_fsts[i], &gmm_decodable,
+                              &alignment_writer, NULL,
+                              &num_done, &num_err, &num_retry,
+                              &tot_like, &frame_count);
       }
-
-      DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
-                                             acoustic_scale);
-
-      
-      AlignUtteranceWrapper(align_config, utt,
-                            acoustic_scale, &decode_fst, &gmm_decodable,
-                            &alignment_writer, NULL,
-                            &num_done, &num_err, &num_retry,
-                            &tot_like, &frame_count);
+      DeletePointers(&decode_fsts);
+      DeletePointers(&features);
     }
     KALDI_LOG << "Overall log-likelihood per frame is " << (tot_like/frame_count)
               << " over " << frame_count<< " frames.";
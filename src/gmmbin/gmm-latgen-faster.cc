@@ -47,6 +47,7 @@ int main(int argc, char *argv[]) {
     Timer timer;
     bool allow_partial = false;
     BaseFloat acoustic_scale = 0.1;
+    int32 batch_frames = 0;
     LatticeFasterDecoderConfig config;
 
     std::string word_syms_filename;
@@ -57,6 +58,10 @@ int main(int argc, char *argv[]) {
                 "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial,
                 "If true, produce output even if end state was not reached.");
+    po.Register("batch-frames", &batch_frames, "If >0, compute GMM "
+                "likelihoods in batches of this many frames, evaluating the "
+                "Gaussians needed together with one matrix multiplication "
+                "(faster for large models).");
 
     po.Read(argc, argv);
 
@@ -80,6 +85,9 @@ int main(int argc, char *argv[]) {
       trans_model.Read(ki.Stream(), binary);
       am_gmm.Read(ki.Stream(), binary);
     }
+    StackedAmDiagGmm *stacked_gmm = NULL;
+    if (batch_frames > 0)
+      stacked_gmm = new StackedAmDiagGmm(am_gmm);
 
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
@@ -124,6 +132,8 @@ int main(int argc, char *argv[]) {
 
           DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
                                                  acoustic_scale);
+          if (stacked_gmm != NULL)
+            gmm_decodable.SetBatchComputation(stacked_gmm, batch_frames);
 
           double like;
           if (DecodeUtteranceLatticeFaster(
@@ -159,6 +169,8 @@ int main(int argc, char *argv[]) {
         LatticeFasterDecoder decoder(fst_reader.Value(), config);
         DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
                                                acoustic_scale);
+        if (stacked_gmm != NULL)
+          gmm_decodable.SetBatchComputation(stacked_gmm, batch_frames);
         double like;
         if (DecodeUtteranceLatticeFaster(
                 decoder, gmm_decodable, trans_model, word_syms, utt,
@@ -172,6 +184,8 @@ int main(int argc, char *argv[]) {
       }
     }
 
+    delete stacked_gmm;
+
     double elapsed = timer.Elapsed();
     KALDI_LOG << "Time taken "<< elapsed
               << "s: real-time factor assuming 100 frames/sec is "
@@ -64,23 +64,24 @@ void WritePosterior(std::ostream &os, bool binary, const Posterior &post) {
 void ReadPosterior(std::istream &is, bool binary, Posterior *post) {
   post->clear();
   if (binary) {
+    BinaryReader reader(is);  // much faster than ReadBasicType(is, ...).
     int32 sz;
-    ReadBasicType(is, true, &sz);
+    reader.ReadBasicType(&sz);
     if (sz < 0 || sz > 10000000)
       KALDI_ERR << "Reading posterior: got negative or improbably large size"
                 << sz;
     post->resize(sz);
     for (Posterior::iterator iter = post->begin(); iter != post->end(); ++iter) {
       int32 sz2;
-      ReadBasicType(is, true, &sz2);
+      reader.ReadBasicType(&sz2);
       if (sz2 < 0)
         KALDI_ERR << "Reading posteriors: got negative size";
       iter->resize(sz2);
       for (std::vector<std::pair<int32, BaseFloat> >::iterator iter2=iter->begin();
            iter2 != iter->end();
            iter2++) {
-        ReadBasicType(is, true, &(iter2->first));
-        ReadBasicType(is, true, &(iter2->second));
+        reader.ReadBasicType(&(iter2->first));
+        reader.ReadBasicType(&(iter2->second));
       }
     }
   } else {
@@ -86,6 +86,18 @@ class DecodableInterface {
   /// before calling this.
   virtual BaseFloat LogLikelihood(int32 frame, int32 index) = 0;
 
+  /// Computes the log likelihoods of several indices on one frame, setting
+  /// (*loglikes)[i] to LogLikelihood(frame, indices[i]).  Decoders may call
+  /// this once per frame with all the indices they are going to need, which
+  /// lets the decodable object compute each underlying pdf once and compute
+  /// them together.  The default implementation just calls LogLikelihood().
+  virtual void LogLikelihoods(int32 frame, const std::vector<int32> &indices,
+                              std::vector<BaseFloat> *loglikes) {
+    loglikes->resize(indices.size());
+    for (size_t i = 0; i < indices.size(); i++)
+      (*loglikes)[i] = LogLikelihood(frame, indices[i]);
+  }
+
   /// Returns true if this is the last frame.  Frames are zero-based, so the
   /// first frame is zero.  IsLastFrame(-1) will return false, unless the file
   /// is empty (which is a case that I'm not sure all the code will handle, so
@@ -95,6 +95,56 @@ void TestCompactLatticeTableCross(bool binary) {
   }
 }
 
+// Write in the packed format, and read back as CompactLattice and as Lattice.
+void TestCompactLatticeTablePacked() {
+  int N = 10;
+  std::vector<CompactLattice*> lat_vec(N);
+  {
+    CompactLatticeWriter writer("ark,packed:tmpf"),
+        fst_writer("ark:tmpf_fst");
+    for (int i = 0; i < N; i++) {
+      std::string key = "key" + std::string(1, '0' + i);
+      lat_vec[i] = RandCompactLattice();
+      writer.Write(key, *(lat_vec[i]));
+      fst_writer.Write(key, *(lat_vec[i]));
+    }
+  }
+  {
+    std::ifstream packed_is("tmpf", std::ios_base::binary),
+        fst_is("tmpf_fst", std::ios_base::binary);
+    packed_is.seekg(0, std::ios_base::end);
+    fst_is.seekg(0, std::ios_base::end);
+    KALDI_LOG << "Packed archive is " << packed_is.tellg() << " bytes, vs. "
+              << fst_is.tellg() << " bytes in OpenFst format.";
+  }
+  SequentialCompactLatticeReader reader("ark:tmpf");
+  RandomAccessLatticeReader lat_reader("ark:tmpf");
+  for (int i = 0; i < N; i++, reader.Next()) {
+    KALDI_ASSERT(!reader.Done());
+    std::string key = "key" + std::string(1, '0' + i);
+    KALDI_ASSERT(reader.Key() == key);
+    KALDI_ASSERT(fst::Equal(reader.Value(), *(lat_vec[i])));
+    CompactLattice clat;
+    ConvertLattice(lat_reader.Value(key), &clat);
+    KALDI_ASSERT(fst::Equal(clat, *(lat_vec[i])));
+    delete lat_vec[i];
+  }
+  KALDI_ASSERT(reader.Done());
+  unlink("tmpf_fst");
+}
+
+// A packed lattice whose size field is corrupted must fail to read, without
+// trying to allocate that much memory.
+void TestPackedLatticeCorruptSize() {
+  std::ostringstream os;
+  WriteToken(os, true, "<PackedLattice>");
+  WriteBasicType(os, true, static_cast<int64>(1) << 31);
+  os << "abcdef";
+  std::istringstream is(os.str());
+  CompactLattice *clat = NULL;
+  KALDI_ASSERT(!ReadCompactLattice(is, true, &clat) && clat == NULL);
+}
+
 // Lattice, binary.
 void TestLatticeTable(bool binary) {
   LatticeWriter writer(binary ? "ark:tmpf" : "ark,t:tmpf");
@@ -167,6 +217,8 @@ int main() {
     TestLatticeTable(binary);
     TestLatticeTableCross(binary);
   }
+  TestCompactLatticeTablePacked();
+  TestPackedLatticeCorruptSize();
   std::cout << "Test OK\n";
   
   unlink("tmpf");
@@ -59,6 +59,21 @@ Lattice* ConvertToLattice(Lattice *ifst) {
 }
 
 
+// Flags used in the packed lattice format.  Each state starts with a byte of
+// flags, where kPackedFinal says whether it is final and the weight flags
+// describe the final-weight; each arc starts with a byte with
+// kPackedOlabel and the weight flags.  Costs that are zero and strings that
+// are empty are not written.
+enum {
+  kPackedFinal = 1,
+  kPackedOlabel = 1,  // olabel differs from ilabel and is written.
+  kPackedGraphCost = 2,
+  kPackedAcousticCost = 4,
+  kPackedString = 8
+};
+
+static const char *kPackedLatticeToken = "<PackedLattice>";
+
 bool WriteCompactLattice(std::ostream &os, bool binary,
                          const CompactLattice &t) {
   if (binary) {
@@ -304,7 +319,9 @@ Lattice *ReadLatticeText(std::istream &is) {
 bool ReadCompactLattice(std::istream &is, bool binary,
                         CompactLattice **clat) {
   KALDI_ASSERT(*clat == NULL);
-  if (binary) {
+  if (binary && is.peek() == kPackedLatticeToken[0]) {
+    return ReadPackedCompactLattice(is, clat);
+  } else if (binary) {
     fst::FstHeader hdr;
     if (!hdr.Read(is, "<unknown>")) {
       KALDI_WARN << "Reading compact lattice: error reading FST header.";
@@ -363,6 +380,249 @@ bool ReadCompactLattice(std::istream &is, bool binary,
 }
 
 
+static inline void PutVarint(uint64 value, std::string *buf) {
+  while (value >= 128) {
+    buf->push_back(static_cast<char>((value & 127) | 128));
+    value >>= 7;
+  }
+  buf->push_back(static_cast<char>(value));
+}
+
+// Labels are written as unsigned 32-bit values, so that (unexpected) negative
+// labels still round-trip.
+static inline void PutLabel(int32 label, std::string *buf) {
+  PutVarint(static_cast<uint32>(label), buf);
+}
+
+static inline int PackedWeightFlags(const CompactLatticeWeight &w) {
+  return (w.Weight().Value1() != 0.0 ? kPackedGraphCost : 0) |
+      (w.Weight().Value2() != 0.0 ? kPackedAcousticCost : 0) |
+      (w.String().empty() ? 0 : kPackedString);
+}
+
+static void PutPackedWeight(const CompactLatticeWeight &w, int flags,
+                            std::string *buf) {
+  BaseFloat costs[2] = { w.Weight().Value1(), w.Weight().Value2() };
+  if (flags & kPackedGraphCost)
+    buf->append(reinterpret_cast<const char*>(&(costs[0])), sizeof(BaseFloat));
+  if (flags & kPackedAcousticCost)
+    buf->append(reinterpret_cast<const char*>(&(costs[1])), sizeof(BaseFloat));
+  if (flags & kPackedString) {
+    // The string is written as (transition-id, repeat-count) pairs.
+    const std::vector<int32> &str = w.String();
+    size_t num_runs = 1;
+    for (size_t i = 1; i < str.size(); i++)
+      if (str[i] != str[i - 1]) num_runs++;
+    PutVarint(num_runs, buf);
+    size_t i = 0;
+    while (i < str.size()) {
+      size_t j = i + 1;
+      while (j < str.size() && str[j] == str[i]) j++;
+      PutLabel(str[i], buf);
+      PutVarint(j - i, buf);
+      i = j;
+    }
+  }
+}
+
+bool WritePackedCompactLattice(std::ostream &os, const CompactLattice &clat) {
+  typedef CompactLattice::StateId StateId;
+  std::string buf;
+  buf.push_back(static_cast<char>(sizeof(BaseFloat)));
+  StateId num_states = clat.NumStates();
+  PutVarint(num_states, &buf);
+  PutVarint(clat.Start() + 1, &buf);  // kNoStateId (-1) becomes 0.
+  for (StateId s = 0; s < num_states; s++) {
+    const CompactLatticeWeight &final_weight = clat.Final(s);
+    bool is_final = (final_weight != CompactLatticeWeight::Zero());
+    int flags = (is_final ? kPackedFinal | PackedWeightFlags(final_weight) : 0);
+    buf.push_back(static_cast<char>(flags));
+    PutVarint(clat.NumArcs(s), &buf);
+    if (is_final)
+      PutPackedWeight(final_weight, flags, &buf);
+    for (fst::ArcIterator<CompactLattice> aiter(clat, s); !aiter.Done();
+         aiter.Next()) {
+      const CompactLatticeArc &arc = aiter.Value();
+      int arc_flags = PackedWeightFlags(arc.weight) |
+          (arc.olabel != arc.ilabel ? kPackedOlabel : 0);
+      buf.push_back(static_cast<char>(arc_flags));
+      // Most arcs go to a nearby state, so we write the zigzag-encoded
+      // difference (0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...).
+      int64 delta = static_cast<int64>(arc.nextstate) - s;
+      PutVarint(delta >= 0 ? 2 * static_cast<uint64>(delta)
+                : 2 * static_cast<uint64>(-delta) - 1, &buf);
+      PutLabel(arc.ilabel, &buf);
+      if (arc_flags & kPackedOlabel)
+        PutLabel(arc.olabel, &buf);
+      PutPackedWeight(arc.weight, arc_flags, &buf);
+    }
+  }
+  try {
+    WriteToken(os, true, kPackedLatticeToken);
+    WriteBasicType(os, true, static_cast<int64>(buf.size()));
+    os.write(buf.data(), buf.size());
+    return os.good();
+  } catch (const std::exception &e) {
+    KALDI_WARN << "Exception caught writing packed lattice. " << e.what();
+    return false;
+  }
+}
+
+/// PackedLatticeDecoder decodes the data of a packed lattice (written by
+/// WritePackedCompactLattice()) from memory; it throws on error.
+class PackedLatticeDecoder {
+  typedef CompactLattice::StateId StateId;
+ public:
+  PackedLatticeDecoder(const char *data, size_t size):
+      cur_(reinterpret_cast<const unsigned char*>(data)), end_(cur_ + size),
+      cost_size_(0) { }
+
+  CompactLattice *Decode() {
+    cost_size_ = GetByte();
+    if (cost_size_ != sizeof(float) && cost_size_ != sizeof(double))
+      KALDI_ERR << "Invalid cost size " << cost_size_;
+    uint64 num_states = GetVarint();
+    // Every state takes at least 2 bytes, which protects us from trying to
+    // allocate a huge lattice if the data is corrupted.
+    if (num_states > static_cast<uint64>(end_ - cur_))
+      KALDI_ERR << "Invalid number of states " << num_states;
+    int64 start = static_cast<int64>(GetVarint()) - 1;
+    if (start >= static_cast<int64>(num_states))
+      KALDI_ERR << "Invalid start state " << start;
+    CompactLattice *clat = new CompactLattice();
+    try {
+      clat->ReserveStates(num_states);
+      for (uint64 s = 0; s < num_states; s++)
+        clat->AddState();
+      if (start >= 0)
+        clat->SetStart(start);
+      for (StateId s = 0; s < static_cast<StateId>(num_states); s++) {
+        int flags = GetByte();
+        uint64 num_arcs = GetVarint();
+        if (num_arcs > static_cast<uint64>(end_ - cur_))
+          KALDI_ERR << "Invalid number of arcs " << num_arcs;
+        if (flags & kPackedFinal)
+          clat->SetFinal(s, GetWeight(flags));
+        clat->ReserveArcs(s, num_arcs);
+        for (uint64 a = 0; a < num_arcs; a++) {
+          int arc_flags = GetByte();
+          uint64 zigzag = GetVarint();
+          int64 nextstate = s + ((zigzag & 1) ? -static_cast<int64>(zigzag >> 1)
+                                 - 1 : static_cast<int64>(zigzag >> 1));
+          if (nextstate < 0 || nextstate >= static_cast<int64>(num_states))
+            KALDI_ERR << "Invalid next-state " << nextstate;
+          CompactLatticeArc arc;
+          arc.ilabel = GetLabel();
+          arc.olabel = ((arc_flags & kPackedOlabel) ? GetLabel() : arc.ilabel);
+          arc.weight = GetWeight(arc_flags);
+          arc.nextstate = nextstate;
+          clat->AddArc(s, arc);
+        }
+      }
+      if (cur_ != end_)
+        KALDI_ERR << "Unexpected data after the end of the lattice";
+    } catch (...) {
+      delete clat;
+      throw;
+    }
+    return clat;
+  }
+
+ private:
+  int GetByte() {
+    if (cur_ == end_)
+      KALDI_ERR << "Unexpected end of data";
+    return *(cur_++);
+  }
+
+  uint64 GetVarint() {
+    uint64 ans = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      int b = GetByte();
+      ans |= static_cast<uint64>(b & 127) << shift;
+      if (b < 128)
+        return ans;
+    }
+    KALDI_ERR << "Invalid variable-length integer";
+    return 0;
+  }
+
+  int32 GetLabel() {
+    return static_cast<int32>(static_cast<uint32>(GetVarint()));
+  }
+
+  BaseFloat GetCost() {
+    if (static_cast<size_t>(end_ - cur_) < cost_size_)
+      KALDI_ERR << "Unexpected end of data";
+    BaseFloat ans;
+    if (cost_size_ == sizeof(float)) {
+      float f;
+      memcpy(&f, cur_, sizeof(f));
+      ans = f;
+    } else {
+      double d;
+      memcpy(&d, cur_, sizeof(d));
+      ans = d;
+    }
+    cur_ += cost_size_;
+    return ans;
+  }
+
+  CompactLatticeWeight GetWeight(int flags) {
+    BaseFloat graph_cost = ((flags & kPackedGraphCost) ? GetCost() : 0.0),
+        acoustic_cost = ((flags & kPackedAcousticCost) ? GetCost() : 0.0);
+    std::vector<int32> str;
+    if (flags & kPackedString) {
+      uint64 num_runs = GetVarint();
+      if (num_runs > static_cast<uint64>(end_ - cur_))
+        KALDI_ERR << "Invalid number of runs " << num_runs;
+      for (uint64 r = 0; r < num_runs; r++) {
+        int32 tid = GetLabel();
+        uint64 count = GetVarint();
+        if (count == 0 || str.size() + count > 10000000)
+          KALDI_ERR << "Invalid or improbably large repeat count " << count;
+        str.insert(str.end(), count, tid);
+      }
+    }
+    return CompactLatticeWeight(LatticeWeight(graph_cost, acoustic_cost),
+                                str);
+  }
+
+  const unsigned char *cur_;
+  const unsigned char *end_;
+  size_t cost_size_;
+};
+
+bool ReadPackedCompactLattice(std::istream &is, CompactLattice **clat) {
+  KALDI_ASSERT(*clat == NULL);
+  try {
+    std::vector<char> buf;
+    BinaryReader reader(is);
+    reader.ExpectToken(kPackedLatticeToken);
+    int64 size;
+    reader.ReadBasicType(&size);
+    // 'size' comes from the stream, so we don't trust it: we read the data in
+    // chunks, so that if it is corrupted we reach the end of the stream
+    // instead of allocating a huge buffer first.
+    const int64 max_size = static_cast<int64>(1) << 32,
+        chunk_size = 1 << 20;
+    if (size < 3 || size > max_size)
+      KALDI_ERR << "Invalid size " << size;
+    for (int64 pos = 0; pos < size; pos += chunk_size) {
+      int64 this_size = std::min(chunk_size, size - pos);
+      buf.resize(pos + this_size);
+      reader.ReadBytes(&(buf[pos]), this_size);
+    }
+    PackedLatticeDecoder decoder(&(buf[0]), size);
+    *clat = decoder.Decode();
+    return true;
+  } catch (const std::exception &e) {
+    KALDI_WARN << "Error reading packed lattice: " << e.what();
+    return false;
+  }
+}
+
+
 bool CompactLatticeHolder::Read(std::istream &is) {
   Clear(); // in case anything currently stored.
   int c = is.peek();
@@ -374,8 +634,9 @@ bool CompactLatticeHolder::Read(std::istream &is) {
     // cannot begin with space because it starts with the FST Type() which is not
     // space).
     return ReadCompactLattice(is, false, &t_);
-  } else if (c != 214) { // 214 is first char of FST magic number,
-    // on little-endian machines which is all we support (\326 octal)
+  } else if (c != 214 && c != kPackedLatticeToken[0]) {
+    // 214 is first char of FST magic number, on little-endian machines which
+    // is all we support (\326 octal); '<' starts the packed format.
     KALDI_WARN << "Reading compact lattice: does not appear to be an FST "
                << " [non-space but no magic number detected], file pos is "
                << is.tellg();
@@ -417,7 +678,13 @@ bool WriteLattice(std::ostream &os, bool binary, const Lattice &t) {
 bool ReadLattice(std::istream &is, bool binary,
                  Lattice **lat) {
   KALDI_ASSERT(*lat == NULL);
-  if (binary) {
+  if (binary && is.peek() == kPackedLatticeToken[0]) {
+    CompactLattice *clat = NULL;
+    if (!ReadPackedCompactLattice(is, &clat))
+      return false;
+    *lat = ConvertToLattice(clat);  // note: this frees clat.
+    return true;
+  } else if (binary) {
     fst::FstHeader hdr;
     if (!hdr.Read(is, "<unknown>")) {
       KALDI_WARN << "Reading lattice: error reading FST header.";
@@ -490,8 +757,9 @@ bool LatticeHolder::Read(std::istream &is) {
     // cannot begin with space because it starts with the FST Type() which is not
     // space).
     return ReadLattice(is, false, &t_);
-  } else if (c != 214) { // 214 is first char of FST magic number,
-    // on little-endian machines which is all we support (\326 octal)
+  } else if (c != 214 && c != kPackedLatticeToken[0]) {
+    // 214 is first char of FST magic number, on little-endian machines which
+    // is all we support (\326 octal); '<' starts the packed format.
     KALDI_WARN << "Reading compact lattice: does not appear to be an FST "
                << " [non-space but no magic number detected], file pos is "
                << is.tellg();
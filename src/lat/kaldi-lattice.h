@@ -66,6 +66,21 @@ bool ReadLattice(std::istream &is, bool binary,
                  Lattice **lat);
 
 
+/// Writes a CompactLattice in the "packed" binary format, which is much
+/// smaller than OpenFst's binary format and faster to read.  State ids are
+/// written as deltas from the source state and labels, counts and string
+/// elements as variable-length integers; the costs are written exactly, and
+/// the transition-id strings are run-length encoded (their elements mostly
+/// repeat because of self-loops).  The result cannot be read by OpenFst, but
+/// ReadCompactLattice(), ReadLattice() and the holders below recognize it, so
+/// programs only need to be told to write it (with the "packed" wspecifier
+/// option, see kaldi-table.h).  Returns false on stream failure.
+bool WritePackedCompactLattice(std::ostream &os, const CompactLattice &clat);
+
+/// Reads a lattice written by WritePackedCompactLattice(); *clat must be NULL
+/// when called.  Returns false (with a warning) on error.
+bool ReadPackedCompactLattice(std::istream &is, CompactLattice **clat);
+
 class CompactLatticeHolder {
  public:
   typedef CompactLattice T;
@@ -142,6 +157,16 @@ class LatticeHolder {
   T *t_;
 };
 
+/// Writes CompactLattices in the packed format when the "packed" wspecifier
+/// option is given; see WriteHolderObject() in util/kaldi-holder-inl.h.
+inline bool WriteHolderObject(std::ostream &os, bool binary, bool packed,
+                              const CompactLattice &t,
+                              const CompactLatticeHolder *holder_type) {
+  if (binary && packed)
+    return WritePackedCompactLattice(os, t);
+  return CompactLatticeHolder::Write(os, binary, t);
+}
+
 typedef TableWriter<LatticeHolder> LatticeWriter;
 typedef SequentialTableReader<LatticeHolder> SequentialLatticeReader;
 typedef RandomAccessTableReader<LatticeHolder> RandomAccessLatticeReader;
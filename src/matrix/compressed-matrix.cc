@@ -21,13 +21,235 @@
 
 #include "matrix/compressed-matrix.h"
 #include <algorithm>
+#include <cstring>
+#include <limits>
 
 namespace kaldi {
 
+// The following is used for the entropy coding of format kRowBlocked.  It is
+// an adaptive binary range coder, of the kind used in LZMA: each binary
+// decision is coded with a probability (out of 1 << kRangeNumProbBits) that
+// adapts to the data coded so far.
+static const int32 kRangeNumProbBits = 11;
+static const uint16 kRangeProbInit = 1 << (kRangeNumProbBits - 1);
+static const int32 kRangeAdaptShift = 5;
+static const uint32 kRangeTopValue = 1 << 24;
+
+static inline void UpdateRangeProb(uint32 bit, uint16 *prob) {
+  if (bit == 0)
+    *prob += ((1 << kRangeNumProbBits) - *prob) >> kRangeAdaptShift;
+  else
+    *prob -= *prob >> kRangeAdaptShift;
+}
+
+class RangeEncoder {
+ public:
+  explicit RangeEncoder(std::vector<char> *output):
+      output_(output), low_(0), range_(0xFFFFFFFFu), cache_(0),
+      cache_size_(1) { }
+
+  void EncodeBit(uint32 bit, uint16 *prob) {
+    uint32 bound = (range_ >> kRangeNumProbBits) * *prob;
+    if (bit == 0) {
+      range_ = bound;
+    } else {
+      low_ += bound;
+      range_ -= bound;
+    }
+    UpdateRangeProb(bit, prob);
+    while (range_ < kRangeTopValue) {
+      range_ <<= 8;
+      ShiftLow();
+    }
+  }
+
+  // Must be called after the last bit.
+  void Finish() {
+    for (int32 i = 0; i < 5; i++)
+      ShiftLow();
+  }
+
+ private:
+  // Outputs the top byte of low_, dealing with carries: a run of 0xFF bytes
+  // is held back (in cache_ and cache_size_) until we know whether a carry
+  // will propagate into it.
+  void ShiftLow() {
+    if (static_cast<uint32>(low_) < 0xFF000000u || (low_ >> 32) != 0) {
+      uint8 carry = static_cast<uint8>(low_ >> 32), temp = cache_;
+      do {
+        output_->push_back(static_cast<char>(static_cast<uint8>(temp + carry)));
+        temp = 0xFF;
+      } while (--cache_size_ != 0);
+      cache_ = static_cast<uint8>(low_ >> 24);
+    }
+    cache_size_++;
+    low_ = (low_ & 0x00FFFFFFu) << 8;
+  }
+
+  std::vector<char> *output_;
+  uint64 low_;
+  uint32 range_;
+  uint8 cache_;
+  int64 cache_size_;
+};
+
+class RangeDecoder {
+ public:
+  RangeDecoder(const char *data, int32 num_bytes):
+      data_(reinterpret_cast<const uint8*>(data)), end_(data_ + num_bytes),
+      range_(0xFFFFFFFFu), code_(0) {
+    for (int32 i = 0; i < 5; i++)
+      code_ = (code_ << 8) | NextByte();
+  }
+
+  uint32 DecodeBit(uint16 *prob) {
+    uint32 bound = (range_ >> kRangeNumProbBits) * *prob, bit;
+    if (code_ < bound) {
+      range_ = bound;
+      bit = 0;
+    } else {
+      code_ -= bound;
+      range_ -= bound;
+      bit = 1;
+    }
+    UpdateRangeProb(bit, prob);
+    while (range_ < kRangeTopValue) {
+      range_ <<= 8;
+      code_ = (code_ << 8) | NextByte();
+    }
+    return bit;
+  }
+
+ private:
+  // Past the end of the data (which can only happen for corrupted data) we
+  // return zeros rather than crash.
+  uint32 NextByte() { return (data_ < end_ ? *(data_++) : 0); }
+
+  const uint8 *data_;
+  const uint8 *end_;
+  uint32 range_;
+  uint32 code_;
+};
+
+// The integers we code (the differences between the quantized values of
+// successive rows) are mapped to unsigned ones as 0, -1, 1, -2, 2 ... -> 0,
+// 1, 2, 3, 4 ..., and u + 1 is coded as its number of bits n (in unary),
+// followed by its bits after the leading one.  The unary code is conditioned
+// on a context, which is the number of bits of the previous integer of the
+// same column (so it follows the local variability of the features); the
+// last context is for the first integer of each column in a block, which is
+// coded on its own.  The probabilities are reset for each block of rows.
+static const int32 kMaxIntBits = 33;
+static const int32 kNumIntContexts = 16;
+
+struct IntegerModel {
+  uint16 num_bits_probs[kNumIntContexts][kMaxIntBits];
+  uint16 bit_probs[kMaxIntBits][kMaxIntBits];
+  IntegerModel() {
+    std::fill(&(num_bits_probs[0][0]),
+              &(num_bits_probs[0][0]) + kNumIntContexts * kMaxIntBits,
+              kRangeProbInit);
+    std::fill(&(bit_probs[0][0]),
+              &(bit_probs[0][0]) + kMaxIntBits * kMaxIntBits,
+              kRangeProbInit);
+  }
+};
+
+// Codes 'value' and returns the context for the next integer of the column.
+static int32 EncodeInteger(int32 value, int32 context, IntegerModel *model,
+                           RangeEncoder *encoder) {
+  uint32 u = (static_cast<uint32>(value) << 1) ^
+      static_cast<uint32>(value >> 31);
+  uint64 x = static_cast<uint64>(u) + 1;
+  int32 num_bits = 0;
+  while ((x >> (num_bits + 1)) != 0)
+    num_bits++;
+  uint16 *num_bits_probs = model->num_bits_probs[context],
+      *bit_probs = model->bit_probs[num_bits];
+  for (int32 i = 0; i < num_bits; i++)
+    encoder->EncodeBit(1, &(num_bits_probs[i]));
+  encoder->EncodeBit(0, &(num_bits_probs[num_bits]));
+  for (int32 i = num_bits - 1; i >= 0; i--)
+    encoder->EncodeBit((x >> i) & 1, &(bit_probs[i]));
+  return std::min(num_bits, kNumIntContexts - 2);
+}
+
+// Decodes an integer coded by EncodeInteger(), and updates the context.
+static int32 DecodeInteger(int32 *context, IntegerModel *model,
+                           RangeDecoder *decoder) {
+  uint16 *num_bits_probs = model->num_bits_probs[*context];
+  int32 num_bits = 0;
+  while (decoder->DecodeBit(&(num_bits_probs[num_bits])) != 0) {
+    if (++num_bits == kMaxIntBits)
+      KALDI_ERR << "Corrupted compressed matrix.";
+  }
+  uint16 *bit_probs = model->bit_probs[num_bits];
+  uint64 x = 1;
+  for (int32 i = num_bits - 1; i >= 0; i--)
+    x = (x << 1) | decoder->DecodeBit(&(bit_probs[i]));
+  uint32 u = static_cast<uint32>(x - 1);
+  *context = std::min(num_bits, kNumIntContexts - 2);
+  return static_cast<int32>((u >> 1) ^ (0u - (u & 1)));
+}
+
+// The quantization step of each column in format kRowBlocked is the
+// interquartile range of the column divided by this (cf. kSpeechFeature,
+// which uses 128 values for that range, but fewer for the tails).
+static const float kRowBlockedStepsPerIqr = 64.0;
+// The minimum step as a fraction of the range of the matrix; this keeps the
+// quantized values small enough to be exactly representable as floats.
+static const float kRowBlockedMinStep = 1.0 / (1 << 20);
+
+// Reads 'size' objects of type T from 'is' into 'vec'.  'size' comes from the
+// stream, so we don't trust it: we read in chunks of 1MB, so that if it is
+// corrupted we reach the end of the stream instead of allocating a huge
+// buffer first.
+template<typename T>
+static void ReadInChunks(std::istream &is, size_t size, std::vector<T> *vec) {
+  const size_t chunk_size = (1 << 20) / sizeof(T);
+  vec->clear();
+  for (size_t pos = 0; pos < size; pos += chunk_size) {
+    size_t this_size = std::min(chunk_size, size - pos);
+    vec->resize(pos + this_size);
+    is.read(reinterpret_cast<char*>(&((*vec)[pos])), sizeof(T) * this_size);
+    if (is.fail())
+      KALDI_ERR << "Failed to read data of compressed matrix.";
+  }
+}
+
+// Decodes the first 'num_cols_needed' columns of the block of rows of size
+// 'num_bytes' starting at 'block_data' (format kRowBlocked) into 'rows',
+// which will be a row-major array of size num-rows-in-block by num_cols.
+// Returns the number of rows in the block.
+static int32 DecodeRowBlock(float min_value, float range, int32 num_cols,
+                            const float *col_steps, const char *block_data,
+                            int32 num_bytes, int32 num_cols_needed,
+                            std::vector<float> *rows) {
+  uint16 num_rows;
+  KALDI_ASSERT(num_bytes >= static_cast<int32>(sizeof(num_rows)));
+  memcpy(&num_rows, block_data, sizeof(num_rows));
+  RangeDecoder decoder(block_data + sizeof(num_rows),
+                       num_bytes - sizeof(num_rows));
+  IntegerModel model;
+  rows->resize(num_rows * num_cols);
+  float *row_data = &((*rows)[0]);
+  for (int32 c = 0; c < num_cols_needed; c++) {
+    float step = range * col_steps[c];
+    int32 context = kNumIntContexts - 1, value = 0;
+    for (int32 r = 0; r < num_rows; r++) {
+      value += DecodeInteger(&context, &model, &decoder);
+      row_data[r * num_cols + c] = min_value + step * value;
+    }
+  }
+  return num_rows;
+}
+
+
 //static
 MatrixIndexT CompressedMatrix::DataSize(const GlobalHeader &header) {
   // Returns size in bytes of the data.
   DataFormat format = static_cast<DataFormat>(header.format);
+  KALDI_ASSERT(format != kRowBlocked);
   if (format == kOneByteWithColHeaders) {
     return sizeof(GlobalHeader) +
         header.num_cols * (sizeof(PerColHeader) + header.num_rows);
@@ -41,6 +263,35 @@ MatrixIndexT CompressedMatrix::DataSize(const GlobalHeader &header) {
   }
 }
 
+MatrixIndexT CompressedMatrix::StoredDataSize() const {
+  const GlobalHeader *h = reinterpret_cast<const GlobalHeader*>(data_);
+  if (static_cast<DataFormat>(h->format) != kRowBlocked)
+    return DataSize(*h);
+  const RowBlockHeader *block_header;
+  const float *col_steps;
+  const uint32 *offsets;
+  const char *blocks;
+  int32 num_blocks;
+  GetRowBlocks(&block_header, &col_steps, &offsets, &blocks, &num_blocks);
+  return (blocks - static_cast<const char*>(data_)) + offsets[num_blocks];
+}
+
+void CompressedMatrix::GetRowBlocks(const RowBlockHeader **block_header,
+                                    const float **col_steps,
+                                    const uint32 **offsets,
+                                    const char **blocks,
+                                    int32 *num_blocks) const {
+  const GlobalHeader *h = reinterpret_cast<const GlobalHeader*>(data_);
+  KALDI_ASSERT(static_cast<DataFormat>(h->format) == kRowBlocked);
+  *block_header = reinterpret_cast<const RowBlockHeader*>(h + 1);
+  int32 block_size = (*block_header)->block_size;
+  *num_blocks = ((*block_header)->row_shift + h->num_rows + block_size - 1) /
+      block_size;
+  *col_steps = reinterpret_cast<const float*>(*block_header + 1);
+  *offsets = reinterpret_cast<const uint32*>(*col_steps + h->num_cols);
+  *blocks = reinterpret_cast<const char*>(*offsets + *num_blocks + 1);
+}
+
 // scale all element of matrix by scaling floats
 // in GlobalHeader with alpha.
 void CompressedMatrix::Scale(float alpha) {
@@ -66,6 +317,9 @@ void CompressedMatrix::ComputeGlobalHeader(
     case kSpeechFeature:
       header->format = static_cast<int32>(kOneByteWithColHeaders);  // 1.
       break;
+    case kRowBlockedSpeechFeature:
+      header->format = static_cast<int32>(kRowBlocked);  // 4.
+      break;
     case kTwoByteAuto: case kTwoByteSignedInteger:
       header->format = static_cast<int32>(kTwoByte);  // 2.
       break;
@@ -82,7 +336,8 @@ void CompressedMatrix::ComputeGlobalHeader(
 
   // Now compute 'min_value' and 'range'.
   switch (method) {
-    case kSpeechFeature: case kTwoByteAuto: case kOneByteAuto: {
+    case kSpeechFeature: case kTwoByteAuto: case kOneByteAuto:
+    case kRowBlockedSpeechFeature: {
       float min_value = mat.Min(), max_value = mat.Max();
       // ensure that max_value is strictly greater than min_value, even if matrix is
       // constant; this avoids crashes in ComputeColHeader when compressing speech
@@ -138,6 +393,12 @@ void CompressedMatrix::CopyFromMat(
   GlobalHeader global_header;
   ComputeGlobalHeader(mat, method, &global_header);
 
+  if (static_cast<DataFormat>(global_header.format) ==
+      kRowBlocked) {
+    CopyFromMatRowBlocked(mat, global_header);
+    return;
+  }
+
   int32 data_size = DataSize(global_header);
 
   data_ = AllocateData(data_size);
@@ -186,6 +447,113 @@ void CompressedMatrix::CopyFromMat(
   }
 }
 
+char *CompressedMatrix::AllocateRowBlocked(
+    const GlobalHeader &global_header,
+    const RowBlockHeader &block_header,
+    const float *col_steps,
+    const std::vector<uint32> &offsets) {
+  KALDI_ASSERT(data_ == NULL && offsets.size() > 1 && offsets[0] == 0);
+  int32 steps_size = sizeof(float) * global_header.num_cols,
+      offsets_size = sizeof(uint32) * offsets.size();
+  data_ = AllocateData(sizeof(GlobalHeader) + sizeof(RowBlockHeader) +
+                       steps_size + offsets_size + offsets.back());
+  GlobalHeader *h = reinterpret_cast<GlobalHeader*>(data_);
+  *h = global_header;
+  RowBlockHeader *b = reinterpret_cast<RowBlockHeader*>(h + 1);
+  *b = block_header;
+  char *ptr = reinterpret_cast<char*>(b + 1);
+  memcpy(ptr, col_steps, steps_size);
+  memcpy(ptr + steps_size, &(offsets[0]), offsets_size);
+  return ptr + steps_size + offsets_size;
+}
+
+template<typename Real>
+void CompressedMatrix::CopyFromMatRowBlocked(
+    const MatrixBase<Real> &mat, const GlobalHeader &global_header) {
+  int32 num_rows = mat.NumRows(), num_cols = mat.NumCols(),
+      block_size = kRowBlockSize,
+      num_blocks = (num_rows + block_size - 1) / block_size;
+  // The step of each column is worked out from its interquartile range, for
+  // which we use the same code as kSpeechFeature.
+  std::vector<float> col_steps(num_cols);
+  for (int32 c = 0; c < num_cols; c++) {
+    PerColHeader header;
+    ComputeColHeader(global_header, mat.Data() + c, mat.Stride(), num_rows,
+                     &header);
+    col_steps[c] = std::max<float>(
+        (header.percentile_75 - header.percentile_25) /
+        (65535.0 * kRowBlockedStepsPerIqr), kRowBlockedMinStep);
+  }
+  std::vector<uint32> offsets(num_blocks + 1, 0);
+  std::vector<char> blocks;
+  for (int32 b = 0; b < num_blocks; b++) {
+    uint16 this_num_rows = std::min(block_size, num_rows - b * block_size);
+    const char *num_rows_ptr = reinterpret_cast<const char*>(&this_num_rows);
+    blocks.insert(blocks.end(), num_rows_ptr,
+                  num_rows_ptr + sizeof(this_num_rows));
+    RangeEncoder encoder(&blocks);
+    IntegerModel model;
+    for (int32 c = 0; c < num_cols; c++) {
+      float inv_step = 1.0 / (global_header.range * col_steps[c]),
+          max_value = global_header.range * inv_step;
+      int32 context = kNumIntContexts - 1, prev_value = 0;
+      for (int32 r = b * block_size; r < b * block_size + this_num_rows; r++) {
+        float f = (mat(r, c) - global_header.min_value) * inv_step;
+        if (f < 0.0) f = 0.0;  // Note: this should not happen.
+        if (f > max_value) f = max_value;  // Note: this should not happen.
+        int32 value = static_cast<int32>(f + 0.5);
+        // Neighboring frames are similar, so we code the difference from the
+        // previous row.
+        context = EncodeInteger(value - prev_value, context, &model, &encoder);
+        prev_value = value;
+      }
+    }
+    encoder.Finish();
+    offsets[b + 1] = blocks.size();
+  }
+  RowBlockHeader block_header;
+  block_header.block_size = block_size;
+  block_header.row_shift = 0;
+  char *block_data = AllocateRowBlocked(global_header, block_header,
+                                        &(col_steps[0]), offsets);
+  memcpy(block_data, &(blocks[0]), blocks.size());
+}
+
+template<typename Real>
+void CompressedMatrix::CopyRowBlocksToMat(int32 row_offset, int32 col_offset,
+                                          MatrixBase<Real> *dest) const {
+  const GlobalHeader *h = reinterpret_cast<const GlobalHeader*>(data_);
+  const RowBlockHeader *block_header;
+  const float *col_steps;
+  const uint32 *offsets;
+  const char *blocks;
+  int32 num_blocks;
+  GetRowBlocks(&block_header, &col_steps, &offsets, &blocks, &num_blocks);
+  int32 num_cols = h->num_cols, block_size = block_header->block_size,
+      tgt_rows = dest->NumRows(), tgt_cols = dest->NumCols();
+
+  std::vector<float> rows;
+  int32 row = 0;
+  while (row < tgt_rows) {
+    // 'stored_row' is the index of the row among the rows stored in the
+    // blocks.
+    int32 stored_row = row_offset + row + block_header->row_shift,
+        b = stored_row / block_size, block_begin = b * block_size;
+    KALDI_ASSERT(b < num_blocks);
+    int32 block_num_rows = DecodeRowBlock(
+        h->min_value, h->range, num_cols, col_steps, blocks + offsets[b],
+        offsets[b + 1] - offsets[b], col_offset + tgt_cols, &rows);
+    for (; row < tgt_rows && stored_row < block_begin + block_num_rows;
+         row++, stored_row++) {
+      const float *src = &(rows[(stored_row - block_begin) * num_cols +
+                                col_offset]);
+      Real *dest_row = dest->RowData(row);
+      for (int32 c = 0; c < tgt_cols; c++)
+        dest_row[c] = src[c];
+    }
+  }
+}
+
 // Instantiate the template for float and double.
 template
 void CompressedMatrix::CopyFromMat(const MatrixBase<float> &mat,
@@ -223,6 +591,54 @@ CompressedMatrix::CompressedMatrix(
   bool padding_is_used = (row_offset < 0 ||
                           row_offset + num_rows > old_num_rows);
 
+  const GlobalHeader *old_h =
+      reinterpret_cast<const GlobalHeader*>(cmat.Data());
+  if (static_cast<DataFormat>(old_h->format) == kRowBlocked) {
+    if (num_cols == old_num_cols && !padding_is_used) {
+      // Copy the blocks that contain the rows.
+      const RowBlockHeader *old_block_header;
+      const float *col_steps;
+      const uint32 *old_offsets;
+      const char *old_blocks;
+      int32 old_num_blocks;
+      cmat.GetRowBlocks(&old_block_header, &col_steps, &old_offsets,
+                        &old_blocks, &old_num_blocks);
+      int32 block_size = old_block_header->block_size,
+          stored_begin = row_offset + old_block_header->row_shift,
+          begin_block = stored_begin / block_size,
+          end_block = (stored_begin + num_rows + block_size - 1) / block_size;
+      std::vector<uint32> offsets(end_block - begin_block + 1);
+      for (size_t i = 0; i < offsets.size(); i++)
+        offsets[i] = old_offsets[begin_block + i] - old_offsets[begin_block];
+      GlobalHeader new_h(*old_h);
+      new_h.num_rows = num_rows;
+      RowBlockHeader block_header;
+      block_header.block_size = block_size;
+      block_header.row_shift = stored_begin - begin_block * block_size;
+      char *block_data = AllocateRowBlocked(new_h, block_header, col_steps,
+                                            offsets);
+      memcpy(block_data, old_blocks + old_offsets[begin_block],
+             offsets.back());
+    } else {
+      // Decompress the rows we need and recompress with kTwoByteAuto, which
+      // gives almost exact reconstruction.
+      int32 begin = std::max<int32>(row_offset, 0),
+          end = std::max<int32>(begin + 1, std::min<int32>(
+              row_offset + num_rows, old_num_rows));
+      Matrix<float> rows(end - begin, num_cols, kUndefined),
+          temp(num_rows, num_cols, kUndefined);
+      cmat.CopyRowBlocksToMat(begin, col_offset, &rows);
+      for (int32 r = 0; r < num_rows; r++) {
+        int32 old_r = std::min<int32>(std::max<int32>(r + row_offset, 0),
+                                      old_num_rows - 1);
+        temp.Row(r).CopyFromVec(rows.Row(old_r - begin));
+      }
+      CompressedMatrix temp_cmat(temp, kTwoByteAuto);
+      this->Swap(&temp_cmat);
+    }
+    return;
+  }
+
   GlobalHeader new_global_header;
   KALDI_COMPILE_TIME_ASSERT(sizeof(new_global_header) == 20);
 
@@ -539,8 +955,10 @@ void CompressedMatrix::Write(std::ostream &os, bool binary) const {
         WriteToken(os, binary, "CM2");
       } else if (format == kOneByte) {
         WriteToken(os, binary, "CM3");
+      } else if (format == kRowBlocked) {
+        WriteToken(os, binary, "CM4");
       }
-      MatrixIndexT size = DataSize(h);  // total size of data in data_
+      MatrixIndexT size = StoredDataSize();  // total size of data in data_
       // We don't write out the "int32 format", hence the + 4, - 4.
       os.write(reinterpret_cast<const char*>(data_) + 4, size - 4);
     } else {  // special case: where data_ == NULL, we treat it as an empty
@@ -577,8 +995,10 @@ void CompressedMatrix::Read(std::istream &is, bool binary) {
       if (tok == "CM") { h.format = 1; } //  kOneByteWithColHeaders
       else if (tok == "CM2") { h.format = 2; }  // kTwoByte
       else if (tok == "CM3") { h.format = 3; }  // kOneByte
+      else if (tok == "CM4") { h.format = 4; }  // kRowBlocked
       else {
-        KALDI_ERR << "Unexpected token " << tok << ", expecting CM, CM2 or CM3";
+        KALDI_ERR << "Unexpected token " << tok
+                  << ", expecting CM, CM2, CM3 or CM4";
       }
       // don't read the "format" -> hence + 4, - 4.
       is.read(reinterpret_cast<char*>(&h) + 4, sizeof(h) - 4);
@@ -586,6 +1006,19 @@ void CompressedMatrix::Read(std::istream &is, bool binary) {
         KALDI_ERR << "Failed to read header";
       if (h.num_cols == 0) // empty matrix.
         return;
+      if (h.format == kRowBlocked) {
+        RowBlockHeader block_header;
+        std::vector<float> col_steps;
+        std::vector<uint32> offsets;
+        ReadRowBlockIndex(is, h, &block_header, &col_steps, &offsets);
+        std::vector<char> blocks;
+        ReadInChunks(is, offsets.back(), &blocks);
+        CheckRowBlocks(h, block_header, offsets, &(blocks[0]));
+        char *block_data = AllocateRowBlocked(h, block_header,
+                                              &(col_steps[0]), offsets);
+        memcpy(block_data, &(blocks[0]), blocks.size());
+        return;
+      }
       int32 size = DataSize(h), remaining_size = size - sizeof(GlobalHeader);
       data_ = AllocateData(size);
       *(reinterpret_cast<GlobalHeader*>(data_)) = h;
@@ -610,6 +1043,158 @@ void CompressedMatrix::Read(std::istream &is, bool binary) {
     KALDI_ERR << "Failed to read data.";
 }
 
+// static
+void CompressedMatrix::ReadRowBlockIndex(std::istream &is,
+                                         const GlobalHeader &h,
+                                         RowBlockHeader *block_header,
+                                         std::vector<float> *col_steps,
+                                         std::vector<uint32> *offsets) {
+  is.read(reinterpret_cast<char*>(block_header), sizeof(*block_header));
+  int32 block_size = block_header->block_size,
+      row_shift = block_header->row_shift;
+  if (is.fail() || block_size <= 0 || row_shift < 0 ||
+      row_shift >= block_size || h.num_rows <= 0 || h.num_cols <= 0)
+    KALDI_ERR << "Failed to read header of compressed matrix.";
+  // The number of rows of each block is stored as a uint16.
+  if (block_size > std::numeric_limits<uint16>::max())
+    KALDI_ERR << "Invalid block size " << block_size
+              << " in compressed matrix.";
+  int32 num_blocks = (static_cast<int64>(row_shift) + h.num_rows +
+                      block_size - 1) / block_size;
+  ReadInChunks(is, h.num_cols, col_steps);
+  ReadInChunks(is, num_blocks + 1, offsets);
+  // Each block has at least its number of rows, so the offsets must increase
+  // by at least that much; this also rules out overlapping blocks and
+  // negative sizes.
+  if ((*offsets)[0] != 0)
+    KALDI_ERR << "Invalid block offsets in compressed matrix.";
+  for (int32 b = 0; b < num_blocks; b++)
+    if ((*offsets)[b + 1] < (*offsets)[b] ||
+        (*offsets)[b + 1] - (*offsets)[b] < sizeof(uint16))
+      KALDI_ERR << "Invalid block offsets in compressed matrix.";
+  // AllocateRowBlocked() allocates all of this in one int32-sized piece.
+  int64 total_size = sizeof(GlobalHeader) + sizeof(RowBlockHeader) +
+      sizeof(float) * static_cast<int64>(h.num_cols) +
+      sizeof(uint32) * static_cast<int64>(num_blocks + 1) + offsets->back();
+  if (total_size > std::numeric_limits<int32>::max() / 2)
+    KALDI_ERR << "Compressed matrix is too large (" << total_size
+              << " bytes); the data is probably corrupted.";
+}
+
+// static
+void CompressedMatrix::CheckRowBlocks(const GlobalHeader &h,
+                                      const RowBlockHeader &block_header,
+                                      const std::vector<uint32> &offsets,
+                                      const char *blocks) {
+  // Every block but the last is full; the last has at least the remaining
+  // rows, and may have more if the matrix is a range of another one.
+  int32 block_size = block_header.block_size,
+      num_blocks = offsets.size() - 1,
+      num_stored_rows = block_header.row_shift + h.num_rows;
+  for (int32 b = 0; b < num_blocks; b++) {
+    uint16 num_rows;
+    memcpy(&num_rows, blocks + offsets[b], sizeof(num_rows));
+    int32 min_num_rows = std::min(block_size, num_stored_rows - b * block_size);
+    if (num_rows < min_num_rows || num_rows > block_size)
+      KALDI_ERR << "Block " << b << " of compressed matrix has " << num_rows
+                << " rows, expected " << min_num_rows
+                << (min_num_rows < block_size ? " or more." : ".");
+  }
+}
+
+void CompressedMatrix::ReadRowRange(std::istream &is, int32 row_offset,
+                                    int32 num_rows, int32 *total_num_rows) {
+  Clear();
+  std::string tok;
+  ReadToken(is, true, &tok);
+  GlobalHeader h;
+  if (tok == "CM") { h.format = 1; }  // kOneByteWithColHeaders
+  else if (tok == "CM2") { h.format = 2; }  // kTwoByte
+  else if (tok == "CM3") { h.format = 3; }  // kOneByte
+  else if (tok == "CM4") { h.format = 4; }  // kRowBlocked
+  else {
+    KALDI_ERR << "Unexpected token " << tok
+              << ", expecting CM, CM2, CM3 or CM4";
+  }
+  // don't read the "format" -> hence + 4, - 4.
+  is.read(reinterpret_cast<char*>(&h) + 4, sizeof(h) - 4);
+  if (is.fail())
+    KALDI_ERR << "Failed to read header";
+  *total_num_rows = h.num_rows;
+  if (h.num_cols == 0)  // empty matrix.
+    return;
+  KALDI_ASSERT(row_offset >= 0);
+  int32 begin = std::min(row_offset, h.num_rows),
+      end = (num_rows < 0 ? h.num_rows :
+             std::min(h.num_rows, begin + num_rows)),
+      num_cols = h.num_cols;
+  if (static_cast<DataFormat>(h.format) == kRowBlocked) {
+    // Read the blocks that contain the rows.
+    RowBlockHeader block_header;
+    std::vector<float> col_steps;
+    std::vector<uint32> old_offsets;
+    ReadRowBlockIndex(is, h, &block_header, &col_steps, &old_offsets);
+    if (end == begin) {
+      SkipBytes(is, old_offsets.back());
+    } else {
+      int32 block_size = block_header.block_size,
+          stored_begin = begin + block_header.row_shift,
+          begin_block = stored_begin / block_size,
+          end_block = (stored_begin + (end - begin) + block_size - 1) /
+                      block_size;
+      std::vector<uint32> offsets(end_block - begin_block + 1);
+      for (size_t i = 0; i < offsets.size(); i++)
+        offsets[i] = old_offsets[begin_block + i] - old_offsets[begin_block];
+      GlobalHeader new_h(h);
+      new_h.num_rows = end - begin;
+      block_header.row_shift = stored_begin - begin_block * block_size;
+      SkipBytes(is, old_offsets[begin_block]);
+      std::vector<char> blocks;
+      ReadInChunks(is, offsets.back(), &blocks);
+      SkipBytes(is, old_offsets.back() - old_offsets[end_block]);
+      CheckRowBlocks(new_h, block_header, offsets, &(blocks[0]));
+      char *block_data = AllocateRowBlocked(new_h, block_header,
+                                            &(col_steps[0]), offsets);
+      memcpy(block_data, &(blocks[0]), blocks.size());
+    }
+  } else if (end == begin) {
+    SkipBytes(is, DataSize(h) - static_cast<int64>(sizeof(GlobalHeader)));
+  } else {
+    GlobalHeader new_h(h);
+    new_h.num_rows = end - begin;
+    data_ = AllocateData(DataSize(new_h));
+    *(reinterpret_cast<GlobalHeader*>(data_)) = new_h;
+    char *ptr = reinterpret_cast<char*>(data_) + sizeof(GlobalHeader);
+    if (static_cast<DataFormat>(h.format) == kOneByteWithColHeaders) {
+      // The column headers apply to any subset of the rows; the data is
+      // column-major, so we want a piece of each column.  Rather than seek
+      // twice per column we read everything from the first piece to the last
+      // in one go; the columns are only num_rows bytes long.
+      int32 header_size = sizeof(PerColHeader) * num_cols,
+          piece_size = end - begin;
+      is.read(ptr, header_size);
+      ptr += header_size;
+      std::vector<char> columns(
+          static_cast<size_t>(num_cols - 1) * h.num_rows + piece_size);
+      SkipBytes(is, begin);
+      is.read(&(columns[0]), columns.size());
+      SkipBytes(is, h.num_rows - end);
+      for (int32 c = 0; c < num_cols; c++, ptr += piece_size)
+        memcpy(ptr, &(columns[0]) + static_cast<size_t>(c) * h.num_rows,
+               piece_size);
+    } else {
+      // Row-major data; the rows we want are contiguous.
+      int64 row_size = num_cols *
+          (static_cast<DataFormat>(h.format) == kTwoByte ? 2 : 1);
+      SkipBytes(is, row_size * begin);
+      is.read(ptr, row_size * (end - begin));
+      SkipBytes(is, row_size * (h.num_rows - end));
+    }
+  }
+  if (is.fail())
+    KALDI_ERR << "Failed to read data.";
+}
+
 template<typename Real>
 void CompressedMatrix::CopyToMat(MatrixBase<Real> *mat,
                                  MatrixTransposeType trans) const {
@@ -631,7 +1216,9 @@ void CompressedMatrix::CopyToMat(MatrixBase<Real> *mat,
   KALDI_ASSERT(mat->NumCols() == num_cols);
 
   DataFormat format = static_cast<DataFormat>(h->format);
-  if (format == kOneByteWithColHeaders) {
+  if (format == kRowBlocked) {
+    CopyRowBlocksToMat(0, 0, mat);
+  } else if (format == kOneByteWithColHeaders) {
     PerColHeader *per_col_header = reinterpret_cast<PerColHeader*>(h+1);
     uint8 *byte_data = reinterpret_cast<uint8*>(per_col_header +
                                                 h->num_cols);
@@ -686,7 +1273,10 @@ void CompressedMatrix::CopyRowToVec(MatrixIndexT row,
 
   GlobalHeader *h = reinterpret_cast<GlobalHeader*>(data_);
   DataFormat format = static_cast<DataFormat>(h->format);
-  if (format == kOneByteWithColHeaders) {
+  if (format == kRowBlocked) {
+    SubMatrix<Real> dest(v->Data(), 1, v->Dim(), v->Dim());
+    CopyRowBlocksToMat(row, 0, &dest);
+  } else if (format == kOneByteWithColHeaders) {
     PerColHeader *per_col_header = reinterpret_cast<PerColHeader*>(h+1);
     uint8 *byte_data = reinterpret_cast<uint8*>(per_col_header +
                                                 h->num_cols);
@@ -730,7 +1320,12 @@ void CompressedMatrix::CopyColToVec(MatrixIndexT col,
   GlobalHeader *h = reinterpret_cast<GlobalHeader*>(data_);
 
   DataFormat format = static_cast<DataFormat>(h->format);
-  if (format == kOneByteWithColHeaders) {
+  if (format == kRowBlocked) {
+    // The data is stored by blocks of rows, so we have to decode all of it.
+    Matrix<Real> col_mat(h->num_rows, 1, kUndefined);
+    CopyRowBlocksToMat(0, col, &col_mat);
+    v->CopyColFromMat(col_mat, 0);
+  } else if (format == kOneByteWithColHeaders) {
     PerColHeader *per_col_header = reinterpret_cast<PerColHeader*>(h+1);
     uint8 *byte_data = reinterpret_cast<uint8*>(per_col_header +
                                                 h->num_cols);
@@ -790,7 +1385,9 @@ void CompressedMatrix::CopyToMat(int32 row_offset,
       tgt_cols = dest->NumCols(), tgt_rows = dest->NumRows();
 
   DataFormat format = static_cast<DataFormat>(h->format);
-  if (format == kOneByteWithColHeaders) {
+  if (format == kRowBlocked) {
+    CopyRowBlocksToMat(row_offset, col_offset, dest);
+  } else if (format == kOneByteWithColHeaders) {
     PerColHeader *per_col_header = reinterpret_cast<PerColHeader*>(h+1);
     uint8 *byte_data = reinterpret_cast<uint8*>(per_col_header +
                                                 h->num_cols);
@@ -863,7 +1460,7 @@ CompressedMatrix::CompressedMatrix(const CompressedMatrix &mat): data_(NULL) {
 CompressedMatrix &CompressedMatrix::operator = (const CompressedMatrix &mat) {
   Clear(); // now this->data_ == NULL.
   if (mat.data_ != NULL) {
-    MatrixIndexT data_size = DataSize(*static_cast<GlobalHeader*>(mat.data_));
+    MatrixIndexT data_size = mat.StoredDataSize();
     data_ = AllocateData(data_size);
     memcpy(static_cast<void*>(data_),
            static_cast<void*>(mat.data_),
@@ -21,6 +21,7 @@
 #ifndef KALDI_MATRIX_COMPRESSED_MATRIX_H_
 #define KALDI_MATRIX_COMPRESSED_MATRIX_H_ 1
 
+#include <vector>
 #include "matrix/kaldi-matrix.h"
 
 namespace kaldi {
@@ -67,6 +68,23 @@ namespace kaldi {
                         one byte as a uint8, with the representable range of
                         values equal to [0.0, 1.0].  Suitable for image data
                         that has previously been compressed as int8.
+    kRowBlockedSpeechFeature = 8
+                        For archives of speech features.  Each column is
+                        quantized uniformly, with a step of 1/64 of its
+                        interquartile range (so the accuracy is about the
+                        same as kSpeechFeature), and the quantized values are
+                        predicted from the previous row and entropy-coded
+                        with an adaptive range coder, in blocks of 64 rows.
+                        How much smaller than kSpeechFeature this is depends
+                        on the features: for feat/test_data/test.wav it was
+                        about 3% smaller for 13-dimensional MFCCs and about
+                        20% smaller for 40-dimensional filterbanks.
+                        Blocks are coded independently, so access to a range
+                        of rows only decodes the blocks that contain it, but
+                        decompression is more than ten times slower than for
+                        the other methods; it is meant for data on disk
+                        rather than data that is decompressed repeatedly,
+                        e.g. in training examples.
 
     // We can add new methods here as needed: if they just imply different ways
     // of selecting the min_value and range, and a num-bytes = 1 or 2, they will
@@ -79,7 +97,8 @@ enum CompressionMethod {
   kTwoByteSignedInteger = 4,
   kOneByteAuto = 5,
   kOneByteUnsignedInteger = 6,
-  kOneByteZeroOne = 7
+  kOneByteZeroOne = 7,
+  kRowBlockedSpeechFeature = 8
 };
 
 
@@ -111,6 +130,11 @@ class CompressedMatrix {
   /// it is permitted to have row_offset < 0 and
   /// row_offset + num_rows > mat.NumRows(), and the result will contain
   /// repeats of the first and last rows of 'mat' as necessary.
+  ///
+  /// For matrices compressed with kRowBlockedSpeechFeature, a range of rows
+  /// with all the columns and no padding is copied without recompression (the
+  /// blocks containing it are copied); anything else is decompressed and
+  /// recompressed with kTwoByteAuto.
   CompressedMatrix(const CompressedMatrix &mat,
                    const MatrixIndexT row_offset,
                    const MatrixIndexT num_rows,
@@ -142,6 +166,19 @@ class CompressedMatrix {
 
   void Read(std::istream &is, bool binary);
 
+  /// Reads only rows row_offset ... row_offset + num_rows - 1 of a compressed
+  /// matrix that was written in binary mode, skipping over the data of the
+  /// other rows (using seekg() if the stream supports it), so the work done
+  /// is proportional to the number of rows read rather than to the size of
+  /// the matrix.  num_rows is truncated at the end of the matrix, and -1 means
+  /// "up to the end".  The stream must be positioned at the "CM", "CM2",
+  /// "CM3" or "CM4" token; for "CM4" (kRowBlockedSpeechFeature), the blocks
+  /// of rows that contain the range are read.  Outputs the number of rows of
+  /// the whole matrix to *total_num_rows.  The result decompresses to exactly
+  /// the same values as the corresponding rows of the whole matrix.
+  void ReadRowRange(std::istream &is, int32 row_offset, int32 num_rows,
+                    int32 *total_num_rows);
+
   /// Returns number of rows (or zero for emtpy matrix).
   inline MatrixIndexT NumRows() const { return (data_ == NULL) ? 0 :
       (*reinterpret_cast<GlobalHeader*>(data_)).num_rows; }
@@ -198,10 +235,17 @@ class CompressedMatrix {
   //    order and is decompressed as:
   //       uint8 i;  GlobalHeader g;
   //       float f = g.min_value + i * (g.range / 255.0)
+  //  kRowBlocked means there is a GlobalHeader followed by a RowBlockHeader,
+  //    a quantization step for each column and the offsets of the blocks of
+  //    rows (see RowBlockHeader).  Each element is quantized as
+  //       int32 i;  GlobalHeader g;  float step = g.range * col_step[c];
+  //       float f = g.min_value + i * step
+  //    and the integers of each block of rows are entropy-coded.
   enum DataFormat {
     kOneByteWithColHeaders = 1,
     kTwoByte = 2,
-    kOneByte = 3
+    kOneByte = 3,
+    kRowBlocked = 4
   };
 
 
@@ -227,9 +271,72 @@ class CompressedMatrix {
                                          GlobalHeader *header);
 
 
-  // The number of bytes we need to request when allocating 'data_'.
+  // The number of bytes we need to request when allocating 'data_'.  Not
+  // defined for format kRowBlocked, whose size depends on the data; see
+  // StoredDataSize().
   static MatrixIndexT DataSize(const GlobalHeader &header);
 
+  // The number of bytes of 'data_' that are in use (works for all formats).
+  MatrixIndexT StoredDataSize() const;
+
+  // This struct is only used in format kRowBlocked.  It comes after the
+  // GlobalHeader and is followed by float col_step[num_cols], which are the
+  // quantization steps of the columns as fractions of the GlobalHeader's
+  // range, and by uint32 offsets[num_blocks + 1], which are the byte offsets
+  // of the blocks from the end of the offsets (offsets[num_blocks] is the
+  // total size of the blocks).  Stored row i is in block i / block_size; the
+  // first 'row_shift' stored rows are not part of the matrix (this is nonzero
+  // after ReadRowRange() or taking a range of rows), so num_blocks =
+  // (row_shift + num_rows + block_size - 1) / block_size.  Each block starts
+  // with uint16 num_rows (the number of rows stored in the block), followed
+  // by the range-coded quantized values, column by column, each predicted
+  // from the previous row of the block (see EncodeInteger() in the .cc).
+  struct RowBlockHeader {
+    int32 block_size;
+    int32 row_shift;
+  };
+
+  static const int32 kRowBlockSize = 64;
+
+  // Used in CopyFromMat() for method kRowBlockedSpeechFeature.
+  template<typename Real>
+  void CopyFromMatRowBlocked(const MatrixBase<Real> &mat,
+                             const GlobalHeader &global_header);
+
+  // Allocates data_ for format kRowBlocked, writes the headers, column steps
+  // and offsets (which must start from zero) to it, and returns the location
+  // where the offsets.back() bytes of block data should go.
+  char *AllocateRowBlocked(const GlobalHeader &global_header,
+                           const RowBlockHeader &block_header,
+                           const float *col_steps,
+                           const std::vector<uint32> &offsets);
+
+  // Works out the location of the parts of data_ for format kRowBlocked.
+  void GetRowBlocks(const RowBlockHeader **block_header,
+                    const float **col_steps, const uint32 **offsets,
+                    const char **blocks, int32 *num_blocks) const;
+
+  // Does the work of CopyToMat(row_offset, col_offset, dest) for format
+  // kRowBlocked, decoding only the blocks that are needed.
+  template<typename Real>
+  void CopyRowBlocksToMat(int32 row_offset, int32 col_offset,
+                          MatrixBase<Real> *dest) const;
+
+  // Reads the RowBlockHeader, column steps and offsets that follow the
+  // GlobalHeader 'h' of a "CM4" matrix from the stream.  Throws if the
+  // offsets are not valid.
+  static void ReadRowBlockIndex(std::istream &is, const GlobalHeader &h,
+                                RowBlockHeader *block_header,
+                                std::vector<float> *col_steps,
+                                std::vector<uint32> *offsets);
+
+  // Throws if the number of rows stored at the start of each of the blocks
+  // 'blocks' (read from a stream) doesn't match the headers.
+  static void CheckRowBlocks(const GlobalHeader &h,
+                             const RowBlockHeader &block_header,
+                             const std::vector<uint32> &offsets,
+                             const char *blocks);
+
   // This struct is only used in format kOneByteWithColHeaders.
   struct PerColHeader {
     uint16 percentile_0;
@@ -4094,10 +4094,11 @@ template<typename Real> static void UnitTestCompressedMatrix() {
 
 
     CompressionMethod method;
-    switch(RandInt(0, 3)) {
+    switch(RandInt(0, 4)) {
       case 0: method = kAutomaticMethod; break;
       case 1: method = kSpeechFeature; break;
       case 2: method = kTwoByteAuto; break;
+      case 3: method = kRowBlockedSpeechFeature; break;
       default: method = kOneByteAuto; break;
     }
 
@@ -4111,11 +4112,14 @@ template<typename Real> static void UnitTestCompressedMatrix() {
     Matrix<Real> diff(M2);
     diff.AddMat(-1.0, M);
 
-    { // Check that when compressing a matrix that has already been compressed,
+    if (method != kRowBlockedSpeechFeature) {
+      // Check that when compressing a matrix that has already been compressed,
       // and uncompressing, we get the same answer if using the same compression
       // method.
       // ok, actually, we can't guarantee this, so just limit the number of
-      // failures.
+      // failures.  (kRowBlockedSpeechFeature is excluded because its
+      // quantization steps depend on the quartiles of the data, which change
+      // slightly after compression.)
       CompressedMatrix cmat2(M2, method);
       Matrix<Real> M3(cmat.NumRows(), cmat.NumCols());
       cmat2.CopyToMat(&M3);
@@ -4464,6 +4468,201 @@ static void UnitTestExtractCompressedMatrix() {
 }
 
 
+// Tests kRowBlockedSpeechFeature on matrices with several blocks of rows.
+template<typename Real>
+static void UnitTestCompressedMatrixRowBlocked() {
+  int64 tot_size = 0, tot_size_speech = 0;
+  double tot_err = 0.0, tot_err_speech = 0.0;
+  for (int32 i = 0; i < 20; i++) {
+    MatrixIndexT num_rows = RandInt(1, 300), num_cols = RandInt(1, 40);
+    // Something like speech features: each dimension has its own offset and
+    // scale, and changes slowly over time.
+    Matrix<Real> mat(num_rows, num_cols);
+    Vector<Real> offset(num_cols), scale(num_cols);
+    offset.SetRandn();
+    offset.Scale(10.0);
+    scale.SetRandn();
+    scale.ApplyAbs();
+    for (MatrixIndexT c = 0; c < num_cols; c++) {
+      Real x = 0.0;
+      for (MatrixIndexT r = 0; r < num_rows; r++) {
+        x = 0.9 * x + 0.3 * RandGauss();
+        mat(r, c) = offset(c) + scale(c) * x;
+      }
+    }
+    CompressedMatrix cmat(mat, kRowBlockedSpeechFeature),
+        cmat_speech(mat, kSpeechFeature);
+    Matrix<Real> mat2(cmat), mat_speech(cmat_speech);
+    Matrix<Real> diff(mat2), diff_speech(mat_speech);
+    diff.AddMat(-1.0, mat);
+    diff_speech.AddMat(-1.0, mat);
+    tot_err += diff.FrobeniusNorm();
+    tot_err_speech += diff_speech.FrobeniusNorm();
+
+    std::ostringstream os, os_speech;
+    cmat.Write(os, true);
+    cmat_speech.Write(os_speech, true);
+    tot_size += os.str().size();
+    tot_size_speech += os_speech.str().size();
+
+    // I/O.
+    CompressedMatrix cmat2;
+    {
+      std::istringstream is(os.str());
+      cmat2.Read(is, true);
+    }
+    KALDI_ASSERT(Matrix<Real>(cmat2).ApproxEqual(mat2, 0.0));
+
+    // Rows, columns and sub-matrices.
+    MatrixIndexT row = RandInt(0, num_rows - 1), col = RandInt(0, num_cols - 1);
+    Vector<Real> v(num_cols), w(num_rows);
+    cmat.CopyRowToVec(row, &v);
+    KALDI_ASSERT(v.ApproxEqual(Vector<Real>(mat2.Row(row)), 0.0));
+    cmat.CopyColToVec(col, &w);
+    Vector<Real> mat2_col(num_rows);
+    mat2_col.CopyColFromMat(mat2, col);
+    KALDI_ASSERT(w.ApproxEqual(mat2_col, 0.0));
+    MatrixIndexT row_offset = RandInt(0, num_rows - 1),
+        sub_num_rows = RandInt(1, num_rows - row_offset),
+        col_offset = RandInt(0, num_cols - 1),
+        sub_num_cols = RandInt(1, num_cols - col_offset);
+    Matrix<Real> block(sub_num_rows, sub_num_cols);
+    cmat.CopyToMat(row_offset, col_offset, &block);
+    KALDI_ASSERT(block.ApproxEqual(Matrix<Real>(mat2.Range(
+        row_offset, sub_num_rows, col_offset, sub_num_cols)), 0.0));
+
+    // A range of rows with all the columns is copied exactly, also from a
+    // matrix that is itself a range.
+    CompressedMatrix cmat_rows(cmat, row_offset, sub_num_rows, 0, num_cols);
+    KALDI_ASSERT(Matrix<Real>(cmat_rows).ApproxEqual(
+        Matrix<Real>(mat2.RowRange(row_offset, sub_num_rows)), 0.0));
+    MatrixIndexT row_offset2 = RandInt(0, sub_num_rows - 1),
+        sub_num_rows2 = RandInt(1, sub_num_rows - row_offset2);
+    CompressedMatrix cmat_rows2(cmat_rows, row_offset2, sub_num_rows2,
+                                0, num_cols);
+    KALDI_ASSERT(Matrix<Real>(cmat_rows2).ApproxEqual(
+        Matrix<Real>(mat2.RowRange(row_offset + row_offset2, sub_num_rows2)),
+        0.0));
+    // ... and it is written and read like any other.
+    std::ostringstream os_rows;
+    cmat_rows.Write(os_rows, true);
+    {
+      std::istringstream is(os_rows.str());
+      cmat2.Read(is, true);
+    }
+    KALDI_ASSERT(Matrix<Real>(cmat2).ApproxEqual(
+        Matrix<Real>(cmat_rows), 0.0));
+
+    // ReadRowRange(), from the whole matrix and from a range, followed by
+    // another object in the stream.
+    for (int32 j = 0; j < 2; j++) {
+      const std::string &str = (j == 0 ? os.str() : os_rows.str());
+      const Matrix<Real> &ref = (j == 0 ? mat2 : Matrix<Real>(cmat_rows));
+      MatrixIndexT offset = RandInt(0, ref.NumRows()),
+          count = RandInt(-1, ref.NumRows() - offset);
+      std::istringstream is(str + "X");
+      int32 total_num_rows;
+      cmat2.ReadRowRange(is, offset, count, &total_num_rows);
+      KALDI_ASSERT(total_num_rows == ref.NumRows());
+      if (count < 0) count = ref.NumRows() - offset;
+      KALDI_ASSERT(cmat2.NumRows() == count);
+      if (count > 0)
+        KALDI_ASSERT(Matrix<Real>(cmat2).ApproxEqual(
+            Matrix<Real>(ref.RowRange(offset, count)), 0.0));
+      KALDI_ASSERT(is.get() == 'X');
+    }
+    {
+      // A truncated matrix gives an error even if the missing data is after
+      // the rows we read.
+      std::istringstream is(os.str().substr(0, os.str().size() - 1));
+      int32 total_num_rows;
+      bool threw = false;
+      try {
+        cmat2.ReadRowRange(is, 0, 1, &total_num_rows);
+      } catch (const std::exception &e) {
+        threw = true;
+      }
+      KALDI_ASSERT(threw);
+    }
+    {
+      // Corrupted block offsets and row counts give an error (and no huge
+      // allocation) in Read() and ReadRowRange().  After the "CM4 " token
+      // come the rest of the GlobalHeader, the RowBlockHeader, the column
+      // steps and then the offsets.
+      int32 block_size;
+      memcpy(&block_size, os.str().data() + 4 + 16, sizeof(block_size));
+      int32 num_blocks = (num_rows + block_size - 1) / block_size;
+      size_t offsets_pos = 4 + 16 + 8 + sizeof(float) * num_cols,
+          last_offset_pos = offsets_pos + sizeof(uint32) * num_blocks,
+          blocks_pos = last_offset_pos + sizeof(uint32);
+      uint32 last_offset;
+      memcpy(&last_offset, os.str().data() + last_offset_pos,
+             sizeof(last_offset));
+      for (int32 k = 0; k < 4; k++) {
+        std::string str = os.str();
+        uint32 value;
+        size_t pos;
+        if (k == 0) {  // Huge size.
+          value = 0xFFFFFFF0u;
+          pos = last_offset_pos;
+        } else if (k == 1) {  // Runs past the end of the stream.
+          value = last_offset + 1000;
+          pos = last_offset_pos;
+        } else if (k == 2) {  // Empty (or, if num_blocks > 1, negative) block.
+          value = (num_blocks > 1 ? last_offset : 0);
+          pos = offsets_pos + sizeof(uint32);
+        } else {  // Wrong number of rows in the first block.
+          uint16 block_num_rows;
+          memcpy(&block_num_rows, str.data() + blocks_pos,
+                 sizeof(block_num_rows));
+          block_num_rows--;
+          str.replace(blocks_pos, sizeof(block_num_rows),
+                      reinterpret_cast<const char*>(&block_num_rows),
+                      sizeof(block_num_rows));
+        }
+        if (k < 3)
+          str.replace(pos, sizeof(value), reinterpret_cast<const char*>(&value),
+                      sizeof(value));
+        for (int32 read_range = 0; read_range < 2; read_range++) {
+          std::istringstream is(str);
+          bool threw = false;
+          try {
+            int32 total_num_rows;
+            if (read_range == 0) cmat2.Read(is, true);
+            else cmat2.ReadRowRange(is, 0, -1, &total_num_rows);
+          } catch (const std::exception &e) {
+            threw = true;
+          }
+          KALDI_ASSERT(threw);
+        }
+      }
+    }
+
+    // Padding falls back to recompression.
+    CompressedMatrix cmat_padded(cmat, -2, num_rows + 4, col_offset,
+                                 sub_num_cols, true);
+    Matrix<Real> padded(cmat_padded);
+    KALDI_ASSERT(padded.NumRows() == num_rows + 4);
+    Real max_err = 1.0e-04 * (mat2.Max() - mat2.Min()) + 1.0e-05;
+    for (MatrixIndexT r = 0; r < num_rows + 4; r++) {
+      MatrixIndexT old_r = std::min<MatrixIndexT>(
+          std::max<MatrixIndexT>(r - 2, 0), num_rows - 1);
+      Vector<Real> err(padded.Row(r));
+      err.AddVec(-1.0, SubVector<Real>(mat2.Row(old_r), col_offset,
+                                       sub_num_cols));
+      KALDI_ASSERT(err.Max() <= max_err && err.Min() >= -max_err);
+    }
+  }
+  KALDI_LOG << "Size of kRowBlockedSpeechFeature compressed matrices was "
+            << tot_size << " bytes vs. " << tot_size_speech
+            << " for kSpeechFeature; error was " << tot_err << " vs. "
+            << tot_err_speech;
+  // It should be smaller, and about as accurate.
+  KALDI_ASSERT(tot_size < tot_size_speech &&
+               tot_err < 1.1 * tot_err_speech);
+}
+
+
 template<typename Real>
 static void UnitTestTridiag() {
   SpMatrix<Real> A(3);
@@ -4603,6 +4802,7 @@ template<typename Real> static void MatrixUnitTest(bool full_test) {
   UnitTestCompressedMatrix<Real>();
   UnitTestCompressedMatrix2<Real>();
   UnitTestExtractCompressedMatrix<Real>();
+  UnitTestCompressedMatrixRowBlocked<Real>();
   UnitTestResize<Real>();
   UnitTestResizeCopyDataDifferentStrideType<Real>();
   UnitTestNonsymmetricPower<Real>();
@@ -799,10 +799,13 @@ MatrixIndexT GeneralMatrix::NumCols() const {
 }
 
 
-void GeneralMatrix::Compress() {
+void GeneralMatrix::Compress(CompressionMethod method) {
   if (mat_.NumRows() != 0) {
-    cmat_.CopyFromMat(mat_);
+    cmat_.CopyFromMat(mat_, method);
     mat_.Resize(0, 0);
+  } else if (cmat_.NumRows() != 0 && method != kAutomaticMethod) {
+    Matrix<BaseFloat> temp_mat(cmat_);
+    cmat_.CopyFromMat(temp_mat, method);
   }
 }
 
@@ -285,8 +285,12 @@ class GeneralMatrix {
   /// kFullMatrix.  If this matrix is empty, returns kFullMatrix.
   GeneralMatrixType Type() const;
 
-  void Compress();  // If it was a full matrix, compresses, changing Type() to
-                    // kCompressedMatrix; otherwise does nothing.
+  /// If it was a full matrix, compresses with the method 'method', changing
+  /// Type() to kCompressedMatrix.  If it was already compressed and 'method'
+  /// is not kAutomaticMethod, it is recompressed with that method (e.g. to
+  /// turn features stored with kRowBlockedSpeechFeature into a format that is
+  /// faster to decompress); otherwise does nothing.
+  void Compress(CompressionMethod method = kAutomaticMethod);
 
   void Uncompress();  // If it was a compressed matrix, uncompresses, changing
                       // Type() to kFullMatrix; otherwise does nothing.
@@ -255,6 +255,19 @@ BaseFloat DecodableAmNnetLoopedOnline::LogLikelihood(int32 subsampled_frame,
       trans_model_.TransitionIdToPdfFast(index));
 }
 
+void DecodableAmNnetLoopedOnline::LogLikelihoods(
+    int32 subsampled_frame, const std::vector<int32> &transition_ids,
+    std::vector<BaseFloat> *loglikes) {
+  subsampled_frame += frame_offset_;
+  EnsureFrameIsComputed(subsampled_frame);
+  SubVector<BaseFloat> log_post(current_log_post_,
+      subsampled_frame - current_log_post_subsampled_offset_);
+  loglikes->resize(transition_ids.size());
+  for (size_t i = 0; i < transition_ids.size(); i++)
+    (*loglikes)[i] = log_post(
+        trans_model_.TransitionIdToPdfFast(transition_ids[i]));
+}
+
 
 } // namespace nnet3
 } // namespace kaldi
@@ -199,6 +199,11 @@ class DecodableAmNnetLoopedOnline: public DecodableNnetLoopedOnlineBase {
   virtual BaseFloat LogLikelihood(int32 subsampled_frame,
                                   int32 transition_id);
 
+  // Batched version of LogLikelihood(); see DecodableInterface.
+  virtual void LogLikelihoods(int32 subsampled_frame,
+                              const std::vector<int32> &transition_ids,
+                              std::vector<BaseFloat> *loglikes);
+
  private:
   const TransitionModel &trans_model_;
 
@@ -318,6 +318,44 @@ void UnitTestPreconditionDirectionsOnline() {
   return;
 }
 
+// Checks that doing the updates of the Fisher-matrix estimate in the
+// background thread gives exactly the same results as doing them inline,
+// including when the object is copied while an update is pending.
+void UnitTestPreconditionDirectionsAsync() {
+  MatrixIndexT R = 1 + Rand() % 30,  // rank of correction
+      N = 1 + Rand() % 60,  // batch size
+      D = R + 1 + Rand() % 20; // problem dimension.  Must be > R.
+
+  OnlineNaturalGradient preconditioner1, preconditioner2;
+  preconditioner1.SetRank(R);
+  preconditioner2.SetRank(R);
+  preconditioner1.SetUpdatePeriod(RandInt(1, 4));
+  preconditioner2.SetUpdatePeriod(preconditioner1.GetUpdatePeriod());
+
+  int32 num_iters = 50;
+  for (int32 iter = 0; iter < num_iters; iter++) {
+    CuMatrix<BaseFloat> M(N, D);
+    M.SetRandn();
+    CuMatrix<BaseFloat> Mcopy1(M), Mcopy2(M);
+    BaseFloat scale1, scale2;
+
+    OnlineNaturalGradient::SetAsyncUpdates(false);
+    preconditioner1.PreconditionDirections(&Mcopy1, &scale1);
+    OnlineNaturalGradient::SetAsyncUpdates(true);
+    preconditioner2.PreconditionDirections(&Mcopy2, &scale2);
+
+    AssertEqual(Mcopy1, Mcopy2, 1.0e-05);
+    AssertEqual(scale1, scale2, 1.0e-05);
+
+    if (iter % 10 == 5) {
+      // The copy must wait for the pending update of preconditioner2.
+      OnlineNaturalGradient preconditioner3(preconditioner2);
+      preconditioner2.Swap(&preconditioner3);
+    }
+  }
+  OnlineNaturalGradient::SetAsyncUpdates(false);
+}
+
 
 } // namespace nnet3
 } // namespace kaldi
@@ -336,6 +374,7 @@ int main() {
 #endif
     for (int32 i = 0; i < 5; i++) {
       UnitTestPreconditionDirectionsOnline();
+      UnitTestPreconditionDirectionsAsync();
     }
   }
 }
@@ -17,18 +17,127 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include "nnet3/natural-gradient-online.h"
 #include "nnet3/nnet-parse.h"
 
 namespace kaldi {
 namespace nnet3 {
 
+// See OnlineNaturalGradient::SetAsyncUpdates().
+static bool natural_gradient_async_updates = false;
+
+struct OnlineNaturalGradient::PendingUpdate {
+  int32 N;
+  BaseFloat rho_t;
+  BaseFloat tr_X_Xt;
+  Vector<BaseFloat> d_t;
+  CuMatrix<BaseFloat> H_t;
+  CuMatrix<BaseFloat> WJKL_t;
+};
+
+/**
+   This class owns the background thread that does the queued updates of the
+   Fisher-matrix estimates, in the order in which they were queued.  There is
+   just one thread, so that a network with many natural-gradient components
+   doesn't end up with a thread per component competing with the main thread
+   and BLAS for the CPU.  The thread is only started when the first update is
+   queued.
+ */
+class OnlineNaturalGradient::UpdateWorker {
+ public:
+  static UpdateWorker &Instance() {
+    static UpdateWorker worker;
+    return worker;
+  }
+
+  // Queues the update 'update' (which this class takes ownership of) for the
+  // object 'ng'.  'ng' must not already have an update pending.
+  void Queue(OnlineNaturalGradient *ng, PendingUpdate *update) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    KALDI_ASSERT(ng->pending_update_ == NULL);
+    ng->pending_update_ = update;
+    queue_.push_back(ng);
+    if (!thread_.joinable())
+      thread_ = std::thread(&UpdateWorker::Run, this);
+    cond_.notify_all();
+  }
+
+  // Waits until 'ng' has no update pending.
+  void Wait(const OnlineNaturalGradient *ng) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (ng->pending_update_ != NULL)
+      cond_.wait(lock);
+  }
+
+  ~UpdateWorker() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      stop_ = true;
+      cond_.notify_all();
+    }
+    if (thread_.joinable())
+      thread_.join();
+  }
+
+ private:
+  UpdateWorker(): stop_(false) { }
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      while (queue_.empty() && !stop_)
+        cond_.wait(lock);
+      if (queue_.empty())
+        return;
+      OnlineNaturalGradient *ng = queue_.front();
+      queue_.pop_front();
+      PendingUpdate *update = ng->pending_update_;
+      lock.unlock();
+      ng->UpdateFisherEstimate(update->N, update->rho_t, update->tr_X_Xt,
+                               update->d_t, update->H_t, &(update->WJKL_t));
+      delete update;
+      lock.lock();
+      ng->pending_update_ = NULL;
+      cond_.notify_all();
+    }
+  }
+
+  std::mutex mutex_;
+  // Signaled when an update is queued, when an update finishes, and when
+  // stop_ is set.
+  std::condition_variable cond_;
+  std::deque<OnlineNaturalGradient*> queue_;
+  bool stop_;
+  std::thread thread_;
+};
+
+// static
+void OnlineNaturalGradient::SetAsyncUpdates(bool async_updates) {
+  natural_gradient_async_updates = async_updates;
+}
+
+// static
+bool OnlineNaturalGradient::AsyncUpdates() {
+  return natural_gradient_async_updates;
+}
+
+void OnlineNaturalGradient::WaitForUpdate() const {
+  UpdateWorker::Instance().Wait(this);
+}
+
+OnlineNaturalGradient::~OnlineNaturalGradient() {
+  WaitForUpdate();
+}
 
 OnlineNaturalGradient::OnlineNaturalGradient():
     rank_(40), update_period_(1), num_samples_history_(2000.0),
     num_minibatches_history_(0.0), alpha_(4.0),
     epsilon_(1.0e-10), delta_(5.0e-04), frozen_(false), t_(0),
-    self_debug_(false), rho_t_(-1.0e+10) { }
+    self_debug_(false), rho_t_(-1.0e+10), pending_update_(NULL) { }
 
 
 /**
@@ -150,6 +259,7 @@ void OnlineNaturalGradient::Init(const CuMatrixBase<BaseFloat> &X0) {
     X0_copy.CopyFromMat(X0);
     this_copy.PreconditionDirections(&X0_copy, &scale);
   }
+  this_copy.WaitForUpdate();
   rank_ = this_copy.rank_;
   W_t_.Swap(&this_copy.W_t_);
   d_t_.Swap(&this_copy.d_t_);
@@ -169,6 +279,9 @@ void OnlineNaturalGradient::PreconditionDirections(
     return;
   }
 
+  // Make sure any update from the previous call has been done.
+  WaitForUpdate();
+
   if (t_ == 0) // not initialized
     Init(*X_t);
 
@@ -326,35 +439,75 @@ void OnlineNaturalGradient::PreconditionDirectionsInternal(
     const BaseFloat tr_X_Xt,
     bool updating,
     const Vector<BaseFloat> &d_t,
-    CuMatrixBase<BaseFloat> *WJKL_t,
+    CuMatrix<BaseFloat> *WJKL_t,
     CuMatrixBase<BaseFloat> *X_t) {
   NVTX_RANGE(__func__);
   int32 N = X_t->NumRows(),  // Minibatch size.
       D = X_t->NumCols(),  // Dimensions of vectors we're preconditioning
       R = rank_;  // Rank of correction to unit matrix.
   KALDI_ASSERT(R > 0 && R < D);
-  BaseFloat eta = Eta(N);
 
   CuMatrix<BaseFloat> H_t(N, R);
   const CuSubMatrix<BaseFloat> W_t(*WJKL_t, 0, R, 0, D);
-  // Below, WJ_t and LK_t are combinations of two matrices,
-  // which we define in order to combine two separate multiplications into one.
-  CuSubMatrix<BaseFloat> J_t(*WJKL_t, R, R, 0, D),
-      L_t(*WJKL_t, 0, R, D, R),
-      K_t(*WJKL_t, R, R, D, R),
-      WJ_t(*WJKL_t, 0, 2 * R, 0, D),
-      LK_t(*WJKL_t, 0, 2 * R, D, R);
+  CuSubMatrix<BaseFloat> J_t(*WJKL_t, R, R, 0, D);
 
   H_t.AddMatMat(1.0, *X_t, kNoTrans, W_t, kTrans, 0.0);  // H_t = X_t W_t^T
 
+  if (updating)
+    J_t.AddMatMat(1.0, H_t, kTrans, *X_t, kNoTrans, 0.0);  // J_t = H_t^T X_t
+
+  // X_hat_t = X_t - H_t W_t.  Note: the rest of the update does not need X_t,
+  // only H_t and J_t.
+  X_t->AddMatMat(-1.0, H_t, kNoTrans, W_t, kNoTrans, 1.0);
+
   if (!updating) {
     // We're not updating the estimate of the Fisher matrix; we just apply the
     // preconditioning and return.
-    // X_hat_t = X_t - H_t W_t
-    X_t->AddMatMat(-1.0, H_t, kNoTrans, W_t, kNoTrans, 1.0);
     return;
   }
-  J_t.AddMatMat(1.0, H_t, kTrans, *X_t, kNoTrans, 0.0);  // J_t = H_t^T X_t
+
+  bool async = AsyncUpdates();
+#if HAVE_CUDA == 1
+  // The background thread would not be able to use the GPU.
+  if (CuDevice::Instantiate().Enabled())
+    async = false;
+#endif
+  if (async) {
+    PendingUpdate *update = new PendingUpdate();
+    update->N = N;
+    update->rho_t = rho_t;
+    update->tr_X_Xt = tr_X_Xt;
+    update->d_t = d_t;
+    update->H_t.Swap(&H_t);
+    update->WJKL_t.Swap(WJKL_t);
+    UpdateWorker::Instance().Queue(this, update);
+  } else {
+    UpdateFisherEstimate(N, rho_t, tr_X_Xt, d_t, H_t, WJKL_t);
+  }
+}
+
+void OnlineNaturalGradient::UpdateFisherEstimate(
+    int32 N,
+    const BaseFloat rho_t,
+    const BaseFloat tr_X_Xt,
+    const Vector<BaseFloat> &d_t,
+    const CuMatrixBase<BaseFloat> &H_t,
+    CuMatrixBase<BaseFloat> *WJKL_t) {
+  NVTX_RANGE(__func__);
+  int32 D = WJKL_t->NumCols() - rank_,
+      R = rank_;
+  KALDI_ASSERT(H_t.NumRows() == N && H_t.NumCols() == R &&
+               WJKL_t->NumRows() == 2 * R);
+  BaseFloat eta = Eta(N);
+
+  const CuSubMatrix<BaseFloat> W_t(*WJKL_t, 0, R, 0, D);
+  // Below, WJ_t and LK_t are combinations of two matrices,
+  // which we define in order to combine two separate multiplications into one.
+  CuSubMatrix<BaseFloat> J_t(*WJKL_t, R, R, 0, D),
+      L_t(*WJKL_t, 0, R, D, R),
+      K_t(*WJKL_t, R, R, D, R),
+      WJ_t(*WJKL_t, 0, 2 * R, 0, D),
+      LK_t(*WJKL_t, 0, 2 * R, D, R);
 
   bool compute_lk_together = (N > D);
 
@@ -416,8 +569,6 @@ void OnlineNaturalGradient::PreconditionDirectionsInternal(
     KALDI_WARN << "Floored " << nf << " elements of C_t.";
   }
 
-  X_t->AddMatMat(-1.0, H_t, kNoTrans, W_t, kNoTrans, 1.0);  // X_hat_t = X_t - H_t W_t
-
   Vector<BaseFloat> sqrt_c_t(c_t);
   sqrt_c_t.ApplyPow(0.5);
 
@@ -581,12 +732,19 @@ OnlineNaturalGradient::OnlineNaturalGradient(const OnlineNaturalGradient &other)
     num_minibatches_history_(other.num_minibatches_history_),
     alpha_(other.alpha_), epsilon_(other.epsilon_), delta_(other.delta_),
     frozen_(other.frozen_), t_(other.t_),
-    self_debug_(other.self_debug_), W_t_(other.W_t_),
-    rho_t_(other.rho_t_), d_t_(other.d_t_) { }
+    self_debug_(other.self_debug_), pending_update_(NULL) {
+  // Any pending update would modify the quantities we're about to copy.
+  other.WaitForUpdate();
+  W_t_ = other.W_t_;
+  rho_t_ = other.rho_t_;
+  d_t_ = other.d_t_;
+}
 
 
 OnlineNaturalGradient& OnlineNaturalGradient::operator = (
     const OnlineNaturalGradient &other) {
+  WaitForUpdate();
+  other.WaitForUpdate();
   rank_ = other.rank_;
   update_period_ = other.update_period_;
   num_samples_history_ = other.num_samples_history_;
@@ -603,6 +761,7 @@ OnlineNaturalGradient& OnlineNaturalGradient::operator = (
 
 void OnlineNaturalGradient::SetRank(int32 rank) {
   KALDI_ASSERT(rank > 0);
+  WaitForUpdate();
   rank_ = rank;
 }
 void OnlineNaturalGradient::SetUpdatePeriod(int32 update_period) {
@@ -612,20 +771,25 @@ void OnlineNaturalGradient::SetUpdatePeriod(int32 update_period) {
 void OnlineNaturalGradient::SetNumSamplesHistory(BaseFloat num_samples_history) {
   KALDI_ASSERT(num_samples_history > 0.0 &&
                num_samples_history < 1.0e+6);
+  WaitForUpdate();
   num_samples_history_ = num_samples_history;
 }
 void OnlineNaturalGradient::SetNumMinibatchesHistory(
     BaseFloat num_minibatches_history) {
   KALDI_ASSERT(num_minibatches_history > 1.0);
+  WaitForUpdate();
   num_minibatches_history_ = num_minibatches_history;
 }
 
 void OnlineNaturalGradient::SetAlpha(BaseFloat alpha) {
   KALDI_ASSERT(alpha >= 0.0);
+  WaitForUpdate();
   alpha_ = alpha;
 }
 
 void OnlineNaturalGradient::Swap(OnlineNaturalGradient *other) {
+  WaitForUpdate();
+  other->WaitForUpdate();
   std::swap(rank_, other->rank_);
   std::swap(update_period_, other->update_period_);
   std::swap(num_samples_history_, other->num_samples_history_);
@@ -436,6 +436,23 @@ class OnlineNaturalGradient {
   // see comment where 'frozen_' is declared.
   inline void Freeze(bool frozen) { frozen_ = frozen; }
 
+  /**
+     If you call this with true, then (when not using a GPU) the part of the
+     update of the Fisher-matrix estimate that does not involve the data
+     matrix X_t itself (the products of R x R matrices, the symmetric
+     eigenvalue decomposition of Z_t, the computation of W_{t+1} and any
+     reorthogonalization) is queued to a single background thread that is
+     shared by all objects of this class, instead of being done inside
+     PreconditionDirections().  This lets the updates of all the components
+     in a backward pass overlap with each other and with the rest of the
+     backprop.  The updated parameters are only needed by the next call to
+     PreconditionDirections() on the same object, which waits for them, so
+     the output is exactly the same as in the synchronous case.  It is a
+     process-wide setting, like g_num_threads; the default is false.
+  */
+  static void SetAsyncUpdates(bool async_updates);
+  static bool AsyncUpdates();
+
   /**
      This call implements the main functionality of this class.
 
@@ -469,18 +486,46 @@ class OnlineNaturalGradient {
 
   // Shallow swap
   void Swap(OnlineNaturalGradient *other);
- private:
 
+  // The destructor waits for any update that is pending in the background
+  // thread (see SetAsyncUpdates()).
+  ~OnlineNaturalGradient();
+ private:
+  // The background thread used if AsyncUpdates() is true; defined in the .cc
+  // file.
+  class UpdateWorker;
+  // The inputs to a queued update; defined in the .cc file.
+  struct PendingUpdate;
 
   // This is an internal function called from PreconditionDirections().
-  // Note: WJKL_t (dimension 2*R by D + R) is [ W_t L_t; J_t K_t ].
+  // Note: WJKL_t (dimension 2*R by D + R) is [ W_t L_t; J_t K_t ].  If we are
+  // updating and AsyncUpdates() is true, the contents of WJKL_t may be
+  // taken by this function (it is swapped into the queued update).
   void PreconditionDirectionsInternal(const BaseFloat rho_t,
                                       const BaseFloat tr_X_Xt,
                                       bool updating,
                                       const Vector<BaseFloat> &d_t,
-                                      CuMatrixBase<BaseFloat> *WJKL_t,
+                                      CuMatrix<BaseFloat> *WJKL_t,
                                       CuMatrixBase<BaseFloat> *X_t);
 
+  // This does the part of the update of W_t, d_t and rho_t that happens after
+  // H_t = X_t W_t^T and J_t = H_t^T X_t have been computed (N is the number of
+  // rows of X_t).  It sets W_t_, d_t_ and rho_t_ to the new values.  It may be
+  // called from the background thread.
+  void UpdateFisherEstimate(int32 N,
+                            const BaseFloat rho_t,
+                            const BaseFloat tr_X_Xt,
+                            const Vector<BaseFloat> &d_t,
+                            const CuMatrixBase<BaseFloat> &H_t,
+                            CuMatrixBase<BaseFloat> *WJKL_t);
+
+  // Waits until any update of this object that is queued in the background
+  // thread has finished.  Must be called before accessing W_t_, d_t_ or
+  // rho_t_, or changing the configuration values that UpdateFisherEstimate()
+  // reads.  It's const because the copy constructor needs to call it on
+  // 'other'; it does not change the logical state of the object.
+  void WaitForUpdate() const;
+
 
   // Works out from t_ and various class variables whether we will update
   // the parameters on this iteration (returns true if so).
@@ -612,6 +657,11 @@ class OnlineNaturalGradient {
   CuMatrix<BaseFloat> W_t_;
   BaseFloat rho_t_;
   Vector<BaseFloat> d_t_;
+
+  // Non-NULL while an update of W_t_, rho_t_ and d_t_ is queued in (or being
+  // done by) the background thread, which deletes it when the update is done.
+  // Only accessed while holding the worker's mutex.
+  PendingUpdate *pending_update_;
 };
 
 } // namespace nnet3
@@ -81,6 +81,15 @@ BaseFloat DecodableAmNnetSimple::LogLikelihood(int32 frame,
   return decodable_nnet_.GetOutput(frame, pdf_id);
 }
 
+void DecodableAmNnetSimple::LogLikelihoods(
+    int32 frame, const std::vector<int32> &transition_ids,
+    std::vector<BaseFloat> *loglikes) {
+  loglikes->resize(transition_ids.size());
+  for (size_t i = 0; i < transition_ids.size(); i++)
+    (*loglikes)[i] = decodable_nnet_.GetOutput(
+        frame, trans_model_.TransitionIdToPdfFast(transition_ids[i]));
+}
+
 int32 DecodableNnetSimple::GetIvectorDim() const {
   if (ivector_ != NULL)
     return ivector_->Dim();
@@ -361,6 +370,15 @@ BaseFloat DecodableAmNnetSimpleParallel::LogLikelihood(int32 frame,
   return decodable_nnet_->GetOutput(frame, pdf_id);
 }
 
+void DecodableAmNnetSimpleParallel::LogLikelihoods(
+    int32 frame, const std::vector<int32> &transition_ids,
+    std::vector<BaseFloat> *loglikes) {
+  loglikes->resize(transition_ids.size());
+  for (size_t i = 0; i < transition_ids.size(); i++)
+    (*loglikes)[i] = decodable_nnet_->GetOutput(
+        frame, trans_model_.TransitionIdToPdfFast(transition_ids[i]));
+}
+
 
 } // namespace nnet3
 } // namespace kaldi
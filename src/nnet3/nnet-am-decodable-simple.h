@@ -327,6 +327,10 @@ class DecodableAmNnetSimple: public DecodableInterface {
 
   virtual BaseFloat LogLikelihood(int32 frame, int32 transition_id);
 
+  virtual void LogLikelihoods(int32 frame,
+                              const std::vector<int32> &transition_ids,
+                              std::vector<BaseFloat> *loglikes);
+
   virtual inline int32 NumFramesReady() const {
     return decodable_nnet_.NumFrames();
   }
@@ -398,6 +402,10 @@ class DecodableAmNnetSimpleParallel: public DecodableInterface {
 
   virtual BaseFloat LogLikelihood(int32 frame, int32 transition_id);
 
+  virtual void LogLikelihoods(int32 frame,
+                              const std::vector<int32> &transition_ids,
+                              std::vector<BaseFloat> *loglikes);
+
   virtual inline int32 NumFramesReady() const {
     return decodable_nnet_->NumFrames();
   }
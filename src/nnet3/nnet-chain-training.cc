@@ -20,6 +20,7 @@
 
 #include "nnet3/nnet-chain-training.h"
 #include "nnet3/nnet-utils.h"
+#include "nnet3/natural-gradient-online.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -37,6 +38,8 @@ NnetChainTrainer::NnetChainTrainer(const NnetChainTrainingOptions &opts,
     srand_seed_(RandInt(0, 100000)) {
   if (opts.nnet_config.zero_component_stats)
     ZeroComponentStats(nnet);
+  OnlineNaturalGradient::SetAsyncUpdates(
+      opts.nnet_config.natural_gradient_async_updates);
   KALDI_ASSERT(opts.nnet_config.momentum >= 0.0 &&
                opts.nnet_config.max_param_change >= 0.0 &&
                opts.nnet_config.backstitch_training_interval > 0);
@@ -59,16 +62,63 @@ NnetChainTrainer::NnetChainTrainer(const NnetChainTrainingOptions &opts,
 
 void NnetChainTrainer::Train(const NnetChainExample &chain_eg) {
   NVTX_RANGE(__func__);
+  Timer timer;
+  ComputationRequest request;
+  GetRequest(chain_eg, &request);
+  times_.prepare += timer.Elapsed();
+  CompileAndTrain(chain_eg, request);
+}
+
+void NnetChainTrainer::Train(SequentialNnetChainExampleReader *reader) {
+  if (opts_.nnet_config.pipeline_examples) {
+    NnetExamplePrefetcher<NnetChainExample, NnetChainTrainer> prefetcher(
+        this, reader);
+    NnetChainExample chain_eg;
+    ComputationRequest request;
+    while (prefetcher.Next(&chain_eg, &request))
+      CompileAndTrain(chain_eg, request);
+    times_.read += prefetcher.ReadTime();
+    times_.wait += prefetcher.WaitTime();
+  } else {
+    Timer timer;
+    for (; !reader->Done(); reader->Next()) {
+      const NnetChainExample &chain_eg = reader->Value();
+      times_.read += timer.Elapsed();
+      Train(chain_eg);
+      timer.Reset();
+    }
+    times_.read += timer.Elapsed();
+  }
+}
+
+void NnetChainTrainer::GetRequest(
+    const NnetChainExample &chain_eg, ComputationRequest *request) const {
   bool need_model_derivative = true;
-  const NnetTrainerOptions &nnet_config = opts_.nnet_config;
   bool use_xent_regularization = (opts_.chain_config.xent_regularize != 0.0);
-  ComputationRequest request;
   GetChainComputationRequest(*nnet_, chain_eg, need_model_derivative,
-                             nnet_config.store_component_stats,
+                             opts_.nnet_config.store_component_stats,
                              use_xent_regularization, need_model_derivative,
-                             &request);
+                             request);
+}
+
+void NnetChainTrainer::PrepareExample(NnetChainExample *chain_eg,
+                                      ComputationRequest *request) const {
+  for (size_t i = 0; i < chain_eg->inputs.size(); i++)
+    chain_eg->inputs[i].features.Uncompress();
+  GetRequest(*chain_eg, request);
+}
+
+void NnetChainTrainer::CompileAndTrain(const NnetChainExample &chain_eg,
+                                       const ComputationRequest &request) {
+  Timer timer;
   std::shared_ptr<const NnetComputation> computation = compiler_.Compile(request);
+  times_.prepare += timer.Elapsed();
+  Train(chain_eg, *computation);
+}
 
+void NnetChainTrainer::Train(const NnetChainExample &chain_eg,
+                             const NnetComputation &computation) {
+  const NnetTrainerOptions &nnet_config = opts_.nnet_config;
   if (nnet_config.backstitch_training_scale > 0.0 && num_minibatches_processed_
       % nnet_config.backstitch_training_interval ==
       srand_seed_ % nnet_config.backstitch_training_interval) {
@@ -78,14 +128,14 @@ void NnetChainTrainer::Train(const NnetChainExample &chain_eg) {
     bool is_backstitch_step1 = true;
     srand(srand_seed_ + num_minibatches_processed_);
     ResetGenerators(nnet_);
-    TrainInternalBackstitch(chain_eg, *computation, is_backstitch_step1);
+    TrainInternalBackstitch(chain_eg, computation, is_backstitch_step1);
     FreezeNaturalGradient(false, delta_nnet_); // un-freeze natural gradient
     is_backstitch_step1 = false;
     srand(srand_seed_ + num_minibatches_processed_);
     ResetGenerators(nnet_);
-    TrainInternalBackstitch(chain_eg, *computation, is_backstitch_step1);
+    TrainInternalBackstitch(chain_eg, computation, is_backstitch_step1);
   } else { // conventional training
-    TrainInternal(chain_eg, *computation);
+    TrainInternal(chain_eg, computation);
   }
   if (num_minibatches_processed_ == 0) {
     ConsolidateMemory(nnet_);
@@ -97,6 +147,7 @@ void NnetChainTrainer::Train(const NnetChainExample &chain_eg) {
 void NnetChainTrainer::TrainInternal(const NnetChainExample &eg,
                                      const NnetComputation &computation) {
   NVTX_RANGE(__func__);
+  Timer timer;
   const NnetTrainerOptions &nnet_config = opts_.nnet_config;
   // note: because we give the 1st arg (nnet_) as a pointer to the
   // constructor of 'computer', it will use that copy of the nnet to
@@ -110,6 +161,8 @@ void NnetChainTrainer::TrainInternal(const NnetChainExample &eg,
 
   this->ProcessOutputs(false, eg, &computer);
   computer.Run();
+  times_.compute += timer.Elapsed();
+  timer.Reset();
 
   // If relevant, add in the part of the gradient that comes from
   // parameter-level L2 regularization.
@@ -138,12 +191,14 @@ void NnetChainTrainer::TrainInternal(const NnetChainExample &eg,
     ScaleNnet(nnet_config.momentum, delta_nnet_);
   else
     ScaleNnet(0.0, delta_nnet_);
+  times_.update += timer.Elapsed();
 }
 
 void NnetChainTrainer::TrainInternalBackstitch(const NnetChainExample &eg,
                                                const NnetComputation &computation,
                                                bool is_backstitch_step1) {
   const NnetTrainerOptions &nnet_config = opts_.nnet_config;
+  Timer timer;
   // note: because we give the 1st arg (nnet_) as a pointer to the
   // constructor of 'computer', it will use that copy of the nnet to
   // store stats.
@@ -156,6 +211,8 @@ void NnetChainTrainer::TrainInternalBackstitch(const NnetChainExample &eg,
   bool is_backstitch_step2 = !is_backstitch_step1;
   this->ProcessOutputs(is_backstitch_step2, eg, &computer);
   computer.Run();
+  times_.compute += timer.Elapsed();
+  timer.Reset();
 
   BaseFloat max_change_scale, scale_adding;
   if (is_backstitch_step1) {
@@ -199,6 +256,7 @@ void NnetChainTrainer::TrainInternalBackstitch(const NnetChainExample &eg,
   }
 
   ScaleNnet(0.0, delta_nnet_);
+  times_.update += timer.Elapsed();
 }
 
 void NnetChainTrainer::ProcessOutputs(bool is_backstitch_step2,
@@ -281,6 +339,8 @@ bool NnetChainTrainer::PrintTotalStats() const {
     ans = info.PrintTotalStats(name) || ans;
   }
   max_change_stats_.Print(*nnet_);
+  times_.Print();
+  PrintNnetComputeProfile();
   return ans;
 }
 
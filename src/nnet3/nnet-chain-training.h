@@ -61,11 +61,30 @@ class NnetChainTrainer {
   // train on one minibatch.
   void Train(const NnetChainExample &eg);
 
+  // Trains on all the examples in 'reader'; see the corresponding function of
+  // NnetTrainer for how this works with --pipeline-examples=true.
+  void Train(SequentialNnetChainExampleReader *reader);
+
+  // Uncompresses the inputs of 'eg' and creates the ComputationRequest for
+  // it; see the corresponding function of NnetTrainer.
+  void PrepareExample(NnetChainExample *eg, ComputationRequest *request) const;
+
   // Prints out the final stats, and return true if there was a nonzero count.
   bool PrintTotalStats() const;
 
   ~NnetChainTrainer();
  private:
+  // Creates the ComputationRequest for 'eg'.
+  void GetRequest(const NnetChainExample &eg,
+                  ComputationRequest *request) const;
+
+  // Compiles the computation for 'request' and trains on 'eg' with it.
+  void CompileAndTrain(const NnetChainExample &eg,
+                       const ComputationRequest &request);
+
+  // Trains on one minibatch whose computation has already been compiled.
+  void Train(const NnetChainExample &eg, const NnetComputation &computation);
+
   // The internal function for doing one step of conventional SGD training.
   void TrainInternal(const NnetChainExample &eg,
                      const NnetComputation &computation);
@@ -102,6 +121,8 @@ class NnetChainTrainer {
   // consistent dropout masks.  It's set to a value derived from rand()
   // when the class is initialized.
   int32 srand_seed_;
+
+  NnetTrainingTimes times_;
 };
 
 
@@ -21,6 +21,7 @@
 
 #include "nnet3/nnet-chain-training2.h"
 #include "nnet3/nnet-utils.h"
+#include "nnet3/natural-gradient-online.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -39,6 +40,8 @@ NnetChainTrainer2::NnetChainTrainer2(const NnetChainTraining2Options &opts,
 
   if (opts.nnet_config.zero_component_stats)
     ZeroComponentStats(nnet);
+  OnlineNaturalGradient::SetAsyncUpdates(
+      opts.nnet_config.natural_gradient_async_updates);
   KALDI_ASSERT(opts.nnet_config.momentum >= 0.0 &&
                opts.nnet_config.max_param_change >= 0.0 &&
                opts.nnet_config.backstitch_training_interval > 0);
@@ -294,6 +297,7 @@ bool NnetChainTrainer2::PrintTotalStats() const {
     ans = info.PrintTotalStats(name) || ans;
   }
   max_change_stats_.Print(*nnet_);
+  PrintNnetComputeProfile();
   return ans;
 }
 
@@ -233,6 +233,39 @@ void NnetComputation::SubMatrixInfo::Write(std::ostream &os, bool binary) const
   if (!binary) os << std::endl;
 }
 
+const char *CommandTypeToString(CommandType command_type) {
+  switch (command_type) {
+    case kAllocMatrix: return "kAllocMatrix";
+    case kDeallocMatrix: return "kDeallocMatrix";
+    case kSwapMatrix: return "kSwapMatrix";
+    case kSetConst: return "kSetConst";
+    case kPropagate: return "kPropagate";
+    case kBackprop: return "kBackprop";
+    case kBackpropNoModelUpdate: return "kBackpropNoModelUpdate";
+    case kMatrixCopy: return "kMatrixCopy";
+    case kMatrixAdd: return "kMatrixAdd";
+    case kCopyRows: return "kCopyRows";
+    case kAddRows: return "kAddRows";
+    case kCopyRowsMulti: return "kCopyRowsMulti";
+    case kCopyToRowsMulti: return "kCopyToRowsMulti";
+    case kAddRowsMulti: return "kAddRowsMulti";
+    case kAddToRowsMulti: return "kAddToRowsMulti";
+    case kAddRowRanges: return "kAddRowRanges";
+    case kCompressMatrix: return "kCompressMatrix";
+    case kDecompressMatrix: return "kDecompressMatrix";
+    case kAcceptInput: return "kAcceptInput";
+    case kProvideOutput: return "kProvideOutput";
+    case kNoOperation: return "kNoOperation";
+    case kNoOperationPermanent: return "kNoOperationPermanent";
+    case kNoOperationMarker: return "kNoOperationMarker";
+    case kNoOperationLabel: return "kNoOperationLabel";
+    case kGotoLabel: return "kGotoLabel";
+    default:
+      KALDI_ERR << "Un-handled command type.";
+      return NULL;
+  }
+}
+
 void NnetComputation::Command::Read(std::istream &is, bool binary) {
   ExpectToken(is, binary, "<Cmd>");
   if (binary) {
@@ -329,86 +362,7 @@ void NnetComputation::Command::Write(std::ostream &os, bool binary) const {
       args.pop_back();
     WriteIntegerVector(os, binary, args);
   } else {
-    std::string command_type_str;
-    switch (command_type) {
-      case kAllocMatrix:
-        os << "kAllocMatrix\n";
-        break;
-      case kDeallocMatrix:
-        os << "kDeallocMatrix\n";
-        break;
-      case kSwapMatrix:
-        os << "kSwapMatrix\n";
-        break;
-      case kSetConst:
-        os << "kSetConst\n";
-        break;
-      case kPropagate:
-        os << "kPropagate\n";
-        break;
-      case kBackprop:
-        os << "kBackprop\n";
-        break;
-      case kBackpropNoModelUpdate:
-        os << "kBackpropNoModelUpdate\n";
-        break;
-      case kMatrixCopy:
-        os << "kMatrixCopy\n";
-        break;
-      case kMatrixAdd:
-        os << "kMatrixAdd\n";
-        break;
-      case kCopyRows:
-        os << "kCopyRows\n";
-        break;
-      case kAddRows:
-        os << "kAddRows\n";
-        break;
-      case kCopyRowsMulti:
-        os << "kCopyRowsMulti\n";
-        break;
-      case kCopyToRowsMulti:
-        os << "kCopyToRowsMulti\n";
-        break;
-      case kAddRowsMulti:
-        os << "kAddRowsMulti\n";
-        break;
-      case kAddToRowsMulti:
-        os << "kAddToRowsMulti\n";
-        break;
-      case kAddRowRanges:
-        os << "kAddRowRanges\n";
-        break;
-      case kCompressMatrix:
-        os << "kCompressMatrix\n";
-        break;
-      case kDecompressMatrix:
-        os << "kDecompressMatrix\n";
-        break;
-      case kAcceptInput:
-        os << "kAcceptInput\n";
-        break;
-      case kProvideOutput:
-        os << "kProvideOutput\n";
-        break;
-      case kNoOperation:
-        os << "kNoOperation\n";
-        break;
-      case kNoOperationPermanent:
-        os << "kNoOperationPermanent\n";
-        break;
-      case kNoOperationMarker:
-        os << "kNoOperationMarker\n";
-        break;
-      case kNoOperationLabel:
-        os << "kNoOperationLabel\n";
-        break;
-      case kGotoLabel:
-        os << "kGotoLabel\n";
-        break;
-      default:
-        KALDI_ERR << "Un-handled command type.";
-    }
+    os << CommandTypeToString(command_type) << "\n";
     os << "<Alpha> " << alpha << " ";
     os << "<Args> " << arg1 << ' ' << arg2 << ' '
        << arg3 << ' ' << arg4 << ' ' << arg5 << ' '
@@ -295,6 +295,10 @@ enum CommandType {
   kNoOperation, kNoOperationPermanent, kNoOperationMarker, kNoOperationLabel,
   kGotoLabel };
 
+// Returns the name of the command type, e.g. "kPropagate", as used in the
+// text form of NnetComputation.  The returned string is a constant.
+const char *CommandTypeToString(CommandType command_type);
+
 
 
 // struct NnetComputation defines the specific steps of a neural-net
@@ -276,6 +276,54 @@ void UnitTestNnetCompute() {
   }
 }
 
+void UnitTestNnetComputeProfile() {
+  struct NnetGenerationOptions gen_config;
+  std::vector<std::string> configs;
+  GenerateConfigSequence(gen_config, &configs);
+  Nnet nnet;
+  for (size_t j = 0; j < configs.size(); j++) {
+    std::istringstream is(configs[j]);
+    nnet.ReadConfig(is);
+  }
+  ComputationRequest request;
+  std::vector<Matrix<BaseFloat> > inputs;
+  ComputeExampleComputationRequestSimple(nnet, &request, &inputs);
+  NnetComputation computation;
+  Compiler compiler(request, nnet);
+  CompilerOptions opts;
+  compiler.CreateComputation(opts, &computation);
+  computation.ComputeCudaIndexes();
+
+  std::map<std::string, NnetComputeProfileStats> per_command_type_before,
+      per_component_before, per_command_type, per_component;
+  GetNnetComputeProfile(&per_command_type_before, &per_component_before);
+
+  NnetComputeOptions compute_opts;
+  compute_opts.profile = true;
+  int32 num_runs = 2;
+  for (int32 n = 0; n < num_runs; n++) {
+    NnetComputer computer(compute_opts, computation, nnet, &nnet);
+    for (size_t i = 0; i < request.inputs.size(); i++) {
+      CuMatrix<BaseFloat> temp(inputs[i]);
+      computer.AcceptInput(request.inputs[i].name, &temp);
+    }
+    computer.Run();
+  }
+  GetNnetComputeProfile(&per_command_type, &per_component);
+
+  int32 num_propagate = 0;
+  for (size_t c = 0; c < computation.commands.size(); c++)
+    if (computation.commands[c].command_type == kPropagate)
+      num_propagate++;
+  KALDI_ASSERT(per_command_type["kPropagate"].count -
+               per_command_type_before["kPropagate"].count ==
+               num_runs * num_propagate);
+  KALDI_ASSERT(per_command_type["kPropagate"].flops >
+               per_command_type_before["kPropagate"].flops);
+  KALDI_ASSERT(!per_component.empty());
+  PrintNnetComputeProfile();
+}
+
 } // namespace nnet3
 } // namespace kaldi
 
@@ -296,6 +344,7 @@ int main() {
       CuDevice::Instantiate().SelectGpuId("yes");
 #endif
     UnitTestNnetCompute();
+    UnitTestNnetComputeProfile();
   }
 
   KALDI_LOG << "Nnet tests succeeded.";
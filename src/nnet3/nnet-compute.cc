@@ -18,6 +18,7 @@
 // limitations under the License.
 
 #include <iterator>
+#include <mutex>
 #include <sstream>
 #include "nnet3/nnet-compute.h"
 
@@ -62,6 +63,10 @@ void NnetComputer::Init() {
     KALDI_LOG << preamble;
     computation_.GetSubmatrixStrings(nnet_, &submatrix_strings_);
   }
+  if (options_.profile) {
+    command_counts_.resize(computation_.commands.size(), 0);
+    command_times_.resize(computation_.commands.size(), 0.0);
+  }
 }
 
 //static
@@ -520,6 +525,10 @@ void NnetComputer::Run() {
               << program_counter_;
   }
   CheckNoPendingIo();
+  KALDI_TRACE_SCOPE("NnetComputer::Run");
+  if (options_.profile)
+    SynchronizeGpu();  // so that earlier work is not attributed to the
+                       // first command.
 
   CommandDebugInfo info;
   Timer timer;
@@ -534,7 +543,22 @@ void NnetComputer::Run() {
     }
     if (debug_)
       DebugBeforeExecute(program_counter_, &info);
-    ExecuteCommand();
+    {
+      KALDI_TRACE_SCOPE(
+          CommandTypeToString(c[program_counter_].command_type),
+          program_counter_);
+      if (options_.profile) {
+        // note: ExecuteCommand() may change program_counter_ (kGotoLabel).
+        int32 command_index = program_counter_;
+        Timer command_timer;
+        ExecuteCommand();
+        SynchronizeGpu();
+        command_times_[command_index] += command_timer.Elapsed();
+        command_counts_[command_index]++;
+      } else {
+        ExecuteCommand();
+      }
+    }
     if (debug_) {
       double total_elapsed_now = timer.Elapsed();
       DebugAfterExecute(program_counter_, info,
@@ -678,6 +702,8 @@ void NnetComputer::AcceptInputs(const Nnet &nnet,
 }
 
 NnetComputer::~NnetComputer() {
+  if (options_.profile)
+    AccumulateProfile();
   // Delete any pointers that are present in compressed_matrices_.  Actually
   // they should all already have been deallocated and set to NULL if the
   // compuation was run to completion; we do this in case someone ran
@@ -686,5 +712,168 @@ NnetComputer::~NnetComputer() {
     delete compressed_matrices_[i];
 }
 
+namespace {
+// The profile accumulated by NnetComputer objects with options.profile ==
+// true; see GetNnetComputeProfile().
+struct NnetComputeProfile {
+  std::mutex mutex;
+  std::map<std::string, NnetComputeProfileStats> per_command_type;
+  std::map<std::string, NnetComputeProfileStats> per_component;
+};
+NnetComputeProfile g_nnet_compute_profile;
+
+// Returns the number of elements in a submatrix.
+double NumElements(const NnetComputation &computation, int32 submatrix_index) {
+  const NnetComputation::SubMatrixInfo &info =
+      computation.submatrices[submatrix_index];
+  return static_cast<double>(info.num_rows) * info.num_cols;
+}
+
+// Returns the number of parameters of a component, or zero if it is not
+// updatable.
+double NumParameters(const Component &component) {
+  if (!(component.Properties() & kUpdatableComponent))
+    return 0.0;
+  const UpdatableComponent *uc =
+      dynamic_cast<const UpdatableComponent*>(&component);
+  return (uc == NULL ? 0.0 : uc->NumParameters());
+}
+}  // namespace
+
+void NnetComputer::GetCommandCost(int32 command_index, double *bytes,
+                                  double *flops) const {
+  const NnetComputation::Command &c = computation_.commands[command_index];
+  const double float_size = sizeof(BaseFloat);
+  *bytes = 0.0;
+  *flops = 0.0;
+  switch (c.command_type) {
+    case kSetConst:
+      *bytes = float_size * NumElements(computation_, c.arg1);
+      break;
+    case kPropagate: {
+      const Component &component = *(nnet_.GetComponent(c.arg1));
+      double num_params = NumParameters(component),
+          in = NumElements(computation_, c.arg3),
+          out = NumElements(computation_, c.arg4),
+          num_rows = computation_.submatrices[c.arg4].num_rows;
+      *bytes = float_size * (in + out + num_params);
+      *flops = (num_params != 0.0 ? 2.0 * num_rows * num_params : in + out);
+      break;
+    }
+    case kBackprop: case kBackpropNoModelUpdate: {
+      const Component &component = *(nnet_.GetComponent(c.arg1));
+      double num_params = NumParameters(component),
+          in_value = NumElements(computation_, c.arg3),
+          out_value = NumElements(computation_, c.arg4),
+          out_deriv = NumElements(computation_, c.arg5),
+          in_deriv = NumElements(computation_, c.arg6),
+          num_rows = computation_.submatrices[c.arg5].num_rows;
+      bool update = (c.command_type == kBackprop && num_params != 0.0 &&
+                     computation_.need_model_derivative);
+      *bytes = float_size * (in_value + out_value + out_deriv + in_deriv +
+                             (update ? 3.0 : 1.0) * num_params);
+      if (num_params != 0.0)
+        *flops = 2.0 * num_rows * num_params * ((c.arg6 != 0 ? 1.0 : 0.0) +
+                                                (update ? 1.0 : 0.0));
+      else
+        *flops = out_deriv + in_deriv;
+      break;
+    }
+    case kMatrixCopy: case kCopyRows: case kCopyRowsMulti:
+    case kCopyToRowsMulti: case kCompressMatrix: case kDecompressMatrix:
+      *bytes = 2.0 * float_size * NumElements(computation_, c.arg1);
+      break;
+    case kMatrixAdd: case kAddRows: case kAddRowsMulti: case kAddToRowsMulti:
+    case kAddRowRanges:
+      *bytes = 3.0 * float_size * NumElements(computation_, c.arg1);
+      *flops = 2.0 * NumElements(computation_, c.arg1);
+      break;
+    default:
+      break;
+  }
+}
+
+void NnetComputer::AccumulateProfile() const {
+  // First work out the stats locally, to minimize the time we hold the lock.
+  std::map<std::string, NnetComputeProfileStats> per_command_type,
+      per_component;
+  for (size_t i = 0; i < command_counts_.size(); i++) {
+    if (command_counts_[i] == 0)
+      continue;
+    const NnetComputation::Command &c = computation_.commands[i];
+    NnetComputeProfileStats stats;
+    GetCommandCost(i, &stats.bytes, &stats.flops);
+    stats.count = command_counts_[i];
+    stats.time = command_times_[i];
+    stats.bytes *= stats.count;
+    stats.flops *= stats.count;
+    per_command_type[CommandTypeToString(c.command_type)].Add(stats);
+    if (c.command_type == kPropagate || c.command_type == kBackprop ||
+        c.command_type == kBackpropNoModelUpdate) {
+      std::ostringstream key;
+      key << nnet_.GetComponentName(c.arg1) << " ("
+          << nnet_.GetComponent(c.arg1)->Type() << ") "
+          << (c.command_type == kPropagate ? "propagate" : "backprop");
+      per_component[key.str()].Add(stats);
+    }
+  }
+  std::lock_guard<std::mutex> lock(g_nnet_compute_profile.mutex);
+  std::map<std::string, NnetComputeProfileStats>::const_iterator iter;
+  for (iter = per_command_type.begin(); iter != per_command_type.end(); ++iter)
+    g_nnet_compute_profile.per_command_type[iter->first].Add(iter->second);
+  for (iter = per_component.begin(); iter != per_component.end(); ++iter)
+    g_nnet_compute_profile.per_component[iter->first].Add(iter->second);
+}
+
+void GetNnetComputeProfile(
+    std::map<std::string, NnetComputeProfileStats> *per_command_type,
+    std::map<std::string, NnetComputeProfileStats> *per_component) {
+  std::lock_guard<std::mutex> lock(g_nnet_compute_profile.mutex);
+  *per_command_type = g_nnet_compute_profile.per_command_type;
+  *per_component = g_nnet_compute_profile.per_component;
+}
+
+static bool CompareProfileTime(
+    const std::pair<std::string, NnetComputeProfileStats> &a,
+    const std::pair<std::string, NnetComputeProfileStats> &b) {
+  return a.second.time > b.second.time;
+}
+
+static void PrintNnetComputeProfileTable(
+    const std::string &title,
+    const std::map<std::string, NnetComputeProfileStats> &stats) {
+  std::vector<std::pair<std::string, NnetComputeProfileStats> > pairs(
+      stats.begin(), stats.end());
+  std::sort(pairs.begin(), pairs.end(), CompareProfileTime);
+  double total_time = 0.0;
+  for (size_t i = 0; i < pairs.size(); i++)
+    total_time += pairs[i].second.time;
+  std::ostringstream os;
+  os << title << " (total time " << total_time << "s):\n";
+  for (size_t i = 0; i < pairs.size(); i++) {
+    const NnetComputeProfileStats &s = pairs[i].second;
+    double time = std::max(s.time, 1.0e-10);
+    os << "  " << pairs[i].first << ": count=" << s.count
+       << ", time=" << s.time << "s (" << (100.0 * s.time / total_time)
+       << "%), GB=" << (s.bytes * 1.0e-09)
+       << ", GFLOP=" << (s.flops * 1.0e-09)
+       << ", GB/s=" << (s.bytes * 1.0e-09 / time)
+       << ", GFLOP/s=" << (s.flops * 1.0e-09 / time) << "\n";
+  }
+  KALDI_LOG << os.str();
+}
+
+void PrintNnetComputeProfile() {
+  std::map<std::string, NnetComputeProfileStats> per_command_type,
+      per_component;
+  GetNnetComputeProfile(&per_command_type, &per_component);
+  if (per_command_type.empty())
+    return;
+  PrintNnetComputeProfileTable("Profile of nnet computation per command type",
+                               per_command_type);
+  PrintNnetComputeProfileTable("Profile of nnet computation per component",
+                               per_component);
+}
+
 } // namespace nnet3
 } // namespace kaldi
@@ -38,16 +38,56 @@ namespace nnet3 {
 
 struct NnetComputeOptions {
   bool debug;
-  NnetComputeOptions(): debug(false) { }
+  bool profile;
+  NnetComputeOptions(): debug(false), profile(false) { }
   void Register(OptionsItf *opts) {
     opts->Register("debug", &debug, "If true, turn on "
                    "debug for the neural net computation (very verbose!) "
                    "Will be turned on regardless if --verbose >= 5");
+    opts->Register("profile", &profile, "If true, accumulate the time taken "
+                   "by each type of command and each component, with "
+                   "estimates of the memory traffic and floating-point "
+                   "operations, and print them at the end.  Slows down GPU "
+                   "computation as it synchronizes after each command.");
   }
 
 };
 
 
+/// Statistics accumulated for a type of command or a component when
+/// NnetComputeOptions::profile is true.  'bytes' and 'flops' are rough
+/// estimates, worked out from the matrix dimensions: e.g. for components with
+/// parameters we assume 2 flops per parameter per row, as for an affine
+/// component, and for other components one flop per input and output element.
+struct NnetComputeProfileStats {
+  int64 count;   // The number of times the command(s) were executed.
+  double time;   // Total elapsed time in seconds.
+  double bytes;  // Estimated number of bytes read plus written.
+  double flops;  // Estimated number of floating-point operations.
+  NnetComputeProfileStats(): count(0), time(0.0), bytes(0.0), flops(0.0) { }
+  void Add(const NnetComputeProfileStats &other) {
+    count += other.count;
+    time += other.time;
+    bytes += other.bytes;
+    flops += other.flops;
+  }
+};
+
+/// Outputs the statistics accumulated so far (over all threads) from the
+/// NnetComputer objects that had NnetComputeOptions::profile == true, keyed by
+/// command type (e.g. "kPropagate") and by component-name and direction (e.g.
+/// "tdnn1.affine (NaturalGradientAffineComponent) propagate").  NnetComputer
+/// adds its stats when it is destroyed.
+void GetNnetComputeProfile(
+    std::map<std::string, NnetComputeProfileStats> *per_command_type,
+    std::map<std::string, NnetComputeProfileStats> *per_component);
+
+/// Prints to the log the statistics described in GetNnetComputeProfile(),
+/// sorted on time.  Does nothing if there are no statistics (i.e. if
+/// --computation.profile was not set).
+void PrintNnetComputeProfile();
+
+
 /**
   class NnetComputer is responsible for executing the computation described in the
   "computation" object.
@@ -129,6 +169,15 @@ class NnetComputer {
  private:
   void Init(); // called from constructors.
 
+  // Works out the estimated number of bytes moved and floating-point
+  // operations for one execution of the command with index 'c'
+  // (see NnetComputeProfileStats).
+  void GetCommandCost(int32 c, double *bytes, double *flops) const;
+
+  // Adds the stats in command_counts_ and command_times_ to the global
+  // profile; called from the destructor if options_.profile is true.
+  void AccumulateProfile() const;
+
   const NnetComputeOptions &options_;
   const NnetComputation &computation_;
   const Nnet &nnet_;
@@ -156,6 +205,12 @@ class NnetComputer {
   // command_strings_ is only used if debug_=true, or in case of error.
   std::vector<std::string> command_strings_;
 
+  // command_counts_ and command_times_ are only used if options_.profile is
+  // true; they are indexed by command index and contain the number of times
+  // the command was executed and the total time taken.
+  std::vector<int64> command_counts_;
+  std::vector<double> command_times_;
+
   // The matrices used in the computation.
   std::vector<CuMatrix<BaseFloat> > matrices_;
 
@@ -200,7 +200,7 @@ bool NnetDiscriminativeTrainer::PrintTotalStats() const {
     bool ret = info.PrintTotalStats(name, opts_.discriminative_config.criterion);
     ans = ans || ret;
   }
-
+  PrintNnetComputeProfile();
   return ans;
 }
 
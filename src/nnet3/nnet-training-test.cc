@@ -0,0 +1,117 @@
+// nnet3/nnet-training-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet3/nnet-training.h"
+#include "nnet3/nnet-diagnostics.h"
+#include "nnet3/nnet-test-utils.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+// Trains a copy of 'nnet' on the examples in 'egs_rspecifier' and returns the
+// objective of the trained nnet on those examples.
+static double TrainAndEvaluate(const Nnet &nnet,
+                               const std::string &egs_rspecifier,
+                               bool pipeline_examples,
+                               Nnet *trained_nnet) {
+  *trained_nnet = nnet;
+  NnetTrainerOptions config;
+  config.pipeline_examples = pipeline_examples;
+  {
+    NnetTrainer trainer(config, trained_nnet);
+    SequentialNnetExampleReader example_reader(egs_rspecifier);
+    trainer.Train(&example_reader);
+    KALDI_ASSERT(trainer.PrintTotalStats());
+  }
+  NnetComputeProbOptions prob_config;
+  NnetComputeProb prob_computer(prob_config, *trained_nnet);
+  SequentialNnetExampleReader example_reader(egs_rspecifier);
+  for (; !example_reader.Done(); example_reader.Next())
+    prob_computer.Compute(example_reader.Value());
+  double tot_weight;
+  double objf = prob_computer.GetTotalObjective(&tot_weight);
+  KALDI_ASSERT(tot_weight > 0.0);
+  return objf / tot_weight;
+}
+
+// Checks that training with --pipeline-examples=true (reading, uncompressing
+// and creating the requests for the examples in a background thread) gives the
+// same result as without.
+void UnitTestNnetTrainerPipelined() {
+  int32 dim = RandInt(5, 10), left_context = 1, right_context = 1;
+  std::ostringstream config_os;
+  config_os << "input-node name=input dim=" << dim << "\n"
+            << "component name=affine1 type=AffineComponent input-dim="
+            << (3 * dim) << " output-dim=20\n"
+            << "component name=relu1 type=RectifiedLinearComponent dim=20\n"
+            << "component name=affine2 type=AffineComponent input-dim=20"
+            << " output-dim=" << dim << "\n"
+            << "component name=logsoftmax type=LogSoftmaxComponent dim="
+            << dim << "\n"
+            << "component-node name=affine1 component=affine1 "
+            << "input=Append(Offset(input, -1), input, Offset(input, 1))\n"
+            << "component-node name=relu1 component=relu1 input=affine1\n"
+            << "component-node name=affine2 component=affine2 input=relu1\n"
+            << "component-node name=logsoftmax component=logsoftmax "
+            << "input=affine2\n"
+            << "output-node name=output input=logsoftmax objective=linear\n";
+  Nnet nnet;
+  {
+    std::istringstream is(config_os.str());
+    nnet.ReadConfig(is);
+  }
+
+  std::string egs_filename = "tmp.nnet-training-test.egs",
+      egs_specifier = "ark:" + egs_filename;
+  int32 num_egs = RandInt(5, 20);
+  {
+    NnetExampleWriter example_writer(egs_specifier);
+    for (int32 i = 0; i < num_egs; i++) {
+      NnetExample eg;
+      // The input and output dims are the same, so it doesn't matter which
+      // order this function takes them in.  It compresses the input features
+      // half the time.
+      GenerateSimpleNnetTrainingExample(RandInt(1, 10), left_context,
+                                        right_context, dim, dim, 0, &eg);
+      std::ostringstream key;
+      key << "eg" << i;
+      example_writer.Write(key.str(), eg);
+    }
+  }
+
+  Nnet nnet1, nnet2;
+  double objf1 = TrainAndEvaluate(nnet, egs_specifier, false, &nnet1),
+      objf2 = TrainAndEvaluate(nnet, egs_specifier, true, &nnet2);
+  KALDI_LOG << "Objective without pipelining is " << objf1
+            << ", with pipelining " << objf2;
+  KALDI_ASSERT(NnetParametersAreIdentical(nnet1, nnet2, 1.0e-05));
+  AssertEqual(objf1, objf2, 1.0e-05);
+  unlink(egs_filename.c_str());
+}
+
+}  // namespace nnet3
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet3;
+  SetVerboseLevel(2);
+  for (int32 i = 0; i < 5; i++)
+    UnitTestNnetTrainerPipelined();
+  KALDI_LOG << "Nnet training tests succeeded.";
+  return 0;
+}
@@ -20,6 +20,7 @@
 
 #include "nnet3/nnet-training.h"
 #include "nnet3/nnet-utils.h"
+#include "nnet3/natural-gradient-online.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -34,6 +35,8 @@ NnetTrainer::NnetTrainer(const NnetTrainerOptions &config,
     srand_seed_(RandInt(0, 100000)) {
   if (config.zero_component_stats)
     ZeroComponentStats(nnet);
+  OnlineNaturalGradient::SetAsyncUpdates(
+      config.natural_gradient_async_updates);
   KALDI_ASSERT(config.momentum >= 0.0 &&
                config.max_param_change >= 0.0 &&
                config.backstitch_training_interval > 0);
@@ -55,13 +58,59 @@ NnetTrainer::NnetTrainer(const NnetTrainerOptions &config,
 
 
 void NnetTrainer::Train(const NnetExample &eg) {
-  bool need_model_derivative = true;
+  Timer timer;
   ComputationRequest request;
+  GetRequest(eg, &request);
+  times_.prepare += timer.Elapsed();
+  CompileAndTrain(eg, request);
+}
+
+void NnetTrainer::Train(SequentialNnetExampleReader *reader) {
+  if (config_.pipeline_examples) {
+    NnetExamplePrefetcher<NnetExample, NnetTrainer> prefetcher(this, reader);
+    NnetExample eg;
+    ComputationRequest request;
+    while (prefetcher.Next(&eg, &request))
+      CompileAndTrain(eg, request);
+    times_.read += prefetcher.ReadTime();
+    times_.wait += prefetcher.WaitTime();
+  } else {
+    Timer timer;
+    for (; !reader->Done(); reader->Next()) {
+      const NnetExample &eg = reader->Value();
+      times_.read += timer.Elapsed();
+      Train(eg);
+      timer.Reset();
+    }
+    times_.read += timer.Elapsed();
+  }
+}
+
+void NnetTrainer::GetRequest(const NnetExample &eg,
+                             ComputationRequest *request) const {
+  bool need_model_derivative = true;
   GetComputationRequest(*nnet_, eg, need_model_derivative,
                         config_.store_component_stats,
-                        &request);
+                        request);
+}
+
+void NnetTrainer::PrepareExample(NnetExample *eg,
+                                 ComputationRequest *request) const {
+  for (size_t i = 0; i < eg->io.size(); i++)
+    eg->io[i].features.Uncompress();
+  GetRequest(*eg, request);
+}
+
+void NnetTrainer::CompileAndTrain(const NnetExample &eg,
+                                  const ComputationRequest &request) {
+  Timer timer;
   std::shared_ptr<const NnetComputation> computation = compiler_.Compile(request);
+  times_.prepare += timer.Elapsed();
+  Train(eg, *computation);
+}
 
+void NnetTrainer::Train(const NnetExample &eg,
+                        const NnetComputation &computation) {
   if (config_.backstitch_training_scale > 0.0 &&
       num_minibatches_processed_ % config_.backstitch_training_interval ==
       srand_seed_ % config_.backstitch_training_interval) {
@@ -71,25 +120,25 @@ void NnetTrainer::Train(const NnetExample &eg) {
     bool is_backstitch_step1 = true;
     srand(srand_seed_ + num_minibatches_processed_);
     ResetGenerators(nnet_);
-    TrainInternalBackstitch(eg, *computation, is_backstitch_step1);
+    TrainInternalBackstitch(eg, computation, is_backstitch_step1);
     FreezeNaturalGradient(false, delta_nnet_); // un-freeze natural gradient
     is_backstitch_step1 = false;
     srand(srand_seed_ + num_minibatches_processed_);
     ResetGenerators(nnet_);
-    TrainInternalBackstitch(eg, *computation, is_backstitch_step1);
+    TrainInternalBackstitch(eg, computation, is_backstitch_step1);
   } else { // conventional training
-    TrainInternal(eg, *computation);
+    TrainInternal(eg, computation);
   }
   if (num_minibatches_processed_ == 0) {
     ConsolidateMemory(nnet_);
     ConsolidateMemory(delta_nnet_);
   }
   num_minibatches_processed_++;
-
 }
 
 void NnetTrainer::TrainInternal(const NnetExample &eg,
                                 const NnetComputation &computation) {
+  Timer timer;
   // note: because we give the 1st arg (nnet_) as a pointer to the
   // constructor of 'computer', it will use that copy of the nnet to
   // store stats.
@@ -101,6 +150,8 @@ void NnetTrainer::TrainInternal(const NnetExample &eg,
 
   this->ProcessOutputs(false, eg, &computer);
   computer.Run();
+  times_.compute += timer.Elapsed();
+  timer.Reset();
 
   // If relevant, add in the part of the gradient that comes from L2
   // regularization.
@@ -126,11 +177,13 @@ void NnetTrainer::TrainInternal(const NnetExample &eg,
     ScaleNnet(config_.momentum, delta_nnet_);
   else
     ScaleNnet(0.0, delta_nnet_);
+  times_.update += timer.Elapsed();
 }
 
 void NnetTrainer::TrainInternalBackstitch(const NnetExample &eg,
                                           const NnetComputation &computation,
                                           bool is_backstitch_step1) {
+  Timer timer;
   // note: because we give the 1st arg (nnet_) as a pointer to the
   // constructor of 'computer', it will use that copy of the nnet to
   // store stats.
@@ -143,6 +196,8 @@ void NnetTrainer::TrainInternalBackstitch(const NnetExample &eg,
   bool is_backstitch_step2 = !is_backstitch_step1;
   this->ProcessOutputs(is_backstitch_step2, eg, &computer);
   computer.Run();
+  times_.compute += timer.Elapsed();
+  timer.Reset();
 
   BaseFloat max_change_scale, scale_adding;
   if (is_backstitch_step1) {
@@ -186,6 +241,7 @@ void NnetTrainer::TrainInternalBackstitch(const NnetExample &eg,
   }
 
   ScaleNnet(0.0, delta_nnet_);
+  times_.update += timer.Elapsed();
 }
 
 void NnetTrainer::ProcessOutputs(bool is_backstitch_step2,
@@ -236,9 +292,19 @@ bool NnetTrainer::PrintTotalStats() const {
     ans = ans || ok;
   }
   max_change_stats_.Print(*nnet_);
+  times_.Print();
+  PrintNnetComputeProfile();
   return ans;
 }
 
+void NnetTrainingTimes::Print() const {
+  KALDI_LOG << "Time taken in the stages of training (in seconds): "
+            << "reading examples " << read << ", preparing computations "
+            << prepare << ", computation " << compute
+            << ", updating parameters " << update
+            << ", waiting for background thread " << wait;
+}
+
 void ObjectiveFunctionInfo::UpdateStats(
     const std::string &output_name,
     int32 minibatches_per_phase,
@@ -27,6 +27,9 @@
 #include "nnet3/nnet-optimize.h"
 #include "nnet3/nnet-example-utils.h"
 #include "nnet3/nnet-utils.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 
 namespace kaldi {
 namespace nnet3 {
@@ -45,6 +48,8 @@ struct NnetTrainerOptions {
   std::string write_cache;
   bool binary_write_cache;
   BaseFloat max_param_change;
+  bool natural_gradient_async_updates;
+  bool pipeline_examples;
   NnetOptimizeOptions optimize_config;
   NnetComputeOptions compute_config;
   CachingOptimizingCompilerOptions compiler_config;
@@ -59,7 +64,9 @@ struct NnetTrainerOptions {
       backstitch_training_interval(1),
       batchnorm_stats_scale(0.8),
       binary_write_cache(true),
-      max_param_change(2.0) { }
+      max_param_change(2.0),
+      natural_gradient_async_updates(false),
+      pipeline_examples(false) { }
   void Register(OptionsItf *opts) {
     opts->Register("store-component-stats", &store_component_stats,
                    "If true, store activations and derivatives for nonlinear "
@@ -105,6 +112,16 @@ struct NnetTrainerOptions {
                    "the cached computation.");
     opts->Register("binary-write-cache", &binary_write_cache, "Write "
                    "computation cache in binary mode");
+    opts->Register("natural-gradient-async-updates",
+                   &natural_gradient_async_updates, "If true (and not using "
+                   "a GPU), do the periodic updates of the natural-gradient "
+                   "Fisher-matrix estimates in a background thread, "
+                   "overlapping with the rest of the backprop.  Does not "
+                   "change the results.");
+    opts->Register("pipeline-examples", &pipeline_examples, "If true, read "
+                   "the examples and uncompress them in a background thread, "
+                   "one minibatch ahead of the training.  Does not change the "
+                   "results.");
 
     // register the optimization options with the prefix "optimization".
     ParseOptions optimization_opts("optimization", opts);
@@ -165,17 +182,152 @@ struct ObjectiveFunctionInfo {
 };
 
 
+/**
+   This struct accumulates the time (in seconds) spent in the different stages
+   of training; it is printed by the trainers' PrintTotalStats() function.
+   When training with --pipeline-examples=true, the reading (which then
+   includes uncompressing the inputs and creating the ComputationRequest)
+   happens in a background thread, so 'prepare' is just the compilation, and
+   'wait' is the time the training thread spent waiting for it; it is zero
+   otherwise.  Note: when using a GPU the
+   kernels are launched asynchronously, so the time will tend to get attributed
+   to whichever stage happens to synchronize with the GPU.
+*/
+struct NnetTrainingTimes {
+  double read;     // reading the examples from the input.
+  double prepare;  // creating the request and compiling the computation.
+  double compute;  // the forward and backward computation.
+  double update;   // updating the parameters (max-change, momentum, etc.).
+  double wait;     // waiting for the background thread, if pipelining.
+  NnetTrainingTimes(): read(0.0), prepare(0.0), compute(0.0), update(0.0),
+                       wait(0.0) { }
+  void Print() const;
+};
+
+
+/**
+   This class template is used by NnetTrainer and NnetChainTrainer when the
+   option --pipeline-examples=true is given, to overlap the reading of
+   minibatch n+1 with the training on minibatch n.  A background thread reads
+   the examples from 'reader' and calls Trainer::PrepareExample() on each one,
+   which uncompresses its inputs and creates its ComputationRequest; they are
+   handed over to the training thread through a buffer that holds a single
+   example, i.e. it is double-buffered.
+
+   The computations are still compiled in the training thread: the compiler
+   reads the nnet, which the training thread is updating, and may allocate GPU
+   memory, and the CUDA allocator is only safe to use from more than one
+   thread after CuDevice::AllowMultithreading().  The background thread is the
+   only user of the reader while this object exists.  Template argument
+   'Example' is NnetExample or NnetChainExample and 'Trainer' the corresponding
+   trainer.
+*/
+template <class Example, class Trainer>
+class NnetExamplePrefetcher {
+ public:
+  NnetExamplePrefetcher(
+      const Trainer *trainer,
+      SequentialTableReader<KaldiObjectHolder<Example> > *reader):
+      trainer_(trainer), reader_(reader), full_(false), done_(false),
+      stop_(false), read_time_(0.0), wait_time_(0.0) {
+    thread_ = std::thread(&NnetExamplePrefetcher::Run, this);
+  }
+
+  /// Outputs the next example, with its inputs uncompressed, and the
+  /// ComputationRequest for it.  Returns false when there are no more
+  /// examples.
+  bool Next(Example *eg, ComputationRequest *request) {
+    Timer timer;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!full_ && !done_)
+      cond_.wait(lock);
+    wait_time_ += timer.Elapsed();
+    if (!full_) {
+      if (!error_.empty())
+        KALDI_ERR << "Error reading examples: " << error_;
+      return false;
+    }
+    eg->Swap(&eg_);
+    std::swap(*request, request_);
+    full_ = false;
+    cond_.notify_all();
+    return true;
+  }
+
+  /// Time (in seconds) spent reading and preparing examples in the background
+  /// thread.  Only valid once Next() has returned false.
+  double ReadTime() const { return read_time_; }
+  /// Time (in seconds) the training thread spent inside Next().
+  double WaitTime() const { return wait_time_; }
+
+  ~NnetExamplePrefetcher() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+      cond_.notify_all();
+    }
+    thread_.join();
+  }
+
+ private:
+  void Run() {
+    try {
+      Timer timer;
+      for (; !reader_->Done(); reader_->Next()) {
+        Example eg(reader_->Value());
+        ComputationRequest request;
+        trainer_->PrepareExample(&eg, &request);
+        read_time_ += timer.Elapsed();
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (full_ && !stop_)
+          cond_.wait(lock);
+        if (stop_)
+          return;
+        eg_.Swap(&eg);
+        std::swap(request_, request);
+        full_ = true;
+        cond_.notify_all();
+        lock.unlock();
+        timer.Reset();
+      }
+      read_time_ += timer.Elapsed();
+    } catch (const std::exception &e) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      error_ = e.what();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+    cond_.notify_all();
+  }
+
+  const Trainer *trainer_;
+  SequentialTableReader<KaldiObjectHolder<Example> > *reader_;
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  // The buffer, containing the next example and its request if full_ is true.
+  Example eg_;
+  ComputationRequest request_;
+  bool full_;
+  bool done_;  // true if the background thread has finished.
+  bool stop_;  // set by the destructor to stop the background thread early.
+  std::string error_;  // error message from the background thread, if any.
+  double read_time_;
+  double wait_time_;
+};
+
+
 /** This class is for single-threaded training of neural nets using
     standard objective functions such as cross-entropy (implemented with
     logsoftmax nonlinearity and a linear objective function) and quadratic loss.
 
-    Something that we should do in the future is to make it possible to have
-    two different threads, one for the compilation, and one for the computation.
-    This would only improve efficiency in the cases where the structure of the
-    input example was different each time, which isn't what we expect to see in
-    speech-recognition training.  (If the structure is the same each time,
-    the CachingOptimizingCompiler notices this and uses the computation from
-    last time).
+    If the option --pipeline-examples is true, the reading and decompression
+    of the examples and the creation of their ComputationRequests are done in
+    a background thread, one minibatch ahead of the computation (see
+    NnetExamplePrefetcher).  The compilation stays in the training thread; it
+    is normally fast anyway because, if the structure of the examples is the
+    same each time, the CachingOptimizingCompiler notices this and uses the
+    computation from last time.
  */
 class NnetTrainer {
  public:
@@ -185,11 +337,34 @@ class NnetTrainer {
   // train on one minibatch.
   void Train(const NnetExample &eg);
 
+  // Trains on all the examples in 'reader'.  If config.pipeline_examples is
+  // true, this reads and prepares the examples in a background thread (see
+  // NnetExamplePrefetcher); otherwise it is the same as calling Train() on each
+  // example, except that the time taken to read them is recorded.
+  void Train(SequentialNnetExampleReader *reader);
+
+  // Uncompresses the inputs of 'eg' and creates the ComputationRequest for
+  // it.  This is done to each example in the background thread with
+  // --pipeline-examples=true.  It only reads the names and types of the nodes
+  // of the nnet, which training doesn't change, so it's safe to call while
+  // another thread is training.
+  void PrepareExample(NnetExample *eg, ComputationRequest *request) const;
+
   // Prints out the final stats, and return true if there was a nonzero count.
   bool PrintTotalStats() const;
 
   ~NnetTrainer();
  private:
+  // Creates the ComputationRequest for 'eg'.
+  void GetRequest(const NnetExample &eg, ComputationRequest *request) const;
+
+  // Compiles the computation for 'request' and trains on 'eg' with it.
+  void CompileAndTrain(const NnetExample &eg,
+                       const ComputationRequest &request);
+
+  // Trains on one minibatch whose computation has already been compiled.
+  void Train(const NnetExample &eg, const NnetComputation &computation);
+
   // The internal function for doing one step of conventional SGD training.
   void TrainInternal(const NnetExample &eg,
                      const NnetComputation &computation);
@@ -225,6 +400,8 @@ class NnetTrainer {
   // consistent dropout masks.  It's set to a value derived from rand()
   // when the class is initialized.
   int32 srand_seed_;
+
+  NnetTrainingTimes times_;
 };
 
 /**
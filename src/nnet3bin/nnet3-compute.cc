@@ -129,11 +129,13 @@ int main(int argc, char *argv[]) {
     int32 num_success = 0, num_fail = 0;
     int64 frame_count = 0;
 
-    SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+    // The features are only read, so we read them as views, which avoids
+    // copying them when they come from memory-mapped files.
+    SequentialBaseFloatMatrixViewReader feature_reader(feature_rspecifier);
 
     for (; !feature_reader.Done(); feature_reader.Next()) {
       std::string utt = feature_reader.Key();
-      const Matrix<BaseFloat> &features (feature_reader.Value());
+      const SubMatrix<BaseFloat> features(feature_reader.Value().Mat());
       if (features.NumRows() == 0) {
         KALDI_WARN << "Zero-length utterance: " << utt;
         num_fail++;
@@ -182,6 +184,7 @@ int main(int argc, char *argv[]) {
       num_success++;
     }
 
+    PrintNnetComputeProfile();
 #if HAVE_CUDA==1
     CuDevice::Instantiate().PrintProfile();
 #endif
@@ -36,6 +36,7 @@ static bool ProcessFile(const GeneralMatrix &feats,
                         const Posterior &pdf_post,
                         const std::string &utt_id,
                         bool compress,
+                        CompressionMethod compression_method,
                         int32 num_pdfs,
                         int32 length_tolerance,
                         UtteranceSplitter *utt_splitter,
@@ -73,6 +74,8 @@ static bool ProcessFile(const GeneralMatrix &feats,
     GeneralMatrix input_frames;
     ExtractRowRangeWithPadding(feats, start_frame, tot_input_frames,
                                &input_frames);
+    if (compress && compression_method != kAutomaticMethod)
+      input_frames.Compress(compression_method);
 
     // 'input_frames' now stores the relevant rows (maybe with padding) from the
     // original Matrix or (more likely) CompressedMatrix.  If a CompressedMatrix,
@@ -121,15 +124,16 @@ static bool ProcessFile(const GeneralMatrix &feats,
 
     eg.io.push_back(NnetIo("output", num_pdfs, 0, labels, frame_subsampling_factor));
 
-    if (compress)
-      eg.Compress();
-
     std::ostringstream os;
     os << utt_id << "-" << chunk.first_frame;
 
     std::string key = os.str(); // key is <utt_id>-<frame_id>
 
-    example_writer->Write(key, eg);
+    if (compress)  // with the "bg" wspecifier option, compresses in the
+                   // background.
+      example_writer->WriteCompressed(key, &eg);
+    else
+      example_writer->Write(key, eg);
   }
   return true;
 }
@@ -165,6 +169,7 @@ int main(int argc, char *argv[]) {
 
 
     bool compress = true;
+    int32 compression_method_in = 1;
     int32 num_pdfs = -1, length_tolerance = 100,
         targets_length_tolerance = 2,  
         online_ivector_period = 1;
@@ -180,7 +185,15 @@ int main(int argc, char *argv[]) {
                 "in compressed format (recommended).  This is "
                 "only relevant if the features being read are un-compressed; "
                 "if already compressed, we keep the same compressed format when "
-                "dumping egs.");
+                "dumping egs.  With the bg option in the wspecifier (e.g. "
+                "ark,bg:-), compression is done in background threads.");
+    po.Register("compression-method", &compression_method_in, "Only "
+                "relevant if --compress=true; if not 1 (automatic), the "
+                "method with which the input features of the egs are "
+                "compressed, even if the features being read are already "
+                "compressed (e.g. use 2 for features that were stored with "
+                "method 8, which is slow to decompress).  Search for "
+                "CompressionMethod in src/matrix/compressed-matrix.h.");
     po.Register("num-pdfs", &num_pdfs, "Number of pdfs in the acoustic "
                 "model");
     po.Register("ivectors", &online_ivector_rspecifier, "Alias for "
@@ -260,7 +273,9 @@ int main(int argc, char *argv[]) {
         }
 
         if (!ProcessFile(feats, online_ivector_feats, online_ivector_period,
-                         pdf_post, key, compress, num_pdfs, 
+                         pdf_post, key, compress,
+                         static_cast<CompressionMethod>(compression_method_in),
+                         num_pdfs,
                          targets_length_tolerance,
                          &utt_splitter, &example_writer))
           num_err++;
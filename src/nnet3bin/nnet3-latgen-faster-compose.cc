@@ -0,0 +1,266 @@
+// nnet3bin/nnet3-latgen-faster-compose.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "hmm/transition-model.h"
+#include "fstext/fstext-lib.h"
+#include "lm/const-arpa-lm.h"
+#include "decoder/decoder-wrappers.h"
+#include "decoder/lm-compose-fst.h"
+#include "nnet3/nnet-am-decodable-simple.h"
+#include "nnet3/nnet-utils.h"
+#include "base/timer.h"
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet3;
+    typedef kaldi::int32 int32;
+    using fst::StdArc;
+
+    const char *usage =
+        "Generate lattices using nnet3 neural net model, composing HCL.fst with\n"
+        "the language model on the fly (no OpenFst extensions needed; see\n"
+        "decoder/lm-compose-fst.h).  The language model is G.fst (its backoff\n"
+        "arcs are taken from its output side, so #0 does not need removing), or\n"
+        "with --const-arpa=true, a ConstArpaLm as made by arpa-to-const-arpa,\n"
+        "in which case --disambig-syms is needed if the LM has <unk>.\n"
+        "Usage: nnet3-latgen-faster-compose [options] <nnet-in> <hcl-fst-in> "
+        "<lm-in> <features-rspecifier> <lattice-wspecifier> "
+        "[ <words-wspecifier> [<alignments-wspecifier>] ]\n"
+        "e.g.: nnet3-latgen-faster-compose final.mdl HCL.fst G.fst "
+        "scp:feats.scp ark:lat.ark\n"
+        "or: nnet3-latgen-faster-compose --const-arpa=true \\\n"
+        "  --disambig-syms=data/lang/phones/wdisambig_words.int final.mdl \\\n"
+        "  HCL.fst G.carpa scp:feats.scp ark:lat.ark\n";
+    ParseOptions po(usage);
+    Timer timer;
+    bool allow_partial = false, const_arpa = false;
+    int32 num_cached_arcs = 1000000;
+    LatticeFasterDecoderConfig config;
+    NnetSimpleComputationOptions decodable_opts;
+
+    std::string word_syms_filename, disambig_rxfilename;
+    std::string ivector_rspecifier,
+        online_ivector_rspecifier,
+        utt2spk_rspecifier;
+    int32 online_ivector_period = 0;
+    config.Register(&po);
+    decodable_opts.Register(&po);
+    po.Register("word-symbol-table", &word_syms_filename,
+                "Symbol table for words [for debug output]");
+    po.Register("allow-partial", &allow_partial,
+                "If true, produce output even if end state was not reached.");
+    po.Register("const-arpa", &const_arpa, "If true, <lm-in> is a ConstArpaLm "
+                "rather than an FST.");
+    po.Register("num-cached-arcs", &num_cached_arcs, "Size of the cache of "
+                "language-model arcs that have been looked up.");
+    po.Register("disambig-syms", &disambig_rxfilename, "List of word-ids "
+                "of the disambiguation symbols on the output side of HCL "
+                "(e.g. data/lang/phones/wdisambig_words.int), whose arcs are "
+                "dropped.  Required with --const-arpa=true if the LM has "
+                "<unk>, because a ConstArpaLm gives unknown words (such as "
+                "#0) the cost of <unk>.");
+    po.Register("ivectors", &ivector_rspecifier, "Rspecifier for "
+                "iVectors as vectors (i.e. not estimated online); per utterance "
+                "by default, or per speaker if you provide the --utt2spk option.");
+    po.Register("utt2spk", &utt2spk_rspecifier, "Rspecifier for "
+                "utt2spk option used to get ivectors per speaker");
+    po.Register("online-ivectors", &online_ivector_rspecifier, "Rspecifier for "
+                "iVectors estimated online, as matrices.  If you supply this,"
+                " you must set the --online-ivector-period option.");
+    po.Register("online-ivector-period", &online_ivector_period, "Number of frames "
+                "between iVectors in matrices supplied to the --online-ivectors "
+                "option");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 5 || po.NumArgs() > 7) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string model_in_filename = po.GetArg(1),
+        hcl_in_str = po.GetArg(2),
+        lm_in_str = po.GetArg(3),
+        feature_rspecifier = po.GetArg(4),
+        lattice_wspecifier = po.GetArg(5),
+        words_wspecifier = po.GetOptArg(6),
+        alignment_wspecifier = po.GetOptArg(7);
+
+    TransitionModel trans_model;
+    AmNnetSimple am_nnet;
+    {
+      bool binary;
+      Input ki(model_in_filename, &binary);
+      trans_model.Read(ki.Stream(), binary);
+      am_nnet.Read(ki.Stream(), binary);
+      SetBatchnormTestMode(true, &(am_nnet.GetNnet()));
+      SetDropoutTestMode(true, &(am_nnet.GetNnet()));
+      CollapseModel(CollapseModelConfig(), &(am_nnet.GetNnet()));
+    }
+
+    bool determinize = config.determinize_lattice;
+    CompactLatticeWriter compact_lattice_writer;
+    LatticeWriter lattice_writer;
+    if (! (determinize ? compact_lattice_writer.Open(lattice_wspecifier)
+           : lattice_writer.Open(lattice_wspecifier)))
+      KALDI_ERR << "Could not open table for writing lattices: "
+                 << lattice_wspecifier;
+
+    RandomAccessBaseFloatMatrixReader online_ivector_reader(
+        online_ivector_rspecifier);
+    RandomAccessBaseFloatVectorReaderMapped ivector_reader(
+        ivector_rspecifier, utt2spk_rspecifier);
+
+    Int32VectorWriter words_writer(words_wspecifier);
+    Int32VectorWriter alignment_writer(alignment_wspecifier);
+
+    fst::SymbolTable *word_syms = NULL;
+    if (word_syms_filename != "")
+      if (!(word_syms = fst::SymbolTable::ReadText(word_syms_filename)))
+        KALDI_ERR << "Could not read symbol table from file "
+                   << word_syms_filename;
+
+    // HCL; we want it as a ConstFst so the arc iterator can access the arcs
+    // directly.
+    fst::ConstFst<StdArc> *hcl_fst;
+    {
+      fst::Fst<StdArc> *fst = fst::ReadFstKaldiGeneric(hcl_in_str);
+      hcl_fst = new fst::ConstFst<StdArc>(*fst);
+      delete fst;
+    }
+
+    // The language model, as a DeterministicOnDemandFst.
+    ConstArpaLm const_arpa_lm;
+    fst::ConstFst<StdArc> *g_fst = NULL;
+    fst::DeterministicOnDemandFst<StdArc> *lm_fst = NULL;
+    if (const_arpa) {
+      ReadKaldiObject(lm_in_str, &const_arpa_lm);
+      lm_fst = new ConstArpaLmDeterministicFst(const_arpa_lm);
+    } else {
+      fst::VectorFst<StdArc> *fst = fst::ReadFstKaldi(lm_in_str);
+      // The backoff arcs have #0 on the input side and epsilon on the output.
+      fst::Project(fst, fst::PROJECT_OUTPUT);
+      fst::ArcSort(fst, fst::ILabelCompare<StdArc>());
+      g_fst = new fst::ConstFst<StdArc>(*fst);
+      delete fst;
+      lm_fst = new fst::BackoffDeterministicOnDemandFst<StdArc>(*g_fst);
+    }
+    std::vector<int32> disambig_words;
+    if (disambig_rxfilename != "") {
+      if (!ReadIntegerVectorSimple(disambig_rxfilename, &disambig_words))
+        KALDI_ERR << "Could not read disambiguation symbols from "
+                  << disambig_rxfilename;
+    } else if (const_arpa && const_arpa_lm.UnkSymbol() != -1) {
+      KALDI_ERR << "The ConstArpaLm has <unk>, so --disambig-syms must be "
+                << "given, or #0 would be decoded as a word.";
+    }
+    fst::CacheDeterministicOnDemandFst<StdArc> cached_lm_fst(lm_fst,
+                                                            num_cached_arcs);
+    fst::LmComposeFst decode_fst(*hcl_fst, &cached_lm_fst, disambig_words);
+
+    double tot_like = 0.0;
+    kaldi::int64 frame_count = 0;
+    int num_success = 0, num_fail = 0;
+    // this compiler object allows caching of computations across
+    // different utterances.
+    CachingOptimizingCompiler compiler(am_nnet.GetNnet(),
+                                       decodable_opts.optimize_config);
+
+    SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+    timer.Reset();
+
+    {
+      LatticeFasterDecoderTpl<fst::LmComposeFst> decoder(decode_fst, config);
+
+      for (; !feature_reader.Done(); feature_reader.Next()) {
+        std::string utt = feature_reader.Key();
+        const Matrix<BaseFloat> &features (feature_reader.Value());
+        if (features.NumRows() == 0) {
+          KALDI_WARN << "Zero-length utterance: " << utt;
+          num_fail++;
+          continue;
+        }
+        const Matrix<BaseFloat> *online_ivectors = NULL;
+        const Vector<BaseFloat> *ivector = NULL;
+        if (!ivector_rspecifier.empty()) {
+          if (!ivector_reader.HasKey(utt)) {
+            KALDI_WARN << "No iVector available for utterance " << utt;
+            num_fail++;
+            continue;
+          } else {
+            ivector = &ivector_reader.Value(utt);
+          }
+        }
+        if (!online_ivector_rspecifier.empty()) {
+          if (!online_ivector_reader.HasKey(utt)) {
+            KALDI_WARN << "No online iVector available for utterance " << utt;
+            num_fail++;
+            continue;
+          } else {
+            online_ivectors = &online_ivector_reader.Value(utt);
+          }
+        }
+
+        DecodableAmNnetSimple nnet_decodable(
+            decodable_opts, trans_model, am_nnet,
+            features, ivector, online_ivectors,
+            online_ivector_period, &compiler);
+
+        double like;
+        if (DecodeUtteranceLatticeFaster(
+                decoder, nnet_decodable, trans_model, word_syms, utt,
+                decodable_opts.acoustic_scale, determinize, allow_partial,
+                &alignment_writer, &words_writer, &compact_lattice_writer,
+                &lattice_writer,
+                &like)) {
+          tot_like += like;
+          frame_count += nnet_decodable.NumFramesReady();
+          num_success++;
+        } else num_fail++;
+      }
+    }
+    // delete these only after the decoder goes out of scope.
+    delete lm_fst;
+    delete g_fst;
+    delete hcl_fst;
+
+    kaldi::int64 input_frame_count =
+        frame_count * decodable_opts.frame_subsampling_factor;
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Time taken "<< elapsed
+              << "s: real-time factor assuming 100 frames/sec is "
+              << (elapsed * 100.0 / input_frame_count);
+    KALDI_LOG << "Done " << num_success << " utterances, failed for "
+              << num_fail;
+    KALDI_LOG << "Overall log-likelihood per frame is "
+              << (tot_like / frame_count) << " over "
+              << frame_count << " frames.";
+
+    delete word_syms;
+    if (num_success != 0) return 0;
+    else return 1;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -22,11 +22,11 @@
 #include "base/timer.h"
 #include "base/kaldi-common.h"
 #include "decoder/decoder-wrappers.h"
+#include "decoder/lattice-faster-decoder-pool.h"
 #include "fstext/fstext-lib.h"
 #include "hmm/transition-model.h"
 #include "nnet3/nnet-am-decodable-simple.h"
 #include "nnet3/nnet-utils.h"
-#include "util/kaldi-thread.h"
 #include "tree/context-dep.h"
 #include "util/common-utils.h"
 
@@ -54,7 +54,7 @@ int main(int argc, char *argv[]) {
 
     Timer timer;
     bool allow_partial = false;
-    TaskSequencerConfig sequencer_config; // has --num-threads option
+    LatticeFasterDecoderPoolConfig pool_config; // has --num-threads option
     LatticeFasterDecoderConfig config;
     NnetSimpleComputationOptions decodable_opts;
 
@@ -63,7 +63,7 @@ int main(int argc, char *argv[]) {
         online_ivector_rspecifier,
         utt2spk_rspecifier;
     int32 online_ivector_period = 0;
-    sequencer_config.Register(&po);
+    pool_config.Register(&po);
     config.Register(&po);
     decodable_opts.Register(&po);
     po.Register("word-symbol-table", &word_syms_filename,
@@ -94,7 +94,6 @@ int main(int argc, char *argv[]) {
         words_wspecifier = po.GetOptArg(5),
         alignment_wspecifier = po.GetOptArg(6);
 
-    TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(sequencer_config);
     TransitionModel trans_model;
     AmNnetSimple am_nnet;
     {
@@ -129,9 +128,12 @@ int main(int argc, char *argv[]) {
         KALDI_ERR << "Could not read symbol table from file "
                    << word_syms_filename;
 
-    double tot_like = 0.0;
-    kaldi::int64 frame_count = 0;
-    int num_success = 0, num_fail = 0;
+    int num_fail = 0;  // utterances we skipped before decoding.
+    LatticeFasterDecoderPool pool(pool_config, config, trans_model, word_syms,
+                                  decodable_opts.acoustic_scale, determinize,
+                                  allow_partial, &alignment_writer,
+                                  &words_writer, &compact_lattice_writer,
+                                  &lattice_writer);
 
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
@@ -170,28 +172,18 @@ int main(int argc, char *argv[]) {
             }
           }
 
-          LatticeFasterDecoder *decoder =
-              new LatticeFasterDecoder(*decode_fst, config);
-
           DecodableInterface *nnet_decodable = new
               DecodableAmNnetSimpleParallel(
                   decodable_opts, trans_model, am_nnet,
                   features, ivector, online_ivectors,
                   online_ivector_period);
 
-          DecodeUtteranceLatticeFasterClass *task =
-              new DecodeUtteranceLatticeFasterClass(
-                  decoder, nnet_decodable, // takes ownership of these two.
-                  trans_model, word_syms, utt, decodable_opts.acoustic_scale,
-                  determinize, allow_partial, &alignment_writer, &words_writer,
-                   &compact_lattice_writer, &lattice_writer,
-                   &tot_like, &frame_count, &num_success, &num_fail, NULL);
-
-          sequencer.Run(task); // takes ownership of "task",
-                               // and will delete it when done.
+          // The pool reuses its decoders for decode_fst across utterances.
+          pool.Decode(utt, decode_fst, false, nnet_decodable); // takes
+          // ownership of "nnet_decodable", and will delete it when done.
         }
       }
-      sequencer.Wait(); // Waits for all tasks to be done.
+      pool.Wait(); // Waits for all utterances to be done.
       delete decode_fst;
     } else { // We have different FSTs for different utterances.
       SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_in_str);
@@ -232,38 +224,31 @@ int main(int argc, char *argv[]) {
           }
         }
 
-        // the following constructor takes ownership of the FST pointer so that
-        // it is deleted when 'decoder' is deleted.
-        LatticeFasterDecoder *decoder =
-            new LatticeFasterDecoder(config, fst_reader.Value().Copy());
-
         DecodableInterface *nnet_decodable = new
             DecodableAmNnetSimpleParallel(
                 decodable_opts, trans_model, am_nnet,
                 features, ivector, online_ivectors,
                 online_ivector_period);
 
-        DecodeUtteranceLatticeFasterClass *task =
-            new DecodeUtteranceLatticeFasterClass(
-                decoder, nnet_decodable, // takes ownership of these two.
-                trans_model, word_syms, utt, decodable_opts.acoustic_scale,
-                determinize, allow_partial, &alignment_writer, &words_writer,
-                &compact_lattice_writer, &lattice_writer,
-                &tot_like, &frame_count, &num_success, &num_fail, NULL);
-
-        sequencer.Run(task); // takes ownership of "task",
-        // and will delete it when done.
+        // takes ownership of the FST and "nnet_decodable", and will delete
+        // them when done.
+        pool.Decode(utt, fst_reader.Value().Copy(), true, nnet_decodable);
       }
-      sequencer.Wait(); // Waits for all tasks to be done.
+      pool.Wait(); // Waits for all utterances to be done.
     }
 
+    double tot_like = pool.TotLike();
+    kaldi::int64 frame_count = pool.NumFrames();
+    int num_success = pool.NumDone();
+    num_fail += pool.NumErr();
+
     kaldi::int64 input_frame_count =
         frame_count * decodable_opts.frame_subsampling_factor;
 
     double elapsed = timer.Elapsed();
     KALDI_LOG << "Time taken " << elapsed
               << "s: real-time factor assuming 100 feature frames/sec is "
-              << (sequencer_config.num_threads * elapsed * 100.0 /
+              << (pool_config.num_threads * elapsed * 100.0 /
                   input_frame_count);
     KALDI_LOG << "Done " << num_success << " utterances, failed for "
               << num_fail;
@@ -53,7 +53,7 @@ int main(int argc, char *argv[]) {
     LatticeFasterDecoderConfig config;
     NnetSimpleComputationOptions decodable_opts;
 
-    std::string word_syms_filename;
+    std::string word_syms_filename, graph_lookahead_rxfilename;
     std::string ivector_rspecifier,
         online_ivector_rspecifier,
         utt2spk_rspecifier;
@@ -64,6 +64,9 @@ int main(int argc, char *argv[]) {
                 "Symbol table for words [for debug output]");
     po.Register("allow-partial", &allow_partial,
                 "If true, produce output even if end state was not reached.");
+    po.Register("graph-lookahead", &graph_lookahead_rxfilename, "Table of "
+                "best future graph costs per state, from compute-graph-lookahead, "
+                "to use in pruning (only with a single FST).");
     po.Register("ivectors", &ivector_rspecifier, "Rspecifier for "
                 "iVectors as vectors (i.e. not estimated online); per utterance "
                 "by default, or per speaker if you provide the --utt2spk option.");
@@ -141,6 +144,11 @@ int main(int argc, char *argv[]) {
 
       {
         LatticeFasterDecoder decoder(*decode_fst, config);
+        GraphLookahead graph_lookahead;
+        if (!graph_lookahead_rxfilename.empty()) {
+          ReadKaldiObject(graph_lookahead_rxfilename, &graph_lookahead);
+          decoder.SetGraphLookahead(&graph_lookahead);
+        }
 
         for (; !feature_reader.Done(); feature_reader.Next()) {
           std::string utt = feature_reader.Key();
@@ -191,6 +199,9 @@ int main(int argc, char *argv[]) {
       }
       delete decode_fst; // delete this only after decoder goes out of scope.
     } else { // We have different FSTs for different utterances.
+      if (!graph_lookahead_rxfilename.empty())
+        KALDI_WARN << "--graph-lookahead is ignored when decoding with "
+                   << "per-utterance FSTs.";
       SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_in_str);
       RandomAccessBaseFloatMatrixReader feature_reader(feature_rspecifier);
       for (; !fst_reader.Done(); fst_reader.Next()) {
@@ -261,6 +272,7 @@ int main(int argc, char *argv[]) {
     KALDI_LOG << "Overall log-likelihood per frame is "
               << (tot_like / frame_count) << " over "
               << frame_count << " frames.";
+    PrintNnetComputeProfile();
 
     delete word_syms;
     if (num_success != 0) return 0;
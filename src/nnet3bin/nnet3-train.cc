@@ -79,8 +79,7 @@ int main(int argc, char *argv[]) {
 
     SequentialNnetExampleReader example_reader(examples_rspecifier);
 
-    for (; !example_reader.Done(); example_reader.Next())
-      trainer.Train(example_reader.Value());
+    trainer.Train(&example_reader);
 
     bool ok = trainer.PrintTotalStats();
 
@@ -0,0 +1,178 @@
+// online2/online-adaptive-beam-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "online2/online-adaptive-beam.h"
+
+namespace kaldi {
+
+static OnlineAdaptiveBeamConfig RandomConfig() {
+  OnlineAdaptiveBeamConfig config;
+  config.rt_max = 0.5 + RandUniform();
+  config.rt_min = (RandInt(0, 1) == 0 ? -1.0 :
+                   config.rt_max * (0.2 + 0.6 * RandUniform()));
+  config.beam_update = 0.01 + 0.05 * RandUniform();
+  config.max_beam_update = 0.02 + 0.1 * RandUniform();
+  config.min_beam = 4.0 + 4.0 * RandUniform();
+  config.min_max_active = RandInt(100, 500);
+  return config;
+}
+
+// Decodes chunks that are over budget until the beam reaches its minimum, then
+// chunks that are well within budget until it's back to the configured beam,
+// checking the size of each step and that max-active follows the beam when
+// it's finite.
+void UnitTestOnlineAdaptiveBeamRange() {
+  OnlineAdaptiveBeamConfig config = RandomConfig();
+  BaseFloat rt_min = (config.rt_min > 0.0 ? config.rt_min :
+                      0.8 * config.rt_max);
+  BaseFloat beam = config.min_beam + 2.0 + 10.0 * RandUniform();
+  bool finite_max_active = (RandInt(0, 1) == 0);
+  int32 max_active = (finite_max_active ? RandInt(1000, 10000) :
+                      std::numeric_limits<int32>::max());
+  OnlineAdaptiveBeam adaptive_beam(config, beam, max_active);
+  KALDI_ASSERT(adaptive_beam.Beam() == beam &&
+               adaptive_beam.MaxActive() == max_active);
+
+  BaseFloat chunk_seconds = 0.2;
+  int32 num_chunks;
+  for (num_chunks = 0; adaptive_beam.Beam() > config.min_beam; num_chunks++) {
+    KALDI_ASSERT(num_chunks < 1000);
+    BaseFloat old_beam = adaptive_beam.Beam(),
+        rtf = config.rt_max * (1.01 + 5.0 * RandUniform());
+    KALDI_ASSERT(adaptive_beam.Update(20, chunk_seconds,
+                                      rtf * chunk_seconds));
+    BaseFloat new_beam = adaptive_beam.Beam();
+    KALDI_ASSERT(new_beam < old_beam && new_beam >= config.min_beam &&
+                 new_beam >= old_beam * (1.0 - config.max_beam_update) -
+                 1.0e-04);
+    if (finite_max_active) {
+      KALDI_ASSERT(adaptive_beam.MaxActive() >= config.min_max_active &&
+                   adaptive_beam.MaxActive() <= max_active);
+      // Until one of them reaches its minimum, max-active is scaled with the
+      // beam.
+      if (adaptive_beam.MaxActive() > config.min_max_active &&
+          new_beam > config.min_beam)
+        AssertEqual(adaptive_beam.MaxActive() / static_cast<BaseFloat>(max_active),
+                    new_beam / beam, 0.01);
+    } else {
+      KALDI_ASSERT(adaptive_beam.MaxActive() ==
+                   std::numeric_limits<int32>::max());
+    }
+  }
+  KALDI_ASSERT(num_chunks > 0);
+  // Once at the minimum, it stays there.
+  BaseFloat rtf = config.rt_max * 10.0;
+  adaptive_beam.Update(20, chunk_seconds, rtf * chunk_seconds);
+  KALDI_ASSERT(adaptive_beam.Beam() == config.min_beam);
+
+  // Between rt_min and rt_max nothing changes.
+  int32 old_max_active = adaptive_beam.MaxActive();
+  rtf = 0.5 * (rt_min + config.rt_max);
+  KALDI_ASSERT(!adaptive_beam.Update(20, chunk_seconds, rtf * chunk_seconds));
+  KALDI_ASSERT(adaptive_beam.Beam() == config.min_beam &&
+               adaptive_beam.MaxActive() == old_max_active);
+
+  for (num_chunks = 0; adaptive_beam.Beam() < beam; num_chunks++) {
+    KALDI_ASSERT(num_chunks < 1000);
+    BaseFloat old_beam = adaptive_beam.Beam();
+    rtf = rt_min * 0.99 * RandUniform();
+    KALDI_ASSERT(adaptive_beam.Update(20, chunk_seconds,
+                                      rtf * chunk_seconds));
+    BaseFloat new_beam = adaptive_beam.Beam();
+    KALDI_ASSERT(new_beam > old_beam && new_beam <= beam &&
+                 new_beam <= old_beam * (1.0 + config.max_beam_update) +
+                 1.0e-04);
+  }
+  KALDI_ASSERT(num_chunks > 0);
+  // Max-active may take longer to get back, if it reached its minimum before
+  // the beam did; the beam goes no further.
+  for (num_chunks = 0; adaptive_beam.Update(20, chunk_seconds, 0.0);
+       num_chunks++)
+    KALDI_ASSERT(num_chunks < 1000 && adaptive_beam.Beam() == beam);
+  KALDI_ASSERT(adaptive_beam.Beam() == beam &&
+               adaptive_beam.MaxActive() == max_active);
+}
+
+// Checks the statistics against a count of what we passed in.
+void UnitTestOnlineAdaptiveBeamStats() {
+  OnlineAdaptiveBeamConfig config = RandomConfig();
+  bool enabled = (RandInt(0, 3) != 0);
+  if (!enabled)
+    config.rt_max = 0.0;
+  BaseFloat beam = config.min_beam + 5.0;
+  OnlineAdaptiveBeam adaptive_beam(config, beam, RandInt(1000, 2000));
+
+  OnlineAdaptiveBeam::Stats stats;
+  int32 num_updates = RandInt(0, 50);
+  for (int32 i = 0; i < num_updates; i++) {
+    int32 num_frames = RandInt(-1, 30);
+    BaseFloat audio_seconds = 0.01 * std::max(num_frames, 0);
+    double elapsed_seconds = audio_seconds * 2.0 * RandUniform();
+    BaseFloat old_beam = adaptive_beam.Beam();
+    bool changed = adaptive_beam.Update(num_frames, audio_seconds,
+                                        elapsed_seconds);
+    if (num_frames <= 0) {
+      // Empty chunks are ignored.
+      KALDI_ASSERT(!changed);
+      continue;
+    }
+    double rtf = elapsed_seconds / audio_seconds;
+    stats.num_chunks++;
+    stats.num_frames += num_frames;
+    stats.audio_seconds += audio_seconds;
+    stats.decode_seconds += elapsed_seconds;
+    stats.max_chunk_rtf = std::max(stats.max_chunk_rtf, rtf);
+    stats.min_beam_used = std::min(stats.min_beam_used, old_beam);
+    if (!enabled) {
+      KALDI_ASSERT(!changed && adaptive_beam.Beam() == beam);
+      continue;
+    }
+    if (rtf > config.rt_max) {
+      stats.num_chunks_over_budget++;
+      KALDI_ASSERT(adaptive_beam.Beam() <= old_beam);
+      if (changed)
+        stats.num_decreases++;
+    } else {
+      KALDI_ASSERT(adaptive_beam.Beam() >= old_beam);
+      if (changed)
+        stats.num_increases++;
+    }
+  }
+  const OnlineAdaptiveBeam::Stats &s = adaptive_beam.GetStats();
+  KALDI_ASSERT(s.num_chunks == stats.num_chunks &&
+               s.num_frames == stats.num_frames &&
+               s.num_chunks_over_budget == stats.num_chunks_over_budget &&
+               s.num_decreases == stats.num_decreases &&
+               s.num_increases == stats.num_increases &&
+               s.min_beam_used == stats.min_beam_used);
+  AssertEqual(s.audio_seconds, stats.audio_seconds);
+  AssertEqual(s.decode_seconds, stats.decode_seconds);
+  AssertEqual(s.max_chunk_rtf, stats.max_chunk_rtf);
+  adaptive_beam.Print();
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 100; i++) {
+    UnitTestOnlineAdaptiveBeamRange();
+    UnitTestOnlineAdaptiveBeamStats();
+  }
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
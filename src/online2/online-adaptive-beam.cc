@@ -0,0 +1,114 @@
+// online2/online-adaptive-beam.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "online2/online-adaptive-beam.h"
+
+namespace kaldi {
+
+OnlineAdaptiveBeam::OnlineAdaptiveBeam(const OnlineAdaptiveBeamConfig &config,
+                                       BaseFloat beam,
+                                       int32 max_active):
+    config_(config),
+    rt_min_(config.rt_min > 0.0 ? config.rt_min : 0.8 * config.rt_max),
+    max_beam_(beam),
+    min_beam_(std::min(config.min_beam, beam)),
+    max_max_active_(max_active),
+    min_max_active_(std::min(config.min_max_active, max_active)),
+    adapt_max_active_(max_active != std::numeric_limits<int32>::max()),
+    beam_(beam),
+    max_active_(max_active) {
+  config.Check();
+  KALDI_ASSERT(beam > 0.0 && max_active > 0);
+}
+
+int32 OnlineAdaptiveBeam::MaxActive() const {
+  if (!adapt_max_active_)
+    return std::numeric_limits<int32>::max();
+  return static_cast<int32>(max_active_ + 0.5);
+}
+
+bool OnlineAdaptiveBeam::Update(int32 num_frames, BaseFloat audio_seconds,
+                                double elapsed_seconds) {
+  if (num_frames <= 0 || audio_seconds <= 0.0)
+    return false;
+  double rtf = elapsed_seconds / audio_seconds;
+  stats_.num_chunks++;
+  stats_.num_frames += num_frames;
+  stats_.audio_seconds += audio_seconds;
+  stats_.decode_seconds += elapsed_seconds;
+  stats_.max_chunk_rtf = std::max(stats_.max_chunk_rtf, rtf);
+  stats_.min_beam_used = std::min(stats_.min_beam_used, beam_);
+  if (!config_.Enabled())
+    return false;
+
+  // As in OnlineFasterDecoder::Decode(): 'factor' is the real-time factor
+  // relative to rt_max, and the further we are from the target range the
+  // bigger the change, up to max_beam_update.
+  BaseFloat factor = rtf / config_.rt_max,
+      min_factor = rt_min_ / config_.rt_max,
+      update_factor;
+  if (factor > 1.0) {
+    stats_.num_chunks_over_budget++;
+    update_factor = -std::min(config_.beam_update * factor,
+                              config_.max_beam_update);
+  } else if (factor < min_factor) {
+    update_factor = (factor > 0.0 ?
+                     std::min(config_.beam_update / factor,
+                              config_.max_beam_update) :
+                     config_.max_beam_update);
+  } else {
+    return false;
+  }
+
+  BaseFloat old_beam = beam_;
+  int32 old_max_active = MaxActive();
+  beam_ += beam_ * update_factor;
+  beam_ = std::max(min_beam_, std::min(max_beam_, beam_));
+  if (adapt_max_active_) {
+    max_active_ += max_active_ * update_factor;
+    max_active_ = std::max(min_max_active_,
+                           std::min(max_max_active_, max_active_));
+  }
+  if (beam_ == old_beam && MaxActive() == old_max_active)
+    return false;
+  // Count by the direction of the update, as max-active may still be changing
+  // after the beam has reached its limit.
+  if (update_factor < 0.0) stats_.num_decreases++;
+  else stats_.num_increases++;
+  KALDI_VLOG(3) << "Chunk real-time factor was " << rtf << ", setting beam to "
+                << beam_ << ", max-active to " << MaxActive();
+  return true;
+}
+
+void OnlineAdaptiveBeam::Print() const {
+  if (stats_.num_chunks == 0)
+    return;
+  KALDI_LOG << "Adaptive beam: decoded " << stats_.num_frames << " frames in "
+            << stats_.num_chunks << " chunks, real-time factor "
+            << (stats_.decode_seconds / stats_.audio_seconds)
+            << " (worst chunk " << stats_.max_chunk_rtf << ")";
+  if (config_.Enabled()) {
+    KALDI_LOG << "Adaptive beam: " << stats_.num_chunks_over_budget
+              << " chunks were over the real-time factor of " << config_.rt_max
+              << "; beam was reduced " << stats_.num_decreases
+              << " times and increased " << stats_.num_increases
+              << " times; smallest beam used was " << stats_.min_beam_used
+              << ", final beam " << beam_ << " (max " << max_beam_ << ")";
+  }
+}
+
+}  // namespace kaldi
@@ -0,0 +1,161 @@
+// online2/online-adaptive-beam.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_ONLINE2_ONLINE_ADAPTIVE_BEAM_H_
+#define KALDI_ONLINE2_ONLINE_ADAPTIVE_BEAM_H_
+
+#include <limits>
+
+#include "base/kaldi-common.h"
+#include "itf/options-itf.h"
+
+namespace kaldi {
+/// @addtogroup  onlinedecoding OnlineDecoding
+/// @{
+
+
+/// Options for class OnlineAdaptiveBeam.  The controller is disabled unless
+/// --adaptive-beam-rt-max is set.
+struct OnlineAdaptiveBeamConfig {
+  BaseFloat rt_max;  // the latency budget, as a real-time factor; 0 disables.
+  BaseFloat rt_min;  // below this real-time factor we widen the beam again.
+  BaseFloat beam_update;  // rate of adjustment of the beam.
+  BaseFloat max_beam_update;  // maximum rate of adjustment of the beam.
+  BaseFloat min_beam;  // the beam is never reduced below this.
+  int32 min_max_active;  // max-active is never reduced below this.
+
+  OnlineAdaptiveBeamConfig(): rt_max(0.0), rt_min(-1.0), beam_update(0.01),
+                              max_beam_update(0.05), min_beam(6.0),
+                              min_max_active(200) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("adaptive-beam-rt-max", &rt_max, "If > 0, the decoding "
+                   "beam and max-active are adjusted after each chunk so that "
+                   "the time taken to decode a chunk stays below this multiple "
+                   "of the chunk's duration.  They never exceed the values "
+                   "given by --beam and --max-active.");
+    opts->Register("adaptive-beam-rt-min", &rt_min, "Real-time factor below "
+                   "which the adaptive beam is widened again; if <= 0, 0.8 "
+                   "times --adaptive-beam-rt-max.");
+    opts->Register("adaptive-beam-update", &beam_update, "Rate of adjustment "
+                   "of the adaptive beam");
+    opts->Register("adaptive-beam-max-update", &max_beam_update, "Maximum "
+                   "proportion by which the adaptive beam changes per chunk");
+    opts->Register("adaptive-beam-min-beam", &min_beam, "Lower limit on the "
+                   "adaptive beam");
+    opts->Register("adaptive-beam-min-max-active", &min_max_active, "Lower "
+                   "limit on the adaptive max-active (only relevant if "
+                   "--max-active is set)");
+  }
+
+  bool Enabled() const { return rt_max > 0.0; }
+
+  void Check() const {
+    KALDI_ASSERT(rt_max >= 0.0 && beam_update > 0.0 &&
+                 max_beam_update > 0.0 && max_beam_update < 1.0 &&
+                 min_beam > 0.0 && min_max_active > 0);
+    if (Enabled())
+      KALDI_ASSERT(rt_min < rt_max &&
+                   "--adaptive-beam-rt-min must be less than "
+                   "--adaptive-beam-rt-max");
+  }
+};
+
+
+/**
+   class OnlineAdaptiveBeam adjusts the decoding beam and max-active of an
+   online decoder so that the decoding keeps up with a real-time-factor target,
+   in the same way as OnlineFasterDecoder (online/online-faster-decoder.h)
+   adjusts its beam, but based on the wall-clock time taken by each chunk
+   rather than an assumed frame rate.  After each chunk, Update() is called
+   with the amount of audio decoded and the time taken.  If the real-time
+   factor was above rt_max, the beam is reduced in proportion to how far over
+   budget we were (at most max_beam_update per chunk); if it was below rt_min,
+   it is increased again, up to the beam we were constructed with.  If a finite
+   max-active was given it is scaled along with the beam.
+
+   The decoders that support this (SingleUtteranceNnet3DecoderTpl,
+   SingleUtteranceNnet3IncrementalDecoderTpl and OnlineWakeWordFasterDecoder)
+   take a pointer to it via SetAdaptiveBeam(), and apply Beam() and MaxActive()
+   before each call to AdvanceDecoding().  It is normally kept across
+   utterances, so an utterance starts with the beam the previous one ended
+   with.  It is not thread-safe: use one per decoding stream.
+ */
+class OnlineAdaptiveBeam {
+ public:
+  /// 'beam' and 'max_active' are the decoder's configured values, which are
+  /// the upper limits of the adaptation.
+  OnlineAdaptiveBeam(const OnlineAdaptiveBeamConfig &config,
+                     BaseFloat beam,
+                     int32 max_active = std::numeric_limits<int32>::max());
+
+  /// Call this after decoding a chunk: 'num_frames' is the number of frames
+  /// decoded, 'audio_seconds' the duration of audio they cover, and
+  /// 'elapsed_seconds' the time taken to decode them.  Returns true if Beam()
+  /// or MaxActive() changed.
+  bool Update(int32 num_frames, BaseFloat audio_seconds,
+              double elapsed_seconds);
+
+  BaseFloat Beam() const { return beam_; }
+
+  int32 MaxActive() const;
+
+  struct Stats {
+    int64 num_chunks;
+    int64 num_frames;
+    double audio_seconds;
+    double decode_seconds;
+    int64 num_chunks_over_budget;  // chunks with real-time factor > rt_max.
+    int64 num_decreases;
+    int64 num_increases;
+    BaseFloat min_beam_used;
+    double max_chunk_rtf;  // worst real-time factor of any chunk.
+    Stats(): num_chunks(0), num_frames(0), audio_seconds(0.0),
+             decode_seconds(0.0), num_chunks_over_budget(0),
+             num_decreases(0), num_increases(0),
+             min_beam_used(std::numeric_limits<BaseFloat>::infinity()),
+             max_chunk_rtf(0.0) { }
+  };
+
+  const Stats &GetStats() const { return stats_; }
+
+  /// Prints the stats to the log.
+  void Print() const;
+
+ private:
+  OnlineAdaptiveBeamConfig config_;
+  BaseFloat rt_min_;  // config_.rt_min with the default applied.
+  BaseFloat max_beam_;
+  BaseFloat min_beam_;
+  // We keep max-active as a float so that small relative changes aren't lost
+  // to rounding.
+  BaseFloat max_max_active_;
+  BaseFloat min_max_active_;
+  bool adapt_max_active_;
+
+  BaseFloat beam_;
+  BaseFloat max_active_;
+
+  Stats stats_;
+};
+
+
+/// @} End of "addtogroup onlinedecoding"
+}  // namespace kaldi
+
+#endif  // KALDI_ONLINE2_ONLINE_ADAPTIVE_BEAM_H_
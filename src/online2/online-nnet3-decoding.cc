@@ -22,6 +22,7 @@
 #include "lat/lattice-functions.h"
 #include "lat/determinize-lattice-pruned.h"
 #include "decoder/grammar-fst.h"
+#include "base/timer.h"
 
 namespace kaldi {
 
@@ -37,7 +38,26 @@ SingleUtteranceNnet3DecoderTpl<FST>::SingleUtteranceNnet3DecoderTpl(
     trans_model_(trans_model),
     decodable_(trans_model_, info,
                features->InputFeature(), features->IvectorFeature()),
-    decoder_(fst, decoder_opts_) {
+    decoder_(fst, decoder_opts_),
+    adaptive_beam_(NULL) {
+  decoder_.InitDecoding();
+}
+
+template <typename FST>
+SingleUtteranceNnet3DecoderTpl<FST>::SingleUtteranceNnet3DecoderTpl(
+    const LatticeFasterDecoderConfig &decoder_opts,
+    const TransitionModel &trans_model,
+    const nnet3::DecodableNnetSimpleLoopedInfo &info,
+    std::shared_ptr<const FST> fst,
+    OnlineNnet2FeaturePipeline *features):
+    decoder_opts_(decoder_opts),
+    input_feature_frame_shift_in_seconds_(features->FrameShiftInSeconds()),
+    trans_model_(trans_model),
+    fst_(fst),
+    decodable_(trans_model_, info,
+               features->InputFeature(), features->IvectorFeature()),
+    decoder_(*fst_, decoder_opts_),
+    adaptive_beam_(NULL) {
   decoder_.InitDecoding();
 }
 
@@ -49,7 +69,28 @@ void SingleUtteranceNnet3DecoderTpl<FST>::InitDecoding(int32 frame_offset) {
 
 template <typename FST>
 void SingleUtteranceNnet3DecoderTpl<FST>::AdvanceDecoding() {
+  if (adaptive_beam_ == NULL) {
+    decoder_.AdvanceDecoding(&decodable_);
+    return;
+  }
+  if (decoder_.GetOptions().beam != adaptive_beam_->Beam() ||
+      decoder_.GetOptions().max_active != adaptive_beam_->MaxActive()) {
+    LatticeFasterDecoderConfig config(decoder_.GetOptions());
+    config.beam = adaptive_beam_->Beam();
+    config.max_active = adaptive_beam_->MaxActive();
+    decoder_.SetOptions(config);
+  }
+  int32 num_frames_decoded = decoder_.NumFramesDecoded();
+  Timer timer;
   decoder_.AdvanceDecoding(&decodable_);
+  // The time includes the neural-net computation, which happens on demand
+  // inside AdvanceDecoding(); that is what determines the latency.
+  int32 num_frames = decoder_.NumFramesDecoded() - num_frames_decoded;
+  BaseFloat output_frame_shift =
+      input_feature_frame_shift_in_seconds_ *
+      decodable_.FrameSubsamplingFactor();
+  adaptive_beam_->Update(num_frames, num_frames * output_frame_shift,
+                         timer.Elapsed());
 }
 
 template <typename FST>
@@ -25,6 +25,7 @@
 #include <string>
 #include <vector>
 #include <deque>
+#include <memory>
 
 #include "nnet3/decodable-online-looped.h"
 #include "matrix/matrix-lib.h"
@@ -32,6 +33,7 @@
 #include "base/kaldi-error.h"
 #include "itf/online-feature-itf.h"
 #include "online2/online-endpoint.h"
+#include "online2/online-adaptive-beam.h"
 #include "online2/online-nnet2-feature-pipeline.h"
 #include "decoder/lattice-faster-online-decoder.h"
 #include "hmm/transition-model.h"
@@ -60,6 +62,17 @@ class SingleUtteranceNnet3DecoderTpl {
                                  const FST &fst,
                                  OnlineNnet2FeaturePipeline *features);
 
+  // This constructor is as the one above, except that this object keeps a
+  // reference to 'fst' until it is destroyed.  This is for graphs that may be
+  // replaced while decoding is going on, e.g. the snapshots returned by
+  // fst::LiveGrammarFstTpl::Snapshot(): the decoder keeps decoding with the
+  // version it started with.
+  SingleUtteranceNnet3DecoderTpl(const LatticeFasterDecoderConfig &decoder_opts,
+                                 const TransitionModel &trans_model,
+                                 const nnet3::DecodableNnetSimpleLoopedInfo &info,
+                                 std::shared_ptr<const FST> fst,
+                                 OnlineNnet2FeaturePipeline *features);
+
   /// Initializes the decoding and sets the frame offset of the underlying
   /// decodable object. This method is called by the constructor. You can also
   /// call this method when you want to reset the decoder state, but want to
@@ -69,6 +82,14 @@ class SingleUtteranceNnet3DecoderTpl {
   /// Advances the decoding as far as we can.
   void AdvanceDecoding();
 
+  /// Makes AdvanceDecoding() apply adaptive_beam->Beam() and MaxActive() to
+  /// the decoder before decoding, and report the frames decoded and the time
+  /// taken to adaptive_beam afterwards; see class OnlineAdaptiveBeam.  The
+  /// pointer is not owned, and may be NULL to turn this off.
+  void SetAdaptiveBeam(OnlineAdaptiveBeam *adaptive_beam) {
+    adaptive_beam_ = adaptive_beam;
+  }
+
   /// Finalizes the decoding. Cleans up and prunes remaining tokens, so the
   /// GetLattice() call will return faster.  You must not call this before
   /// calling (TerminateDecoding() or InputIsFinished()) and then Wait().
@@ -111,10 +132,16 @@ class SingleUtteranceNnet3DecoderTpl {
   // it's needed by the endpointing code.
   const TransitionModel &trans_model_;
 
+  // Only set if the constructor taking a shared_ptr was used; keeps the
+  // graph alive for as long as decoder_ uses it.
+  std::shared_ptr<const FST> fst_;
+
   nnet3::DecodableAmNnetLoopedOnline decodable_;
 
   LatticeFasterOnlineDecoderTpl<FST> decoder_;
 
+  OnlineAdaptiveBeam *adaptive_beam_;  // not owned; may be NULL.
+
 };
 
 
@@ -21,6 +21,7 @@
 #include "lat/lattice-functions.h"
 #include "lat/determinize-lattice-pruned.h"
 #include "decoder/grammar-fst.h"
+#include "base/timer.h"
 
 namespace kaldi {
 
@@ -36,7 +37,8 @@ SingleUtteranceNnet3IncrementalDecoderTpl<FST>::SingleUtteranceNnet3IncrementalD
     trans_model_(trans_model),
     decodable_(trans_model_, info,
                features->InputFeature(), features->IvectorFeature()),
-    decoder_(fst, trans_model, decoder_opts_) {
+    decoder_(fst, trans_model, decoder_opts_),
+    adaptive_beam_(NULL) {
   decoder_.InitDecoding();
 }
 
@@ -48,7 +50,28 @@ void SingleUtteranceNnet3IncrementalDecoderTpl<FST>::InitDecoding(int32 frame_of
 
 template <typename FST>
 void SingleUtteranceNnet3IncrementalDecoderTpl<FST>::AdvanceDecoding() {
+  if (adaptive_beam_ == NULL) {
+    decoder_.AdvanceDecoding(&decodable_);
+    return;
+  }
+  if (decoder_.GetOptions().beam != adaptive_beam_->Beam() ||
+      decoder_.GetOptions().max_active != adaptive_beam_->MaxActive()) {
+    LatticeIncrementalDecoderConfig config(decoder_.GetOptions());
+    config.beam = adaptive_beam_->Beam();
+    config.max_active = adaptive_beam_->MaxActive();
+    decoder_.SetOptions(config);
+  }
+  int32 num_frames_decoded = decoder_.NumFramesDecoded();
+  Timer timer;
   decoder_.AdvanceDecoding(&decodable_);
+  // The time includes the neural-net computation, which happens on demand
+  // inside AdvanceDecoding(); that is what determines the latency.
+  int32 num_frames = decoder_.NumFramesDecoded() - num_frames_decoded;
+  BaseFloat output_frame_shift =
+      input_feature_frame_shift_in_seconds_ *
+      decodable_.FrameSubsamplingFactor();
+  adaptive_beam_->Update(num_frames, num_frames * output_frame_shift,
+                         timer.Elapsed());
 }
 
 template <typename FST>
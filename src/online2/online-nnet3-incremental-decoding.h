@@ -31,6 +31,7 @@
 #include "base/kaldi-error.h"
 #include "itf/online-feature-itf.h"
 #include "online2/online-endpoint.h"
+#include "online2/online-adaptive-beam.h"
 #include "online2/online-nnet2-feature-pipeline.h"
 #include "decoder/lattice-incremental-online-decoder.h"
 #include "hmm/transition-model.h"
@@ -68,6 +69,14 @@ class SingleUtteranceNnet3IncrementalDecoderTpl {
   /// Advances the decoding as far as we can.
   void AdvanceDecoding();
 
+  /// Makes AdvanceDecoding() apply adaptive_beam->Beam() and MaxActive() to
+  /// the decoder before decoding, and report the frames decoded and the time
+  /// taken to adaptive_beam afterwards; see class OnlineAdaptiveBeam.  The
+  /// pointer is not owned, and may be NULL to turn this off.
+  void SetAdaptiveBeam(OnlineAdaptiveBeam *adaptive_beam) {
+    adaptive_beam_ = adaptive_beam;
+  }
+
   /// Finalizes the decoding. Cleans up and prunes remaining tokens, so the
   /// GetLattice() call will return faster.  You must not call this before
   /// calling (TerminateDecoding() or InputIsFinished()) and then Wait().
@@ -134,6 +143,8 @@ class SingleUtteranceNnet3IncrementalDecoderTpl {
 
   LatticeIncrementalOnlineDecoderTpl<FST> decoder_;
 
+  OnlineAdaptiveBeam *adaptive_beam_;  // not owned; may be NULL.
+
 };
 
 
@@ -39,6 +39,24 @@ void OnlineWakeWordFasterDecoder::InitDecoding() {
 }
 
 
+void OnlineWakeWordFasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
+                                                  int32 max_num_frames) {
+  if (adaptive_beam_ == NULL) {
+    FasterDecoder::AdvanceDecoding(decodable, max_num_frames);
+    return;
+  }
+  // As in OnlineFasterDecoder, we change the beam in config_ directly.
+  config_.beam = adaptive_beam_->Beam();
+  config_.max_active = adaptive_beam_->MaxActive();
+  int32 num_frames_decoded = NumFramesDecoded();
+  Timer timer;
+  FasterDecoder::AdvanceDecoding(decodable, max_num_frames);
+  int32 num_frames = NumFramesDecoded() - num_frames_decoded;
+  adaptive_beam_->Update(num_frames, num_frames * frame_shift_,
+                         timer.Elapsed());
+}
+
+
 void OnlineWakeWordFasterDecoder::MakeLattice(const Token *start,
     const Token *end, fst::MutableFst<LatticeArc> *out_fst) const {
   out_fst->DeleteStates();
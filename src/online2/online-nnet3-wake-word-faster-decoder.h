@@ -26,6 +26,7 @@
 #include "decoder/faster-decoder.h"
 #include "itf/online-feature-itf.h"
 #include "online2/online-nnet2-feature-pipeline.h"
+#include "online2/online-adaptive-beam.h"
 #include "hmm/transition-model.h"
 
 namespace kaldi {
@@ -46,7 +47,8 @@ struct OnlineWakeWordFasterDecoderOpts : public FasterDecoderOptions {
     detection. It uses `immortal tokens` from OnlineFasterDecoder for patial
     tracing back to obtain partial hypotheses while decoding a recording.
     Different from OnlineFasterDecoder, tt doesn't have end-point detection,
-    and doesn't use run-time factor to adjust the beam.
+    and only adjusts the beam according to the run-time factor if you call
+    SetAdaptiveBeam() (see class OnlineAdaptiveBeam).
 */
 
 class OnlineWakeWordFasterDecoder : public FasterDecoder {
@@ -54,7 +56,8 @@ class OnlineWakeWordFasterDecoder : public FasterDecoder {
   OnlineWakeWordFasterDecoder(const fst::Fst<fst::StdArc> &fst,
                               const OnlineWakeWordFasterDecoderOpts &opts,
                               const TransitionModel &trans_model)
-      : FasterDecoder(fst, opts), opts_(opts), trans_model_(trans_model) {}
+      : FasterDecoder(fst, opts), opts_(opts), trans_model_(trans_model),
+        adaptive_beam_(NULL), frame_shift_(0.0) {}
 
   // Makes a linear graph, by tracing back from the last "immortal" token
   // to the previous one
@@ -69,7 +72,23 @@ class OnlineWakeWordFasterDecoder : public FasterDecoder {
   // and then (possibly multiple times) AdvanceDecoding().
   void InitDecoding();
 
-  
+  /// This is as FasterDecoder::AdvanceDecoding(), except that if
+  /// SetAdaptiveBeam() has been called it first applies the adaptive beam and
+  /// max-active, and afterwards reports the time taken.
+  void AdvanceDecoding(DecodableInterface *decodable,
+                       int32 max_num_frames = -1);
+
+  /// Makes AdvanceDecoding() adjust the beam and max-active using
+  /// 'adaptive_beam', which is not owned and may be NULL to turn this off.
+  /// 'frame_shift_in_seconds' is the frame shift of the decodable object
+  /// (i.e. including any frame subsampling), needed to work out the
+  /// real-time factor.
+  void SetAdaptiveBeam(OnlineAdaptiveBeam *adaptive_beam,
+                       BaseFloat frame_shift_in_seconds) {
+    adaptive_beam_ = adaptive_beam;
+    frame_shift_ = frame_shift_in_seconds;
+  }
+
  private:
   // Returns a linear fst by tracing back the last N frames, beginning
   // from the best current token
@@ -87,6 +106,8 @@ class OnlineWakeWordFasterDecoder : public FasterDecoder {
   const TransitionModel &trans_model_; // needed for trans-id -> phone conversion
   Token *immortal_tok_;      // "immortal" token means it's an ancestor of ...
   Token *prev_immortal_tok_; // ... all currently active tokens
+  OnlineAdaptiveBeam *adaptive_beam_;  // not owned; may be NULL.
+  BaseFloat frame_shift_;  // frame shift of the decodable, in seconds.
   KALDI_DISALLOW_COPY_AND_ASSIGN(OnlineWakeWordFasterDecoder);
 };
 
@@ -104,6 +104,7 @@ int main(int argc, char *argv[]) {
     nnet3::NnetSimpleLoopedComputationOptions decodable_opts;
     LatticeFasterDecoderConfig decoder_opts;
     OnlineEndpointConfig endpoint_opts;
+    OnlineAdaptiveBeamConfig adaptive_beam_opts;
 
     BaseFloat chunk_length_secs = 0.18;
     bool do_endpointing = false;
@@ -132,6 +133,7 @@ int main(int argc, char *argv[]) {
     decodable_opts.Register(&po);
     decoder_opts.Register(&po);
     endpoint_opts.Register(&po);
+    adaptive_beam_opts.Register(&po);
 
 
     po.Read(argc, argv);
@@ -195,6 +197,10 @@ int main(int argc, char *argv[]) {
     CompactLatticeWriter clat_writer(clat_wspecifier);
 
     OnlineTimingStats timing_stats;
+    // The utterances are decoded one after another, so one controller
+    // serves for all of them.
+    OnlineAdaptiveBeam adaptive_beam(adaptive_beam_opts, decoder_opts.beam,
+                                     decoder_opts.max_active);
 
     for (; !spk2utt_reader.Done(); spk2utt_reader.Next()) {
       std::string spk = spk2utt_reader.Key();
@@ -228,6 +234,8 @@ int main(int argc, char *argv[]) {
         SingleUtteranceNnet3Decoder decoder(decoder_opts, trans_model,
                                             decodable_info,
                                             *decode_fst, &feature_pipeline);
+        if (adaptive_beam_opts.Enabled())
+          decoder.SetAdaptiveBeam(&adaptive_beam);
         OnlineTimer decoding_timer(utt);
 
         BaseFloat samp_freq = wave_data.SampFreq();
@@ -298,6 +306,7 @@ int main(int argc, char *argv[]) {
       }
     }
     timing_stats.Print(online);
+    adaptive_beam.Print();
 
     KALDI_LOG << "Decoded " << num_done << " utterances, "
               << num_err << " with errors.";
@@ -65,6 +65,7 @@ int main(int argc, char *argv[]) {
     nnet3::NnetSimpleLoopedComputationOptions decodable_opts;
     OnlineWakeWordFasterDecoderOpts decoder_opts;
     OnlineEndpointConfig endpoint_opts;
+    OnlineAdaptiveBeamConfig adaptive_beam_opts;
 
     BaseFloat chunk_length_secs = 1.0;
     bool online = true;
@@ -90,6 +91,7 @@ int main(int argc, char *argv[]) {
     decodable_opts.Register(&po);
     decoder_opts.Register(&po, true);
     endpoint_opts.Register(&po);
+    adaptive_beam_opts.Register(&po);
 
 
     po.Read(argc, argv);
@@ -145,6 +147,10 @@ int main(int argc, char *argv[]) {
     RandomAccessTableReader<WaveHolder> wav_reader(wav_rspecifier);
 
     OnlineTimingStats timing_stats;
+    // The utterances are decoded one after another, so one controller
+    // serves for all of them.
+    OnlineAdaptiveBeam adaptive_beam(adaptive_beam_opts, decoder_opts.beam,
+                                     decoder_opts.max_active);
 
     Int32VectorWriter words_writer(words_wspecifier);
     Int32VectorWriter alignment_writer(alignment_wspecifier);
@@ -185,6 +191,11 @@ int main(int argc, char *argv[]) {
 
         OnlineWakeWordFasterDecoder decoder(*decode_fst, decoder_opts,
                                             trans_model);
+        if (adaptive_beam_opts.Enabled())
+          decoder.SetAdaptiveBeam(
+              &adaptive_beam,
+              feature_pipeline.FrameShiftInSeconds() *
+              decodable.FrameSubsamplingFactor());
         OnlineTimer decoding_timer(utt);
 
         BaseFloat samp_freq = wave_data.SampFreq();
@@ -273,6 +284,7 @@ int main(int argc, char *argv[]) {
       }
     }
     timing_stats.Print(online);
+    adaptive_beam.Print();
 
     KALDI_LOG << "Decoded " << num_done << " utterances, "
               << num_err << " with errors.";
@@ -51,6 +51,7 @@ struct RnnlmEmbeddingTrainerOptions {
                             // write the embedding matrix).
   BaseFloat backstitch_training_scale;
   int32 backstitch_training_interval;
+  bool sparse_feature_update;
 
   // Natural-gradient related options
   bool use_natural_gradient;
@@ -67,6 +68,7 @@ struct RnnlmEmbeddingTrainerOptions {
       learning_rate(0.01),
       backstitch_training_scale(0.0),
       backstitch_training_interval(1),
+      sparse_feature_update(false),
       use_natural_gradient(true),
       natural_gradient_alpha(4.0),
       natural_gradient_rank(80),
@@ -98,6 +100,15 @@ struct RnnlmEmbeddingTrainerOptions {
                    &backstitch_training_interval,
                    "do backstitch training with the specified interval of "
                    "minibatches. It is referred to as 'n' in our publications.");
+    opts->Register("sparse-feature-update", &sparse_feature_update,
+                   "If true, and we are using a sparse feature representation "
+                   "of words and the egs were sampled, only compute the "
+                   "derivative for, and update, the rows of the feature-"
+                   "embedding matrix for features of the words in the "
+                   "minibatch (as is always done for the word-embedding "
+                   "matrix when there are no features).  Much faster for "
+                   "large feature sets, but note: l2 regularization and "
+                   "the natural gradient then only see those rows.");
     opts->Register("use-natural-gradient", &use_natural_gradient,
                    "True if you want to use natural gradient to update the "
                    "embedding matrix");
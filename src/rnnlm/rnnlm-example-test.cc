@@ -73,6 +73,99 @@ void TestRnnlmTraining(const std::string &archive_rxfilename,
   delete rnnlm;
 }
 
+// Makes a random minibatch with sampling, with one sample group per
+// time step.
+static void GetSampledTestExample(int32 vocab_size, RnnlmExample *minibatch) {
+  minibatch->vocab_size = vocab_size;
+  minibatch->num_chunks = RandInt(1, 4);
+  minibatch->chunk_length = RandInt(1, 5);
+  minibatch->sample_group_size = 1;
+  minibatch->num_samples = RandInt(2, std::min(vocab_size, 10));
+  int32 num_words = minibatch->num_chunks * minibatch->chunk_length,
+      num_samples = minibatch->num_samples;
+  minibatch->input_words.resize(num_words);
+  minibatch->output_words.resize(num_words);
+  Vector<BaseFloat> output_weights(num_words);
+  for (int32 i = 0; i < num_words; i++) {
+    minibatch->input_words[i] = RandInt(0, vocab_size - 1);
+    minibatch->output_words[i] = RandInt(0, num_samples - 1);
+    output_weights(i) = 0.5 * RandInt(0, 2);
+  }
+  minibatch->output_weights.Resize(num_words);
+  minibatch->output_weights.CopyFromVec(output_weights);
+
+  minibatch->sampled_words.clear();
+  Vector<BaseFloat> sample_inv_probs(minibatch->chunk_length * num_samples);
+  for (int32 t = 0; t < minibatch->chunk_length; t++) {
+    std::set<int32> words;
+    while (static_cast<int32>(words.size()) < num_samples)
+      words.insert(RandInt(0, vocab_size - 1));
+    minibatch->sampled_words.insert(minibatch->sampled_words.end(),
+                                    words.begin(), words.end());
+    for (int32 i = 0; i < num_samples; i++)
+      sample_inv_probs(t * num_samples + i) = 1.0 + 2.0 * RandUniform();
+  }
+  minibatch->sample_inv_probs.Resize(sample_inv_probs.Dim());
+  minibatch->sample_inv_probs.CopyFromVec(sample_inv_probs);
+}
+
+// Checks that with a sparse word-feature matrix, no l2 regularization and no
+// natural gradient, one minibatch changes the feature-embedding matrix in the
+// same way with --sparse-feature-update=true as with the dense update.
+void TestRnnlmSparseFeatureUpdate(int32 vocab_size) {
+  int32 embedding_dim = RandInt(10, 30),
+      feature_dim = RandInt(vocab_size, 2 * vocab_size);
+  // Each word has 1 to 3 features, so the minibatch won't use all of them.
+  std::vector<std::vector<std::pair<MatrixIndexT, BaseFloat> > > pairs(
+      vocab_size);
+  for (int32 w = 0; w < vocab_size; w++) {
+    std::set<int32> features;
+    int32 num_features = RandInt(1, 3);
+    while (static_cast<int32>(features.size()) < num_features)
+      features.insert(RandInt(0, feature_dim - 1));
+    for (std::set<int32>::iterator iter = features.begin();
+         iter != features.end(); ++iter)
+      pairs[w].push_back(std::pair<MatrixIndexT, BaseFloat>(
+          *iter, 0.5 + RandUniform()));
+  }
+  CuSparseMatrix<BaseFloat> word_feature_mat(
+      SparseMatrix<BaseFloat>(feature_dim, pairs));
+
+  RnnlmExample minibatch;
+  GetSampledTestExample(vocab_size, &minibatch);
+  nnet3::Nnet *rnnlm = GetTestingNnet(embedding_dim);
+  CuMatrix<BaseFloat> embedding_mat(feature_dim, embedding_dim);
+  embedding_mat.SetRandn();
+
+  RnnlmCoreTrainerOptions core_config;
+  RnnlmEmbeddingTrainerOptions embedding_config;
+  embedding_config.l2_regularize = 0.0;
+  embedding_config.use_natural_gradient = false;
+  RnnlmObjectiveOptions objective_config;
+
+  CuMatrix<BaseFloat> embedding_change[2];
+  for (int32 sparse = 0; sparse < 2; sparse++) {
+    embedding_config.sparse_feature_update = (sparse == 1);
+    nnet3::Nnet nnet(*rnnlm);
+    CuMatrix<BaseFloat> this_embedding_mat(embedding_mat);
+    RnnlmExample this_minibatch(minibatch);
+    {
+      bool train_embedding = true;
+      RnnlmTrainer trainer(train_embedding, core_config, embedding_config,
+                           objective_config, &word_feature_mat,
+                           &this_embedding_mat, &nnet);
+      trainer.Train(&this_minibatch);
+    }
+    embedding_change[sparse] = this_embedding_mat;
+    embedding_change[sparse].AddMat(-1.0, embedding_mat);
+  }
+  KALDI_LOG << "Embedding change is " << embedding_change[1].FrobeniusNorm()
+            << " with sparse update, " << embedding_change[0].FrobeniusNorm()
+            << " with dense update.";
+  KALDI_ASSERT(embedding_change[1].ApproxEqual(embedding_change[0], 0.001));
+  delete rnnlm;
+}
+
 void TestRnnlmOutput(const std::string &archive_rxfilename) {
   SequentialRnnlmExampleReader reader(archive_rxfilename);
   int32 num_test = 10;
@@ -267,6 +360,7 @@ void TestRnnlmExample() {
 
   TestRnnlmOutput("ark:tmp.ark");
   TestRnnlmTraining("ark:tmp.ark", egs_config.vocab_size);
+  TestRnnlmSparseFeatureUpdate(egs_config.vocab_size);
 
 }
 
@@ -136,7 +136,8 @@ RnnlmExampleSampler::RnnlmExampleSampler(
 }
 
 
-void RnnlmExampleSampler::SampleForMinibatch(RnnlmExample *minibatch) const {
+void RnnlmExampleSampler::SampleForMinibatch(RnnlmExample *minibatch,
+                                             struct RandomState *state) const {
   if (sampler_ == NULL) return;  // we're not actually sampling.
   KALDI_ASSERT(minibatch->chunk_length == config_.chunk_length &&
                minibatch->num_chunks == config_.num_chunks_per_minibatch &&
@@ -153,13 +154,14 @@ void RnnlmExampleSampler::SampleForMinibatch(RnnlmExample *minibatch) const {
   minibatch->sample_inv_probs.Resize(num_groups * num_samples);
 
   for (int32 g = 0; g < num_groups; g++) {
-    SampleForGroup(g, minibatch);
+    SampleForGroup(g, minibatch, state);
   }
 }
 
 
 void RnnlmExampleSampler::SampleForGroup(int32 g,
-                                         RnnlmExample *minibatch) const {
+                                         RnnlmExample *minibatch,
+                                         struct RandomState *state) const {
   // All words that appear on the output are required to appear in the sample.  we
   // need to figure what this set of words is.
   int32 num_chunks_per_minibatch = config_.num_chunks_per_minibatch;
@@ -198,7 +200,7 @@ void RnnlmExampleSampler::SampleForGroup(int32 g,
   int32 num_samples = config_.num_samples;
   sampler_->SampleWords(num_samples, unigram_weight,
                         higher_order_probs, words_we_must_sample,
-                        &sample);
+                        &sample, state);
   KALDI_ASSERT(sample.size() == static_cast<size_t>(num_samples));
   std::sort(sample.begin(), sample.end());
   // write to the 'sampled_words' and 'sample_inv_probs' arrays.
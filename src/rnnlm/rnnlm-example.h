@@ -312,7 +312,12 @@ class RnnlmExampleSampler {
   // Does the sampling for 'minibatch'.  'minibatch' is expected to already
   // have all fields populated except for 'sampled_words' and 'sample_probs'.
   // This function does the sampling and sets those fields.
-  void SampleForMinibatch(RnnlmExample *minibatch) const;
+  // This function may be called from multiple threads at once; if 'state' is
+  // non-NULL it is used as the random number generator state, and if each
+  // thread supplies its own one, the threads don't contend for the lock
+  // inside Rand().
+  void SampleForMinibatch(RnnlmExample *minibatch,
+                          struct RandomState *state = NULL) const;
 
   ~RnnlmExampleSampler() { delete sampler_; }
 
@@ -324,7 +329,8 @@ class RnnlmExampleSampler {
   // same as the position 0 <= t < chunk_length in the sequence if
   // config_.sample_group_size == 1, and otherwise, each group
   // encompasses several successive 't' values.
-  void SampleForGroup(int32 g, RnnlmExample *minibatch) const;
+  void SampleForGroup(int32 g, RnnlmExample *minibatch,
+                      struct RandomState *state) const;
 
 
   // This function gets the combination of histories to be sampled from for the g'th
@@ -564,7 +570,7 @@ class RnnlmExampleCreator {
         sampler_(sampler), key_(key), writer_(writer), minibatch_(minibatch) { }
 
     void operator () () {
-      sampler_.SampleForMinibatch(minibatch_);
+      sampler_.SampleForMinibatch(minibatch_, &random_state_);
     }
     ~SamplerTask() {
       writer_->Write(key_, *minibatch_);
@@ -575,6 +581,10 @@ class RnnlmExampleCreator {
     std::string key_;
     TableWriter<KaldiObjectHolder<RnnlmExample> > *writer_;
     RnnlmExample *minibatch_; // owned here.
+    // Each task has its own random number generator state, seeded (from
+    // Rand()) when the task is created in the main thread, so the sampling
+    // threads never have to lock.
+    RandomState random_state_;
   };
 
 
@@ -75,6 +75,43 @@ RnnlmTrainer::RnnlmTrainer(bool train_embedding,
 }
 
 
+// This is used when embedding_config_.sparse_feature_update is true.  Given
+// 'word_features' (the rows of the word-feature matrix for the active words),
+// it outputs to 'active_features' the sorted list of features that appear in
+// it, and to 'features_trans' the transpose of 'word_features' restricted to
+// the rows for those features, i.e. of dimension active_features->size() by
+// word_features.NumRows().
+static void GetActiveFeatures(const CuSparseMatrix<BaseFloat> &word_features,
+                              std::vector<int32> *active_features,
+                              CuSparseMatrix<BaseFloat> *features_trans) {
+  SparseMatrix<BaseFloat> cpu_word_features;
+  word_features.CopyToSmat(&cpu_word_features);
+  int32 num_words = cpu_word_features.NumRows();
+  active_features->clear();
+  for (int32 w = 0; w < num_words; w++) {
+    const SparseVector<BaseFloat> &row = cpu_word_features.Row(w);
+    for (int32 i = 0; i < row.NumElements(); i++)
+      active_features->push_back(row.GetElement(i).first);
+  }
+  SortAndUniq(active_features);
+
+  std::vector<std::vector<std::pair<MatrixIndexT, BaseFloat> > > pairs(
+      active_features->size());
+  for (int32 w = 0; w < num_words; w++) {
+    const SparseVector<BaseFloat> &row = cpu_word_features.Row(w);
+    for (int32 i = 0; i < row.NumElements(); i++) {
+      const std::pair<MatrixIndexT, BaseFloat> &elem = row.GetElement(i);
+      size_t f = std::lower_bound(active_features->begin(),
+                                  active_features->end(), elem.first) -
+          active_features->begin();
+      pairs[f].push_back(std::pair<MatrixIndexT, BaseFloat>(w, elem.second));
+    }
+  }
+  SparseMatrix<BaseFloat> cpu_features_trans(num_words, pairs);
+  CuSparseMatrix<BaseFloat> cu_features_trans(cpu_features_trans);
+  features_trans->Swap(&cu_features_trans);
+}
+
 void RnnlmTrainer::Train(RnnlmExample *minibatch) {
   // check the minibatch for sanity.
   if (minibatch->vocab_size != VocabSize())
@@ -88,6 +125,7 @@ void RnnlmTrainer::Train(RnnlmExample *minibatch) {
   CuArray<int32> active_words_cuda;
   CuSparseMatrix<BaseFloat> active_word_features;
   CuSparseMatrix<BaseFloat> active_word_features_trans;
+  CuArray<int32> active_features_cuda;
 
   if (!current_minibatch_.sampled_words.empty()) {
     std::vector<int32> active_words;
@@ -97,8 +135,15 @@ void RnnlmTrainer::Train(RnnlmExample *minibatch) {
     if (word_feature_mat_ != NULL) {
       active_word_features.SelectRows(active_words_cuda,
                                       *word_feature_mat_);
-      active_word_features_trans.CopyFromSmat(active_word_features,
-                                              kTrans);
+      if (train_embedding_ && embedding_config_.sparse_feature_update) {
+        std::vector<int32> active_features;
+        GetActiveFeatures(active_word_features, &active_features,
+                          &active_word_features_trans);
+        active_features_cuda.CopyFromVec(active_features);
+      } else {
+        active_word_features_trans.CopyFromSmat(active_word_features,
+                                                kTrans);
+      }
     }
   }
   GetRnnlmExampleDerived(current_minibatch_, train_embedding_,
@@ -108,6 +153,7 @@ void RnnlmTrainer::Train(RnnlmExample *minibatch) {
   active_words_.Swap(&active_words_cuda);
   active_word_features_.Swap(&active_word_features);
   active_word_features_trans_.Swap(&active_word_features_trans);
+  active_features_.Swap(&active_features_cuda);
 
   TrainInternal();
 
@@ -171,6 +217,22 @@ void RnnlmTrainer::TrainWordEmbedding(
     // There is a sparse word-feature matrix, so we need to multiply by it
     // to get the derivative w.r.t. the feature-embedding matrix.
 
+    if (sampling && embedding_config_.sparse_feature_update) {
+      // Only the rows of the feature-embedding matrix for the features in
+      // active_features_ have a nonzero derivative, so we only compute and
+      // update those.
+      if (active_features_.Dim() == 0)
+        return;
+      CuMatrix<BaseFloat> active_feature_embedding_deriv(
+          active_features_.Dim(), embedding_mat_->NumCols());
+      active_feature_embedding_deriv.AddSmatMat(
+          1.0, active_word_features_trans_, kNoTrans,
+          *word_embedding_deriv, 0.0);
+      embedding_trainer_->Train(active_features_,
+                                &active_feature_embedding_deriv);
+      return;
+    }
+
     if (!sampling && word_feature_mat_transpose_.NumRows() == 0)
       word_feature_mat_transpose_.CopyFromSmat(*word_feature_mat_, kTrans);
 
@@ -210,6 +272,21 @@ void RnnlmTrainer::TrainBackstitchWordEmbedding(
     // There is a sparse word-feature matrix, so we need to multiply by it
     // to get the derivative w.r.t. the feature-embedding matrix.
 
+    if (sampling && embedding_config_.sparse_feature_update) {
+      // See TrainWordEmbedding().
+      if (active_features_.Dim() == 0)
+        return;
+      CuMatrix<BaseFloat> active_feature_embedding_deriv(
+          active_features_.Dim(), embedding_mat_->NumCols());
+      active_feature_embedding_deriv.AddSmatMat(
+          1.0, active_word_features_trans_, kNoTrans,
+          *word_embedding_deriv, 0.0);
+      embedding_trainer_->TrainBackstitch(is_backstitch_step1,
+                                          active_features_,
+                                          &active_feature_embedding_deriv);
+      return;
+    }
+
     if (!sampling && word_feature_mat_transpose_.NumRows() == 0)
       word_feature_mat_transpose_.CopyFromSmat(*word_feature_mat_, kTrans);
 
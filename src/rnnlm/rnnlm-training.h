@@ -179,6 +179,13 @@ class RnnlmTrainer {
   // active_word_features_trans_ is the transpose of active_word_features_;
   // This is a derived quantity computed by the background thread.
   CuSparseMatrix<BaseFloat> active_word_features_trans_;
+  // Only if we are doing subsampling AND we have sparse word features AND
+  // embedding_config_.sparse_feature_update is true: active_features_ is
+  // the sorted list of features that appear in active_word_features_, and
+  // active_word_features_trans_ is then not the full transpose of
+  // active_word_features_ but only has the rows for those features, i.e. its
+  // dimension is active_features_.Dim() by active_words_.Dim().
+  CuArray<int32> active_features_;
 
   // This value is used in backstitch training when we need to ensure
   // consistent dropout masks.  It's set to a value derived from rand()
@@ -19,6 +19,7 @@
 #include "base/kaldi-math.h"
 #include <limits>
 #include <numeric>
+#include <thread>
 #include "rnnlm/sampler.h"
 #include "util/stl-utils.h"
 
@@ -247,6 +248,9 @@ void UnitTestSampleWords() {
 
     Sampler sampler(unigram_probs);
     std::vector<double> sample_total(vocab_size);
+    // Half the time, test the version that uses a local random state.
+    RandomState random_state;
+    RandomState *state = (t % 2 == 0 ? NULL : &random_state);
     size_t l = 0;
     while (true) {
       // this will loop forever if the normalized samples don't approach
@@ -254,7 +258,7 @@ void UnitTestSampleWords() {
       std::vector<std::pair<int32, BaseFloat> > sample;
       sampler.SampleWords(num_words_to_sample, unigram_weight,
                           higher_order_probs, words_we_must_sample,
-                          &sample);
+                          &sample, state);
 
       KALDI_ASSERT(sample.size() == size_t(num_words_to_sample));
       std::sort(sample.begin(), sample.end());
@@ -275,6 +279,58 @@ void UnitTestSampleWords() {
 }
 
 
+// Samples 'num_samples' times from 'sampler' using a random state with seed
+// 'seed', appending the sampled words to 'words'.
+static void SampleWordsWithSeed(const Sampler &sampler,
+                                int32 num_words_to_sample,
+                                const std::vector<std::pair<int32, BaseFloat> >
+                                    &higher_order_probs,
+                                unsigned int seed, int32 num_samples,
+                                std::vector<int32> *words) {
+  RandomState state;
+  state.seed = seed;
+  for (int32 n = 0; n < num_samples; n++) {
+    std::vector<std::pair<int32, BaseFloat> > sample;
+    sampler.SampleWords(num_words_to_sample, 1.0, higher_order_probs,
+                        &sample, &state);
+    std::sort(sample.begin(), sample.end());
+    for (size_t i = 0; i < sample.size(); i++)
+      words->push_back(sample[i].first);
+  }
+}
+
+// Checks that several threads can share one Sampler, and that with a
+// per-thread random state the output only depends on the seed.
+void UnitTestSampleWordsThreaded() {
+  int32 vocab_size = RandInt(1000, 2000);
+  std::vector<BaseFloat> unigram_probs(vocab_size);
+  for (int32 i = 0; i < vocab_size; i++)
+    unigram_probs[i] = 1.0 / vocab_size;
+  std::vector<std::pair<int32, BaseFloat> > higher_order_probs;
+  higher_order_probs.push_back(std::pair<int32, BaseFloat>(5, 0.5));
+  higher_order_probs.push_back(std::pair<int32, BaseFloat>(10, 0.25));
+  Sampler sampler(unigram_probs);
+
+  int32 num_threads = 4, num_samples = 200, num_words_to_sample = 50;
+  unsigned int seed = RandInt(0, 10000);
+  std::vector<std::vector<int32> > words(num_threads);
+  std::vector<std::thread> threads;
+  for (int32 t = 0; t < num_threads; t++)
+    threads.push_back(std::thread(SampleWordsWithSeed, std::cref(sampler),
+                                  num_words_to_sample,
+                                  std::cref(higher_order_probs), seed,
+                                  num_samples, &(words[t])));
+  for (int32 t = 0; t < num_threads; t++)
+    threads[t].join();
+
+  std::vector<int32> single_threaded_words;
+  SampleWordsWithSeed(sampler, num_words_to_sample, higher_order_probs,
+                      seed, num_samples, &single_threaded_words);
+  for (int32 t = 0; t < num_threads; t++)
+    KALDI_ASSERT(words[t] == single_threaded_words);
+}
+
+
 }  // end namespace rnnlm.
 }  // end namespace kaldi.
 
@@ -284,4 +340,5 @@ int main() {
   UnitTestSampleWithoutReplacement();
   UnitTestSampleFromCdf();
   UnitTestSampleWords();
+  UnitTestSampleWordsThreaded();
 }
@@ -29,7 +29,8 @@ namespace rnnlm {
 
 
 void SampleWithoutReplacement(const std::vector<double> &probs,
-                              std::vector<int32> *sample) {
+                              std::vector<int32> *sample,
+                              struct RandomState *state) {
 
   // This outer loop over 't' will *almost always* just run for t == 0.  The
   // loop is necessary only to handle a pathological case.
@@ -55,7 +56,7 @@ void SampleWithoutReplacement(const std::vector<double> &probs,
     std::random_shuffle(order.begin(), order.end());
 #endif
 
-    double r = RandUniform();  // r <= 0 <= 1.
+    double r = RandUniform(state);  // r <= 0 <= 1.
 
     double c = -r;  // c is a kind of counter, to which we add the probabilities
                     // we we process them..  Whenever it becomes >= 0, we add something
@@ -142,10 +143,11 @@ BaseFloat TotalOfDistribution(const Distribution &d) {
 
 
 const double* SampleFromCdf(const double *cdf_start,
-                            const double *cdf_end) {
+                            const double *cdf_end,
+                            struct RandomState *state) {
   double tot_prob = *cdf_end - *cdf_start;
   KALDI_ASSERT(cdf_end > cdf_start && tot_prob > 0.0);
-  double cutoff = *cdf_start + tot_prob * RandUniform();
+  double cutoff = *cdf_start + tot_prob * RandUniform(state);
   if (cutoff >= *cdf_end) {
     // Mathematically speaking this should not happen; if it happens it is due
     // to roundoff.  It should be extremely rare in any case.
@@ -199,7 +201,8 @@ void Sampler::SampleWords(
     BaseFloat unigram_weight,
     const std::vector<std::pair<int32, BaseFloat> > &higher_order_probs,
     const std::vector<int32> &words_we_must_sample,
-    std::vector<std::pair<int32, BaseFloat> > *sample) const {
+    std::vector<std::pair<int32, BaseFloat> > *sample,
+    struct RandomState *state) const {
   CheckDistribution(higher_order_probs);  // TODO: delete this.
   int32 vocab_size = unigram_cdf_.size();
   KALDI_ASSERT(IsSortedAndUniq(words_we_must_sample) &&
@@ -251,7 +254,7 @@ void Sampler::SampleWords(
 
   SampleWords(num_words_to_sample, unigram_weight,
               merged_distribution,
-              sample);
+              sample, state);
   if (GetVerboseLevel() >= 2) {
     std::vector<int32> merged_list(words_we_must_sample);
     for (size_t i = 0; i < sample->size(); i++)
@@ -289,7 +292,8 @@ void Sampler::SampleWords(
     int32 num_words_to_sample,
     BaseFloat unigram_weight,
     const std::vector<std::pair<int32, BaseFloat> > &higher_order_probs,
-    std::vector<std::pair<int32, BaseFloat> > *sample) const {
+    std::vector<std::pair<int32, BaseFloat> > *sample,
+    struct RandomState *state) const {
   int32 vocab_size = unigram_cdf_.size() - 1;
   KALDI_ASSERT(num_words_to_sample > 0 &&
                num_words_to_sample + 1 < unigram_cdf_.size() &&
@@ -312,7 +316,7 @@ void Sampler::SampleWords(
                 unigram_weight + TotalOfDistribution(higher_order_probs));
   }
   NormalizeIntervals(num_words_to_sample, total_p, &intervals);
-  SampleFromIntervals(intervals, sample);
+  SampleFromIntervals(intervals, sample, state);
 }
 
 
@@ -446,7 +450,8 @@ void Sampler::NormalizeIntervals(int32 num_words_to_sample,
 }
 
 void Sampler::SampleFromIntervals(const std::vector<Interval> &intervals,
-                                  std::vector<std::pair<int32, BaseFloat> > *samples)  const {
+                                  std::vector<std::pair<int32, BaseFloat> > *samples,
+                                  struct RandomState *state)  const {
   size_t num_intervals = intervals.size();
   std::vector<double> probs(num_intervals);
   for (size_t i = 0; i < num_intervals; i++)
@@ -454,7 +459,7 @@ void Sampler::SampleFromIntervals(const std::vector<Interval> &intervals,
   // 'raw_samples' will contain indexes into the 'intervals' vector,
   // which we need to convert into actual words.
   std::vector<int32> raw_samples;
-  SampleWithoutReplacement(probs, &raw_samples);
+  SampleWithoutReplacement(probs, &raw_samples, state);
   size_t num_samples = raw_samples.size();
   samples->resize(num_samples);
   const double *cdf_start = &(unigram_cdf_[0]);
@@ -470,7 +475,7 @@ void Sampler::SampleFromIntervals(const std::vector<Interval> &intervals,
       (*samples)[i].second = interval.prob;
     } else {
       const double *word_ptr = SampleFromCdf(interval.start,
-                                             interval.end);
+                                             interval.end, state);
       int32 word = word_ptr - cdf_start;
       // the probability with which this word was sampled is: the probability of
       // sampling from this interval of the unigram, times the probability of
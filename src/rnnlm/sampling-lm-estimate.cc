@@ -18,8 +18,11 @@
 // limitations under the License.
 
 #include <iomanip>
+#include <memory>
 #include <numeric>
+#include <thread>
 #include "rnnlm/sampling-lm-estimate.h"
+#include "util/kaldi-semaphore.h"
 
 namespace kaldi {
 namespace rnnlm {
@@ -36,6 +39,7 @@ void SamplingLmEstimatorOptions::Check() const {
                unigram_factor > backoff_factor &&
                bos_factor > 0.0 && bos_factor <= unigram_factor);
   KALDI_ASSERT(unigram_power > 0.2 && unigram_power <= 1.0);
+  KALDI_ASSERT(num_threads >= 1);
 }
 
 SamplingLmEstimator::SamplingLmEstimator(
@@ -77,22 +81,34 @@ void SamplingLmEstimator::ProcessLine(BaseFloat corpus_weight,
                                           sentence_length + 1));
 }
 
+// Parses a line of the input to SamplingLmEstimator::Process(), of the form
+// <weight> <possibly-empty-sequence-of-integers>.  Returns false if the line
+// could not be interpreted.
+static bool ParseSamplingLmInputLine(const std::string &line,
+                                     BaseFloat *weight,
+                                     std::vector<int32> *words) {
+  std::istringstream line_is(line);
+  line_is >> *weight;
+  words->clear();
+  int32 word;
+  while (line_is >> word) {
+    words->push_back(word);
+  }
+  return line_is.eof();
+}
 
 void SamplingLmEstimator::Process(std::istream &is) {
+  if (config_.num_threads > 1) {
+    ProcessMultiThreaded(is);
+    return;
+  }
   int32 num_lines = 0;
   std::vector<int32> words;
   std::string line;
   while (getline(is, line)) {
     num_lines++;
-    std::istringstream line_is(line);
     BaseFloat weight;
-    line_is >> weight;
-    words.clear();
-    int32 word;
-    while (line_is >> word) {
-      words.push_back(word);
-    }
-    if (!line_is.eof()) {
+    if (!ParseSamplingLmInputLine(line, &weight, &words)) {
       KALDI_ERR << "Could not interpret input: " << line;
     }
     this->ProcessLine(weight, words);
@@ -101,6 +117,170 @@ void SamplingLmEstimator::Process(std::istream &is) {
 }
 
 
+class SamplingLmEstimator::NgramBlockQueue {
+ public:
+  explicit NgramBlockQueue(int32 num_blocks):
+      blocks_(num_blocks), next_to_write_(0), next_to_read_(0),
+      empty_semaphore_(num_blocks), full_semaphore_(0) { }
+
+  // Called by the producer: waits until a block is free, and returns it,
+  // emptied.  Call DoneWriting() when it has been filled.
+  NgramBlock *NextToWrite() {
+    empty_semaphore_.Wait();
+    NgramBlock *block = &(blocks_[next_to_write_]);
+    block->words.clear();
+    block->lengths.clear();
+    block->weights.clear();
+    return block;
+  }
+  void DoneWriting() {
+    next_to_write_ = (next_to_write_ + 1) % blocks_.size();
+    full_semaphore_.Signal();
+  }
+
+  // Called by the consumer: waits until a block has been written, and returns
+  // it.  Call DoneReading() when it is no longer needed.
+  const NgramBlock *NextToRead() {
+    full_semaphore_.Wait();
+    return &(blocks_[next_to_read_]);
+  }
+  void DoneReading() {
+    next_to_read_ = (next_to_read_ + 1) % blocks_.size();
+    empty_semaphore_.Signal();
+  }
+
+ private:
+  std::vector<NgramBlock> blocks_;
+  // next_to_write_ is only accessed by the producer and next_to_read_ by the
+  // consumer; the semaphores make sure they don't use the same block at once.
+  size_t next_to_write_;
+  size_t next_to_read_;
+  Semaphore empty_semaphore_;  // counts the blocks free for writing.
+  Semaphore full_semaphore_;  // counts the blocks ready to be read.
+};
+
+// static
+void SamplingLmEstimator::AccumulateNgramBlocks(
+    NgramBlockQueue *queue, std::vector<HistoryMap> *history_states) {
+  std::vector<int32> history;
+  while (true) {
+    const NgramBlock *block = queue->NextToRead();
+    if (block->lengths.empty())
+      break;  // no more input.
+    std::vector<int32>::const_iterator iter = block->words.begin();
+    for (size_t i = 0; i < block->lengths.size(); i++) {
+      int32 length = block->lengths[i];
+      history.assign(iter, iter + length - 1);
+      // If 'history' was not previously a key, 'value' will be
+      // value-initialized to NULL; see the comment in GetHistoryState().
+      HistoryState *&value = (*history_states)[history.size()][history];
+      if (value == NULL)
+        value = new HistoryState();
+      value->AddCount(iter[length - 1], block->weights[i]);
+      iter += length;
+    }
+    queue->DoneReading();
+  }
+}
+
+void SamplingLmEstimator::ProcessMultiThreaded(std::istream &is) {
+  int32 num_shards = config_.num_threads,
+      ngram_order = config_.ngram_order,
+      vocab_size = config_.vocab_size;
+  KALDI_ASSERT(num_shards > 1);
+  // Each thread has its own shard of the history-states: those for histories
+  // h with VectorHasher<int32>()(h) % num_shards == shard.  We first move any
+  // history-states we already have (e.g. from previous calls to Process())
+  // into the shards they belong to.
+  std::vector<std::vector<HistoryMap> > shards(
+      num_shards, std::vector<HistoryMap>(ngram_order));
+  for (int32 o = 0; o < ngram_order; o++) {
+    HistoryMap::iterator iter = history_states_[o].begin(),
+        end = history_states_[o].end();
+    for (; iter != end; ++iter) {
+      int32 shard = VectorHasher<int32>()(iter->first) % num_shards;
+      shards[shard][o][iter->first] = iter->second;
+    }
+    history_states_[o].clear();
+  }
+
+  // This thread parses the input and sends each n-gram to the thread for its
+  // history's shard, in blocks of up to this many n-grams.
+  const size_t ngrams_per_block = 10000;
+  const int32 blocks_per_queue = 4;
+  std::vector<std::unique_ptr<NgramBlockQueue> > queues(num_shards);
+  std::vector<NgramBlock*> blocks(num_shards);
+  std::vector<std::thread> threads;
+  for (int32 shard = 0; shard < num_shards; shard++) {
+    queues[shard].reset(new NgramBlockQueue(blocks_per_queue));
+    blocks[shard] = queues[shard]->NextToWrite();
+    threads.push_back(std::thread(&SamplingLmEstimator::AccumulateNgramBlocks,
+                                  queues[shard].get(), &(shards[shard])));
+  }
+
+  int32 num_lines = 0;
+  std::string line;
+  bool input_ok = true;
+  std::vector<int32> words, history;
+  while (getline(is, line)) {
+    num_lines++;
+    BaseFloat weight;
+    // We can't throw while the threads are running, so we stop at the first
+    // bad line and report it after they have finished.
+    input_ok = ParseSamplingLmInputLine(line, &weight, &words) &&
+        weight >= 0.0;
+    for (size_t i = 0; input_ok && i < words.size(); i++)
+      input_ok = (words[i] > 0 && words[i] < vocab_size);
+    if (!input_ok)
+      break;
+    // With BOS and EOS added, each word after the BOS is predicted from up to
+    // ngram_order - 1 words of history.
+    words.insert(words.begin(), config_.bos_symbol);
+    words.push_back(config_.eos_symbol);
+    for (int32 i = 1; i < static_cast<int32>(words.size()); i++) {
+      int32 history_start = std::max(0, i - ngram_order + 1);
+      history.assign(words.begin() + history_start, words.begin() + i);
+      int32 shard = VectorHasher<int32>()(history) % num_shards;
+      NgramBlock *block = blocks[shard];
+      block->words.insert(block->words.end(), words.begin() + history_start,
+                          words.begin() + i + 1);
+      block->lengths.push_back(i + 1 - history_start);
+      block->weights.push_back(weight);
+      if (block->lengths.size() == ngrams_per_block) {
+        queues[shard]->DoneWriting();
+        blocks[shard] = queues[shard]->NextToWrite();
+      }
+    }
+  }
+  // Send the remaining n-grams, then an empty block to tell the threads to
+  // finish.
+  for (int32 shard = 0; shard < num_shards; shard++) {
+    if (!blocks[shard]->lengths.empty()) {
+      queues[shard]->DoneWriting();
+      blocks[shard] = queues[shard]->NextToWrite();
+    }
+    queues[shard]->DoneWriting();
+  }
+  for (int32 shard = 0; shard < num_shards; shard++)
+    threads[shard].join();
+
+  // The shards have disjoint sets of histories, so merging them is simple.
+  for (int32 shard = 0; shard < num_shards; shard++) {
+    for (int32 o = 0; o < ngram_order; o++) {
+      history_states_[o].insert(shards[shard][o].begin(),
+                                shards[shard][o].end());
+      HistoryMap().swap(shards[shard][o]);
+    }
+  }
+  if (!input_ok)
+    KALDI_ERR << "Could not interpret input (or invalid corpus weight or "
+              << "word-id out of range [1, " << (vocab_size - 1) << "]): "
+              << line;
+  KALDI_LOG << "Processed " << num_lines << " lines of input using "
+            << num_shards << " threads.";
+}
+
+
 void SamplingLmEstimator::HistoryState::AddCount(int32 word,
                                                   BaseFloat corpus_weight) {
   new_counts.push_back(std::pair<int32, BaseFloat>(word, corpus_weight));
@@ -42,6 +42,8 @@ struct SamplingLmEstimatorOptions {
   int32 eos_symbol;
   int32 brk_symbol;
 
+  int32 num_threads;
+
   SamplingLmEstimatorOptions(): vocab_size(-1),
                                 ngram_order(3),
                                 discounting_constant(1.0),
@@ -51,7 +53,8 @@ struct SamplingLmEstimatorOptions {
                                 unigram_power(0.8),
                                 bos_symbol(1),
                                 eos_symbol(2),
-                                brk_symbol(-1) { }
+                                brk_symbol(-1),
+                                num_threads(1) { }
 
   void Register(OptionsItf *po) {
     po->Register("vocab-size", &vocab_size, "If set, must be set to the "
@@ -92,6 +95,10 @@ struct SamplingLmEstimatorOptions {
                  "importance sampling to use this kind of power term.  "
                  "There are both theoretical and practical reasons why we want "
                  "to just apply this power to the unigram portion.  E.g. 0.75.");
+    po->Register("num-threads", &num_threads, "Number of threads used to "
+                 "accumulate the n-gram counts from the input text (each "
+                 "thread handles a disjoint subset of the history states). "
+                 "Does not affect the result.");
   }
   void Check() const;
 };
@@ -222,6 +229,9 @@ class SamplingLmEstimator {
   // <weight> <possibly-empty-sequence-of-integers>
   // e.g.:
   // 1.0  2560 8991
+  // If config_.num_threads > 1, the counts are accumulated by that many
+  // threads, each handling a disjoint subset of the histories, while this
+  // thread reads the input; the result is exactly the same.
   void Process(std::istream &is);
 
   // Estimates the language model (internal representation); includes
@@ -304,6 +314,39 @@ class SamplingLmEstimator {
     GetHistoryState(history, true)->AddCount(word, corpus_weight);
   }
 
+  // A map from a history (a sequence of words) to its HistoryState; see
+  // history_states_.
+  typedef unordered_map<std::vector<int32>, HistoryState*,
+                        VectorHasher<int32> > HistoryMap;
+
+  // A block of n-grams with their corpus weights, passed by the thread that
+  // reads the input in ProcessMultiThreaded() to one of the threads that
+  // accumulate the counts.  The words of the n-grams are concatenated in
+  // 'words'; n-gram i has length lengths[i] (its history followed by the
+  // predicted word) and weight weights[i].  An empty block means there are no
+  // more n-grams.
+  struct NgramBlock {
+    std::vector<int32> words;
+    std::vector<int32> lengths;
+    std::vector<BaseFloat> weights;
+  };
+
+  // A fixed-size queue of NgramBlocks from one producer to one consumer;
+  // defined in the .cc file.
+  class NgramBlockQueue;
+
+  // Adds the counts from the blocks it gets from 'queue' to 'history_states'
+  // (indexed by history length, like history_states_), until it gets an empty
+  // block.  This is what each thread runs in ProcessMultiThreaded().  Since
+  // the input is split between the threads by history, and each history-state
+  // gets its counts in the same order as it would with a single thread, the
+  // result is the same.
+  static void AccumulateNgramBlocks(NgramBlockQueue *queue,
+                                    std::vector<HistoryMap> *history_states);
+
+  // This is called from Process() if config_.num_threads > 1.
+  void ProcessMultiThreaded(std::istream &is);
+
   // Scales the unigram counts by taking them to the power 'power' and
   // renormalizing.
   void TakeUnigramCountsToPower(BaseFloat power);
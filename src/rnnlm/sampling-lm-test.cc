@@ -19,6 +19,7 @@
 // limitations under the License.
 
 #include "rnnlm/sampling-lm.h"
+#include "rnnlm/sampling-lm-estimate.h"
 
 namespace kaldi {
 namespace rnnlm {
@@ -122,6 +123,46 @@ void SamplingLmTest::TestGetDistribution(const WeightedHistType &histories) {
   KALDI_ASSERT(ApproxEqual(unigram_weight + non_unigram_probsum, total_weights));
 }
 
+// Checks that accumulating the counts for SamplingLmEstimator with multiple
+// threads gives exactly the same LM as with one thread.
+void UnitTestSamplingLmEstimatorThreaded() {
+  SamplingLmEstimatorOptions config;
+  config.vocab_size = 50;
+  config.ngram_order = RandInt(2, 4);
+  fst::SymbolTable symbols;
+  symbols.AddSymbol("<eps>", 0);
+  symbols.AddSymbol("<s>", config.bos_symbol);
+  symbols.AddSymbol("</s>", config.eos_symbol);
+  for (int32 i = 3; i < config.vocab_size; i++)
+    symbols.AddSymbol("w" + std::to_string(i), i);
+
+  std::ostringstream text;
+  for (int32 n = 0; n < 2000; n++) {
+    text << (0.5 * RandInt(1, 3));
+    int32 length = RandInt(0, 10);
+    for (int32 i = 0; i < length; i++)  // skewed towards low word-ids.
+      text << ' ' << RandInt(3, RandInt(3, config.vocab_size - 1));
+    text << '\n';
+  }
+
+  // The ARPA files are compared as sorted lists of lines, because the order in
+  // which the n-grams are printed depends on the order of the hash tables.
+  std::vector<std::string> arpa[2];
+  for (int32 i = 0; i < 2; i++) {
+    config.num_threads = (i == 0 ? 1 : RandInt(2, 4));
+    SamplingLmEstimator estimator(config);
+    std::istringstream is(text.str());
+    estimator.Process(is);
+    bool will_write_arpa = true;
+    estimator.Estimate(will_write_arpa);
+    std::ostringstream os;
+    estimator.PrintAsArpa(os, symbols);
+    SplitStringToVector(os.str(), "\n", true, &(arpa[i]));
+    std::sort(arpa[i].begin(), arpa[i].end());
+  }
+  KALDI_ASSERT(arpa[0] == arpa[1]);
+}
+
 }  // namespace rnnlm
 }  // namespace kaldi
 
@@ -162,6 +203,9 @@ int main(int argc, char **argv) {
   SamplingLmTest::WeightedHistType histories;
   mdl.ReadHistories(k2.Stream(), binary, &histories);
   mdl.TestGetDistribution(histories);
+
+  for (int32 i = 0; i < 5; i++)
+    UnitTestSamplingLmEstimatorThreaded();
   KALDI_LOG << "Tests for SamplingLm class succeed.";
   return 0;
 }
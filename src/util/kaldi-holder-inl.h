@@ -37,6 +37,17 @@ namespace kaldi {
 /// \addtogroup holders
 /// @{
 
+// Returns the position of a stream that a read from it failed at, for use in
+// error messages; tellg() by itself returns -1 once the failbit is set.  We
+// only look at the position on failure, as tellg() may be a system call.
+inline std::streamoff FailedReadPosition(std::istream &is) {
+  std::ios_base::iostate state = is.rdstate();
+  is.clear();
+  std::streamoff pos = is.tellg();
+  is.clear(state);
+  return pos;
+}
+
 
 // KaldiObjectHolder is valid only for Kaldi objects with
 // copy constructors, default constructors, and "normal"
@@ -112,6 +123,25 @@ template<class KaldiType> class KaldiObjectHolder {
     return ExtractObjectRange(*(other.t_), range, t_);
   }
 
+  // Reads just the part 'range' of the object; see ReadObjectRange().
+  bool ReadRange(std::istream &is, const std::string &range) {
+    delete t_;
+    t_ = new T;
+    bool is_binary;
+    if (!InitKaldiInputStream(is, &is_binary)) {
+      KALDI_WARN << "Reading Table object, failed reading binary header\n";
+      return false;
+    }
+    try {
+      return ReadObjectRange(is, is_binary, range, t_);
+    } catch(const std::exception &e) {
+      KALDI_WARN << "Exception caught reading Table object. " << e.what();
+      delete t_;
+      t_ = NULL;
+      return false;
+    }
+  }
+
   ~KaldiObjectHolder() { delete t_; }
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(KaldiObjectHolder);
@@ -119,6 +149,75 @@ template<class KaldiType> class KaldiObjectHolder {
 };
 
 
+// ReadHolderRange() is used by the script-file Table readers for scp lines
+// with ranges like foo.ark:1234[0:99].  It reads the part 'range' of the object
+// in 'is' into 'range_holder'.  The generic version reads the whole object
+// into 'holder' and extracts the range (holders other than KaldiObjectHolder
+// don't support ranges, so ExtractRange() will throw); for KaldiObjectHolder,
+// the range is read directly, and 'holder' is left empty.
+template<class Holder>
+bool ReadHolderRange(std::istream &is, const std::string &range,
+                     Holder *holder, Holder *range_holder) {
+  return holder->Read(is) && range_holder->ExtractRange(*holder, range);
+}
+
+template<class T>
+bool ReadHolderRange(std::istream &is, const std::string &range,
+                     KaldiObjectHolder<T> *holder,
+                     KaldiObjectHolder<T> *range_holder) {
+  holder->Clear();
+  return range_holder->ReadRange(is, range);
+}
+
+
+// WriteHolderObject() is used by the Table writers to write objects.  The
+// generic version calls Holder::Write(), ignoring 'packed' (the "packed"
+// wspecifier option); holders whose type has a packed binary format
+// overload it for their own type, e.g. CompactLatticeHolder (see
+// lat/kaldi-lattice.h).  'holder_type' is only used to choose the overload
+// and may be NULL.
+template<class Holder>
+bool WriteHolderObject(std::ostream &os, bool binary, bool packed,
+                       const typename Holder::T &t,
+                       const Holder *holder_type) {
+  return Holder::Write(os, binary, t);
+}
+
+// HolderDataAlignment() is used by the archive writers in binary mode with the
+// "align" wspecifier option.  If the binary form of 't' is a header of fixed
+// size followed by data that can be used in place when it is suitably aligned
+// (see MatrixView in matrix-view.h), it sets *header_size (which includes the
+// binary-mode header "\0B") and *alignment, and returns true; the writer then
+// pads the archive so that the data is aligned.  The generic version returns
+// false; holders for such types overload it.
+template<class Holder>
+bool HolderDataAlignment(const typename Holder::T &t,
+                         const Holder *holder_type,
+                         int32 *header_size, int32 *alignment) {
+  return false;
+}
+
+// A binary matrix is "\0B", "FM " or "DM ", and the number of rows and columns
+// (each written as a size byte and 4 bytes), followed by the data.
+template<class Real>
+bool HolderDataAlignment(const MatrixBase<Real> &t,
+                         const KaldiObjectHolder<MatrixBase<Real> > *holder_type,
+                         int32 *header_size, int32 *alignment) {
+  *header_size = 15;
+  *alignment = sizeof(Real);
+  return true;
+}
+
+template<class Real>
+bool HolderDataAlignment(const Matrix<Real> &t,
+                         const KaldiObjectHolder<Matrix<Real> > *holder_type,
+                         int32 *header_size, int32 *alignment) {
+  *header_size = 15;
+  *alignment = sizeof(Real);
+  return true;
+}
+
+
 // BasicHolder is valid for float, double, bool, and integer
 // types.  There will be a compile time error otherwise, because
 // we make sure that the {Write, Read}BasicType functions do not
@@ -293,20 +392,20 @@ template<class BasicType> class BasicVectorHolder {
         return false;
       }
     } else {  // binary mode.
-      size_t filepos = is.tellg();
       try {
+        BinaryReader reader(is);
         int32 size;
-        ReadBasicType(is, true, &size);
+        reader.ReadBasicType(&size);
         t_.resize(size);
         for (typename std::vector<BasicType>::iterator iter = t_.begin();
              iter != t_.end();
              ++iter) {
-          ReadBasicType(is, true, &(*iter));
+          reader.ReadBasicType(&(*iter));
         }
         return true;
       } catch(...) {
         KALDI_WARN << "BasicVectorHolder::Read, read error or unexpected data"
-            " at archive entry beginning at file position " << filepos;
+            " at file position " << FailedReadPosition(is);
         return false;
       }
     }
@@ -437,27 +536,27 @@ template<class BasicType> class BasicVectorVectorHolder {
         return false;
       }
     } else {  // binary mode.
-      size_t filepos = is.tellg();
       try {
+        BinaryReader reader(is);
         int32 size;
-        ReadBasicType(is, true, &size);
+        reader.ReadBasicType(&size);
         t_.resize(size);
         for (typename std::vector<std::vector<BasicType> >::iterator
                  iter = t_.begin();
              iter != t_.end();
              ++iter) {
           int32 size2;
-          ReadBasicType(is, true, &size2);
+          reader.ReadBasicType(&size2);
           iter->resize(size2);
           for (typename std::vector<BasicType>::iterator iter2 = iter->begin();
                iter2 != iter->end();
                ++iter2)
-            ReadBasicType(is, true, &(*iter2));
+            reader.ReadBasicType(&(*iter2));
         }
         return true;
       } catch(...) {
-        KALDI_WARN << "Read error or unexpected data at archive entry beginning"
-            " at file position " << filepos;
+        KALDI_WARN << "Read error or unexpected data at file position "
+                   << FailedReadPosition(is);
         return false;
       }
     }
@@ -588,21 +687,21 @@ template<class BasicType> class BasicPairVectorHolder {
         return false;
       }
     } else {  // binary mode.
-      size_t filepos = is.tellg();
       try {
+        BinaryReader reader(is);
         int32 size;
-        ReadBasicType(is, true, &size);
+        reader.ReadBasicType(&size);
         t_.resize(size);
         for (typename T::iterator iter = t_.begin();
              iter != t_.end();
              ++iter) {
-          ReadBasicType(is, true, &(iter->first));
-          ReadBasicType(is, true, &(iter->second));
+          reader.ReadBasicType(&(iter->first));
+          reader.ReadBasicType(&(iter->second));
         }
         return true;
       } catch(...) {
-        KALDI_WARN << "BasicVectorHolder::Read, read error or unexpected data"
-            " at archive entry beginning at file position " << filepos;
+        KALDI_WARN << "BasicPairVectorHolder::Read, read error or unexpected "
+            "data at file position " << FailedReadPosition(is);
         return false;
       }
     }
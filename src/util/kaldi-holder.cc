@@ -85,6 +85,19 @@ bool ParseMatrixRangeSpecifier(const std::string &range,
   return status;
 }
 
+void ParseMatrixRangeRows(const std::string &range, int32 *row_offset,
+                          int32 *num_rows) {
+  // Parse as if for a very large matrix, so a missing end of the row range
+  // comes out as kLargeDim - 1.
+  const int32 kLargeDim = 1 << 30;
+  std::vector<int32> row_range, col_range;
+  ParseMatrixRangeSpecifier(range, kLargeDim, kLargeDim,
+                            &row_range, &col_range);
+  *row_offset = row_range[0];
+  *num_rows = (row_range[1] >= kLargeDim - 1 ? -1 :
+               row_range[1] - row_range[0] + 1);
+}
+
 bool ExtractObjectRange(const GeneralMatrix &input, const std::string &range,
                         GeneralMatrix *output) {
   // We just inspect input's type and forward to the correct implementation
@@ -160,6 +173,79 @@ template bool ExtractObjectRange(const Matrix<double> &, const std::string &,
 template bool ExtractObjectRange(const Matrix<float> &, const std::string &,
                                  Matrix<float> *);
 
+template<class Real>
+bool ReadObjectRange(std::istream &is, bool binary, const std::string &range,
+                     Matrix<Real> *output) {
+  const char *my_token = (sizeof(Real) == 4 ? "FM" : "DM");
+  int peekval = (binary ? Peek(is, binary) : -1);
+  if (peekval != 'C' && peekval != my_token[0]) {
+    Matrix<Real> input;
+    input.Read(is, binary);
+    return ExtractObjectRange(input, range, output);
+  }
+  int32 row_offset, num_rows_wanted, rows, cols;
+  ParseMatrixRangeRows(range, &row_offset, &num_rows_wanted);
+  Matrix<Real> row_block;  // the rows asked for, with all the columns.
+  if (peekval == 'C') {
+    CompressedMatrix cmat;
+    cmat.ReadRowRange(is, row_offset, num_rows_wanted, &rows);
+    cols = cmat.NumCols();
+    row_block.Resize(cmat.NumRows(), cols, kUndefined);
+    cmat.CopyToMat(&row_block);
+  } else {
+    ExpectToken(is, binary, my_token);
+    ReadBasicType(is, binary, &rows);
+    ReadBasicType(is, binary, &cols);
+    if (rows < 0 || cols < 0 || (rows == 0) != (cols == 0))
+      KALDI_ERR << "Invalid matrix dimensions " << rows << " x " << cols;
+    int32 begin = std::min(row_offset, rows),
+        end = (num_rows_wanted < 0 ? rows :
+               std::min(rows, begin + num_rows_wanted));
+    int64 row_bytes = sizeof(Real) * static_cast<int64>(cols);
+    row_block.Resize(end - begin, cols, kUndefined);
+    SkipBytes(is, row_bytes * begin);
+    for (int32 r = begin; r < end; r++)
+      is.read(reinterpret_cast<char*>(row_block.RowData(r - begin)),
+              row_bytes);
+    SkipBytes(is, row_bytes * (rows - end));
+    if (is.fail())
+      KALDI_ERR << "Failed to read matrix from stream.";
+  }
+  std::vector<int32> row_range, col_range;
+  if (!ParseMatrixRangeSpecifier(range, rows, cols, &row_range, &col_range)) {
+    KALDI_ERR << "Could not parse range specifier \"" << range << "\".";
+  }
+  KALDI_ASSERT(row_block.NumRows() ==
+               std::min(row_range[1], rows - 1) - row_range[0] + 1);
+  int32 col_size = col_range[1] - col_range[0] + 1;
+  if (col_size == cols) {
+    output->Swap(&row_block);
+  } else {
+    output->Resize(row_block.NumRows(), col_size, kUndefined);
+    output->CopyFromMat(row_block.ColRange(col_range[0], col_size));
+  }
+  return true;
+}
+
+template bool ReadObjectRange(std::istream &, bool, const std::string &,
+                              Matrix<float> *);
+template bool ReadObjectRange(std::istream &, bool, const std::string &,
+                              Matrix<double> *);
+
+bool ReadObjectRange(std::istream &is, bool binary, const std::string &range,
+                     GeneralMatrix *output) {
+  if (!binary || Peek(is, binary) == 'S') {  // text, or a sparse matrix.
+    GeneralMatrix input;
+    input.Read(is, binary);
+    return ExtractObjectRange(input, range, output);
+  }
+  Matrix<BaseFloat> output_mat;
+  ReadObjectRange(is, binary, range, &output_mat);
+  output->Clear();
+  output->SwapFullMatrix(&output_mat);
+  return true;
+}
+
 template<class Real>
 bool ExtractObjectRange(const Vector<Real> &input, const std::string &range,
                         Vector<Real> *output) {
@@ -94,7 +94,9 @@ template<class SomeType> class GenericHolder {
   /// to write from this class).  The Write method may throw if it cannot write
   /// the object in the given (binary/non-binary) mode.  The holder object can
   /// assume the stream has been opened in the given mode (where relevant).  The
-  /// object can write the data how it likes.
+  /// object can write the data how it likes.  (Table writers call it via
+  /// WriteHolderObject(), which a holder may overload to support the "packed"
+  /// wspecifier option.)
   static bool Write(std::ostream &os, bool binary, const T &t);
 
   /// Reads into the holder.  Must work out from the stream (which will be
@@ -148,6 +150,13 @@ template<class SomeType> class GenericHolder {
     return false;
   }
 
+  /// Optional; at the time of writing only KaldiObjectHolder has it.  Reads
+  /// just the part 'range' of the object in the stream (see ReadObjectRange()),
+  /// like Read() followed by ExtractRange() but without necessarily reading
+  /// the whole object.  Table code calls it via ReadHolderRange(), which falls
+  /// back to Read() and ExtractRange() for holders that don't have it.
+  bool ReadRange(std::istream &is, const std::string &range);
+
   /// If the object held pointers, the destructor would free them.
   ~GenericHolder() { }
 
@@ -235,6 +244,24 @@ bool ExtractObjectRange(const T &input, const std::string &range, T *output) {
   return false;
 }
 
+/// Parses a matrix range specifier of the form r1:r2,c1:c2, where any of the
+/// four numbers may be missing (then r1 and c1 default to zero and r2 and c2
+/// to rows - 1 and cols - 1; e.g. "0:39,:", ":,:3" or ":,5:10"), for a matrix
+/// with the given dimensions.  Outputs the two ranges as (first, last) pairs.
+/// Throws (or returns false) on error; r2 may exceed rows - 1 by a small
+/// tolerance, with a warning.
+bool ParseMatrixRangeSpecifier(const std::string &range,
+                               const int rows, const int cols,
+                               std::vector<int32> *row_range,
+                               std::vector<int32> *col_range);
+
+/// For reading ranges of matrices before their dimensions are known (see
+/// ReadObjectRange()): outputs the first row of the row range in 'range' and
+/// the number of rows, which is -1 if the range goes to the end of the matrix.
+/// The range should be checked later with ParseMatrixRangeSpecifier().
+void ParseMatrixRangeRows(const std::string &range, int32 *row_offset,
+                          int32 *num_rows);
+
 /// The template is specialized with a version that actually does something,
 /// for types Matrix<float> and Matrix<double>.  We can later add versions of
 /// this template for other types, such as Vector, which can meaningfully
@@ -259,6 +286,33 @@ template <class Real>
 bool ExtractObjectRange(const CompressedMatrix &input, const std::string &range,
                         Matrix<Real> *output);
 
+/// ReadObjectRange() reads just the part 'range' (as for ExtractObjectRange())
+/// of an object from a stream; the stream must be positioned after the binary
+/// header, if any, and 'binary' says whether it was present.  The script-file
+/// Table readers use it (via KaldiObjectHolder::ReadRange()) for scp lines
+/// with ranges like foo.ark:1234[100:399], so that only the rows needed are
+/// read and decompressed, instead of the whole object.
+/// The generic version reads the whole object and calls ExtractObjectRange().
+template <class T>
+bool ReadObjectRange(std::istream &is, bool binary, const std::string &range,
+                     T *output) {
+  T input;
+  input.Read(is, binary);
+  return ExtractObjectRange(input, range, output);
+}
+
+/// For binary compressed matrices and binary matrices of type Real, this reads
+/// only the rows in the range and skips over the rest (see
+/// CompressedMatrix::ReadRowRange()); other formats are read in full.
+template <class Real>
+bool ReadObjectRange(std::istream &is, bool binary, const std::string &range,
+                     Matrix<Real> *output);
+
+/// Compressed and full matrices are read as for Matrix<BaseFloat>, into a full
+/// matrix (as ExtractObjectRange() would output).
+bool ReadObjectRange(std::istream &is, bool binary, const std::string &range,
+                     GeneralMatrix *output);
+
 // In SequentialTableReaderScriptImpl and RandomAccessTableReaderScriptImpl, for
 // cases where the scp contained 'range specifiers' (things in square brackets
 // identifying parts of objects like matrices), use this function to separate
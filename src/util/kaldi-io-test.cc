@@ -19,8 +19,11 @@
 #ifndef _MSC_VER
 #include <unistd.h>
 #endif
+#include <fstream>
+#include <vector>
 #include "base/io-funcs.h"
 #include "util/kaldi-io.h"
+#include "util/kaldi-mmap.h"
 #include "base/kaldi-math.h"
 #include "base/kaldi-utils.h"
 
@@ -280,6 +283,70 @@ void UnitTestIoPipe(bool binary) {
   unlink("tmpf.gz");
 }
 
+void UnitTestIoOffset(int32 cache_capacity) {
+  MappedFileCache::Instance().SetCapacity(cache_capacity);
+  int32 num_files = 3, num_values = 20;
+  // offsets[f][v] is the offset of the v'th value in the f'th file.
+  std::vector<std::vector<size_t> > offsets(num_files);
+  std::vector<std::string> filenames(num_files);
+  for (int32 f = 0; f < num_files; f++) {
+    filenames[f] = "tmpf" + std::to_string(f);
+    std::ofstream os(filenames[f].c_str(), std::ios::binary);
+    for (int32 v = 0; v < num_values; v++) {
+      offsets[f].push_back(os.tellp());
+      WriteBasicType(os, true, 1000 * f + v);
+    }
+  }
+  Input ki;
+  for (int32 n = 0; n < 100; n++) {
+    int32 f = Rand() % num_files, v = Rand() % num_values;
+    std::string rxfilename = filenames[f] + ":" +
+        std::to_string(offsets[f][v]);
+    KALDI_ASSERT(ki.Open(rxfilename));
+    int32 value;
+    ReadBasicType(ki.Stream(), true, &value);
+    KALDI_ASSERT(value == 1000 * f + v);
+  }
+  // Rewrite a file with different contents and size; the next read must see
+  // the new contents.
+  {
+    std::ofstream os(filenames[0].c_str(), std::ios::binary);
+    WriteBasicType(os, true, -1);
+    WriteBasicType(os, true, -2);
+  }
+  KALDI_ASSERT(ki.Open(filenames[0] + ":5"));
+  int32 value;
+  ReadBasicType(ki.Stream(), true, &value);
+  KALDI_ASSERT(value == -2);
+  if (cache_capacity > 0)  // past the end (ifstream allows this seek).
+    KALDI_ASSERT(!ki.Open(filenames[0] + ":100"));
+  for (int32 f = 0; f < num_files; f++)
+    unlink(filenames[f].c_str());
+  MappedFileCache::Instance().SetCapacity(64);
+}
+
+void UnitTestMappedFileTruncated() {
+  {
+    std::ofstream os("tmpf", std::ios::binary);
+    os << std::string(100, 'a');
+  }
+  MappedFile file;
+  KALDI_ASSERT(file.Open("tmpf") && file.Size() == 100);
+  KALDI_ASSERT(file.InRange(0, 100) && file.InRange(100, 0));
+  KALDI_ASSERT(!file.InRange(0, 101) && !file.InRange(101, 0));
+  {  // truncates the same file, which stays mapped.
+    std::ofstream os("tmpf", std::ios::binary);
+    os << std::string(10, 'b');
+  }
+  KALDI_ASSERT(file.Size() == 100);
+#ifndef _MSC_VER
+  KALDI_ASSERT(file.CurrentSize() == 10);
+  KALDI_ASSERT(file.InRange(5, 5) && !file.InRange(5, 6));
+#endif
+  file.Close();
+  unlink("tmpf");
+}
+
 void UnitTestIoStandard() {
   /*
     Don't do the the following part because it requires
@@ -361,6 +428,10 @@ int main(int argc, const char** argv) {
   UnitTestIoPipe(true);
   UnitTestIoPipe(false);
   UnitTestIoStandard();
+  UnitTestIoOffset(0);
+  UnitTestIoOffset(1);
+  UnitTestIoOffset(64);
+  UnitTestMappedFileTruncated();
   UnitTestClassifyRxfilename();
   UnitTestClassifyWxfilename();
 
@@ -24,6 +24,7 @@
 #include "util/text-utils.h"
 #include "util/parse-options.h"
 #include "util/kaldi-holder.h"
+#include "util/kaldi-mmap.h"
 #include "util/kaldi-pipebuf.h"
 #include "util/kaldi-table.h"  // for Classify{W,R}specifier
 #include <stdio.h>
@@ -554,7 +555,14 @@ class PipeInputImpl: public InputImplBase {
 */
 
 class OffsetFileInputImpl: public InputImplBase {
-  // This class is a bit more complicated than the
+  // This class is a bit more complicated than the others because it is
+  // designed to be re-opened cheaply.  Where possible the file is read
+  // through a memory mapping obtained from the process-wide MappedFileCache,
+  // so reads from a set of archives in any order (e.g. from a shuffled scp
+  // file) need no open(), seek or read system calls.  Otherwise (e.g. if the
+  // file cannot be mapped, or has been truncated since it was mapped) we read
+  // it with an ifstream, which we keep open in case the next read is from the
+  // same file.
 
  public:
   // splits a filename like /my/file:123 into /my/file and the
@@ -576,6 +584,11 @@ class OffsetFileInputImpl: public InputImplBase {
   }
 
   bool Seek(size_t offset) {
+    if (mapped_is_) {
+      mapped_is_->clear();
+      if (offset > mapped_->Size()) return false;
+      return !mapped_is_->seekg(offset).fail();
+    }
     size_t cur_pos = is_.tellg();
     if (cur_pos == offset) return true;
     else if (cur_pos<offset && cur_pos+100 > offset) {
@@ -600,51 +613,60 @@ class OffsetFileInputImpl: public InputImplBase {
   // if it was already open.  This for efficiency when seeking multiple
   // times.
   virtual bool Open(const std::string &rxfilename, bool binary) {
-    if (is_.is_open()) {
-      // We are opening when we have an already-open file.
-      // We may have to seek within this file, or else close it and
-      // open a different one.
-      std::string tmp_filename;
-      size_t offset;
-      SplitFilename(rxfilename, &tmp_filename, &offset);
-      if (tmp_filename == filename_ && binary == binary_) {  // Just seek
+    std::string filename;
+    size_t offset;
+    SplitFilename(rxfilename, &filename, &offset);
+    if (IsOpen() && filename == filename_ && binary == binary_) {
+      // Just seek.  For a mapped file we still go through the cache, to
+      // notice if the file has been replaced.
+      if (!mapped_is_) {
         is_.clear();  // clear fail bit, etc.
         return Seek(offset);
-      } else {
-        is_.close();  // don't bother checking error status of is_.
-        filename_ = tmp_filename;
-        is_.open(MapOsPath(filename_).c_str(),
-                 binary ? std::ios_base::in | std::ios_base::binary
-                        : std::ios_base::in);
-        if (!is_.is_open()) return false;
-        else
-          return Seek(offset);
       }
     } else {
-      size_t offset;
-      SplitFilename(rxfilename, &filename_, &offset);
+      CloseInternal();
+      filename_ = filename;
       binary_ = binary;
-      is_.open(MapOsPath(filename_).c_str(),
-                binary ? std::ios_base::in | std::ios_base::binary
-                      : std::ios_base::in);
-      if (!is_.is_open()) return false;
-      else
-        return Seek(offset);
     }
+    // Text and binary mode only differ on Windows, where the cache does not
+    // map files.
+    std::shared_ptr<const MappedFile> mapped =
+        MappedFileCache::Instance().Get(MapOsPath(filename_));
+    // Reading a mapping past the current end of the file raises SIGBUS, so
+    // if the file was truncated after Get() looked at it, read it normally.
+    if (mapped && !mapped->InRange(0, mapped->Size()))
+      mapped.reset();
+    if (mapped) {
+      if (mapped != mapped_) {
+        mapped_is_.reset();
+        mapped_ = mapped;
+        mapped_buf_.reset(new MemoryStreamBuf(mapped_));
+        mapped_is_.reset(new std::istream(mapped_buf_.get()));
+      }
+      return Seek(offset);
+    }
+    CloseInternal();
+    is_.open(MapOsPath(filename_).c_str(),
+             binary ? std::ios_base::in | std::ios_base::binary
+                    : std::ios_base::in);
+    if (!is_.is_open()) return false;
+    else
+      return Seek(offset);
   }
 
   virtual std::istream &Stream() {
-    if (!is_.is_open())
+    if (!IsOpen())
       KALDI_ERR << "FileInputImpl::Stream(), file is not open.";
     // I believe this error can only arise from coding error.
+    if (mapped_is_) return *mapped_is_;
     return is_;
   }
 
   virtual int32 Close() {
-    if (!is_.is_open())
+    if (!IsOpen())
       KALDI_ERR << "FileInputImpl::Close(), file is not open.";
     // I believe this error can only arise from coding error.
-    is_.close();
+    CloseInternal();
     // Don't check status.
     return 0;
   }
@@ -656,9 +678,24 @@ class OffsetFileInputImpl: public InputImplBase {
     // whether it fails.
   }
  private:
+  bool IsOpen() const { return mapped_is_ || is_.is_open(); }
+
+  void CloseInternal() {
+    mapped_is_.reset();
+    mapped_buf_.reset();
+    mapped_.reset();
+    if (is_.is_open())
+      is_.close();
+  }
+
   std::string filename_;  // the actual filename
   bool binary_;  // true if was opened in binary mode.
-  std::ifstream is_;
+  std::ifstream is_;  // used if the file could not be mapped.
+  // The following are used if the file is mapped; mapped_is_ reads from
+  // mapped_buf_, which refers to the memory of mapped_.
+  std::shared_ptr<const MappedFile> mapped_;
+  std::unique_ptr<MemoryStreamBuf> mapped_buf_;
+  std::unique_ptr<std::istream> mapped_is_;
 };
 
 
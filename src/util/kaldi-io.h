@@ -69,6 +69,9 @@ class InputImplBase;  // Forward decl; defined in a .cc file
 // (4) An offset into a file, e.g.: "/mnt/blah/data/1.ark:24871"
 //   [these are created by the Table and TableWriter classes; I may also write
 //    a program that creates them for arbitrary files]
+//   Files read this way are kept memory-mapped in a process-wide LRU cache
+//   (see MappedFileCache in kaldi-mmap.h), so reading from many archives in
+//   a random order is cheap.
 //
 
 
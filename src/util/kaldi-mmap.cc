@@ -0,0 +1,217 @@
+// util/kaldi-mmap.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/kaldi-mmap.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace kaldi {
+
+// Data() must be non-NULL for an open but empty file.
+static const char kEmptyFile[1] = { '\0' };
+
+bool MappedFile::Open(const std::string &filename) {
+  Close();
+#ifndef _MSC_VER
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1) {
+    KALDI_WARN << "Could not open " << filename << " for reading: "
+               << strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    KALDI_WARN << "Could not map " << filename
+               << ": not a regular file, or could not stat it.";
+    close(fd);
+    return false;
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ == 0) {
+    close(fd);
+    data_ = kEmptyFile;
+    return true;
+  }
+  void *addr = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    KALDI_WARN << "Failed to mmap " << filename << ": " << strerror(errno);
+    close(fd);
+    size_ = 0;
+    return false;
+  }
+  // The mapping would stay valid if we closed the fd, but we keep it so that
+  // CurrentSize() can check the size of the file we mapped.
+  fd_ = fd;
+  data_ = static_cast<const char*>(addr);
+  is_mapped_ = true;
+  return true;
+#else
+  std::ifstream is(filename.c_str(), std::ios::binary);
+  if (!is.is_open()) {
+    KALDI_WARN << "Could not open " << filename << " for reading.";
+    return false;
+  }
+  buffer_.assign(std::istreambuf_iterator<char>(is),
+                 std::istreambuf_iterator<char>());
+  size_ = buffer_.size();
+  data_ = (size_ == 0 ? kEmptyFile : &(buffer_[0]));
+  return true;
+#endif
+}
+
+void MappedFile::Close() {
+#ifndef _MSC_VER
+  if (is_mapped_)
+    munmap(const_cast<char*>(data_), size_);
+  if (fd_ != -1)
+    close(fd_);
+  fd_ = -1;
+#endif
+  data_ = NULL;
+  size_ = 0;
+  is_mapped_ = false;
+  std::vector<char> empty;
+  buffer_.swap(empty);
+}
+
+size_t MappedFile::CurrentSize() const {
+#ifndef _MSC_VER
+  if (is_mapped_) {
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+      KALDI_WARN << "fstat() failed on mapped file: " << strerror(errno);
+      return 0;
+    }
+    return static_cast<size_t>(st.st_size);
+  }
+#endif
+  return size_;
+}
+
+bool MappedFile::InRange(size_t offset, size_t length) const {
+  if (offset > size_ || length > size_ - offset)
+    return false;
+  return offset + length <= CurrentSize();
+}
+
+
+MemoryStreamBuf::MemoryStreamBuf(const char *data, size_t size) {
+  char *begin = const_cast<char*>(data);
+  setg(begin, begin, begin + size);
+}
+
+MemoryStreamBuf::MemoryStreamBuf(const std::shared_ptr<const MappedFile> &file):
+    file_(file) {
+  char *begin = const_cast<char*>(file->Data());
+  setg(begin, begin, begin + file->Size());
+}
+
+MemoryStreamBuf::pos_type MemoryStreamBuf::seekoff(
+    off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+  if (which & std::ios_base::out)
+    return pos_type(off_type(-1));
+  char *target;
+  if (dir == std::ios_base::beg) target = eback() + off;
+  else if (dir == std::ios_base::cur) target = gptr() + off;
+  else target = egptr() + off;
+  if (target < eback() || target > egptr())
+    return pos_type(off_type(-1));
+  setg(eback(), target, egptr());
+  return pos_type(target - eback());
+}
+
+MemoryStreamBuf::pos_type MemoryStreamBuf::seekpos(
+    pos_type pos, std::ios_base::openmode which) {
+  return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+std::streamsize MemoryStreamBuf::showmanyc() {
+  std::streamsize ans = egptr() - gptr();
+  return (ans == 0 ? -1 : ans);
+}
+
+MappedFileCache &MappedFileCache::Instance() {
+  static MappedFileCache cache(64);
+  return cache;
+}
+
+std::shared_ptr<const MappedFile> MappedFileCache::Get(
+    const std::string &filename) {
+#ifdef _MSC_VER
+  // MappedFile would read the whole file into memory.
+  return std::shared_ptr<const MappedFile>();
+#else
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (capacity_ <= 0)
+    return std::shared_ptr<const MappedFile>();
+  struct stat st;
+  if (stat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+    return std::shared_ptr<const MappedFile>();
+  std::unordered_map<std::string, ListType::iterator>::iterator
+      iter = map_.find(filename);
+  if (iter != map_.end()) {
+    Entry &entry = *(iter->second);
+    if (entry.device == static_cast<uint64>(st.st_dev) &&
+        entry.inode == static_cast<uint64>(st.st_ino) &&
+        entry.size == static_cast<uint64>(st.st_size)) {
+      list_.splice(list_.begin(), list_, iter->second);
+      return entry.file;
+    }
+    // The file was replaced or changed size: map it again.
+    list_.erase(iter->second);
+    map_.erase(iter);
+  }
+  std::shared_ptr<MappedFile> file(new MappedFile());
+  if (!file->Open(filename))
+    return std::shared_ptr<const MappedFile>();
+  Entry entry;
+  entry.filename = filename;
+  entry.file = file;
+  entry.device = st.st_dev;
+  entry.inode = st.st_ino;
+  entry.size = st.st_size;
+  list_.push_front(entry);
+  map_[filename] = list_.begin();
+  Trim();
+  return file;
+#endif
+}
+
+void MappedFileCache::SetCapacity(int32 capacity) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  capacity_ = capacity;
+  Trim();
+}
+
+void MappedFileCache::Trim() {
+  while (list_.size() > static_cast<size_t>(std::max<int32>(capacity_, 0))) {
+    map_.erase(list_.back().filename);
+    list_.pop_back();
+  }
+}
+
+}  // namespace kaldi
@@ -0,0 +1,184 @@
+// util/kaldi-mmap.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_KALDI_MMAP_H_
+#define KALDI_UTIL_KALDI_MMAP_H_
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/// This class maps a whole regular file into memory, read-only.  The pages
+/// are loaded by the operating system as they are accessed and can be
+/// discarded by it under memory pressure, so mapping a large file does not
+/// by itself use much memory.  On platforms without mmap() the file is read
+/// into memory instead.
+///
+/// Note: if the file is truncated while it is mapped, reading the part of the
+/// mapping that is now past the end of the file raises SIGBUS, which kills
+/// the program.  Code that reads from a mapping some time after it was made
+/// should check the range it is about to read with InRange(), which looks at
+/// the current size of the file, and read the file in the normal way (or fail)
+/// if that returns false.  This cannot protect against a truncation that
+/// happens during the read itself, so archives must not be truncated or
+/// rewritten in place while they are being read (replacing them, e.g. with
+/// "mv", is safe).
+class MappedFile {
+ public:
+  MappedFile(): data_(NULL), size_(0), is_mapped_(false), fd_(-1) { }
+
+  /// Maps the file 'filename', which must be a regular file (not a pipe or
+  /// similar).  Returns false and prints a warning on failure.
+  bool Open(const std::string &filename);
+
+  bool IsOpen() const { return data_ != NULL; }
+
+  void Close();
+
+  /// Returns a pointer to the start of the file's contents.
+  const char *Data() const { return data_; }
+
+  /// Returns the size of the file in bytes, when it was mapped.
+  size_t Size() const { return size_; }
+
+  /// Returns the current size of the mapped file, from fstat() (so if the
+  /// file has been replaced, this is the size of the file we mapped, not of
+  /// its replacement).  Returns Size() if the file is not actually mapped.
+  size_t CurrentSize() const;
+
+  /// Returns true if the bytes [offset, offset + length) are in the mapping
+  /// and in the file as it currently is, i.e. if reading them cannot raise
+  /// SIGBUS (unless the file is truncated in the meantime).
+  bool InRange(size_t offset, size_t length) const;
+
+  ~MappedFile() { Close(); }
+
+ private:
+  const char *data_;
+  size_t size_;
+  bool is_mapped_;  // true if data_ came from mmap(), false if it points to
+                    // buffer_ (or to a static empty string, for empty files).
+  int fd_;  // the mapped file, kept open for CurrentSize(); -1 if not mapped.
+  std::vector<char> buffer_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+
+/// A read-only, seekable stream buffer over a range of memory, e.g. part of a
+/// MappedFile, so that objects can be read from it with their usual Read()
+/// functions without copying the data.  Positions are relative to 'data'.
+/// Example:
+/// \code
+///   MemoryStreamBuf buf(mapped_file.Data(), mapped_file.Size());
+///   std::istream is(&buf);
+///   is.seekg(offset);
+///   mat.Read(is, true);
+/// \endcode
+/// Code that reads objects can check whether the stream it reads from has a
+/// MemoryStreamBuf with a file (using dynamic_cast on is.rdbuf()), and if so
+/// point into the file's memory instead of copying the data; see MatrixView.
+class MemoryStreamBuf: public std::streambuf {
+ public:
+  MemoryStreamBuf(const char *data, size_t size);
+
+  /// Reads the whole of 'file', and shares ownership of it, so that objects
+  /// that point into its memory can keep it mapped (see File()).
+  explicit MemoryStreamBuf(const std::shared_ptr<const MappedFile> &file);
+
+  /// Returns the file this reads from, if it was constructed from one, else
+  /// NULL.
+  const std::shared_ptr<const MappedFile> &File() const { return file_; }
+
+  /// Returns a pointer to the current read position.
+  const char *CurrentPointer() const { return gptr(); }
+
+  /// Returns the number of bytes between the current read position and the
+  /// end of the memory range.
+  size_t BytesRemaining() const { return egptr() - gptr(); }
+
+ protected:
+  virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                           std::ios_base::openmode which);
+  virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+  virtual std::streamsize showmanyc();
+ private:
+  std::shared_ptr<const MappedFile> file_;
+};
+
+
+/// MappedFileCache keeps up to a fixed number of files memory-mapped, with
+/// least-recently-used eviction, so that repeated reads from the same set of
+/// files (e.g. "ark:offset" entries from an scp file, in whatever order) need
+/// no open(), seek or read system calls; see OffsetFileInputImpl in
+/// kaldi-io.cc, which uses the process-wide instance.  It is thread safe, and
+/// a MappedFile stays valid for as long as a caller holds a pointer to it,
+/// even after it has been evicted.  Each call to Get() stat()s the file, so a
+/// file that has been replaced or has changed size is mapped again; but see
+/// the note on MappedFile about files that are truncated while they are being
+/// read.
+class MappedFileCache {
+ public:
+  explicit MappedFileCache(int32 capacity): capacity_(capacity) { }
+
+  /// The process-wide cache.  Its default capacity is 64 files.
+  static MappedFileCache &Instance();
+
+  /// Returns the mapping of 'filename', mapping it if it is not in the cache
+  /// or if the file has been replaced or has changed size since it was
+  /// mapped.  Returns NULL if the file cannot be mapped (e.g. it does not
+  /// exist or is not a regular file), or if the capacity is zero or mmap()
+  /// is not supported on this platform; callers should then fall back to
+  /// reading the file in the normal way.
+  std::shared_ptr<const MappedFile> Get(const std::string &filename);
+
+  /// Sets the maximum number of files kept mapped (0 disables the cache).
+  void SetCapacity(int32 capacity);
+
+  void Clear() { SetCapacity(0); }
+
+ private:
+  struct Entry {
+    std::string filename;
+    std::shared_ptr<const MappedFile> file;
+    // These identify the version of the file that was mapped.  Because the
+    // mapping is shared, a file that is rewritten in place at the same size
+    // is seen correctly through the existing mapping.
+    uint64 device, inode, size;
+  };
+  typedef std::list<Entry> ListType;  // most recently used first.
+
+  // Removes entries from the back of the list until there are at most
+  // capacity_ entries.  Requires mutex_ to be held.
+  void Trim();
+
+  std::mutex mutex_;
+  int32 capacity_;
+  ListType list_;
+  std::unordered_map<std::string, ListType::iterator> map_;
+};
+
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_KALDI_MMAP_H_
@@ -24,6 +24,9 @@
 #define KALDI_UTIL_KALDI_TABLE_INL_H_
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <utility>
@@ -34,6 +37,7 @@
 #include "util/text-utils.h"
 #include "util/stl-utils.h"  // for StringHasher.
 #include "util/kaldi-semaphore.h"
+#include "util/kaldi-thread.h"
 
 
 namespace kaldi {
@@ -182,7 +186,8 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
       state_ = kHaveScpLine;
     } else if (state_ == kHaveRange) {
       range_holder_.Clear();
-      state_ = kHaveObject;
+      holder_.Clear();
+      state_ = kHaveScpLine;
     } else {
       KALDI_WARN << "FreeCurrent called at the wrong time.";
     }
@@ -200,8 +205,9 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
       state_ = kHaveScpLine;
     } else if (state_ == kHaveRange) {
       range_holder_.Swap(other_holder);
-      state_ = kHaveObject;
-      // This indicates that we still have the base object (but no range).
+      // holder_ may not contain the whole object (see ReadHolderRange()),
+      // so we don't try to reuse it.
+      state_ = kHaveScpLine;
     } else {
       KALDI_ERR << "Code error";
     }
@@ -310,6 +316,19 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
         KALDI_WARN << "Failed to open file "
                    << PrintableRxfilename(data_rxfilename_);
         return false;
+      } else if (!range_.empty()) {
+        // Read just the range, if the holder supports that.
+        if (ReadHolderRange(data_input_.Stream(), range_,
+                            &holder_, &range_holder_)) {
+          state_ = kHaveRange;
+          return true;
+        } else {
+          KALDI_WARN << "Failed to load object from "
+                     << PrintableRxfilename(data_rxfilename_)
+                     << "[" << range_ << "]";
+          holder_.Clear();
+          return false;
+        }
       } else {
         if (holder_.Read(data_input_.Stream())) {
           state_ = kHaveObject;
@@ -361,8 +380,10 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
   void NextScpLine() {
     switch (state_) {  // Check and simplify the state.
       case kHaveRange:
+        // holder_ may not contain the whole object (see ReadHolderRange()).
         range_holder_.Clear();
-        state_ = kHaveObject;
+        holder_.Clear();
+        state_ = kHaveScpLine;
         break;
       case kHaveScpLine: case kHaveObject: case kFileStart: break;
       default:
@@ -462,8 +483,9 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
     kError,         // no  no  no  no            Error reading or parsing script file.
     kHaveScpLine,   // no  no  yes yes           Have a line of the script file but nothing else.
     kHaveObject,    // yes no  yes yes           holder_ contains an object but range_holder_ does not.
-    kHaveRange,     // yes yes yes yes           we have the range object in range_holder_ (implies
-                    //                           range_ nonempty).
+    kHaveRange,     // ?   yes yes yes           we have the range object in range_holder_ (implies
+                    //                           range_ nonempty).  holder_ contains the whole object
+                    //                           only if the range was extracted from it.
   } state_;
 
 
@@ -933,6 +955,7 @@ template<class Holder>
 typename SequentialTableReader<Holder>::T &
 SequentialTableReader<Holder>::Value() {
   CheckImpl();
+  KALDI_TRACE_SCOPE("SequentialTableReader::Value");
   return impl_->Value();  // This may throw (if EnsureObjectLoaded() returned false you
                           // are safe.).
 }
@@ -941,6 +964,7 @@ SequentialTableReader<Holder>::Value() {
 template<class Holder>
 void SequentialTableReader<Holder>::Next() {
   CheckImpl();
+  KALDI_TRACE_SCOPE("SequentialTableReader::Next");
   impl_->Next();
 }
 
@@ -959,6 +983,18 @@ SequentialTableReader<Holder>::~SequentialTableReader() {
 
 
 
+// Writing a copy of an object (see TableWriterBackgroundImpl) needs a type
+// that can be constructed from a const T&.  MatrixBase and VectorBase (which are what the
+// standard matrix and vector writers write) can't be, so we use Matrix and
+// Vector for them.
+template<class T> struct TableWriterCopyType { typedef T Type; };
+template<class Real> struct TableWriterCopyType<MatrixBase<Real> > {
+  typedef Matrix<Real> Type;
+};
+template<class Real> struct TableWriterCopyType<VectorBase<Real> > {
+  typedef Vector<Real> Type;
+};
+
 template<class Holder> class TableWriterImplBase {
  public:
   typedef typename Holder::T T;
@@ -973,6 +1009,16 @@ template<class Holder> class TableWriterImplBase {
   // TableWriter::Write returned an exit status.
   virtual bool Write(const std::string &key, const T &value) = 0;
 
+  // Calls prepare() on *value, which modifies it in place, and writes it (this
+  // is used for compression, see TableWriter::WriteCompressed()).  The
+  // background writer overrides this to take a copy, on which prepare() is
+  // called in a worker thread; *value is then left unchanged.
+  virtual bool Write(const std::string &key, T *value,
+                     void (*prepare)(T*)) {
+    prepare(value);
+    return Write(key, *value);
+  }
+
   // Flush will flush any archive; it does not return error status,
   //  any errors will be reported on the next Write or Close.
   virtual void Flush() = 0;
@@ -990,6 +1036,28 @@ template<class Holder> class TableWriterImplBase {
 };
 
 
+// Used by the archive writers in binary mode with the "align" option, before
+// writing 'key': if the data of 'value' can be used in place when aligned (see
+// HolderDataAlignment() in kaldi-holder-inl.h), writes as many newlines as are
+// needed for it to be aligned in the file, so that readers of memory-mapped
+// archives (see MatrixView) don't have to copy it.  Archive readers skip whitespace before
+// keys.  Does nothing if we can't get the position in the stream, e.g. for
+// pipes.
+template<class Holder>
+void WriteArchivePadding(std::ostream &os, const std::string &key,
+                         const typename Holder::T &value) {
+  int32 header_size, alignment;
+  if (!HolderDataAlignment(value, static_cast<const Holder*>(NULL),
+                           &header_size, &alignment))
+    return;
+  int64 pos = static_cast<int64>(os.tellp());
+  if (pos < 0)
+    return;
+  int64 data_pos = pos + key.size() + 1 + header_size;
+  for (int32 i = (alignment - data_pos % alignment) % alignment; i > 0; i--)
+    os.put('\n');
+}
+
 // The implementation of TableWriter we use when writing directly
 // to an archive with no associated scp.
 template<class Holder>
@@ -1014,6 +1082,13 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
                                            NULL,
                                            &opts_);
     KALDI_ASSERT(ws == kArchiveWspecifier);  // or wrongly called.
+    if (opts_.index && ClassifyWxfilename(archive_wxfilename_) != kFileOutput) {
+      KALDI_WARN << "The idx option requires the archive to be an actual "
+                 << "file: wspecifier = " << wspecifier;
+      state_ = kUninitialized;
+      return false;
+    }
+    index_entries_.clear();
 
     if (output_.Open(archive_wxfilename_, opts_.binary, false)) {  // false
                                                       // means no binary header.
@@ -1052,8 +1127,14 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
     // state is now kOpen or kWriteError.
     if (!IsToken(key))  // e.g. empty string or has spaces...
       KALDI_ERR << "Using invalid key " << key;
+    if (opts_.binary && opts_.align)
+      WriteArchivePadding<Holder>(output_.Stream(), key, value);
     output_.Stream() << key << ' ';
-    if (!Holder::Write(output_.Stream(), opts_.binary, value)) {
+    if (opts_.index)
+      index_entries_.push_back(std::pair<std::string, int64>(
+          key, static_cast<int64>(output_.Stream().tellp())));
+    if (!WriteHolderObject(output_.Stream(), opts_.binary, opts_.packed, value,
+                           static_cast<const Holder*>(NULL))) {
       KALDI_WARN << "Write failure to "
                  << PrintableWxfilename(archive_wxfilename_);
       state_ = kWriteError;
@@ -1084,6 +1165,8 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
     if (!this->IsOpen() || !output_.IsOpen())
       KALDI_ERR << "Close called on a stream that was not open."
                 << this->IsOpen() << ", " << output_.IsOpen();
+    int64 archive_size = (opts_.index ?
+                          static_cast<int64>(output_.Stream().tellp()) : -1);
     bool close_success = output_.Close();
     if (!close_success) {
       KALDI_WARN << "Error closing stream: wspecifier is " << wspecifier_;
@@ -1097,6 +1180,12 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
       return false;
     }
     state_ = kUninitialized;
+    if (opts_.index && !WriteArchiveIndex(archive_wxfilename_ + ".idx",
+                                          archive_size, &index_entries_)) {
+      KALDI_WARN << "Error writing archive index: wspecifier is "
+                 << wspecifier_;
+      return false;
+    }
     return true;
   }
 
@@ -1115,6 +1204,8 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
   WspecifierOptions opts_;
   std::string wspecifier_;
   std::string archive_wxfilename_;
+  // (key, offset) pairs for the index, if opts_.index.
+  std::vector<std::pair<std::string, int64> > index_entries_;
   enum {               // is stream open?
     kUninitialized,    // no
     kOpen,             // yes
@@ -1216,7 +1307,8 @@ class TableWriterScriptImpl: public TableWriterImplBase<Holder> {
                  << PrintableWxfilename(wxfilename);
       return false;
     }
-    if (!Holder::Write(output.Stream(), opts_.binary, value)
+    if (!WriteHolderObject(output.Stream(), opts_.binary, opts_.packed, value,
+                           static_cast<const Holder*>(NULL))
         || !output.Close()) {
       KALDI_WARN << "Failed to write data to "
                  << PrintableWxfilename(wxfilename);
@@ -1311,6 +1403,13 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
       KALDI_WARN << "When writing to both archive and script, the script file "
           "will generally not be interpreted correctly unless the archive is "
           "an actual file: wspecifier = " << wspecifier;
+    if (opts_.index && ClassifyWxfilename(archive_wxfilename_) != kFileOutput) {
+      KALDI_WARN << "The idx option requires the archive to be an actual "
+                 << "file: wspecifier = " << wspecifier;
+      state_ = kUninitialized;
+      return false;
+    }
+    index_entries_.clear();
 
     if (!archive_output_.Open(archive_wxfilename_, opts_.binary, false)) {
       // false means no binary header.
@@ -1367,6 +1466,8 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
     if (!IsToken(key))  // e.g. empty string or has spaces...
       KALDI_ERR << "Using invalid key " << key;
     std::ostream &archive_os = archive_output_.Stream();
+    if (opts_.binary && opts_.align)
+      WriteArchivePadding<Holder>(archive_os, key, value);
     archive_os << key << ' ';
     typename std::ostream::pos_type archive_os_pos = archive_os.tellp();
     // position at start of Write() to archive.  We will record this in the
@@ -1374,6 +1475,9 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
     std::string offset_rxfilename;  // rxfilename with offset into the archive,
     // e.g. some_archive_name.ark:431541423
     MakeFilename(archive_os_pos, &offset_rxfilename);
+    if (opts_.index)
+      index_entries_.push_back(std::pair<std::string, int64>(
+          key, static_cast<int64>(archive_os_pos)));
 
     // Write to the script file first.
     // The idea is that we want to get all the information possible into the
@@ -1381,7 +1485,9 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
     std::ostream &script_os = script_output_.Stream();
     script_output_.Stream() << key << ' ' << offset_rxfilename << '\n';
 
-    if (!Holder::Write(archive_output_.Stream(), opts_.binary, value)) {
+    if (!WriteHolderObject(archive_output_.Stream(), opts_.binary,
+                           opts_.packed, value,
+                           static_cast<const Holder*>(NULL))) {
       KALDI_WARN << "Write failure to"
                  << PrintableWxfilename(archive_wxfilename_);
       state_ = kWriteError;
@@ -1428,12 +1534,23 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
     if (!this->IsOpen())
       KALDI_ERR << "Close called on a stream that was not open.";
     bool close_success = true;
-    if (archive_output_.IsOpen())
+    int64 archive_size = -1;
+    if (archive_output_.IsOpen()) {
+      if (opts_.index)
+        archive_size = static_cast<int64>(archive_output_.Stream().tellp());
       if (!archive_output_.Close()) close_success = false;
+    }
     if (script_output_.IsOpen())
       if (!script_output_.Close()) close_success = false;
     bool ans = close_success && (state_ != kWriteError);
     state_ = kUninitialized;
+    if (ans && opts_.index &&
+        !WriteArchiveIndex(archive_wxfilename_ + ".idx", archive_size,
+                           &index_entries_)) {
+      KALDI_WARN << "Error writing archive index: wspecifier is "
+                 << wspecifier_;
+      ans = false;
+    }
     return ans;
   }
 
@@ -1455,6 +1572,8 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
   std::string archive_wxfilename_;
   std::string script_wxfilename_;
   std::string wspecifier_;
+  // (key, offset) pairs for the index, if opts_.index.
+  std::vector<std::pair<std::string, int64> > index_entries_;
   enum {               // is stream open?
     kUninitialized,    // no
     kOpen,             // yes
@@ -1463,6 +1582,181 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
 };
 
 
+// TableWriterSerializedHolder is a minimal Holder, only for use with the
+// TableWriter implementation classes, for objects that were already
+// serialized by some Holder's Write() function (including the binary-mode
+// header, if any); it writes them out unchanged.
+class TableWriterSerializedHolder {
+ public:
+  typedef std::string T;
+  static bool Write(std::ostream &os, bool binary, const T &t) {
+    os.write(t.data(), t.size());
+    return os.good();
+  }
+};
+
+
+// This is the implementation of TableWriter for the "bg" (background) option.
+// Worker threads serialize (and optionally prepare, e.g. compress) the objects
+// into strings, using TaskSequencer, which runs the destructors of the tasks
+// in the order they were submitted; the destructors hand the strings to an
+// ordinary archive/script writer ('base_writer_') for
+// TableWriterSerializedHolder, which writes them out.  Because each task holds
+// a copy of its object, the number of tasks in flight bounds the memory used;
+// TaskSequencer::Run() blocks when there are too many.
+template<class Holder>
+class TableWriterBackgroundImpl: public TableWriterImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  TableWriterBackgroundImpl(): base_writer_(NULL), sequencer_(NULL),
+                               error_(false) { }
+
+  virtual bool Open(const std::string &wspecifier) {
+    KALDI_ASSERT(base_writer_ == NULL);
+    WspecifierType ws = ClassifyWspecifier(wspecifier, NULL, NULL, &opts_);
+    switch (ws) {
+      case kBothWspecifier:
+        base_writer_ = new TableWriterBothImpl<TableWriterSerializedHolder>();
+        break;
+      case kArchiveWspecifier:
+        base_writer_ =
+            new TableWriterArchiveImpl<TableWriterSerializedHolder>();
+        break;
+      case kScriptWspecifier:
+        base_writer_ =
+            new TableWriterScriptImpl<TableWriterSerializedHolder>();
+        break;
+      case kNoWspecifier: default:
+        KALDI_ERR << "Invalid wspecifier " << wspecifier;  // code error.
+    }
+    if (!base_writer_->Open(wspecifier)) {
+      delete base_writer_;
+      base_writer_ = NULL;
+      return false;
+    }
+    TaskSequencerConfig config;
+    config.num_threads = opts_.num_background_threads;
+    config.num_threads_total = opts_.num_background_threads +
+        kNumExtraQueued;
+    sequencer_ = new TaskSequencer<WriteTask>(config);
+    error_ = false;
+    return true;
+  }
+
+  virtual bool IsOpen() const { return base_writer_ != NULL; }
+
+  virtual bool Write(const std::string &key, const T &value) {
+    return WriteCopy(key, value, NULL);
+  }
+
+  virtual bool Write(const std::string &key, T *value,
+                     void (*prepare)(T*)) {
+    return WriteCopy(key, *value, prepare);
+  }
+
+  // Waits for the objects written so far to be written, and flushes.
+  virtual void Flush() {
+    KALDI_ASSERT(IsOpen());
+    sequencer_->Wait();
+    base_writer_->Flush();
+  }
+
+  virtual bool Close() {
+    KALDI_ASSERT(IsOpen());
+    sequencer_->Wait();
+    delete sequencer_;
+    sequencer_ = NULL;
+    bool ans = base_writer_->Close();
+    delete base_writer_;
+    base_writer_ = NULL;
+    return ans && !error_;
+  }
+
+  virtual ~TableWriterBackgroundImpl() {
+    // TableWriter calls Close() before deleting this.
+    KALDI_ASSERT(base_writer_ == NULL && sequencer_ == NULL);
+  }
+
+ private:
+  // Queues a copy of 'value' to be written; if 'prepare' is not NULL it is
+  // called on the copy in a worker thread, before it is serialized.
+  bool WriteCopy(const std::string &key, const T &value,
+                 void (*prepare)(T*)) {
+    KALDI_ASSERT(IsOpen());
+    if (error_) {
+      // An earlier object failed to be written.
+      KALDI_WARN << "Attempting to write to invalid stream.";
+      return false;
+    }
+    if (!IsToken(key))  // e.g. empty string or has spaces...
+      KALDI_ERR << "Using invalid key " << key;
+    sequencer_->Run(new WriteTask(this, key, value, prepare));
+    return true;
+  }
+
+  class WriteTask {
+   public:
+    WriteTask(TableWriterBackgroundImpl<Holder> *writer,
+              const std::string &key, const T &value, void (*prepare)(T*)):
+        writer_(writer), key_(key), value_(new CopyType(value)),
+        prepare_(prepare),
+        ok_(false) { }
+
+    // This runs in a worker thread.
+    void operator () () {
+      try {
+        if (prepare_ != NULL)
+          prepare_(value_);
+        std::ostringstream os;
+        ok_ = WriteHolderObject(os, writer_->opts_.binary,
+                                writer_->opts_.packed, *value_,
+                                static_cast<const Holder*>(NULL));
+        data_ = os.str();
+      } catch (const std::exception &e) {
+        KALDI_WARN << "Exception caught preparing Table object. " << e.what();
+      }
+      delete value_;  // free the memory as soon as possible.
+      value_ = NULL;
+    }
+
+    // The destructors are called in the order the tasks were created.
+    ~WriteTask() {
+      delete value_;
+      if (writer_->error_)
+        return;  // don't write anything after an error.
+      try {
+        if (!ok_ || !writer_->base_writer_->Write(key_, data_))
+          writer_->error_ = true;
+      } catch (const std::exception &e) {
+        KALDI_WARN << "Exception caught writing Table object. " << e.what();
+        writer_->error_ = true;
+      }
+    }
+   private:
+    TableWriterBackgroundImpl<Holder> *writer_;
+    typedef typename TableWriterCopyType<T>::Type CopyType;
+    std::string key_;
+    CopyType *value_;
+    void (*prepare_)(T*);
+    bool ok_;
+    std::string data_;
+  };
+
+  // The number of objects that may be waiting, in addition to the ones being
+  // serialized by the opts_.num_background_threads threads; this bounds the
+  // memory used.
+  static const int32 kNumExtraQueued = 8;
+
+  WspecifierOptions opts_;
+  TableWriterImplBase<TableWriterSerializedHolder> *base_writer_;
+  TaskSequencer<WriteTask> *sequencer_;
+  // Set (in the destructor of a WriteTask) if an object could not be written;
+  // read by Write() and Close() in the main thread.
+  std::atomic<bool> error_;
+};
+
+
 template<class Holder>
 TableWriter<Holder>::TableWriter(const std::string &wspecifier): impl_(NULL) {
   if (wspecifier != "" && !Open(wspecifier))
@@ -1483,7 +1777,8 @@ bool TableWriter<Holder>::Open(const std::string &wspecifier) {
       KALDI_ERR << "Failed to close previously open writer.";
   }
   KALDI_ASSERT(impl_ == NULL);
-  WspecifierType wtype = ClassifyWspecifier(wspecifier, NULL, NULL, NULL);
+  WspecifierOptions opts;
+  WspecifierType wtype = ClassifyWspecifier(wspecifier, NULL, NULL, &opts);
   switch (wtype) {
     case kBothWspecifier:
       impl_ = new TableWriterBothImpl<Holder>();
@@ -1498,6 +1793,12 @@ bool TableWriter<Holder>::Open(const std::string &wspecifier) {
       KALDI_WARN << "ClassifyWspecifier: invalid wspecifier " << wspecifier;
       return false;
   }
+  if (opts.background) {
+    // TableWriterBackgroundImpl creates its own writer of the right type,
+    // for serialized objects.
+    delete impl_;
+    impl_ = new TableWriterBackgroundImpl<Holder>();
+  }
   if (impl_->Open(wspecifier)) {
     return true;
   } else {  // The class will have printed a more specific warning.
@@ -1511,12 +1812,22 @@ template<class Holder>
 void TableWriter<Holder>::Write(const std::string &key,
                                 const T &value) const {
   CheckImpl();
+  KALDI_TRACE_SCOPE("TableWriter::Write");
   if (!impl_->Write(key, value))
     KALDI_ERR << "Error in TableWriter::Write";
   // More specific warning will have
   // been printed in the Write function.
 }
 
+template<class Holder>
+void TableWriter<Holder>::WriteCompressed(const std::string &key,
+                                          T *value) const {
+  CheckImpl();
+  KALDI_TRACE_SCOPE("TableWriter::Write");
+  if (!impl_->Write(key, value, &TableWriter<Holder>::CompressObject))
+    KALDI_ERR << "Error in TableWriter::Write";
+}
+
 template<class Holder>
 void TableWriter<Holder>::Flush() {
   CheckImpl();
@@ -1745,8 +2056,11 @@ class RandomAccessTableReaderScriptImpl:
             key_ = key;
             return true;
           } else {
+            // holder_ may not contain the whole object (see ReadHolderRange()),
+            // so we don't try to reuse it.
             range_holder_.Clear();
-            state_ = kHaveObject;
+            holder_.Clear();
+            state_ = kNotHaveObject;
           }
         }
         // OK, at this point the state will be kHaveObject or kNotHaveObject.
@@ -1769,6 +2083,19 @@ class RandomAccessTableReaderScriptImpl:
             KALDI_WARN << "Error opening stream "
                        << PrintableRxfilename(data_rxfilename);
             return false;
+          } else if (!range.empty()) {
+            // Read just the range, if the holder supports that.
+            if (ReadHolderRange(input_.Stream(), range,
+                                &holder_, &range_holder_)) {
+              state_ = kHaveRange;
+              return true;
+            } else {
+              KALDI_WARN << "Failed to load object from "
+                         << PrintableRxfilename(data_rxfilename)
+                         << "[" << range << "]";
+              holder_.Clear();
+              return false;
+            }
           } else {
             if (holder_.Read(input_.Stream())) {
               state_ = kHaveObject;
@@ -1870,13 +2197,15 @@ class RandomAccessTableReaderScriptImpl:
     kNotReadScript,  //    no    no    no
     kNotHaveObject,  //    yes   no    no
     kHaveObject,     //    yes   yes   no
-    kHaveRange,      //    yes   yes   yes
+    kHaveRange,      //    yes   maybe yes
 
     // If we are in a state where holder_ contains an object, it always contains
     // the object from 'key_', and the corresponding rxfilename is always
     // 'data_rxfilename_'.  If range_holder_ contains an object, it always
-    // corresponds to the range 'range_' of the object in 'holder_', and always
-    // corresponds to the current key.
+    // corresponds to the range 'range_' of that object, and always corresponds
+    // to the current key.  In state kHaveRange, holder_ only contains the
+    // whole object if the range was extracted from it; ranges are normally
+    // read directly (see ReadHolderRange()).
   } state_;
 };
 
@@ -2504,6 +2833,137 @@ class RandomAccessTableReaderUnsortedArchiveImpl:
 
 
 
+// RandomAccessTableReaderIndexedArchiveImpl is used for archives when the
+// "idx" option is given.  It memory-maps the archive and its index (written
+// by a TableWriter with the "idx" option, see WriteArchiveIndex()), looks up
+// keys in the index and reads each object from its offset in the archive when
+// it is asked for.  Only the most recently read object is kept in memory.
+template<class Holder>
+class RandomAccessTableReaderIndexedArchiveImpl:
+      public RandomAccessTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  RandomAccessTableReaderIndexedArchiveImpl(): have_object_(false) { }
+
+  virtual bool Open(const std::string &rspecifier) {
+    if (IsOpen())
+      KALDI_ERR << "Opening already open RandomAccessTableReader:"
+                   " call Close first.";
+    rspecifier_ = rspecifier;
+    RspecifierType rs = ClassifyRspecifier(rspecifier,
+                                           &archive_rxfilename_,
+                                           &opts_);
+    KALDI_ASSERT(rs == kArchiveRspecifier && opts_.indexed);  // or wrongly
+                                                              // called.
+    if (ClassifyRxfilename(archive_rxfilename_) != kFileInput) {
+      KALDI_WARN << "The idx option requires the archive to be an actual "
+                 << "file: rspecifier = " << rspecifier;
+      return false;
+    }
+    std::shared_ptr<MappedFile> archive(new MappedFile());
+    if (!archive->Open(archive_rxfilename_) ||
+        !index_.Open(archive_rxfilename_ + ".idx", archive->Size()))
+      return false;
+    archive_ = archive;
+    buf_.reset(new MemoryStreamBuf(archive_));
+    is_.reset(new std::istream(buf_.get()));
+    have_object_ = false;
+    return true;
+  }
+
+  virtual bool IsOpen() const { return archive_ != NULL; }
+
+  virtual bool Close() {
+    if (!IsOpen())
+      KALDI_ERR << "Close() called on RandomAccessTableReader that was not"
+                   " open.";
+    holder_.Clear();
+    have_object_ = false;
+    cur_key_ = "";
+    is_.reset();
+    buf_.reset();
+    if (input_.IsOpen())
+      input_.Close();
+    index_.Close();
+    archive_.reset();
+    // Errors reading individual objects are reported when they happen.
+    return true;
+  }
+
+  virtual bool HasKey(const std::string &key) {
+    // In permissive mode we have to check that the object can be read.
+    if (opts_.permissive)
+      return ReadObject(key);
+    else
+      return (have_object_ && key == cur_key_) || index_.Lookup(key, NULL);
+  }
+
+  virtual const T &Value(const std::string &key) {
+    if (!ReadObject(key))
+      KALDI_ERR << "Value() called but no such key " << key
+                << " in archive " << PrintableRxfilename(archive_rxfilename_);
+    return holder_.Value();
+  }
+
+  virtual ~RandomAccessTableReaderIndexedArchiveImpl() { }
+
+ private:
+  // Makes sure holder_ contains the object for 'key', and returns true, or
+  // returns false if the key is not in the index or (in permissive mode) the
+  // object could not be read.
+  bool ReadObject(const std::string &key) {
+    if (have_object_ && key == cur_key_)
+      return true;
+    int64 offset;
+    if (!index_.Lookup(key, &offset))
+      return false;
+    have_object_ = false;
+    std::istream *is = is_.get();
+    is->clear();
+    if (offset >= 0 && !archive_->InRange(0, archive_->Size())) {
+      // The archive has been truncated since we mapped it, and reading the
+      // mapping past its new end would raise SIGBUS; read it normally.
+      if (input_.IsOpen())
+        input_.Close();
+      std::ostringstream rxfilename;
+      rxfilename << archive_rxfilename_ << ':' << offset;
+      is = (input_.Open(rxfilename.str()) ? &input_.Stream() : NULL);
+    }
+    if (offset < 0 || static_cast<size_t>(offset) > archive_->Size() ||
+        is == NULL || (is == is_.get() && !is->seekg(offset)) ||
+        !holder_.Read(*is)) {
+      holder_.Clear();
+      if (opts_.permissive) {
+        KALDI_WARN << "Error reading object for key " << key
+                   << " from archive " << archive_rxfilename_
+                   << " (offset " << offset << ")";
+        return false;
+      }
+      KALDI_ERR << "Error reading object for key " << key
+                << " from archive " << archive_rxfilename_
+                << " (offset " << offset << "); is the index up to date?";
+    }
+    cur_key_ = key;
+    have_object_ = true;
+    return true;
+  }
+
+  RspecifierOptions opts_;
+  std::string rspecifier_;
+  std::string archive_rxfilename_;
+  // The archive; objects read from it (e.g. MatrixView) may share ownership.
+  std::shared_ptr<const MappedFile> archive_;
+  ArchiveIndex index_;
+  std::unique_ptr<MemoryStreamBuf> buf_;
+  std::unique_ptr<std::istream> is_;
+  Input input_;  // used instead of is_ if the archive has been truncated.
+  Holder holder_;
+  std::string cur_key_;
+  bool have_object_;
+};
+
+
 template<class Holder>
 RandomAccessTableReader<Holder>::RandomAccessTableReader(const
                                                        std::string &rspecifier):
@@ -2524,7 +2984,9 @@ bool RandomAccessTableReader<Holder>::Open(const std::string &rspecifier) {
       impl_ = new RandomAccessTableReaderScriptImpl<Holder>();
       break;
     case kArchiveRspecifier:
-      if (opts.sorted) {
+      if (opts.indexed) {
+        impl_ = new RandomAccessTableReaderIndexedArchiveImpl<Holder>();
+      } else if (opts.sorted) {
         if (opts.called_sorted)  // "doubly" sorted case.
           impl_ = new RandomAccessTableReaderDSortedArchiveImpl<Holder>();
         else
@@ -2552,6 +3014,7 @@ bool RandomAccessTableReader<Holder>::HasKey(const std::string &key) {
   CheckImpl();
   if (!IsToken(key))
     KALDI_ERR << "Invalid key \"" << key << '"';
+  KALDI_TRACE_SCOPE("RandomAccessTableReader::HasKey");
   return impl_->HasKey(key);
 }
 
@@ -2560,6 +3023,7 @@ template<class Holder>
 const typename RandomAccessTableReader<Holder>::T&
 RandomAccessTableReader<Holder>::Value(const std::string &key) {
   CheckImpl();
+  KALDI_TRACE_SCOPE("RandomAccessTableReader::Value");
   return impl_->Value(key);
 }
 
@@ -16,6 +16,7 @@
 // MERCHANTABLITY OR NON-INFRINGEMENT.
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
+#include <fstream>
 #include "base/io-funcs.h"
 #include "util/kaldi-io.h"
 #include "base/kaldi-math.h"
@@ -89,6 +90,51 @@ void UnitTestReadScriptFile() {
 
 
 void UnitTestClassifyWspecifier() {
+  {
+    std::string a = "ark,scp,bg:foo.ark,foo.scp";
+    std::string ark = "x", scp = "y";
+    WspecifierOptions opts;
+    WspecifierType ans = ClassifyWspecifier(a, &ark, &scp, &opts);
+    KALDI_ASSERT(ans == kBothWspecifier && ark == "foo.ark" &&
+                 scp == "foo.scp" && opts.background == true);
+  }
+
+  {
+    std::string a = "ark,bg=4:foo.ark";
+    std::string ark = "x";
+    WspecifierOptions opts;
+    WspecifierType ans = ClassifyWspecifier(a, &ark, NULL, &opts);
+    KALDI_ASSERT(ans == kArchiveWspecifier && ark == "foo.ark" &&
+                 opts.background == true && opts.num_background_threads == 4);
+  }
+
+  {
+    std::string a = "ark,bg=0:foo.ark";
+    WspecifierType ans = ClassifyWspecifier(a, NULL, NULL, NULL);
+    KALDI_ASSERT(ans == kNoWspecifier);
+    a = "ark,bg=x:foo.ark";
+    ans = ClassifyWspecifier(a, NULL, NULL, NULL);
+    KALDI_ASSERT(ans == kNoWspecifier);
+  }
+
+  {
+    std::string a = "ark,packed:foo.ark";
+    std::string ark = "x", scp = "y";
+    WspecifierOptions opts;
+    WspecifierType ans = ClassifyWspecifier(a, &ark, &scp, &opts);
+    KALDI_ASSERT(ans == kArchiveWspecifier && ark == "foo.ark" &&
+                 opts.packed == true && opts.background == false);
+  }
+
+  {
+    std::string a = "ark,idx:foo.ark";
+    std::string ark = "x", scp = "y";
+    WspecifierOptions opts;
+    WspecifierType ans = ClassifyWspecifier(a, &ark, &scp, &opts);
+    KALDI_ASSERT(ans == kArchiveWspecifier && ark == "foo.ark" && scp == "" &&
+                 opts.index == true);
+  }
+
   {
     std::string a = "b,ark:|foo";
     std::string ark = "x", scp = "y";
@@ -175,6 +221,15 @@ void UnitTestClassifyWspecifier() {
 
 
 void UnitTestClassifyRspecifier() {
+  {
+    std::string a = "idx,ark:foo.ark";
+    std::string fname = "x";
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &fname, &opts);
+    KALDI_ASSERT(ans == kArchiveRspecifier && fname == "foo.ark" &&
+                 opts.indexed);
+  }
+
   {
     std::string a = "ark:foo|";
     std::string fname = "x";
@@ -969,6 +1024,171 @@ void UnitTestRangesMatrix(bool binary) {
   unlink("tmpf_ranges.scp");
 }
 
+static void ReadFileToString(const std::string &filename, std::string *data) {
+  std::ifstream is(filename.c_str(), std::ios::binary);
+  KALDI_ASSERT(is.good());
+  data->assign(std::istreambuf_iterator<char>(is),
+               std::istreambuf_iterator<char>());
+}
+
+// Writes the same objects with and without the "bg" option and checks that
+// the output is the same.
+void UnitTestTableBackgroundWriter(bool binary, bool both) {
+  std::vector<std::string> keys;
+  std::vector<GeneralMatrix> mats;
+  int32 num_mats = RandInt(0, 30);
+  for (int32 i = 0; i < num_mats; i++) {
+    std::ostringstream key;
+    key << "key" << i;
+    keys.push_back(key.str());
+    Matrix<BaseFloat> mat(RandInt(1, 20), RandInt(1, 10));
+    mat.SetRandn();
+    mats.push_back(GeneralMatrix(mat));
+  }
+  std::string opts = std::string(binary ? "b" : "t") + (both ? ",ark,scp" :
+                                                         ",ark");
+  for (int32 bg = 0; bg < 2; bg++) {
+    std::string bg_opt = (RandInt(0, 1) == 0 ? ",bg:" : ",bg=4:"),
+        wspecifier = opts + (bg ? bg_opt : ":") + "tmpf" +
+        std::string(bg ? "_bg" : "") + (both ? ",tmpf.scp" : "");
+    GeneralMatrixWriter writer(wspecifier);
+    for (int32 i = 0; i < num_mats; i++) {
+      if (i % 2 == 0) {
+        GeneralMatrix mat(mats[i]);  // WriteCompressed() may compress it.
+        writer.WriteCompressed(keys[i], &mat);
+      } else {
+        writer.Write(keys[i], mats[i]);
+      }
+      if (i == num_mats / 2) writer.Flush();
+    }
+    KALDI_ASSERT(writer.Close());
+  }
+  std::string data, data_bg;
+  ReadFileToString("tmpf", &data);
+  ReadFileToString("tmpf_bg", &data_bg);
+  KALDI_ASSERT(data == data_bg);
+
+  SequentialGeneralMatrixReader reader("ark:tmpf_bg");
+  int32 i = 0;
+  for (; !reader.Done(); reader.Next(), i++) {
+    KALDI_ASSERT(reader.Key() == keys[i]);
+    if (binary)  // text mode doesn't keep matrices compressed.
+      KALDI_ASSERT(reader.Value().Type() ==
+                   (i % 2 == 0 ? kCompressedMatrix : kFullMatrix));
+  }
+  KALDI_ASSERT(i == num_mats);
+  unlink("tmpf");
+  unlink("tmpf_bg");
+  unlink("tmpf.scp");
+}
+
+// Tests reading ranges of compressed and uncompressed matrices from scp
+// files, where only the rows that are needed are read.  'mode' is 0 for scp
+// lines like foo.ark:1234[...], 1 for single-object files and 2 for pipes
+// (which can't seek).
+void UnitTestRangesCompressedMatrix(int32 mode) {
+  int32 num_mats = 6;
+  std::vector<Matrix<BaseFloat> > mats;  // what we expect to read.
+  std::vector<std::string> rxfilenames;
+  {
+    BaseFloatMatrixWriter mat_writer("ark,scp,b:tmpf,tmpf.scp");
+    CompressedMatrixWriter cmat_writer("ark,scp,b:tmpf2,tmpf2.scp");
+    CompressionMethod methods[] = { kSpeechFeature, kTwoByteAuto,
+                                    kOneByteAuto };
+    for (int32 i = 0; i < num_mats; i++) {
+      Matrix<BaseFloat> mat(RandInt(1, 30), RandInt(1, 10));
+      mat.SetRandn();
+      std::string key(1, 'A' + i);
+      std::ostringstream filename;
+      filename << "tmpf_" << i;
+      if (i < 3) {
+        CompressedMatrix cmat(mat, methods[i]);
+        cmat_writer.Write(key, cmat);
+        WriteKaldiObject(cmat, filename.str(), true);
+        cmat.CopyToMat(&mat);
+      } else {
+        mat_writer.Write(key, mat);
+        WriteKaldiObject(mat, filename.str(), true);
+      }
+      mats.push_back(mat);
+      rxfilenames.push_back(mode == 1 ? filename.str() :
+                            "cat " + filename.str() + " |");
+    }
+  }
+  if (mode == 0) {
+    rxfilenames.clear();
+    const char *scps[] = { "tmpf2.scp", "tmpf.scp" };
+    for (int32 j = 0; j < 2; j++) {
+      // The scp files contain lines like "A tmpf2:2".
+      Input input(scps[j]);
+      std::string line;
+      while (std::getline(input.Stream(), line))
+        rxfilenames.push_back(line.substr(2));
+    }
+  }
+
+  std::vector<Matrix<BaseFloat> > range_mats;
+  {
+    Output output("tmpf_ranges.scp", false);
+    for (int32 i = 0; i < 20; i++) {
+      int32 src_i = RandInt(0, num_mats - 1);
+      const Matrix<BaseFloat> &src_mat = mats[src_i];
+      int32 tot_rows = src_mat.NumRows(), tot_cols = src_mat.NumCols(),
+          row_offset = RandInt(0, tot_rows - 1),
+          num_rows = RandInt(1, tot_rows - row_offset),
+          col_offset = RandInt(0, tot_cols - 1),
+          num_cols = RandInt(1, tot_cols - col_offset);
+      range_mats.push_back(Matrix<BaseFloat>(
+          src_mat.Range(row_offset, num_rows, col_offset, num_cols)));
+      output.Stream() << static_cast<char>('a' + i) << ' '
+                      << rxfilenames[src_i] << '[' << row_offset << ':';
+      // Sometimes go a little past the end, which is allowed.
+      if (row_offset + num_rows == tot_rows && RandInt(0, 1) == 0)
+        output.Stream() << (tot_rows + 1);
+      else
+        output.Stream() << (row_offset + num_rows - 1);
+      if (num_cols != tot_cols || RandInt(0, 1) == 0)
+        output.Stream() << ',' << col_offset << ':'
+                        << (col_offset + num_cols - 1);
+      output.Stream() << "]\n";
+    }
+  }
+
+  {
+    SequentialBaseFloatMatrixReader reader("scp:tmpf_ranges.scp");
+    int32 i = 0;
+    for (; !reader.Done(); reader.Next(), i++) {
+      KALDI_ASSERT(reader.Key() == std::string(1, 'a' + i));
+      KALDI_ASSERT(reader.Value().ApproxEqual(range_mats[i], 0.0));
+    }
+    KALDI_ASSERT(i == static_cast<int32>(range_mats.size()));
+  }
+  {
+    RandomAccessBaseFloatMatrixReader reader("scp:tmpf_ranges.scp");
+    RandomAccessDoubleMatrixReader double_reader("scp:tmpf_ranges.scp");
+    RandomAccessGeneralMatrixReader general_reader("scp:tmpf_ranges.scp");
+    for (int32 n = 0; n < 20; n++) {
+      int32 i = RandInt(0, range_mats.size() - 1);
+      std::string key(1, 'a' + i);
+      KALDI_ASSERT(reader.Value(key).ApproxEqual(range_mats[i], 0.0));
+      Matrix<BaseFloat> mat(double_reader.Value(key));
+      KALDI_ASSERT(mat.ApproxEqual(range_mats[i], 1.0e-06));
+      general_reader.Value(key).GetMatrix(&mat);
+      KALDI_ASSERT(mat.ApproxEqual(range_mats[i], 0.0));
+    }
+  }
+  unlink("tmpf");
+  unlink("tmpf2");
+  unlink("tmpf.scp");
+  unlink("tmpf2.scp");
+  unlink("tmpf_ranges.scp");
+  for (int32 i = 0; i < num_mats; i++) {
+    std::ostringstream filename;
+    filename << "tmpf_" << i;
+    unlink(filename.str().c_str());
+  }
+}
+
 void UnitTestTableRandomBothDoubleMatrix(bool binary, bool read_scp,
                                          bool sorted, bool called_sorted,
                                          bool once) {
@@ -1045,6 +1265,72 @@ void UnitTestTableRandomBothDoubleMatrix(bool binary, bool read_scp,
 }
 
 
+void UnitTestTableRandomIndexedMatrix(bool binary, bool both) {
+  int32 sz = Rand() % 10;
+  std::vector<std::string> k;
+  std::vector<Matrix<double> > v;
+  for (int32 i = 0; i < sz; i++) {
+    k.push_back(CharToString('a' + static_cast<char>(i)));
+    if (i % 2 == 0) k.back() = k.back() + CharToString('a' + i);
+    v.push_back(Matrix<double>(1 + Rand() % 5, 1 + Rand() % 5));
+    v.back().SetRandn();
+  }
+  RandomizeVector(&k);  // the index does not require sorted keys.
+
+  std::string wspecifier = std::string(binary ? "b," : "t,") +
+      (both ? "ark,scp,idx:tmpf,tmpf.scp" : "ark,idx:tmpf");
+  DoubleMatrixWriter writer(wspecifier);
+  for (int32 i = 0; i < sz; i++)
+    writer.Write(k[i], v[i]);
+  KALDI_ASSERT(writer.Close());
+
+  ArchiveIndex index;
+  KALDI_ASSERT(index.Open("tmpf.idx") && index.NumEntries() == sz);
+  KALDI_ASSERT(!index.Lookup("zz", NULL) && !index.Lookup("", NULL));
+  index.Close();
+
+  RandomAccessDoubleMatrixReader reader(Rand() % 2 == 0 ? "idx,ark:tmpf" :
+                                        "p,idx,ark:tmpf");
+  for (int32 n = 0; n < 2 * sz; n++) {
+    int32 i = Rand() % sz;
+    if (Rand() % 2 == 0)
+      KALDI_ASSERT(reader.HasKey(k[i]));
+    const Matrix<double> &value = reader.Value(k[i]);
+    if (binary) KALDI_ASSERT(value.ApproxEqual(v[i], 0.0));
+    else KALDI_ASSERT(value.ApproxEqual(v[i], 1.0e-05));
+  }
+  KALDI_ASSERT(!reader.HasKey("zz"));
+  KALDI_ASSERT(reader.Close());
+
+  // The sequential reader ignores the idx option.
+  SequentialDoubleMatrixReader seq_reader("idx,ark:tmpf");
+  int32 num_read = 0;
+  for (; !seq_reader.Done(); seq_reader.Next())
+    num_read++;
+  KALDI_ASSERT(num_read == sz);
+  seq_reader.Close();
+
+  // If the archive is truncated while it is mapped, reads must fail cleanly
+  // rather than touch the mapping past the end of the file.
+  if (sz > 0) {
+    RandomAccessDoubleMatrixReader truncated_reader("p,idx,ark:tmpf");
+    std::ofstream os("tmpf", std::ios::binary);
+    os.close();
+    KALDI_ASSERT(!truncated_reader.HasKey(k[0]));
+  }
+
+  // An index that does not match the archive should be rejected.
+  {
+    Output ko("tmpf", binary);
+    ko.Stream() << "extra";
+  }
+  RandomAccessDoubleMatrixReader stale_reader;
+  KALDI_ASSERT(!stale_reader.Open("idx,ark:tmpf"));
+
+  unlink("tmpf");
+  unlink("tmpf.idx");
+  unlink("tmpf.scp");
+}
 
 }  // end namespace kaldi.
 
@@ -1060,6 +1346,7 @@ int main() {
     UnitTestTableSequentialInt32Script(b);
     UnitTestTableSequentialDouble(b);
     UnitTestRangesMatrix(b);
+    UnitTestRangesCompressedMatrix(i % 3);
     for (int j = 0; j < 2; j++) {
       bool c = (j == 0);
       UnitTestTableSequentialDoubleBoth(b, c);
@@ -1068,6 +1355,8 @@ int main() {
       UnitTestTableSequentialInt32PairVectorBoth(b, c);
       UnitTestTableSequentialInt32VectorVectorBoth(b, c);
       UnitTestTableSequentialBaseFloatVectorBoth(b, c);
+      UnitTestTableRandomIndexedMatrix(b, c);
+      UnitTestTableBackgroundWriter(b, c);
       for (int k = 0; k < 2; k++) {
         bool d = (k == 0);
         for (int l = 0; l < 2; l++) {
@@ -20,6 +20,10 @@
 #include "util/kaldi-table.h"
 #include "util/text-utils.h"
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
 namespace kaldi {
 
 
@@ -183,6 +187,22 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
       if (opts) opts->binary = false;
     } else if (!strcmp(c, "p")) {
       if (opts) opts->permissive = true;
+    } else if (!strcmp(c, "idx")) {
+      if (opts) opts->index = true;
+    } else if (!strcmp(c, "bg")) {
+      if (opts) opts->background = true;
+    } else if (!strncmp(c, "bg=", 3)) {
+      int32 num_threads;
+      if (!ConvertStringToInteger(c + 3, &num_threads) || num_threads <= 0)
+        return kNoWspecifier;
+      if (opts) {
+        opts->background = true;
+        opts->num_background_threads = num_threads;
+      }
+    } else if (!strcmp(c, "packed")) {
+      if (opts) opts->packed = true;
+    } else if (!strcmp(c, "align")) {
+      if (opts) opts->align = true;
     } else if (!strcmp(c, "ark")) {
       if (ws == kNoWspecifier) ws = kArchiveWspecifier;
       else
@@ -293,6 +313,8 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
       if (opts) opts->called_sorted = false;
     } else if (!strcmp(c, "bg")) {
       if (opts) opts->background = true;
+    } else if (!strcmp(c, "idx")) {
+      if (opts) opts->indexed = true;
     } else if (!strcmp(c, "ark")) {
       if (rs == kNoRspecifier) rs = kArchiveRspecifier;
       else
@@ -314,6 +336,126 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
 }
 
 
+static const char kArchiveIndexMagic[9] = "KALDIIDX";
+static const size_t kArchiveIndexHeaderSize = 8 + 2 * sizeof(int64);
+
+bool WriteArchiveIndex(const std::string &filename,
+                       int64 archive_size,
+                       std::vector<std::pair<std::string, int64> > *entries) {
+  // stable_sort so that of duplicate keys, the first one written is kept.
+  std::stable_sort(entries->begin(), entries->end(),
+                   [](const std::pair<std::string, int64> &a,
+                      const std::pair<std::string, int64> &b) {
+                     return a.first < b.first; });
+  std::vector<int64> records;
+  records.reserve(3 * entries->size());
+  std::string keys;
+  for (size_t i = 0; i < entries->size(); i++) {
+    const std::pair<std::string, int64> &entry = (*entries)[i];
+    if (i > 0 && entry.first == (*entries)[i-1].first) {
+      KALDI_WARN << "Duplicate key " << entry.first << " in archive; only "
+                 << "the first one will be indexed in " << filename;
+      continue;
+    }
+    records.push_back(keys.size());
+    records.push_back(entry.first.size());
+    records.push_back(entry.second);
+    keys += entry.first;
+  }
+  std::ofstream os(filename.c_str(), std::ios::binary);
+  if (!os.is_open()) {
+    KALDI_WARN << "Could not open " << filename << " for writing.";
+    return false;
+  }
+  int64 num_entries = records.size() / 3;
+  os.write(kArchiveIndexMagic, 8);
+  os.write(reinterpret_cast<const char*>(&archive_size), sizeof(int64));
+  os.write(reinterpret_cast<const char*>(&num_entries), sizeof(int64));
+  if (!records.empty())
+    os.write(reinterpret_cast<const char*>(&(records[0])),
+             records.size() * sizeof(int64));
+  os.write(keys.data(), keys.size());
+  os.close();
+  if (os.fail()) {
+    KALDI_WARN << "Error writing archive index " << filename;
+    return false;
+  }
+  return true;
+}
+
+bool ArchiveIndex::Open(const std::string &filename, int64 archive_size) {
+  Close();
+  if (!file_.Open(filename))
+    return false;
+  const char *data = file_.Data();
+  size_t size = file_.Size();
+  int64 stored_archive_size = -1;
+  if (size >= kArchiveIndexHeaderSize &&
+      !memcmp(data, kArchiveIndexMagic, 8)) {
+    memcpy(&stored_archive_size, data + 8, sizeof(int64));
+    memcpy(&num_entries_, data + 8 + sizeof(int64), sizeof(int64));
+  }
+  if (stored_archive_size < 0 || num_entries_ < 0 ||
+      static_cast<uint64>(num_entries_) >
+      (size - kArchiveIndexHeaderSize) / (3 * sizeof(int64))) {
+    KALDI_WARN << "File " << filename << " is not a valid archive index.";
+    Close();
+    return false;
+  }
+  if (archive_size >= 0 && archive_size != stored_archive_size) {
+    KALDI_WARN << "Archive index " << filename << " is out of date: it is "
+               << "for an archive of size " << stored_archive_size
+               << " but the archive has size " << archive_size;
+    Close();
+    return false;
+  }
+  // The header size is a multiple of 8 and mmap() returns page-aligned
+  // memory, so the records are suitably aligned.
+  records_ = reinterpret_cast<const int64*>(data + kArchiveIndexHeaderSize);
+  keys_ = data + kArchiveIndexHeaderSize + 3 * sizeof(int64) * num_entries_;
+  size_t keys_size = size - (keys_ - data);
+  for (int64 i = 0; i < num_entries_; i++) {
+    const int64 *record = records_ + 3 * i;
+    if (record[0] < 0 || record[1] < 0 ||
+        static_cast<uint64>(record[0] + record[1]) > keys_size) {
+      KALDI_WARN << "Archive index " << filename << " is corrupted.";
+      Close();
+      return false;
+    }
+  }
+  return true;
+}
+
+void ArchiveIndex::Close() {
+  file_.Close();
+  num_entries_ = 0;
+  records_ = NULL;
+  keys_ = NULL;
+}
+
+bool ArchiveIndex::Lookup(const std::string &key, int64 *offset) const {
+  int64 lo = 0, hi = num_entries_;  // the key, if present, is in [lo, hi).
+  while (lo < hi) {
+    int64 mid = lo + (hi - lo) / 2;
+    const int64 *record = records_ + 3 * mid;
+    size_t len = record[1], min_len = std::min(len, key.size());
+    int c = memcmp(keys_ + record[0], key.data(), min_len);
+    if (c == 0)
+      c = (len < key.size() ? -1 : (len > key.size() ? 1 : 0));
+    if (c == 0) {
+      if (offset != NULL)
+        *offset = record[2];
+      return true;
+    } else if (c < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return false;
+}
+
+
 
 
 
@@ -27,6 +27,7 @@
 
 #include "base/kaldi-common.h"
 #include "util/kaldi-holder.h"
+#include "util/kaldi-mmap.h"
 
 namespace kaldi {
 
@@ -71,12 +72,42 @@ typedef std::vector<std::string> KeyList;
 //  p means permissive mode, when writing to an "scp" file only: will ignore
 //     missing scp entries, i.e. won't write anything for those files but will
 //     return success status).
+//  idx means also write a key index for the archive, to the file
+//     <archive-filename>.idx, when the writer is closed.  It is used by the
+//     "idx" rspecifier option (see below) for fast random access.  Only
+//     allowed if the archive is an actual file.
+//  bg means "background": Write() only queues a copy of the object, and
+//     worker threads serialize the objects (and compress them, if you use
+//     TableWriter::WriteCompressed()), while they are written out in the
+//     order they were given.  Write() blocks if too many objects are queued,
+//     and errors are reported by a later Write() or by Close().  This helps
+//     programs that spend a lot of their time writing, e.g. egs generation.
+//     bg=N is the same but uses N worker threads instead of 2, and allows
+//     N + 8 objects to be queued; use it if the serialization or compression
+//     can't keep up.
+//  packed means write objects in a smaller binary format, for types that
+//     have one; currently this is only CompactLattice (see
+//     WritePackedCompactLattice() in lat/kaldi-lattice.h).  It is ignored for
+//     other types and in text mode.  Readers recognize the packed format
+//     automatically, so no rspecifier option is needed to read it back.
+//  align means pad a binary archive with newlines before keys, which readers
+//     skip, so that the data of uncompressed matrices is aligned in the file
+//     and MatrixView can use it in place when the archive is memory-mapped
+//     (see matrix-view.h); it is mainly useful together with idx.  It has no
+//     effect if the position in the output is not known (e.g. for pipes, or
+//     with bg).  Without it, archives are written exactly as by older
+//     versions of Kaldi.
 //
 //  So the following are valid wspecifiers:
 //  ark,b,f:foo
 //  "ark,b,b:| gzip -c > foo"
 //  "ark,scp,t,nf:foo.ark,|gzip -c > foo.scp.gz"
 //  ark,b:-
+//  ark,idx:foo.ark
+//  ark,idx,align:foo.ark
+//  ark,bg:foo.ark
+//  ark,bg=4:foo.ark
+//  "ark,packed:| gzip -c > lat.1.gz"
 //
 //  The meanings of rxfilename and wxfilename are as described in
 //  kaldi-io.h (they are filenames but include pipes, stdin/stdout
@@ -114,7 +145,15 @@ struct WspecifierOptions {
   bool binary;
   bool flush;
   bool permissive;  // will ignore absent scp entries.
-  WspecifierOptions(): binary(true), flush(false), permissive(false) { }
+  bool index;  // write <archive>.idx when closing (for archives only).
+  bool background;  // serialize and write objects in background threads.
+  int32 num_background_threads;  // the number of those threads (bg=N).
+  bool packed;  // use the packed binary format, for types that have one.
+  bool align;  // pad binary archives so that matrix data is aligned.
+  WspecifierOptions(): binary(true), flush(false), permissive(false),
+                       index(false), background(false),
+                       num_background_threads(2), packed(false),
+                       align(false) { }
 };
 
 // ClassifyWspecifier returns the type of the wspecifier string,
@@ -190,6 +229,15 @@ bool WriteScriptFile(std::ostream &os,
 //       such as neural-net training examples, especially when you want to
 //       maximize GPU usage.
 //
+//   idx means that the archive is an actual file with an up-to-date index
+//       <archive-filename>.idx, as written by the "idx" wspecifier option.
+//       For random-access readers this memory-maps the archive and the index
+//       and reads each object directly from its offset when it is asked for,
+//       instead of reading the archive sequentially and holding the objects in
+//       memory; the "s", "cs" and "o" options are then irrelevant, and memory
+//       use does not depend on the size of the archive.  It has no effect for
+//       sequential readers.
+//
 //   b   is ignored [for scripting convenience]
 //   t   is ignored [for scripting convenience]
 //
@@ -197,6 +245,7 @@ bool WriteScriptFile(std::ostream &os,
 //  So for instance the following would be a valid rspecifier:
 //
 //   "o, s, p, ark:gunzip -c foo.gz|"
+//   "idx, ark:foo.ark"
 
 struct  RspecifierOptions {
   // These options only make a difference for the RandomAccessTableReader class.
@@ -211,9 +260,12 @@ struct  RspecifierOptions {
   bool background;  // For sequential readers, if the background option ("bg")
                     // is provided, it will read ahead to the next object in a
                     // background thread.
+  bool indexed;  // For random-access readers of archives, if the "idx" option
+                 // is provided, look up keys in <archive>.idx and read objects
+                 // from a memory-mapped archive.
   RspecifierOptions(): once(false), sorted(false),
                        called_sorted(false), permissive(false),
-                       background(false) { }
+                       background(false), indexed(false) { }
 };
 
 enum RspecifierType  {
@@ -227,6 +279,51 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
                                   RspecifierOptions *opts);
 
 
+// Writes an index for an archive: 'entries' contains, for each object in
+// the archive, its key and the byte offset of the object (i.e. the position
+// just after "key "), in any order.  'archive_size' is the size of the
+// archive in bytes; it is stored so that an index that is older than its
+// archive can be detected.  If a key appears more than once, the first
+// occurrence is indexed and a warning is printed.  'filename' must be an
+// actual file (normally <archive-filename>.idx).  Returns true on success.
+//
+// The index is a binary file in the machine's native byte order: the magic
+// string "KALDIIDX", then the archive size, the number of entries N, then N
+// records (key-position, key-length, object-offset) sorted on key, all as
+// 64-bit integers, then the keys themselves, concatenated.
+bool WriteArchiveIndex(const std::string &filename,
+                       int64 archive_size,
+                       std::vector<std::pair<std::string, int64> > *entries);
+
+/// ArchiveIndex memory-maps an index written by WriteArchiveIndex() and
+/// looks up keys in it by binary search, without reading it into memory.
+class ArchiveIndex {
+ public:
+  ArchiveIndex(): num_entries_(0), records_(NULL), keys_(NULL) { }
+
+  /// Opens the index 'filename'.  If archive_size >= 0, checks that it
+  /// matches the archive size stored in the index.  Returns false and prints
+  /// a warning on failure.
+  bool Open(const std::string &filename, int64 archive_size = -1);
+
+  bool IsOpen() const { return file_.IsOpen(); }
+
+  void Close();
+
+  int64 NumEntries() const { return num_entries_; }
+
+  /// If 'key' is in the index, returns true and, if 'offset' is non-NULL,
+  /// outputs the byte offset of its object in the archive.
+  bool Lookup(const std::string &key, int64 *offset) const;
+
+ private:
+  MappedFile file_;
+  int64 num_entries_;
+  const int64 *records_;
+  const char *keys_;
+};
+
+
 /// Allows random access to a collection
 /// of objects in an archive or script file; see \ref io_sec_tables.
 template<class Holder>
@@ -386,6 +483,11 @@ class TableWriter {
   // Write the object. Throws KaldiFatalError on error via the KALDI_ERR macro.
   inline void Write(const std::string &key, const T &value) const;
 
+  // Like Write(), but calls Compress() on the object before writing it; for
+  // types that have that function, e.g. NnetExample.  Normally *value is
+  // compressed in place, so don't rely on its contents afterwards; with the
+  // "bg" option a copy is compressed in a background thread instead.
+  void WriteCompressed(const std::string &key, T *value) const;
 
   // Flush will flush any archive; it does not return error status
   // or throw, any errors will be reported on the next Write or Close.
@@ -408,6 +510,7 @@ class TableWriter {
   }
  private:
   TableWriter &operator = (const TableWriter&);  // Disallow assignment.
+  static void CompressObject(T *t) { t->Compress(); }  // see WriteCompressed().
 
   void CheckImpl() const;  // Checks that impl_ is non-NULL; prints an error
                            // message and dies (with KALDI_ERR) if NULL.
@@ -0,0 +1,171 @@
+// util/matrix-view-test.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+#include <fstream>
+#include "util/matrix-view.h"
+#include "util/table-types.h"
+
+namespace kaldi {
+
+// Writes some random matrices, with keys of different lengths (so the data
+// would have different alignments if the writer did not pad the archive), and
+// returns them.  The data of the first one, at offset 4 + 16 in the archive,
+// is aligned even without padding.
+static void WriteMatrices(const std::string &wspecifier,
+                          std::vector<std::string> *keys,
+                          std::vector<Matrix<BaseFloat> > *mats) {
+  BaseFloatMatrixWriter writer(wspecifier);
+  for (int32 i = 0; i < 8; i++) {
+    keys->push_back(std::string(i + 4, 'a' + i));
+    mats->push_back(Matrix<BaseFloat>(5 + Rand() % 5, 1 + Rand() % 5));
+    mats->back().SetRandn();
+    writer.Write(keys->back(), mats->back());
+  }
+}
+
+void UnitTestMatrixViewMapped(const std::string &rspecifier, bool align) {
+  std::vector<std::string> keys;
+  std::vector<Matrix<BaseFloat> > mats;
+  WriteMatrices(align ? "b,ark,scp,idx,align:tmpf,tmpf.scp" :
+                "b,ark,scp,idx:tmpf,tmpf.scp", &keys, &mats);
+  if (!align) {
+    // Without the align option the archive is not padded.
+    int64 expected_size = 0;
+    for (size_t i = 0; i < keys.size(); i++)
+      expected_size += keys[i].size() + 1 + 15 +
+          sizeof(BaseFloat) * mats[i].NumRows() * mats[i].NumCols();
+    std::ifstream is("tmpf", std::ios::binary | std::ios::ate);
+    KALDI_ASSERT(static_cast<int64>(is.tellg()) == expected_size);
+  }
+
+  RandomAccessBaseFloatMatrixViewReader reader(rspecifier);
+  for (size_t i = 0; i < keys.size(); i++) {
+    const MatrixView<BaseFloat> &view = reader.Value(keys[i]);
+    KALDI_ASSERT(!view.IsCompressed());
+    KALDI_ASSERT(view.Mat().ApproxEqual(mats[i], 0.0));
+    // With the align option the writer aligns the data, so all of them are
+    // mapped.
+    KALDI_ASSERT(view.IsMapped() || (!align && i != 0));
+
+    // A copy of a mapped view points to the same data.
+    MatrixView<BaseFloat> copy(view);
+    KALDI_ASSERT(copy.IsMapped() == view.IsMapped() &&
+                 copy.Mat().ApproxEqual(mats[i], 0.0));
+    if (view.IsMapped())
+      KALDI_ASSERT(copy.Mat().Data() == view.Mat().Data());
+
+    MatrixView<BaseFloat> range;
+    KALDI_ASSERT(ExtractObjectRange(view, "1:3,0:0", &range));
+    KALDI_ASSERT(range.NumRows() == 3 && range.NumCols() == 1 &&
+                 range.IsMapped() == view.IsMapped());
+    Matrix<BaseFloat> expected(mats[i].Range(1, 3, 0, 1));
+    KALDI_ASSERT(range.Mat().ApproxEqual(expected, 0.0));
+    Matrix<BaseFloat> block(3, 1);
+    view.CopyToMat(1, 0, &block);
+    KALDI_ASSERT(block.ApproxEqual(expected, 0.0));
+  }
+  reader.Close();
+  unlink("tmpf");
+  unlink("tmpf.scp");
+  unlink("tmpf.idx");
+}
+
+void UnitTestMatrixViewNotMapped() {
+  std::vector<std::string> keys;
+  std::vector<Matrix<BaseFloat> > mats;
+  WriteMatrices("t,ark:tmpf", &keys, &mats);
+  SequentialBaseFloatMatrixViewReader reader("ark:tmpf");
+  for (size_t i = 0; !reader.Done(); reader.Next(), i++) {
+    const MatrixView<BaseFloat> &view = reader.Value();
+    KALDI_ASSERT(reader.Key() == keys[i] && !view.IsMapped());
+    KALDI_ASSERT(view.Mat().ApproxEqual(mats[i], 1.0e-04));
+    MatrixView<BaseFloat> view1(view), view2;
+    view2.Swap(&view1);
+    KALDI_ASSERT(view2.Mat().ApproxEqual(mats[i], 1.0e-04) &&
+                 view1.NumRows() == 0);
+  }
+  unlink("tmpf");
+}
+
+void UnitTestMatrixViewCompressed() {
+  Matrix<BaseFloat> mat(20, 10);
+  mat.SetRandn();
+  CompressedMatrix cmat(mat);
+  Matrix<BaseFloat> decompressed(20, 10);
+  cmat.CopyToMat(&decompressed);
+  {
+    CompressedMatrixWriter writer("ark,scp:tmpf,tmpf.scp");
+    writer.Write("foo", cmat);
+  }
+  RandomAccessBaseFloatMatrixViewReader reader("scp:tmpf.scp");
+  const MatrixView<BaseFloat> &view = reader.Value("foo");
+  KALDI_ASSERT(view.IsCompressed() && view.NumRows() == 20 &&
+               view.NumCols() == 10);
+  Matrix<BaseFloat> block(4, 3);
+  view.CopyToMat(5, 2, &block);
+  KALDI_ASSERT(block.ApproxEqual(Matrix<BaseFloat>(
+      decompressed.Range(5, 4, 2, 3)), 0.0));
+  KALDI_ASSERT(view.Mat().ApproxEqual(decompressed, 0.0));
+  MatrixView<BaseFloat> uncompressed(view);
+  uncompressed.Uncompress();
+  KALDI_ASSERT(!uncompressed.IsCompressed() &&
+               uncompressed.Mat().ApproxEqual(decompressed, 0.0));
+  reader.Close();
+
+  // Ranges of compressed matrices are read directly, and stay compressed if
+  // they have all the columns.
+  std::string line;
+  {
+    Input input("tmpf.scp");
+    std::getline(input.Stream(), line);
+  }
+  {
+    Output output("tmpf_ranges.scp", false);
+    output.Stream() << line << "[3:7]\n" << "bar"
+                    << line.substr(3) << "[3:7,2:4]\n";
+  }
+  RandomAccessBaseFloatMatrixViewReader range_reader("scp:tmpf_ranges.scp");
+  const MatrixView<BaseFloat> &range = range_reader.Value("foo");
+  KALDI_ASSERT(range.IsCompressed() && range.Mat().ApproxEqual(
+      Matrix<BaseFloat>(decompressed.RowRange(3, 5)), 0.0));
+  const MatrixView<BaseFloat> &block2 = range_reader.Value("bar");
+  KALDI_ASSERT(!block2.IsCompressed() && block2.Mat().ApproxEqual(
+      Matrix<BaseFloat>(decompressed.Range(3, 5, 2, 3)), 0.0));
+  range_reader.Close();
+  unlink("tmpf");
+  unlink("tmpf.scp");
+  unlink("tmpf_ranges.scp");
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 5; i++) {
+    UnitTestMatrixViewMapped("scp:tmpf.scp", true);
+    UnitTestMatrixViewMapped("idx,ark:tmpf", true);
+    UnitTestMatrixViewMapped("scp:tmpf.scp", false);
+    UnitTestMatrixViewMapped("idx,ark:tmpf", false);
+    UnitTestMatrixViewNotMapped();
+    UnitTestMatrixViewCompressed();
+  }
+  std::cout << "Test OK.\n";
+  return 0;
+}
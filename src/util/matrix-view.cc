@@ -0,0 +1,255 @@
+// util/matrix-view.cc
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <vector>
+#include "util/matrix-view.h"
+#include "util/kaldi-holder.h"
+
+namespace kaldi {
+
+template<typename Real>
+MatrixView<Real> &MatrixView<Real>::operator = (const MatrixView<Real> &other) {
+  if (&other == this)
+    return *this;
+  Clear();
+  if (other.IsCompressed()) {
+    compressed_ = other.compressed_;
+  } else if (other.data_ != NULL && other.data_ == other.owned_.Data()) {
+    owned_ = other.owned_;
+    PointToOwned();
+  } else {
+    // 'other' points to mapped memory (or is empty); share it.
+    file_ = other.file_;
+    data_ = other.data_;
+    num_rows_ = other.num_rows_;
+    num_cols_ = other.num_cols_;
+    stride_ = other.stride_;
+  }
+  return *this;
+}
+
+template<typename Real>
+void MatrixView<Real>::PointToOwned() {
+  data_ = owned_.Data();
+  num_rows_ = owned_.NumRows();
+  num_cols_ = owned_.NumCols();
+  stride_ = owned_.Stride();
+}
+
+template<typename Real>
+const SubMatrix<Real> MatrixView<Real>::Mat() const {
+  if (IsCompressed()) {
+    if (owned_.NumRows() == 0) {
+      owned_.Resize(compressed_.NumRows(), compressed_.NumCols(), kUndefined);
+      compressed_.CopyToMat(&owned_);
+    }
+    return SubMatrix<Real>(owned_, 0, owned_.NumRows(), 0, owned_.NumCols());
+  }
+  return SubMatrix<Real>(const_cast<Real*>(data_), num_rows_, num_cols_,
+                         stride_);
+}
+
+template<typename Real>
+void MatrixView<Real>::Uncompress() {
+  if (!IsCompressed())
+    return;
+  if (owned_.NumRows() == 0) {
+    owned_.Resize(compressed_.NumRows(), compressed_.NumCols(), kUndefined);
+    compressed_.CopyToMat(&owned_);
+  }
+  compressed_.Clear();
+  file_.reset();
+  PointToOwned();
+}
+
+template<typename Real>
+void MatrixView<Real>::CopyToMat(MatrixIndexT row_offset,
+                                 MatrixIndexT col_offset,
+                                 MatrixBase<Real> *dest) const {
+  KALDI_ASSERT(row_offset >= 0 && col_offset >= 0 &&
+               row_offset + dest->NumRows() <= NumRows() &&
+               col_offset + dest->NumCols() <= NumCols());
+  if (dest->NumRows() == 0 || dest->NumCols() == 0)
+    return;
+  if (IsCompressed() && owned_.NumRows() == 0)
+    compressed_.CopyToMat(row_offset, col_offset, dest);
+  else
+    dest->CopyFromMat(Mat().Range(row_offset, dest->NumRows(),
+                                  col_offset, dest->NumCols()));
+}
+
+template<typename Real>
+void MatrixView<Real>::SetRange(const MatrixView<Real> &other,
+                                MatrixIndexT row_offset, MatrixIndexT num_rows,
+                                MatrixIndexT col_offset, MatrixIndexT num_cols) {
+  KALDI_ASSERT(&other != this && row_offset >= 0 && col_offset >= 0 &&
+               num_rows >= 0 && num_cols >= 0 &&
+               row_offset + num_rows <= other.NumRows() &&
+               col_offset + num_cols <= other.NumCols());
+  Clear();
+  if (num_rows == 0 || num_cols == 0)
+    return;
+  if (other.IsCompressed() ||
+      (other.data_ != NULL && other.data_ == other.owned_.Data())) {
+    owned_.Resize(num_rows, num_cols, kUndefined);
+    other.CopyToMat(row_offset, col_offset, &owned_);
+    PointToOwned();
+  } else {
+    file_ = other.file_;
+    data_ = other.data_ + row_offset * other.stride_ + col_offset;
+    num_rows_ = num_rows;
+    num_cols_ = num_cols;
+    stride_ = other.stride_;
+  }
+}
+
+template<typename Real>
+void MatrixView<Real>::Read(std::istream &is, bool binary) {
+  Clear();
+  if (binary) {
+    int peekval = Peek(is, binary);
+    if (peekval == 'C') {
+      compressed_.Read(is, binary);
+      return;
+    }
+    const char *my_token = (sizeof(Real) == 4 ? "FM" : "DM");
+    MemoryStreamBuf *buf = dynamic_cast<MemoryStreamBuf*>(is.rdbuf());
+    if (buf != NULL && buf->File() != NULL && peekval == my_token[0]) {
+      ExpectToken(is, binary, my_token);
+      int32 rows, cols;
+      ReadBasicType(is, binary, &rows);
+      ReadBasicType(is, binary, &cols);
+      if (rows < 0 || cols < 0 || (rows == 0) != (cols == 0))
+        KALDI_ERR << "Invalid matrix dimensions " << rows << " x " << cols;
+      size_t num_bytes = sizeof(Real) * static_cast<size_t>(rows) * cols;
+      if (num_bytes > buf->BytesRemaining())
+        KALDI_ERR << "Failed to read matrix from stream: file too short.";
+      const char *ptr = buf->CurrentPointer();
+      // The view may be used long after this, so check that the file has
+      // not been truncated under the mapping (which would give SIGBUS).
+      if (!buf->File()->InRange(ptr - buf->File()->Data(), num_bytes))
+        KALDI_ERR << "Failed to read matrix: the file was truncated while "
+                  << "it was being read.";
+      if (reinterpret_cast<size_t>(ptr) % sizeof(Real) == 0) {
+        file_ = buf->File();
+        data_ = (rows == 0 ? NULL : reinterpret_cast<const Real*>(ptr));
+        num_rows_ = rows;
+        num_cols_ = cols;
+        stride_ = cols;
+        is.seekg(num_bytes, std::ios_base::cur);
+      } else {
+        owned_.Resize(rows, cols, kUndefined);
+        for (int32 r = 0; r < rows; r++)
+          is.read(reinterpret_cast<char*>(owned_.RowData(r)),
+                  sizeof(Real) * cols);
+        PointToOwned();
+      }
+      if (is.fail())
+        KALDI_ERR << "Failed to read matrix from stream.";
+      return;
+    }
+  }
+  owned_.Read(is, binary);
+  PointToOwned();
+}
+
+template<typename Real>
+void MatrixView<Real>::Write(std::ostream &os, bool binary) const {
+  if (IsCompressed())
+    compressed_.Write(os, binary);
+  else
+    Mat().Write(os, binary);
+}
+
+template<typename Real>
+void MatrixView<Real>::Clear() {
+  compressed_.Clear();
+  file_.reset();
+  owned_.Resize(0, 0);
+  data_ = NULL;
+  num_rows_ = num_cols_ = stride_ = 0;
+}
+
+template<typename Real>
+void MatrixView<Real>::Swap(MatrixView<Real> *other) {
+  // Matrix::Swap swaps the pointers, so data_ stays valid.
+  compressed_.Swap(&(other->compressed_));
+  file_.swap(other->file_);
+  owned_.Swap(&(other->owned_));
+  std::swap(data_, other->data_);
+  std::swap(num_rows_, other->num_rows_);
+  std::swap(num_cols_, other->num_cols_);
+  std::swap(stride_, other->stride_);
+}
+
+template<typename Real>
+bool ExtractObjectRange(const MatrixView<Real> &input,
+                        const std::string &range,
+                        MatrixView<Real> *output) {
+  std::vector<int32> row_range, col_range;
+  if (!ParseMatrixRangeSpecifier(range, input.NumRows(), input.NumCols(),
+                                 &row_range, &col_range)) {
+    KALDI_ERR << "Could not parse range specifier \"" << range << "\".";
+  }
+  int32 row_size = std::min(row_range[1], input.NumRows() - 1)
+                   - row_range[0] + 1,
+        col_size = col_range[1] - col_range[0] + 1;
+  output->SetRange(input, row_range[0], row_size, col_range[0], col_size);
+  return true;
+}
+
+template<typename Real>
+bool ReadObjectRange(std::istream &is, bool binary, const std::string &range,
+                     MatrixView<Real> *output) {
+  if (!binary || Peek(is, binary) != 'C') {
+    // Reading the whole matrix only maps it, or copies it if it can't.
+    MatrixView<Real> input;
+    input.Read(is, binary);
+    return ExtractObjectRange(input, range, output);
+  }
+  int32 row_offset, num_rows, rows;
+  ParseMatrixRangeRows(range, &row_offset, &num_rows);
+  MatrixView<Real> row_block;  // the rows asked for, with all the columns.
+  row_block.compressed_.ReadRowRange(is, row_offset, num_rows, &rows);
+  int32 cols = row_block.NumCols();
+  std::vector<int32> row_range, col_range;
+  if (!ParseMatrixRangeSpecifier(range, rows, cols, &row_range, &col_range)) {
+    KALDI_ERR << "Could not parse range specifier \"" << range << "\".";
+  }
+  int32 col_size = col_range[1] - col_range[0] + 1;
+  if (col_size == cols)
+    output->Swap(&row_block);
+  else
+    output->SetRange(row_block, 0, row_block.NumRows(), col_range[0],
+                     col_size);
+  return true;
+}
+
+template class MatrixView<float>;
+template class MatrixView<double>;
+
+template bool ExtractObjectRange(const MatrixView<float> &, const std::string &,
+                                 MatrixView<float> *);
+template bool ExtractObjectRange(const MatrixView<double> &,
+                                 const std::string &, MatrixView<double> *);
+template bool ReadObjectRange(std::istream &, bool, const std::string &,
+                              MatrixView<float> *);
+template bool ReadObjectRange(std::istream &, bool, const std::string &,
+                              MatrixView<double> *);
+
+}  // namespace kaldi
@@ -0,0 +1,169 @@
+// util/matrix-view.h
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_MATRIX_VIEW_H_
+#define KALDI_UTIL_MATRIX_VIEW_H_
+
+#include <memory>
+#include <string>
+#include "base/kaldi-common.h"
+#include "matrix/kaldi-matrix.h"
+#include "matrix/compressed-matrix.h"
+#include "util/kaldi-mmap.h"
+
+namespace kaldi {
+
+template<class KaldiType> class KaldiObjectHolder;
+
+/**
+   MatrixView is a read-only matrix for use in Tables (as
+   KaldiObjectHolder<MatrixView<Real> >; see the typedefs such as
+   RandomAccessBaseFloatMatrixViewReader in table-types.h), for programs that
+   only look at the matrices they read.  It reads the same formats as
+   Matrix<Real>, but avoids copying the data where it can:
+
+    - When a binary matrix of type Real is read from memory-mapped data (i.e.
+      from a stream whose buffer is a MemoryStreamBuf that owns a MappedFile,
+      which is the case for "file:offset" rxfilenames in scp files and for
+      archives read with the "idx" rspecifier option), the view points
+      directly at the data in the file and nothing is allocated or copied.
+      This requires the data to be suitably aligned for Real.  Archives
+      written with the "align" wspecifier option are padded so that it is
+      (see HolderDataAlignment() in kaldi-holder-inl.h); otherwise it depends
+      on the key length.  Data that is not aligned is copied as it would be
+      by Matrix.
+    - A compressed matrix is kept compressed, and CopyToMat() decompresses only
+      the part that is asked for.  Mat() decompresses the whole matrix, the
+      first time it is called.
+    - Anything else is read into a Matrix<Real> that the view owns.
+
+   The memory that the view points to is only valid while the view exists (it
+   keeps the file mapped), and must not be written to.  The file must not be
+   truncated while a view points into it: accessing the data would then raise
+   SIGBUS (see MappedFile in kaldi-mmap.h).  Like Matrix, this
+   class is not thread-safe, and note that this applies to the const function
+   Mat() too, which decompresses into a cache the first time it is called:
+   if several threads use the same view, call Mat() (or Uncompress()) before
+   sharing it.
+*/
+template<typename Real>
+class MatrixView {
+ public:
+  MatrixView(): data_(NULL), num_rows_(0), num_cols_(0), stride_(0) { }
+
+  MatrixView(const MatrixView<Real> &other):
+      data_(NULL), num_rows_(0), num_cols_(0), stride_(0) { *this = other; }
+
+  MatrixView<Real> &operator = (const MatrixView<Real> &other);
+
+  MatrixIndexT NumRows() const {
+    return (compressed_.NumRows() != 0 ? compressed_.NumRows() : num_rows_);
+  }
+  MatrixIndexT NumCols() const {
+    return (compressed_.NumRows() != 0 ? compressed_.NumCols() : num_cols_);
+  }
+
+  /// Returns true if the data is stored in compressed form.
+  bool IsCompressed() const { return compressed_.NumRows() != 0; }
+
+  /// Returns true if the data points into a memory-mapped file, i.e. it was
+  /// read without copying.
+  bool IsMapped() const { return file_ != NULL; }
+
+  /// Returns the matrix.  If it is compressed, this decompresses all of it
+  /// (once); use CopyToMat() if you only need part of it.  You must not
+  /// change the contents.  Not thread-safe for compressed matrices, see above.
+  const SubMatrix<Real> Mat() const;
+
+  /// If the matrix is compressed, decompresses it, so that it is written
+  /// uncompressed by Write().
+  void Uncompress();
+
+  /// Copies the block of the matrix of the size of 'dest', starting at
+  /// (row_offset, col_offset), to 'dest'.  If the matrix is compressed only
+  /// that block is decompressed.
+  void CopyToMat(MatrixIndexT row_offset, MatrixIndexT col_offset,
+                 MatrixBase<Real> *dest) const;
+
+  /// Sets *this to the block of 'other' starting at (row_offset, col_offset)
+  /// with the given size.  Unless 'other' is compressed (in which case the
+  /// block is decompressed), no data is copied.
+  void SetRange(const MatrixView<Real> &other,
+                MatrixIndexT row_offset, MatrixIndexT num_rows,
+                MatrixIndexT col_offset, MatrixIndexT num_cols);
+
+  void Read(std::istream &is, bool binary);
+
+  /// Writes in the same format as Matrix<Real> (or CompressedMatrix, if
+  /// compressed).
+  void Write(std::ostream &os, bool binary) const;
+
+  void Clear();
+
+  void Swap(MatrixView<Real> *other);
+
+  template<typename R>
+  friend bool ReadObjectRange(std::istream &is, bool binary,
+                              const std::string &range, MatrixView<R> *output);
+ private:
+  // Makes data_ etc. point to owned_.
+  void PointToOwned();
+
+  // If nonempty, the matrix is compressed and data_ is NULL.
+  CompressedMatrix compressed_;
+  // If the data is in a mapped file, this keeps it mapped.
+  std::shared_ptr<const MappedFile> file_;
+  // Holds the data if it is neither compressed nor mapped, and the
+  // decompressed matrix if Mat() was called for a compressed matrix.
+  mutable Matrix<Real> owned_;
+  const Real *data_;
+  MatrixIndexT num_rows_;
+  MatrixIndexT num_cols_;
+  MatrixIndexT stride_;
+};
+
+/// Extracts a [first-row:last-row,first-col:last-col] range of a MatrixView,
+/// as for Matrix (see kaldi-holder.h); no data is copied unless 'input' is
+/// compressed.
+template<typename Real>
+bool ExtractObjectRange(const MatrixView<Real> &input,
+                        const std::string &range,
+                        MatrixView<Real> *output);
+
+/// Reads a range of a MatrixView from a stream (see ReadObjectRange() in
+/// kaldi-holder.h).  For a compressed matrix, only the rows in the range are
+/// read, and they stay compressed if all columns are wanted.
+template<typename Real>
+bool ReadObjectRange(std::istream &is, bool binary, const std::string &range,
+                     MatrixView<Real> *output);
+
+/// Tells the archive writers where the data of an uncompressed MatrixView is
+/// (see HolderDataAlignment() in kaldi-holder-inl.h).
+template<typename Real>
+bool HolderDataAlignment(const MatrixView<Real> &t,
+                         const KaldiObjectHolder<MatrixView<Real> > *holder,
+                         int32 *header_size, int32 *alignment) {
+  if (t.IsCompressed())
+    return false;
+  *header_size = 15;  // As for Matrix.
+  *alignment = sizeof(Real);
+  return true;
+}
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_MATRIX_VIEW_H_
@@ -18,6 +18,12 @@
 // MERCHANTABLITY OR NON-INFRINGEMENT.
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+#include <fstream>
+#include <iterator>
+#include "base/trace-profiler.h"
 #include "util/parse-options.h"
 
 namespace kaldi {
@@ -295,12 +301,33 @@ void UnitTestParseOptions() {
   KALDI_ASSERT(po6.GetArg(1) == "--foo=8");
 }
 
+// Checks that the trace requested with --trace-file is written when the
+// ParseOptions object is destroyed, i.e. before main() returns.
+void UnitTestParseOptionsTraceFile() {
+  std::string filename = "tmp.parse-options-test.trace";
+  unlink(filename.c_str());
+  {
+    int argc = 2;
+    std::string arg = "--trace-file=" + filename;
+    const char *argv[3] = { "program_name", arg.c_str(), NULL };
+    ParseOptions po("my usage msg");
+    po.Read(argc, argv);
+    KALDI_TRACE_SCOPE("UnitTestParseOptionsTraceFile");
+  }
+  std::ifstream is(filename.c_str());
+  std::string contents((std::istreambuf_iterator<char>(is)),
+                       std::istreambuf_iterator<char>());
+  KALDI_ASSERT(contents.find("UnitTestParseOptionsTraceFile") !=
+               std::string::npos);
+  unlink(filename.c_str());
+}
 
 }  // end namespace kaldi.
 
 int main() {
   using namespace kaldi;
   UnitTestParseOptions();
+  UnitTestParseOptionsTraceFile();
   return 0;
 }
 
@@ -32,6 +32,7 @@
 #include "util/parse-options.h"
 #include "util/text-utils.h"
 #include "base/kaldi-common.h"
+#include "base/trace-profiler.h"
 
 namespace kaldi {
 
@@ -53,6 +54,11 @@ ParseOptions::ParseOptions(const std::string &prefix,
   }
 }
 
+ParseOptions::~ParseOptions() {
+  if (!trace_file_.empty())
+    TraceProfiler::Stop();
+}
+
 void ParseOptions::Register(const std::string &name,
                             bool *ptr, const std::string &doc) {
   RegisterTmpl(name, ptr, doc);
@@ -378,6 +384,9 @@ int ParseOptions::Read(int argc, const char *const argv[]) {
     }
   }
 
+  if (!trace_file_.empty())
+    TraceProfiler::Start(trace_file_);
+
   // if the user did not suppress this with --print-args = false....
   if (print_args_) {
     std::ostringstream strm;
@@ -48,6 +48,10 @@ class ParseOptions : public OptionsItf {
     RegisterStandard("help", &help_, "Print out usage message");
     RegisterStandard("verbose", &g_kaldi_verbose_level,
                      "Verbose level (higher->more logging)");
+    RegisterStandard("trace-file", &trace_file_, "If set, record where the "
+                     "time is spent (see TraceProfiler) and, at the end, write "
+                     "it to this file in Chrome trace-event JSON format "
+                     "(viewable in chrome://tracing, Perfetto or speedscope)");
   }
 
   /**
@@ -68,7 +72,10 @@ class ParseOptions : public OptionsItf {
    */
   ParseOptions(const std::string &prefix, OptionsItf *other);
 
-  ~ParseOptions() {}
+  /// If --trace-file was given, stops the TraceProfiler and writes the trace.
+  /// Programs declare their ParseOptions object in main(), so this happens
+  /// before main() returns rather than during static destruction.
+  ~ParseOptions();
 
   // Methods from the interface
   void Register(const std::string &name,
@@ -209,6 +216,7 @@ class ParseOptions : public OptionsItf {
   bool print_args_;     ///< variable for the implicit --print-args parameter
   bool help_;           ///< variable for the implicit --help parameter
   std::string config_;  ///< variable for the implicit --config parameter
+  std::string trace_file_;  ///< variable for the implicit --trace-file parameter
   std::vector<std::string> positional_args_;
   const char *usage_;
   int argc_;
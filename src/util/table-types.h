@@ -23,6 +23,7 @@
 #include "base/kaldi-common.h"
 #include "util/kaldi-table.h"
 #include "util/kaldi-holder.h"
+#include "util/matrix-view.h"
 #include "matrix/matrix-lib.h"
 
 namespace kaldi {
@@ -54,6 +55,15 @@ typedef RandomAccessTableReaderMapped<KaldiObjectHolder<Matrix<double> > >
 typedef TableWriter<KaldiObjectHolder<CompressedMatrix> >
                                       CompressedMatrixWriter;
 
+// Readers of read-only matrices that avoid copying the data where possible,
+// and a writer for them; see MatrixView in matrix-view.h.
+typedef SequentialTableReader<KaldiObjectHolder<MatrixView<BaseFloat> > >
+                              SequentialBaseFloatMatrixViewReader;
+typedef RandomAccessTableReader<KaldiObjectHolder<MatrixView<BaseFloat> > >
+                                RandomAccessBaseFloatMatrixViewReader;
+typedef TableWriter<KaldiObjectHolder<MatrixView<BaseFloat> > >
+                    BaseFloatMatrixViewWriter;
+
 typedef TableWriter<KaldiObjectHolder<VectorBase<BaseFloat> > >
                                       BaseFloatVectorWriter;
 typedef SequentialTableReader<KaldiObjectHolder<Vector<BaseFloat> > >